@@ -8,17 +8,27 @@
 #include "string.hpp"
 #include "hash.hpp"
 #include "hash_set.hpp"
+#include "frozen_hash_list.hpp"
+#include "hash_pool.hpp"
+#include "hash_table.hpp"
+#include "concurrent_hash_set.hpp"
 #include "hash_container_list.hpp"
 #include "hash_data_file_set.hpp"
 #include "distributed_vector.hpp"
+#include "tiered_vector.hpp"
 #include "sorted_set.hpp"
 #include "reference_sorted_set.hpp"
+#include "value_sorted_set.hpp"
+#include "b_plus_tree.hpp"
+#include "reference_counter.hpp"
 #include "reference_hash_set.hpp"
+#include "snapshot_hash_set.hpp"
 #include "log.hpp"
 #include "thread.hpp"
 #include "buffer.hpp"
 #include "file_stream.hpp"
 #include "digest.hpp"
+#include "merkle_tree.hpp"
 #include "encrypt.hpp"
 #include "profiler.hpp"
 
@@ -45,18 +55,45 @@ namespace NextCash
         if(!NextCash::testReferenceSortedSet())
             ++failed;
 
+        if(!NextCash::testValueSortedSet())
+            ++failed;
+
+        if(!NextCash::testBPlusTree())
+            ++failed;
+
         if(!NextCash::testDistributedVector())
             ++failed;
 
+        if(!NextCash::testTieredVector())
+            ++failed;
+
         if(!NextCash::Hash::test())
             ++failed;
 
         if(!NextCash::HashSet::test())
             ++failed;
 
+        if(!NextCash::FrozenHashList::test())
+            ++failed;
+
+        if(!NextCash::HashPool::test())
+            ++failed;
+
+        if(!NextCash::HashTable::test())
+            ++failed;
+
+        if(!NextCash::ConcurrentHashSet::test())
+            ++failed;
+
+        if(!NextCash::testReferenceCounter())
+            ++failed;
+
         if(!NextCash::testReferenceHashSet())
             ++failed;
 
+        if(!NextCash::testSnapshotHashSet())
+            ++failed;
+
         if(!NextCash::testHashContainerList())
             ++failed;
 
@@ -66,6 +103,9 @@ namespace NextCash
         if(!NextCash::Digest::test())
             ++failed;
 
+        if(!NextCash::MerkleTree::test())
+            ++failed;
+
         if(!NextCash::Encryption::test())
             ++failed;
 
@@ -0,0 +1,327 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "b_plus_tree.hpp"
+
+#include "hash.hpp"
+#include "math.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+
+
+namespace NextCash
+{
+    class BPlusTreeTestItem
+    {
+    public:
+
+        BPlusTreeTestItem() : key(0), value(0) {}
+        BPlusTreeTestItem(unsigned int pKey, unsigned int pValue) : key(pKey), value(pValue) {}
+
+        unsigned int key, value;
+
+    };
+
+    class BPlusTreeTestCompare
+    {
+    public:
+
+        int operator()(const BPlusTreeTestItem &pLeft, const BPlusTreeTestItem &pRight) const
+        {
+            return (*this)(pLeft.key, pRight);
+        }
+
+        int operator()(unsigned int pLeft, const BPlusTreeTestItem &pRight) const
+        {
+            if(pLeft < pRight.key)
+                return -1;
+            if(pLeft > pRight.key)
+                return 1;
+            return 0;
+        }
+
+        bool valueEquals(const BPlusTreeTestItem &pLeft, const BPlusTreeTestItem &pRight) const
+        {
+            return pLeft.value == pRight.value;
+        }
+
+    };
+
+    // Return true if the tree contains exactly the sorted items.
+    static bool bPlusTreeMatches(BPlusTree<Hash> &pTree, std::vector<Hash> &pSorted)
+    {
+        if(pTree.size() != pSorted.size())
+            return false;
+
+        std::vector<Hash>::iterator sorted = pSorted.begin();
+        for(BPlusTree<Hash>::Iterator item = pTree.begin(); item != pTree.end(); ++item, ++sorted)
+            if(sorted == pSorted.end() || *item != *sorted)
+                return false;
+        return sorted == pSorted.end();
+    }
+
+    bool testBPlusTree()
+    {
+        Log::add(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME,
+          "------------- Starting B+ Tree Tests -------------");
+
+        bool success = true;
+
+        /******************************************************************************************
+         * Insert
+         *****************************************************************************************/
+        BPlusTree<Hash> tree;
+        std::vector<Hash> hashes, sorted;
+        Hash hash(32);
+
+        for(unsigned int i = 0; i < 50000; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+            tree.insert(hash);
+        }
+        sorted = hashes;
+        std::sort(sorted.begin(), sorted.end());
+
+        bool insertSuccess = bPlusTreeMatches(tree, sorted) && tree.height() >= 3 &&
+          !tree.insert(hashes[100]) && !tree.insert(hashes[100], true);
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+            if(!tree.contains(hashes[i]) || *tree.get(hashes[i]) != hashes[i])
+                insertSuccess = false;
+        hash.randomize();
+        if(tree.contains(hash) || tree.get(hash) != NULL)
+            insertSuccess = false;
+
+        if(insertSuccess)
+            Log::addFormatted(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME,
+              "Passed insert (height %d)", tree.height());
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Failed insert");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Range scan and reverse iterate
+         *****************************************************************************************/
+        bool rangeSuccess = true;
+        std::vector<Hash>::iterator sortedItem = sorted.begin() + 1000;
+        BPlusTree<Hash>::Iterator item = tree.lowerBound(*sortedItem);
+        for(unsigned int i = 0; i < 2000; ++i, ++item, ++sortedItem)
+            if(*item != *sortedItem)
+                rangeSuccess = false;
+        if(*tree.upperBound(sorted[5]) != sorted[6] || tree.upperBound(sorted.back()) != tree.end())
+            rangeSuccess = false;
+
+        sortedItem = sorted.end();
+        item = tree.end();
+        for(unsigned int i = 0; i < sorted.size(); ++i)
+            if(*--item != *--sortedItem)
+                rangeSuccess = false;
+        if(item != tree.begin() || tree.front() != sorted.front() || tree.back() != sorted.back())
+            rangeSuccess = false;
+
+        if(rangeSuccess)
+            Log::add(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Passed range scan");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Failed range scan");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Remove
+         *****************************************************************************************/
+        bool removeSuccess = true;
+        for(unsigned int i = 0; i < hashes.size(); i += 2)
+            if(!tree.remove(hashes[i]))
+                removeSuccess = false;
+
+        std::vector<Hash> remaining;
+        for(unsigned int i = 1; i < hashes.size(); i += 2)
+            remaining.push_back(hashes[i]);
+        std::sort(remaining.begin(), remaining.end());
+        if(!bPlusTreeMatches(tree, remaining) || tree.remove(hashes[0]))
+            removeSuccess = false;
+
+        // Erase while iterating
+        unsigned int erased = 0;
+        for(item = tree.begin(); item != tree.end();)
+        {
+            if(item->getByte(0) & 0x01)
+            {
+                item = tree.erase(item);
+                ++erased;
+            }
+            else
+                ++item;
+        }
+
+        std::vector<Hash> even;
+        for(std::vector<Hash>::iterator value = remaining.begin(); value != remaining.end();
+          ++value)
+            if(!(value->getByte(0) & 0x01))
+                even.push_back(*value);
+        if(!bPlusTreeMatches(tree, even) || erased != remaining.size() - even.size())
+            removeSuccess = false;
+
+        // Remove everything
+        for(std::vector<Hash>::iterator value = even.begin(); value != even.end(); ++value)
+            if(!tree.remove(*value))
+                removeSuccess = false;
+        if(tree.size() != 0 || tree.begin() != tree.end() || tree.height() != 0)
+            removeSuccess = false;
+
+        if(removeSuccess)
+            Log::add(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Passed remove");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Failed remove");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Duplicate sorts
+         *****************************************************************************************/
+        BPlusTree<BPlusTreeTestItem, BPlusTreeTestCompare> itemTree;
+        bool duplicateSuccess = true;
+
+        // Long runs of the same key span multiple leaves.
+        for(unsigned int i = 0; i < 20000; ++i)
+            if(!itemTree.insert(BPlusTreeTestItem(Math::randomInt() % 50, i), true))
+                duplicateSuccess = false;
+        if(itemTree.insert(BPlusTreeTestItem(itemTree.front().key, itemTree.front().value), true))
+            duplicateSuccess = false;
+
+        unsigned int totalCount = 0, keyCount;
+        for(unsigned int key = 0; key < 50; ++key)
+        {
+            keyCount = 0;
+            unsigned int lastValue = 0;
+            BPlusTree<BPlusTreeTestItem, BPlusTreeTestCompare>::Iterator keyItem =
+              itemTree.find(key);
+            for(; keyItem != itemTree.end() && keyItem->key == key; ++keyItem, ++keyCount)
+            {
+                // Duplicates are inserted after existing matches, so values are in order.
+                if(keyCount > 0 && keyItem->value < lastValue)
+                    duplicateSuccess = false;
+                lastValue = keyItem->value;
+            }
+            totalCount += keyCount;
+
+            if(key % 2 == 0 && itemTree.removeAll(key) != keyCount)
+                duplicateSuccess = false;
+        }
+
+        if(totalCount != 20000 || itemTree.contains(10u) || !itemTree.contains(11u))
+            duplicateSuccess = false;
+
+        if(duplicateSuccess)
+            Log::add(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Passed duplicate sorts");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Failed duplicate sorts");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Bulk load
+         *****************************************************************************************/
+        tree.bulkLoad(sorted.begin(), sorted.end());
+        bool bulkSuccess = bPlusTreeMatches(tree, sorted);
+        for(unsigned int i = 0; i < hashes.size(); i += 10)
+            if(!tree.contains(hashes[i]))
+                bulkSuccess = false;
+
+        // Modify after bulk load
+        for(unsigned int i = 0; i < 1000; ++i)
+        {
+            hash.randomize();
+            tree.insert(hash);
+            sorted.push_back(hash);
+            tree.remove(hashes[i]);
+        }
+        sorted.erase(std::remove_if(sorted.begin(), sorted.end(), [&](const Hash &pHash)
+          { return std::find(hashes.begin(), hashes.begin() + 1000, pHash) !=
+          hashes.begin() + 1000; }), sorted.end());
+        std::sort(sorted.begin(), sorted.end());
+        if(!bPlusTreeMatches(tree, sorted))
+            bulkSuccess = false;
+
+        if(bulkSuccess)
+            Log::add(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Passed bulk load");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Failed bulk load");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Throughput compared to ValueSortedSet
+         *****************************************************************************************/
+        Timer insertTimer, findTimer, removeTimer;
+        unsigned int benchmarkCount = 10000;
+        unsigned int found = 0;
+
+        tree.clear();
+        insertTimer.start();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            tree.insert(hashes[i]);
+        insertTimer.stop();
+        findTimer.start();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            if(tree.contains(hashes[i]))
+                ++found;
+        findTimer.stop();
+        removeTimer.start();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            tree.remove(hashes[i]);
+        removeTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME,
+          "BPlusTree      %d items : insert %6d us, find %6d us, remove %6d us", benchmarkCount,
+          (int)insertTimer.microseconds(), (int)findTimer.microseconds(),
+          (int)removeTimer.microseconds());
+
+        ValueSortedSet<Hash> valueSet;
+        insertTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            valueSet.insert(hashes[i]);
+        insertTimer.stop();
+        findTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            if(valueSet.contains(hashes[i]))
+                ++found;
+        findTimer.stop();
+        removeTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            valueSet.remove(hashes[i]);
+        removeTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME,
+          "ValueSortedSet %d items : insert %6d us, find %6d us, remove %6d us", benchmarkCount,
+          (int)insertTimer.microseconds(), (int)findTimer.microseconds(),
+          (int)removeTimer.microseconds());
+
+        std::sort(hashes.begin(), hashes.end());
+        insertTimer.clear(true);
+        tree.bulkLoad(hashes.begin(), hashes.end());
+        insertTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME,
+          "BPlusTree bulk load %d items : %6d us", hashes.size(), (int)insertTimer.microseconds());
+
+        if(found == benchmarkCount * 2 && tree.size() == hashes.size() && valueSet.size() == 0)
+            Log::add(Log::INFO, NEXTCASH_B_PLUS_TREE_LOG_NAME, "Passed throughput");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_B_PLUS_TREE_LOG_NAME,
+              "Failed throughput : %d/%d found", found, benchmarkCount * 2);
+            success = false;
+        }
+
+        return success;
+    }
+}
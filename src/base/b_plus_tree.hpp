@@ -0,0 +1,861 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_B_PLUS_TREE_HPP
+#define NEXTCASH_B_PLUS_TREE_HPP
+
+#include "value_sorted_set.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#define NEXTCASH_B_PLUS_TREE_LOG_NAME "BPlusTree"
+
+
+namespace NextCash
+{
+    // Sorted set for very large numbers of items. Same interface as ValueSortedSet.
+    //   Items are stored by value in leaves of about 512 bytes, so insert and remove only shift
+    //   items within one leaf and are O(log n). Leaves are linked for fast iteration and range
+    //   scans.
+    //
+    // tCompare must have the same functions as for ValueSortedSet.
+    //
+    // Iterators are invalidated by insert and remove, except the iterator returned by erase.
+    template <class tType, class tCompare = ValueCompare<tType> >
+    class BPlusTree
+    {
+    private:
+
+        class Leaf;
+        class Branch;
+
+    public:
+
+        // Items per leaf
+        static const unsigned int LEAF_CAPACITY = (sizeof(tType) * 16 <= 512) ?
+          512 / sizeof(tType) : 16;
+        // Children per branch
+        static const unsigned int BRANCH_CAPACITY = 32;
+
+        BPlusTree()
+        {
+            mRoot = NULL;
+            mFirst = NULL;
+            mLast = NULL;
+            mSize = 0;
+        }
+        BPlusTree(const tCompare &pCompare) : mCompare(pCompare)
+        {
+            mRoot = NULL;
+            mFirst = NULL;
+            mLast = NULL;
+            mSize = 0;
+        }
+        ~BPlusTree() { clear(); }
+
+        unsigned int size() const { return mSize; }
+
+        // Number of levels including leaves.
+        unsigned int height() const;
+
+        void clear();
+
+        template <class tMatching>
+        bool contains(const tMatching &pMatching) { return find(pMatching) != end(); }
+
+        // Returns true if the item was inserted.
+        // If pAllowDuplicateSorts is false then multiple items with the same "sort" value will
+        //   not be inserted.
+        // Multiple items that match according to "valueEquals" will never be inserted.
+        bool insert(const tType &pValue, bool pAllowDuplicateSorts = false)
+        {
+            tType value(pValue);
+            return insert(std::move(value), pAllowDuplicateSorts);
+        }
+        bool insert(tType &&pValue, bool pAllowDuplicateSorts = false);
+
+        // Removes the first item with matching "sort" value.
+        // Returns true if the item was removed.
+        template <class tMatching>
+        bool remove(const tMatching &pMatching);
+
+        // Removes all items with matching "sort" value.
+        // Returns number of items removed.
+        template <class tMatching>
+        unsigned int removeAll(const tMatching &pMatching);
+
+        // Returns the first item with matching "sort" value.
+        // Return NULL if not found. Only valid until the tree is modified.
+        template <class tMatching>
+        tType *get(const tMatching &pMatching);
+
+        // Moves the first item with matching "sort" value into pValue and removes it.
+        // Returns false if not found.
+        template <class tMatching>
+        bool getAndRemove(const tMatching &pMatching, tType &pValue);
+
+        // Replace contents with items from a sorted range. Much faster than inserting them one at
+        //   a time. No duplicate checks are done.
+        template <class tIterator>
+        void bulkLoad(tIterator pBegin, tIterator pEnd);
+
+        class Iterator
+        {
+        public:
+            Iterator() { mTree = NULL; mLeaf = NULL; mOffset = 0; }
+            Iterator(BPlusTree *pTree, Leaf *pLeaf, unsigned int pOffset)
+            {
+                mTree   = pTree;
+                mLeaf   = pLeaf;
+                mOffset = pOffset;
+            }
+            Iterator(const Iterator &pCopy)
+            {
+                mTree   = pCopy.mTree;
+                mLeaf   = pCopy.mLeaf;
+                mOffset = pCopy.mOffset;
+            }
+
+            Iterator &operator = (const Iterator &pRight)
+            {
+                mTree   = pRight.mTree;
+                mLeaf   = pRight.mLeaf;
+                mOffset = pRight.mOffset;
+                return *this;
+            }
+
+            tType &operator *() { return mLeaf->items[mOffset]; }
+            tType *operator ->() { return mLeaf->items + mOffset; }
+
+            bool operator ==(const Iterator &pRight) const
+            {
+                return mLeaf == pRight.mLeaf && mOffset == pRight.mOffset;
+            }
+            bool operator !=(const Iterator &pRight) const
+            {
+                return mLeaf != pRight.mLeaf || mOffset != pRight.mOffset;
+            }
+
+            Iterator &operator ++() // Prefix increment
+            {
+                if(++mOffset >= mLeaf->count)
+                {
+                    mLeaf = mLeaf->next;
+                    mOffset = 0;
+                }
+                return *this;
+            }
+            Iterator operator ++(int) // Postfix increment
+            {
+                Iterator result = *this;
+                ++(*this);
+                return result;
+            }
+
+            Iterator &operator --() // Prefix decrement
+            {
+                if(mLeaf == NULL)
+                {
+                    mLeaf = mTree->mLast;
+                    mOffset = mLeaf->count - 1;
+                }
+                else if(mOffset == 0)
+                {
+                    mLeaf = mLeaf->previous;
+                    mOffset = mLeaf->count - 1;
+                }
+                else
+                    --mOffset;
+                return *this;
+            }
+            Iterator operator --(int) // Postfix decrement
+            {
+                Iterator result = *this;
+                --(*this);
+                return result;
+            }
+
+        private:
+
+            BPlusTree *mTree;
+            Leaf *mLeaf; // NULL for end
+            unsigned int mOffset;
+
+            friend class BPlusTree;
+
+        };
+
+        Iterator begin() { return Iterator(this, mFirst, 0); }
+        Iterator end() { return Iterator(this, NULL, 0); }
+
+        tType &front() { return mFirst->items[0]; }
+        tType &back() { return mLast->items[mLast->count - 1]; }
+
+        // Return iterator to first matching item or end.
+        template <class tMatching>
+        Iterator find(const tMatching &pMatching)
+        {
+            Iterator result = lowerBound(pMatching);
+            if(result != end() && mCompare(pMatching, *result) == 0)
+                return result;
+            return end();
+        }
+
+        // Return iterator to first item not less than pMatching.
+        template <class tMatching>
+        Iterator lowerBound(const tMatching &pMatching);
+
+        // Return iterator to first item more than pMatching.
+        template <class tMatching>
+        Iterator upperBound(const tMatching &pMatching);
+
+        // Remove the item and return the item after it.
+        Iterator erase(const Iterator &pIterator);
+
+    private:
+
+        static const unsigned int LEAF_MINIMUM = LEAF_CAPACITY / 2;
+        static const unsigned int BRANCH_MINIMUM = BRANCH_CAPACITY / 2;
+
+        class Node
+        {
+        public:
+            Branch *parent;
+            bool isLeaf;
+            unsigned int count; // Items in leaf or children in branch
+        };
+
+        class Leaf : public Node
+        {
+        public:
+            Leaf() { this->parent = NULL; this->isLeaf = true; this->count = 0; }
+
+            tType items[LEAF_CAPACITY];
+            Leaf *previous, *next;
+        };
+
+        class Branch : public Node
+        {
+        public:
+            Branch() { this->parent = NULL; this->isLeaf = false; this->count = 0; }
+
+            // keys[i] is not more than any item in children[i + 1] and not less than any item
+            //   in children[i].
+            tType keys[BRANCH_CAPACITY - 1];
+            Node *children[BRANCH_CAPACITY];
+        };
+
+        static void deleteNode(Node *pNode);
+        static unsigned int childOffset(Branch *pParent, Node *pChild);
+
+        // Insert pRight, with the separator pKey, after pLeft in pLeft's parent.
+        void insertIntoParent(Node *pLeft, tType &&pKey, Node *pRight);
+
+        // Remove the child at pOffset (not zero) and the key before it.
+        static void removeChild(Branch *pBranch, unsigned int pOffset);
+
+        // Fix leaf with too few items. pOffset is updated to the new location of the item that
+        //   was at pOffset in pLeaf. Returns the leaf that item is now in.
+        Leaf *rebalanceLeaf(Leaf *pLeaf, unsigned int &pOffset);
+        void rebalanceBranch(Branch *pBranch);
+
+        Node *mRoot;
+        Leaf *mFirst, *mLast;
+        unsigned int mSize;
+        tCompare mCompare;
+
+        BPlusTree(const BPlusTree &pCopy);
+        BPlusTree &operator = (const BPlusTree &pRight);
+
+    };
+
+    template <class tType, class tCompare>
+    unsigned int BPlusTree<tType, tCompare>::height() const
+    {
+        unsigned int result = 0;
+        for(Node *node = mRoot; node != NULL; ++result)
+        {
+            if(node->isLeaf)
+                node = NULL;
+            else
+                node = ((Branch *)node)->children[0];
+        }
+        return result;
+    }
+
+    template <class tType, class tCompare>
+    void BPlusTree<tType, tCompare>::deleteNode(Node *pNode)
+    {
+        if(pNode->isLeaf)
+            delete (Leaf *)pNode;
+        else
+        {
+            Branch *branch = (Branch *)pNode;
+            for(unsigned int i = 0; i < branch->count; ++i)
+                deleteNode(branch->children[i]);
+            delete branch;
+        }
+    }
+
+    template <class tType, class tCompare>
+    void BPlusTree<tType, tCompare>::clear()
+    {
+        if(mRoot != NULL)
+            deleteNode(mRoot);
+        mRoot = NULL;
+        mFirst = NULL;
+        mLast = NULL;
+        mSize = 0;
+    }
+
+    template <class tType, class tCompare>
+    unsigned int BPlusTree<tType, tCompare>::childOffset(Branch *pParent, Node *pChild)
+    {
+        unsigned int result = 0;
+        while(pParent->children[result] != pChild)
+            ++result;
+        return result;
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    typename BPlusTree<tType, tCompare>::Iterator
+      BPlusTree<tType, tCompare>::lowerBound(const tMatching &pMatching)
+    {
+        if(mRoot == NULL)
+            return end();
+
+        Node *node = mRoot;
+        unsigned int offset;
+        while(!node->isLeaf)
+        {
+            Branch *branch = (Branch *)node;
+            offset = 0;
+            while(offset < branch->count - 1 && mCompare(pMatching, branch->keys[offset]) > 0)
+                ++offset;
+            node = branch->children[offset];
+        }
+
+        Leaf *leaf = (Leaf *)node;
+        offset = 0;
+        while(offset < leaf->count && mCompare(pMatching, leaf->items[offset]) > 0)
+            ++offset;
+
+        if(offset == leaf->count)
+            return Iterator(this, leaf->next, 0);
+        return Iterator(this, leaf, offset);
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    typename BPlusTree<tType, tCompare>::Iterator
+      BPlusTree<tType, tCompare>::upperBound(const tMatching &pMatching)
+    {
+        if(mRoot == NULL)
+            return end();
+
+        Node *node = mRoot;
+        unsigned int offset;
+        while(!node->isLeaf)
+        {
+            Branch *branch = (Branch *)node;
+            offset = 0;
+            while(offset < branch->count - 1 && mCompare(pMatching, branch->keys[offset]) >= 0)
+                ++offset;
+            node = branch->children[offset];
+        }
+
+        Leaf *leaf = (Leaf *)node;
+        offset = 0;
+        while(offset < leaf->count && mCompare(pMatching, leaf->items[offset]) >= 0)
+            ++offset;
+
+        if(offset == leaf->count)
+            return Iterator(this, leaf->next, 0);
+        return Iterator(this, leaf, offset);
+    }
+
+    template <class tType, class tCompare>
+    bool BPlusTree<tType, tCompare>::insert(tType &&pValue, bool pAllowDuplicateSorts)
+    {
+        // Check items with the same sort value.
+        for(Iterator item = lowerBound(pValue); item != end() && mCompare(pValue, *item) == 0;
+          ++item)
+            if(!pAllowDuplicateSorts || mCompare.valueEquals(pValue, *item))
+                return false;
+
+        if(mRoot == NULL)
+        {
+            Leaf *leaf = new Leaf();
+            leaf->previous = NULL;
+            leaf->next = NULL;
+            mRoot = leaf;
+            mFirst = leaf;
+            mLast = leaf;
+        }
+
+        // Find the leaf and position after any matching items.
+        Node *node = mRoot;
+        unsigned int offset;
+        while(!node->isLeaf)
+        {
+            Branch *branch = (Branch *)node;
+            offset = 0;
+            while(offset < branch->count - 1 && mCompare(pValue, branch->keys[offset]) >= 0)
+                ++offset;
+            node = branch->children[offset];
+        }
+
+        Leaf *leaf = (Leaf *)node;
+        offset = 0;
+        while(offset < leaf->count && mCompare(pValue, leaf->items[offset]) >= 0)
+            ++offset;
+
+        ++mSize;
+
+        if(leaf->count < LEAF_CAPACITY)
+        {
+            for(unsigned int i = leaf->count; i > offset; --i)
+                leaf->items[i] = std::move(leaf->items[i - 1]);
+            leaf->items[offset] = std::move(pValue);
+            ++leaf->count;
+            return true;
+        }
+
+        // Split the leaf in half.
+        Leaf *right = new Leaf();
+        unsigned int half = LEAF_CAPACITY / 2;
+        for(unsigned int i = half; i < LEAF_CAPACITY; ++i)
+            right->items[i - half] = std::move(leaf->items[i]);
+        right->count = LEAF_CAPACITY - half;
+        leaf->count = half;
+
+        right->previous = leaf;
+        right->next = leaf->next;
+        if(leaf->next != NULL)
+            leaf->next->previous = right;
+        else
+            mLast = right;
+        leaf->next = right;
+
+        Leaf *target = leaf;
+        if(offset > half)
+        {
+            target = right;
+            offset -= half;
+        }
+        for(unsigned int i = target->count; i > offset; --i)
+            target->items[i] = std::move(target->items[i - 1]);
+        target->items[offset] = std::move(pValue);
+        ++target->count;
+
+        insertIntoParent(leaf, tType(right->items[0]), right);
+        return true;
+    }
+
+    template <class tType, class tCompare>
+    void BPlusTree<tType, tCompare>::insertIntoParent(Node *pLeft, tType &&pKey, Node *pRight)
+    {
+        Branch *parent = pLeft->parent;
+        if(parent == NULL)
+        {
+            // New root
+            Branch *root = new Branch();
+            root->children[0] = pLeft;
+            root->children[1] = pRight;
+            root->keys[0] = std::move(pKey);
+            root->count = 2;
+            pLeft->parent = root;
+            pRight->parent = root;
+            mRoot = root;
+            return;
+        }
+
+        unsigned int offset = childOffset(parent, pLeft) + 1;
+
+        if(parent->count < BRANCH_CAPACITY)
+        {
+            for(unsigned int i = parent->count; i > offset; --i)
+            {
+                parent->children[i] = parent->children[i - 1];
+                parent->keys[i - 1] = std::move(parent->keys[i - 2]);
+            }
+            parent->children[offset] = pRight;
+            parent->keys[offset - 1] = std::move(pKey);
+            pRight->parent = parent;
+            ++parent->count;
+            return;
+        }
+
+        // Split the branch. Gather all keys and children in order first.
+        //   separators[i] separates children[i] and children[i + 1].
+        std::vector<Node *> children(parent->children, parent->children + BRANCH_CAPACITY);
+        children.insert(children.begin() + offset, pRight);
+
+        std::vector<tType> separators;
+        separators.reserve(BRANCH_CAPACITY);
+        for(unsigned int i = 0; i < BRANCH_CAPACITY - 1; ++i)
+            separators.emplace_back(std::move(parent->keys[i]));
+        separators.insert(separators.begin() + offset - 1, std::move(pKey));
+
+        unsigned int leftCount = (BRANCH_CAPACITY + 1) / 2;
+        Branch *newBranch = new Branch();
+
+        parent->count = leftCount;
+        for(unsigned int i = 0; i < leftCount; ++i)
+        {
+            parent->children[i] = children[i];
+            children[i]->parent = parent;
+            if(i > 0)
+                parent->keys[i - 1] = std::move(separators[i - 1]);
+        }
+        for(unsigned int i = leftCount - 1; i < BRANCH_CAPACITY - 1; ++i)
+            parent->keys[i] = tType();
+
+        newBranch->count = children.size() - leftCount;
+        for(unsigned int i = leftCount; i < children.size(); ++i)
+        {
+            newBranch->children[i - leftCount] = children[i];
+            children[i]->parent = newBranch;
+            if(i > leftCount)
+                newBranch->keys[i - leftCount - 1] = std::move(separators[i - 1]);
+        }
+
+        insertIntoParent(parent, std::move(separators[leftCount - 1]), newBranch);
+    }
+
+    template <class tType, class tCompare>
+    void BPlusTree<tType, tCompare>::removeChild(Branch *pBranch, unsigned int pOffset)
+    {
+        for(unsigned int i = pOffset; i < pBranch->count - 1; ++i)
+        {
+            pBranch->children[i] = pBranch->children[i + 1];
+            pBranch->keys[i - 1] = std::move(pBranch->keys[i]);
+        }
+        --pBranch->count;
+        pBranch->keys[pBranch->count - 1] = tType();
+    }
+
+    template <class tType, class tCompare>
+    typename BPlusTree<tType, tCompare>::Iterator
+      BPlusTree<tType, tCompare>::erase(const Iterator &pIterator)
+    {
+        Leaf *leaf = pIterator.mLeaf;
+        unsigned int offset = pIterator.mOffset;
+
+        for(unsigned int i = offset + 1; i < leaf->count; ++i)
+            leaf->items[i - 1] = std::move(leaf->items[i]);
+        --leaf->count;
+        leaf->items[leaf->count] = tType(); // Release memory
+        --mSize;
+
+        if(mSize == 0)
+        {
+            clear();
+            return end();
+        }
+
+        if(leaf != mRoot && leaf->count < LEAF_MINIMUM)
+            leaf = rebalanceLeaf(leaf, offset);
+
+        if(offset >= leaf->count)
+            return Iterator(this, leaf->next, 0);
+        return Iterator(this, leaf, offset);
+    }
+
+    template <class tType, class tCompare>
+    typename BPlusTree<tType, tCompare>::Leaf *
+      BPlusTree<tType, tCompare>::rebalanceLeaf(Leaf *pLeaf, unsigned int &pOffset)
+    {
+        Branch *parent = pLeaf->parent;
+        unsigned int offset = childOffset(parent, pLeaf);
+        Leaf *left = NULL, *right = NULL;
+        if(offset > 0)
+            left = (Leaf *)parent->children[offset - 1];
+        if(offset < parent->count - 1)
+            right = (Leaf *)parent->children[offset + 1];
+
+        if(left != NULL && left->count > LEAF_MINIMUM)
+        {
+            // Move last item from left.
+            for(unsigned int i = pLeaf->count; i > 0; --i)
+                pLeaf->items[i] = std::move(pLeaf->items[i - 1]);
+            pLeaf->items[0] = std::move(left->items[--left->count]);
+            left->items[left->count] = tType();
+            ++pLeaf->count;
+            parent->keys[offset - 1] = pLeaf->items[0];
+            ++pOffset;
+            return pLeaf;
+        }
+
+        if(right != NULL && right->count > LEAF_MINIMUM)
+        {
+            // Move first item from right.
+            pLeaf->items[pLeaf->count++] = std::move(right->items[0]);
+            for(unsigned int i = 1; i < right->count; ++i)
+                right->items[i - 1] = std::move(right->items[i]);
+            --right->count;
+            right->items[right->count] = tType();
+            parent->keys[offset] = right->items[0];
+            return pLeaf;
+        }
+
+        // Merge the right leaf of a pair into the left.
+        Leaf *mergeLeft, *mergeRight;
+        unsigned int rightOffset;
+        if(left != NULL)
+        {
+            mergeLeft = left;
+            mergeRight = pLeaf;
+            rightOffset = offset;
+            pOffset += left->count;
+        }
+        else
+        {
+            mergeLeft = pLeaf;
+            mergeRight = right;
+            rightOffset = offset + 1;
+        }
+
+        for(unsigned int i = 0; i < mergeRight->count; ++i)
+            mergeLeft->items[mergeLeft->count++] = std::move(mergeRight->items[i]);
+
+        mergeLeft->next = mergeRight->next;
+        if(mergeRight->next != NULL)
+            mergeRight->next->previous = mergeLeft;
+        else
+            mLast = mergeLeft;
+
+        delete mergeRight;
+        removeChild(parent, rightOffset);
+        rebalanceBranch(parent);
+        return mergeLeft;
+    }
+
+    template <class tType, class tCompare>
+    void BPlusTree<tType, tCompare>::rebalanceBranch(Branch *pBranch)
+    {
+        if(pBranch == mRoot)
+        {
+            if(pBranch->count == 1)
+            {
+                // Remove a level.
+                mRoot = pBranch->children[0];
+                mRoot->parent = NULL;
+                delete pBranch;
+            }
+            return;
+        }
+
+        if(pBranch->count >= BRANCH_MINIMUM)
+            return;
+
+        Branch *parent = pBranch->parent;
+        unsigned int offset = childOffset(parent, pBranch);
+        Branch *left = NULL, *right = NULL;
+        if(offset > 0)
+            left = (Branch *)parent->children[offset - 1];
+        if(offset < parent->count - 1)
+            right = (Branch *)parent->children[offset + 1];
+
+        if(left != NULL && left->count > BRANCH_MINIMUM)
+        {
+            // Rotate last child of left through the parent.
+            for(unsigned int i = pBranch->count; i > 0; --i)
+            {
+                pBranch->children[i] = pBranch->children[i - 1];
+                if(i > 1)
+                    pBranch->keys[i - 1] = std::move(pBranch->keys[i - 2]);
+            }
+            pBranch->keys[0] = std::move(parent->keys[offset - 1]);
+            pBranch->children[0] = left->children[left->count - 1];
+            pBranch->children[0]->parent = pBranch;
+            ++pBranch->count;
+
+            parent->keys[offset - 1] = std::move(left->keys[left->count - 2]);
+            left->keys[left->count - 2] = tType();
+            --left->count;
+            return;
+        }
+
+        if(right != NULL && right->count > BRANCH_MINIMUM)
+        {
+            // Rotate first child of right through the parent.
+            pBranch->keys[pBranch->count - 1] = std::move(parent->keys[offset]);
+            pBranch->children[pBranch->count] = right->children[0];
+            pBranch->children[pBranch->count]->parent = pBranch;
+            ++pBranch->count;
+
+            parent->keys[offset] = std::move(right->keys[0]);
+            for(unsigned int i = 1; i < right->count; ++i)
+            {
+                right->children[i - 1] = right->children[i];
+                if(i < right->count - 1)
+                    right->keys[i - 1] = std::move(right->keys[i]);
+            }
+            --right->count;
+            right->keys[right->count - 1] = tType();
+            return;
+        }
+
+        // Merge the right branch of a pair into the left.
+        Branch *mergeLeft, *mergeRight;
+        unsigned int rightOffset;
+        if(left != NULL)
+        {
+            mergeLeft = left;
+            mergeRight = pBranch;
+            rightOffset = offset;
+        }
+        else
+        {
+            mergeLeft = pBranch;
+            mergeRight = right;
+            rightOffset = offset + 1;
+        }
+
+        mergeLeft->keys[mergeLeft->count - 1] = std::move(parent->keys[rightOffset - 1]);
+        for(unsigned int i = 0; i < mergeRight->count; ++i)
+        {
+            mergeLeft->children[mergeLeft->count + i] = mergeRight->children[i];
+            mergeRight->children[i]->parent = mergeLeft;
+            if(i < mergeRight->count - 1)
+                mergeLeft->keys[mergeLeft->count + i] = std::move(mergeRight->keys[i]);
+        }
+        mergeLeft->count += mergeRight->count;
+
+        delete mergeRight;
+        removeChild(parent, rightOffset);
+        rebalanceBranch(parent);
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    bool BPlusTree<tType, tCompare>::remove(const tMatching &pMatching)
+    {
+        Iterator item = find(pMatching);
+        if(item == end())
+            return false;
+        erase(item);
+        return true;
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    unsigned int BPlusTree<tType, tCompare>::removeAll(const tMatching &pMatching)
+    {
+        unsigned int result = 0;
+        Iterator item = find(pMatching);
+        while(item != end() && mCompare(pMatching, *item) == 0)
+        {
+            item = erase(item);
+            ++result;
+        }
+        return result;
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    tType *BPlusTree<tType, tCompare>::get(const tMatching &pMatching)
+    {
+        Iterator item = find(pMatching);
+        if(item == end())
+            return NULL;
+        return &(*item);
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    bool BPlusTree<tType, tCompare>::getAndRemove(const tMatching &pMatching, tType &pValue)
+    {
+        Iterator item = find(pMatching);
+        if(item == end())
+            return false;
+        pValue = std::move(*item);
+        erase(item);
+        return true;
+    }
+
+    template <class tType, class tCompare>
+    template <class tIterator>
+    void BPlusTree<tType, tCompare>::bulkLoad(tIterator pBegin, tIterator pEnd)
+    {
+        clear();
+
+        unsigned int count = 0;
+        for(tIterator item = pBegin; item != pEnd; ++item)
+            ++count;
+        if(count == 0)
+            return;
+
+        // Spread items evenly over full leaves.
+        unsigned int leafCount = (count + LEAF_CAPACITY - 1) / LEAF_CAPACITY;
+        std::vector<Node *> level;
+        std::vector<tType *> lowest; // Lowest item in each node of level
+        level.reserve(leafCount);
+        lowest.reserve(leafCount);
+
+        tIterator item = pBegin;
+        Leaf *previous = NULL;
+        for(unsigned int i = 0; i < leafCount; ++i)
+        {
+            Leaf *leaf = new Leaf();
+            leaf->count = (count / leafCount) + (i < count % leafCount ? 1 : 0);
+            for(unsigned int j = 0; j < leaf->count; ++j, ++item)
+                leaf->items[j] = *item;
+
+            leaf->previous = previous;
+            leaf->next = NULL;
+            if(previous == NULL)
+                mFirst = leaf;
+            else
+                previous->next = leaf;
+            previous = leaf;
+
+            level.push_back(leaf);
+            lowest.push_back(leaf->items);
+        }
+        mLast = previous;
+        mSize = count;
+
+        // Build branch levels until there is only one node.
+        std::vector<Node *> nextLevel;
+        std::vector<tType *> nextLowest;
+        while(level.size() > 1)
+        {
+            unsigned int branchCount = (level.size() + BRANCH_CAPACITY - 1) / BRANCH_CAPACITY;
+            unsigned int offset = 0;
+            nextLevel.clear();
+            nextLowest.clear();
+            for(unsigned int i = 0; i < branchCount; ++i)
+            {
+                Branch *branch = new Branch();
+                branch->count = (level.size() / branchCount) +
+                  (i < level.size() % branchCount ? 1 : 0);
+                for(unsigned int j = 0; j < branch->count; ++j, ++offset)
+                {
+                    branch->children[j] = level[offset];
+                    level[offset]->parent = branch;
+                    if(j > 0)
+                        branch->keys[j - 1] = *lowest[offset];
+                }
+                nextLowest.push_back(lowest[offset - branch->count]);
+                nextLevel.push_back(branch);
+            }
+            level.swap(nextLevel);
+            lowest.swap(nextLowest);
+        }
+
+        mRoot = level.front();
+    }
+
+    bool testBPlusTree();
+}
+
+#endif
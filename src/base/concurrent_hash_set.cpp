@@ -0,0 +1,380 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "concurrent_hash_set.hpp"
+
+#include "log.hpp"
+#include "thread.hpp"
+#include "timer.hpp"
+
+#include <vector>
+
+
+namespace NextCash
+{
+    const unsigned int ConcurrentHashSet::SHARD_COUNT;
+
+    void ConcurrentHashSet::reserve(unsigned int pSize)
+    {
+        unsigned int sizePerShard = pSize / SHARD_COUNT;
+        Shard *shard = mShards;
+        for(unsigned int i = 0; i < SHARD_COUNT; ++i, ++shard)
+        {
+            shard->lock.lock();
+            shard->set.reserve(sizePerShard);
+            shard->lock.unlock();
+        }
+    }
+
+    bool ConcurrentHashSet::contains(const Hash &pHash)
+    {
+        HashLookupObject lookup(pHash);
+        Shard &hashShard = shard(pHash);
+
+        hashShard.lock.lock();
+        bool result = hashShard.set.contains(lookup);
+        hashShard.lock.unlock();
+        return result;
+    }
+
+    bool ConcurrentHashSet::insert(HashObject *pObject, bool pAllowDuplicateSorts)
+    {
+        Shard &hashShard = shard(pObject->getHash());
+
+        hashShard.lock.lock();
+        bool result = hashShard.set.insert(pObject, pAllowDuplicateSorts);
+        hashShard.lock.unlock();
+
+        if(result)
+            mSize.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    bool ConcurrentHashSet::remove(const Hash &pHash)
+    {
+        HashLookupObject lookup(pHash);
+        Shard &hashShard = shard(pHash);
+
+        hashShard.lock.lock();
+        bool result = hashShard.set.remove(lookup);
+        hashShard.lock.unlock();
+
+        if(result)
+            mSize.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    unsigned int ConcurrentHashSet::removeAll(const Hash &pHash)
+    {
+        HashLookupObject lookup(pHash);
+        Shard &hashShard = shard(pHash);
+
+        hashShard.lock.lock();
+        unsigned int result = hashShard.set.removeAll(lookup);
+        hashShard.lock.unlock();
+
+        if(result > 0)
+            mSize.fetch_sub(result, std::memory_order_relaxed);
+        return result;
+    }
+
+    HashObject *ConcurrentHashSet::getAndRemove(const Hash &pHash)
+    {
+        HashLookupObject lookup(pHash);
+        Shard &hashShard = shard(pHash);
+
+        hashShard.lock.lock();
+        HashObject *result = (HashObject *)hashShard.set.getAndRemove(lookup);
+        hashShard.lock.unlock();
+
+        if(result != NULL)
+            mSize.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    void ConcurrentHashSet::clear()
+    {
+        unsigned int removed;
+        Shard *shard = mShards;
+        for(unsigned int i = 0; i < SHARD_COUNT; ++i, ++shard)
+        {
+            shard->lock.lock();
+            removed = shard->set.size();
+            shard->set.clear();
+            shard->lock.unlock();
+
+            // Only subtract what was removed so concurrent inserts are still counted.
+            mSize.fetch_sub(removed, std::memory_order_relaxed);
+        }
+    }
+
+    void ConcurrentHashSet::clearNoDelete()
+    {
+        unsigned int removed;
+        Shard *shard = mShards;
+        for(unsigned int i = 0; i < SHARD_COUNT; ++i, ++shard)
+        {
+            shard->lock.lock();
+            removed = shard->set.size();
+            shard->set.clearNoDelete();
+            shard->lock.unlock();
+
+            mSize.fetch_sub(removed, std::memory_order_relaxed);
+        }
+    }
+
+    void ConcurrentHashSet::shrink()
+    {
+        Shard *shard = mShards;
+        for(unsigned int i = 0; i < SHARD_COUNT; ++i, ++shard)
+        {
+            shard->lock.lock();
+            shard->set.shrink();
+            shard->lock.unlock();
+        }
+    }
+
+    class ConcurrentHashSetTestObject : public HashObject
+    {
+    public:
+
+        ConcurrentHashSetTestObject(const Hash &pHash, unsigned int pValue) :
+          hash(pHash), value(pValue) {}
+
+        const Hash &getHash() { return hash; }
+
+        Hash hash;
+        unsigned int value;
+
+    };
+
+    // Shared by the test threads. Each thread inserts, finds, then removes its own range of
+    //   hashes.
+    class ConcurrentHashSetTestData
+    {
+    public:
+
+        ConcurrentHashSetTestData(std::vector<Hash> &pHashes, unsigned int pThreadCount) :
+          hashes(pHashes), mutex("ConcurrentHashSetTest")
+        {
+            threadCount = pThreadCount;
+            nextThread = 0;
+            failed = 0;
+            useLockedSet = false;
+        }
+
+        // Returns the next range offset for a thread.
+        unsigned int start()
+        {
+            return nextThread.fetch_add(1) * (hashes.size() / threadCount);
+        }
+
+        std::vector<Hash> &hashes;
+        unsigned int threadCount;
+        std::atomic<unsigned int> nextThread;
+        std::atomic<unsigned int> failed;
+
+        ConcurrentHashSet concurrentSet;
+
+        // Single lock around a HashSet for comparison.
+        bool useLockedSet;
+        MutexWithConstantName mutex;
+        HashSet lockedSet;
+
+    };
+
+    static void concurrentHashSetTestRun(void *pParameter)
+    {
+        ConcurrentHashSetTestData *data = (ConcurrentHashSetTestData *)pParameter;
+        unsigned int count = data->hashes.size() / data->threadCount;
+        unsigned int begin = data->start();
+        unsigned int end = begin + count;
+        unsigned int failed = 0;
+
+        if(data->useLockedSet)
+        {
+            for(unsigned int i = begin; i < end; ++i)
+            {
+                data->mutex.lock();
+                if(!data->lockedSet.insert(new ConcurrentHashSetTestObject(data->hashes[i], i)))
+                    ++failed;
+                data->mutex.unlock();
+            }
+            for(unsigned int i = begin; i < end; ++i)
+            {
+                data->mutex.lock();
+                if(!data->lockedSet.contains(data->hashes[i]))
+                    ++failed;
+                data->mutex.unlock();
+            }
+            for(unsigned int i = begin; i < end; i += 2)
+            {
+                data->mutex.lock();
+                if(!data->lockedSet.remove(data->hashes[i]))
+                    ++failed;
+                data->mutex.unlock();
+            }
+        }
+        else
+        {
+            for(unsigned int i = begin; i < end; ++i)
+                if(!data->concurrentSet.insert(new ConcurrentHashSetTestObject(data->hashes[i], i)))
+                    ++failed;
+            for(unsigned int i = begin; i < end; ++i)
+                if(!data->concurrentSet.contains(data->hashes[i]))
+                    ++failed;
+            for(unsigned int i = begin; i < end; i += 2)
+                if(!data->concurrentSet.remove(data->hashes[i]))
+                    ++failed;
+        }
+
+        data->failed += failed;
+    }
+
+    // Runs the test threads and returns the number of microseconds they took.
+    static unsigned int concurrentHashSetTestThreads(ConcurrentHashSetTestData &pData)
+    {
+        Timer timer(true);
+        std::vector<Thread *> threads;
+        String threadName;
+
+        for(unsigned int i = 0; i < pData.threadCount; ++i)
+        {
+            threadName.writeFormatted("ConcurrentHashSetTest%d", i);
+            threads.push_back(new Thread(threadName, concurrentHashSetTestRun, &pData));
+        }
+
+        // Thread destructor waits for the thread to finish.
+        for(std::vector<Thread *>::iterator thread = threads.begin(); thread != threads.end();
+          ++thread)
+            delete *thread;
+
+        timer.stop();
+        return (unsigned int)timer.microseconds();
+    }
+
+    bool ConcurrentHashSet::test()
+    {
+        Log::add(Log::INFO, NEXTCASH_CONCURRENT_HASH_SET_LOG_NAME,
+          "------------- Starting Concurrent Hash Set Tests -------------");
+
+        bool success = true;
+
+        /******************************************************************************************
+         * Single thread
+         *****************************************************************************************/
+        ConcurrentHashSet set;
+        std::vector<Hash> hashes;
+        Hash hash(32);
+
+        for(unsigned int i = 0; i < 1000; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+            set.insert(new ConcurrentHashSetTestObject(hash, i));
+        }
+
+        bool singleSuccess = set.size() == 1000;
+        ConcurrentHashSetTestObject *duplicate = new ConcurrentHashSetTestObject(hashes[5], 5000);
+        if(set.insert(duplicate))
+            singleSuccess = false;
+        else
+            delete duplicate;
+
+        unsigned int value = 0;
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+            if(!set.contains(hashes[i]) || !set.get(hashes[i], [&](HashObject *pObject)
+              { value = ((ConcurrentHashSetTestObject *)pObject)->value; }) || value != i)
+                singleSuccess = false;
+
+        HashObject *removed = set.getAndRemove(hashes[10]);
+        if(removed == NULL || removed->getHash() != hashes[10] || set.contains(hashes[10]) ||
+          set.size() != 999)
+            singleSuccess = false;
+        delete removed;
+
+        if(!set.remove(hashes[11]) || set.remove(hashes[11]) || set.size() != 998)
+            singleSuccess = false;
+
+        // Iteration is sorted within each shard and covers every item.
+        unsigned int iterated = 0;
+        for(unsigned int i = 0; i < SHARD_COUNT; ++i)
+        {
+            HashObject *previous = NULL;
+            set.forEachInShard(i, [&](HashObject *pObject)
+            {
+                if(shardFor(pObject->getHash()) != i ||
+                  (previous != NULL && previous->getHash() > pObject->getHash()))
+                    singleSuccess = false;
+                previous = pObject;
+                ++iterated;
+            });
+        }
+        if(iterated != 998)
+            singleSuccess = false;
+
+        set.clear();
+        if(set.size() != 0 || set.contains(hashes[0]))
+            singleSuccess = false;
+
+        if(singleSuccess)
+            Log::add(Log::INFO, NEXTCASH_CONCURRENT_HASH_SET_LOG_NAME, "Passed single thread");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_CONCURRENT_HASH_SET_LOG_NAME, "Failed single thread");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Multiple threads
+         *****************************************************************************************/
+        const unsigned int threadCount = 4;
+        const unsigned int itemCount = 40000;
+        hashes.clear();
+        for(unsigned int i = 0; i < itemCount; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+        }
+
+        ConcurrentHashSetTestData concurrentData(hashes, threadCount);
+        unsigned int concurrentTime = concurrentHashSetTestThreads(concurrentData);
+
+        bool threadSuccess = concurrentData.failed == 0 &&
+          concurrentData.concurrentSet.size() == itemCount / 2;
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+            if(concurrentData.concurrentSet.contains(hashes[i]) != (i % 2 == 1))
+                threadSuccess = false;
+
+        ConcurrentHashSetTestData lockedData(hashes, threadCount);
+        lockedData.useLockedSet = true;
+        unsigned int lockedTime = concurrentHashSetTestThreads(lockedData);
+        if(lockedData.failed != 0 || lockedData.lockedSet.size() != itemCount / 2)
+            threadSuccess = false;
+
+        ConcurrentHashSetTestData singleData(hashes, 1);
+        unsigned int singleTime = concurrentHashSetTestThreads(singleData);
+        if(singleData.failed != 0 || singleData.concurrentSet.size() != itemCount / 2)
+            threadSuccess = false;
+
+        Log::addFormatted(Log::INFO, NEXTCASH_CONCURRENT_HASH_SET_LOG_NAME,
+          "%d items : 1 thread %d us, %d threads %d us, %d threads single lock %d us",
+          itemCount, singleTime, threadCount, concurrentTime, threadCount, lockedTime);
+
+        if(threadSuccess)
+            Log::add(Log::INFO, NEXTCASH_CONCURRENT_HASH_SET_LOG_NAME, "Passed multiple threads");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_CONCURRENT_HASH_SET_LOG_NAME,
+              "Failed multiple threads : %d failed, size %d", (int)concurrentData.failed,
+              concurrentData.concurrentSet.size());
+            success = false;
+        }
+
+        return success;
+    }
+}
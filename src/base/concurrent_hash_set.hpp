@@ -0,0 +1,166 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_CONCURRENT_HASH_SET_HPP
+#define NEXTCASH_CONCURRENT_HASH_SET_HPP
+
+#include "hash.hpp"
+#include "hash_set.hpp"
+#include "mutex.hpp"
+#include "sorted_set.hpp"
+
+#include <atomic>
+
+#define NEXTCASH_CONCURRENT_HASH_SET_LOG_NAME "ConcurrentHashSet"
+
+
+namespace NextCash
+{
+    // Thread safe version of HashSet.
+    // Items are split into the same 256 shards as HashSet, but each shard has its own lock so
+    //   threads only contend when they access the same shard.
+    // Pointers to items can't be returned since another thread could delete them, so access to
+    //   items is through functions called while the shard is locked.
+    class ConcurrentHashSet
+    {
+    public:
+
+        static const unsigned int SHARD_COUNT = 0x0100;
+
+        ConcurrentHashSet() : mSize(0) {}
+        ~ConcurrentHashSet() {}
+
+        // Doesn't lock. The value can be out of date as soon as it is returned if other threads
+        //   are modifying the set.
+        unsigned int size() const { return mSize.load(std::memory_order_relaxed); }
+
+        void reserve(unsigned int pSize);
+
+        bool contains(const Hash &pHash);
+
+        // Returns true if the item was inserted.
+        // If pAllowDuplicateSorts is false then multiple objects with the same "sort" value will
+        //   not be inserted.
+        // Multiple objects that match according to "valueEquals" will never be inserted.
+        // The set takes ownership of the object only when it is inserted.
+        bool insert(HashObject *pObject, bool pAllowDuplicateSorts = false);
+
+        // Removes and deletes the first item matching the hash.
+        // Returns true if an item was removed.
+        bool remove(const Hash &pHash);
+
+        // Remove and deletes all items with a matching hash.
+        // Returns the number of items removed.
+        unsigned int removeAll(const Hash &pHash);
+
+        // Calls pFunction(HashObject *) with the first item matching the hash while its shard is
+        //   locked.
+        // Returns false if not found.
+        template <class tFunction>
+        bool get(const Hash &pHash, tFunction pFunction);
+
+        // Returns item and doesn't delete it. The caller takes ownership.
+        HashObject *getAndRemove(const Hash &pHash);
+
+        void clear();
+        void clearNoDelete(); // Doesn't delete items.
+
+        void shrink();
+
+        // Calls pFunction(HashObject *) for each item in the shard, in sorted order, while the
+        //   shard is locked.
+        // pFunction must not call back into this set for the same shard.
+        template <class tFunction>
+        void forEachInShard(unsigned int pShard, tFunction pFunction);
+
+        // Calls pFunction(HashObject *) for each item, one shard at a time. Each shard is
+        //   consistent, but other threads can modify shards that have not been reached yet.
+        template <class tFunction>
+        void forEach(tFunction pFunction)
+        {
+            for(unsigned int i = 0; i < SHARD_COUNT; ++i)
+                forEachInShard(i, pFunction);
+        }
+
+        static unsigned int shardFor(const Hash &pHash)
+        {
+            if(pHash.isEmpty())
+                return 0;
+            return pHash.getByte(pHash.size() - 1);
+        }
+
+        static bool test();
+
+    private:
+
+        // Used for lookups in SortedSets containing HashObjects
+        class HashLookupObject : public HashObject
+        {
+        public:
+
+            HashLookupObject(const Hash &pHash) : mHash(pHash) {}
+            ~HashLookupObject() {}
+
+            const Hash &getHash() { return mHash; }
+
+        private:
+
+            const Hash &mHash;
+
+        };
+
+        // Aligned so each lock is on its own cache line and threads using neighboring shards
+        //   don't contend on the same line.
+        class alignas(64) Shard
+        {
+        public:
+
+            Shard() : lock("HashSetShard") {}
+
+            MutexWithConstantName lock;
+            SortedSet set;
+
+        };
+
+        std::atomic<unsigned int> mSize;
+        Shard mShards[SHARD_COUNT];
+
+        Shard &shard(const Hash &pHash) { return mShards[shardFor(pHash)]; }
+
+        ConcurrentHashSet(const ConcurrentHashSet &pCopy);
+        ConcurrentHashSet &operator = (const ConcurrentHashSet &pRight);
+
+    };
+
+    template <class tFunction>
+    bool ConcurrentHashSet::get(const Hash &pHash, tFunction pFunction)
+    {
+        HashLookupObject lookup(pHash);
+        Shard &hashShard = shard(pHash);
+
+        hashShard.lock.lock();
+        HashObject *result = (HashObject *)hashShard.set.get(lookup);
+        if(result != NULL)
+            pFunction(result);
+        hashShard.lock.unlock();
+        return result != NULL;
+    }
+
+    template <class tFunction>
+    void ConcurrentHashSet::forEachInShard(unsigned int pShard, tFunction pFunction)
+    {
+        Shard &iterShard = mShards[pShard];
+
+        iterShard.lock.lock();
+        for(SortedSet::Iterator item = iterShard.set.begin(); item != iterShard.set.end();
+          ++item)
+            pFunction((HashObject *)*item);
+        iterShard.lock.unlock();
+    }
+}
+
+#endif
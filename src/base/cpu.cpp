@@ -0,0 +1,103 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "cpu.hpp"
+
+#include "string.hpp"
+
+#include <cstdint>
+
+#ifdef NEXTCASH_X86_INTRINSICS
+#include <cpuid.h>
+#endif
+
+
+namespace NextCash
+{
+    namespace CPU
+    {
+        static const char *sFeatureNames[] =
+          { "SSSE3", "SSE4.1", "SSE4.2", "AVX", "AVX2", "BMI2", "SHA", "AES", "PCLMUL" };
+        static const unsigned int FEATURE_COUNT = sizeof(sFeatureNames) / sizeof(const char *);
+
+        // Returns a bit for each supported feature.
+        static uint32_t detect()
+        {
+            uint32_t result = 0;
+#ifdef NEXTCASH_X86_INTRINSICS
+            unsigned int eax, ebx, ecx, edx;
+            if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+                return result;
+
+            if(ecx & (1 << 9))
+                result |= 1 << SSSE3;
+            if(ecx & (1 << 19))
+                result |= 1 << SSE41;
+            if(ecx & (1 << 20))
+                result |= 1 << SSE42;
+            if(ecx & (1 << 25))
+                result |= 1 << AES;
+            if(ecx & (1 << 1))
+                result |= 1 << PCLMUL;
+
+            // AVX registers are only usable if the operating system saves them (OSXSAVE and the
+            //   XMM and YMM bits of XCR0).
+            bool avxUsable = false;
+            if((ecx & (1 << 27)) && (ecx & (1 << 28)))
+            {
+                uint32_t xcr0, xcr0High;
+                __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+                avxUsable = (xcr0 & 0x06) == 0x06;
+            }
+            if(avxUsable)
+                result |= 1 << AVX;
+
+            if(__get_cpuid_max(0, NULL) >= 7)
+            {
+                __cpuid_count(7, 0, eax, ebx, ecx, edx);
+                if(avxUsable && (ebx & (1 << 5)))
+                    result |= 1 << AVX2;
+                if(ebx & (1 << 8))
+                    result |= 1 << BMI2;
+                if(ebx & (1 << 29))
+                    result |= 1 << SHA;
+            }
+#endif
+            return result;
+        }
+
+        static uint32_t features()
+        {
+            static const uint32_t result = detect();
+            return result;
+        }
+
+        bool has(Feature pFeature)
+        {
+            return features() & (1 << pFeature);
+        }
+
+        static String buildFeatureNames()
+        {
+            String result;
+            for(unsigned int i = 0; i < FEATURE_COUNT; ++i)
+                if(has((Feature)i))
+                {
+                    if(result.length() > 0)
+                        result += " ";
+                    result += sFeatureNames[i];
+                }
+            return result;
+        }
+
+        const char *featureNames()
+        {
+            static const String result = buildFeatureNames();
+            return result.text();
+        }
+    }
+}
@@ -0,0 +1,35 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_CPU_HPP
+#define NEXTCASH_CPU_HPP
+
+// Code using x86 instruction set extensions is compiled per function with target attributes,
+//   so the rest of the program doesn't require them, and is only called after checking
+//   CPU::has (currently only supports g++ and clang).
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define NEXTCASH_X86_INTRINSICS
+#endif
+
+
+namespace NextCash
+{
+    // Instruction set extensions of the processor running the program.
+    namespace CPU
+    {
+        enum Feature { SSSE3, SSE41, SSE42, AVX, AVX2, BMI2, SHA, AES, PCLMUL };
+
+        // Returns true if the processor and operating system support the feature. Always false
+        //   when NEXTCASH_X86_INTRINSICS isn't defined.
+        bool has(Feature pFeature);
+
+        // Space separated names of supported features.
+        const char *featureNames();
+    }
+}
+
+#endif
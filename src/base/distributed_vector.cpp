@@ -8,6 +8,9 @@
 #include "distributed_vector.hpp"
 
 #include "log.hpp"
+#include "math.hpp"
+#include "string.hpp"
+#include "timer.hpp"
 
 
 namespace NextCash
@@ -213,6 +216,133 @@ namespace NextCash
         // for(item=testVector.begin();item!=testVector.end();++item)
             // Log::addFormatted(Log::INFO, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME, "Vector : %3d", *item);
 
+        /***********************************************************************************************
+         * DistributedVector distribute moves items
+         ***********************************************************************************************/
+        DistributedVector<String> moveVector(4);
+        std::vector<const char *> moveAddresses;
+        for(unsigned int i = 0; i < 3000; ++i)
+        {
+            String value;
+            value.writeFormatted("%d", i);
+            moveAddresses.push_back(value.text());
+            if(i % 2 == 0)
+                moveVector.push_back(std::move(value));
+            else
+                moveVector.emplace(moveVector.end(), std::move(value));
+        }
+
+        bool moveSuccess = moveVector.size() == 3000 && moveVector.dataSet(2)->size() > 0;
+        unsigned int moveOffset = 0;
+        String moveValue;
+        for(DistributedVector<String>::Iterator moveItem = moveVector.begin();
+          moveSuccess && moveItem != moveVector.end(); ++moveItem, ++moveOffset)
+        {
+            moveValue.clear();
+            moveValue.writeFormatted("%d", moveOffset);
+            if(*moveItem != moveValue || moveItem->text() != moveAddresses[moveOffset])
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME,
+                  "Failed distribute move at %d : %s", moveOffset, moveItem->text());
+                moveSuccess = false;
+            }
+        }
+
+        if(moveSuccess)
+            Log::add(Log::INFO, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME, "Passed distribute move");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME, "Failed distribute move");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * DistributedVector random access
+         ***********************************************************************************************/
+        DistributedVector<unsigned int> accessVector(100);
+        std::vector<unsigned int> accessCheck;
+        bool accessSuccess = true;
+        unsigned int position, value, count;
+
+        // Random inserts and erases so sets have different sizes and are distributed.
+        for(unsigned int i = 0; i < 40000; ++i)
+        {
+            if(accessCheck.size() > 0 && Math::randomInt() % 4 == 0)
+            {
+                position = Math::randomInt() % accessCheck.size();
+                accessVector.erase(accessVector.begin() + position);
+                accessCheck.erase(accessCheck.begin() + position);
+            }
+            else
+            {
+                position = Math::randomInt() % (accessCheck.size() + 1);
+                accessVector.insert(accessVector.begin() + position, i);
+                accessCheck.insert(accessCheck.begin() + position, i);
+            }
+        }
+
+        if(accessVector.size() != accessCheck.size())
+            accessSuccess = false;
+
+        for(position = 0; accessSuccess && position < accessCheck.size(); ++position)
+            if(accessVector[position] != accessCheck[position])
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME,
+                  "Failed random access at %d : %d != %d", position, accessVector[position],
+                  accessCheck[position]);
+                accessSuccess = false;
+            }
+
+        // Iterator arithmetic in both directions, including past each end.
+        DistributedVector<unsigned int>::Iterator accessItem;
+        for(unsigned int i = 0; accessSuccess && i < 1000; ++i)
+        {
+            position = Math::randomInt() % accessCheck.size();
+            count = Math::randomInt() % accessCheck.size();
+            accessItem = accessVector.begin() + position;
+            if(position + count < accessCheck.size())
+                accessSuccess = *(accessItem + count) == accessCheck[position + count];
+            else
+                accessSuccess = accessItem + count == accessVector.end();
+            if(accessSuccess && count <= position)
+                accessSuccess = *(accessItem - count) == accessCheck[position - count];
+            else if(accessSuccess)
+                accessSuccess = accessItem - count == accessVector.begin();
+            if(!accessSuccess)
+                Log::addFormatted(Log::ERROR, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME,
+                  "Failed iterator arithmetic from %d by %d", position, count);
+        }
+
+        if(accessSuccess && (accessVector.end() - 1 != --accessVector.end() ||
+          *(accessVector.end() - accessCheck.size()) != accessCheck.front()))
+            accessSuccess = false;
+
+        // Sets modified directly are counted after refresh.
+        accessVector.dataSet(0)->insert(accessVector.dataSet(0)->begin(), 1000000);
+        accessCheck.insert(accessCheck.begin(), 1000000);
+        accessVector.refresh();
+        position = accessCheck.size() / 2;
+        if(accessVector[0] != 1000000 || accessVector[position] != accessCheck[position] ||
+          accessVector.size() != accessCheck.size())
+            accessSuccess = false;
+
+        Timer accessTimer(true);
+        value = 0;
+        for(unsigned int i = 0; i < 100000; ++i)
+            value += accessVector[Math::randomInt() % accessVector.size()];
+        accessTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME,
+          "100000 random accesses into %d items in 100 sets : %d us", accessVector.size(),
+          (int)accessTimer.microseconds());
+
+        if(accessSuccess)
+            Log::add(Log::INFO, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME, "Passed random access");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME, "Failed random access");
+            success = false;
+        }
+
         return success;
     }
 }
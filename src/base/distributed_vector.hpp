@@ -12,6 +12,8 @@
 
 #include <cstring>
 #include <vector>
+#include <iterator>
+#include <utility>
 
 #define NEXTCASH_DISTRIBUTED_VECTOR_LOG_NAME "DistributedVector"
 
@@ -21,7 +23,9 @@ namespace NextCash
     // This class reduces insert times on large data sets because an insert doesn't require moving
     //   all objects after the insert position, only those in the subset
     // It does increase time for iteration, moving iterators up and down the data set, because it
-    //   has to traverse the multiple sets. Especially finding an iterator at an arbitrary offset.
+    //   has to traverse the multiple sets.
+    // A Fenwick tree of set sizes is kept so finding an iterator at an arbitrary offset, or moving
+    //   an iterator by more than the rest of its set, is O(log sets) instead of walking the sets.
     template <class tType>
     class DistributedVector
     {
@@ -155,16 +159,31 @@ namespace NextCash
         tType &operator [](unsigned int pOffset);
 
         // Insert new item before specified item
-        void insert(const Iterator &pBefore, const tType &pValue);
+        void insert(const Iterator &pBefore, const tType &pValue)
+          { emplace(pBefore, pValue); }
+        void insert(const Iterator &pBefore, tType &&pValue)
+          { emplace(pBefore, std::move(pValue)); }
+
+        // Construct a new item in place before specified item
+        template <typename... tArgs>
+        void emplace(const Iterator &pBefore, tArgs &&...pArgs);
 
         // Add a new item to the end
-        void push_back(const tType &pValue);
+        void push_back(const tType &pValue) { emplace_back(pValue); }
+        void push_back(tType &&pValue) { emplace_back(std::move(pValue)); }
+
+        // Construct a new item in place at the end
+        template <typename... tArgs>
+        void emplace_back(tArgs &&...pArgs);
 
         // Remove specified item and return the item after it
         Iterator erase(const Iterator &pItem);
 
+        // Direct access to a set. refresh() must be called after changing the size of sets
+        //   directly.
         std::vector<tType> *dataSet(unsigned int pOffset) { return mSets + pOffset; }
 
+        // Update size and set size tree after sets were modified directly.
         void refresh();
 
     private:
@@ -177,12 +196,27 @@ namespace NextCash
         // Distribute items to other sets if one set is getting too large
         void distribute(std::vector<tType> *pSet, bool pFromPrevious, bool pFromNext);
 
+        // Set size tree
+        // Add pCount to the size of the set.
+        void addSetSize(std::vector<tType> *pSet, int pCount);
+        // Return the number of items in the sets before the specified set.
+        unsigned int sizeBefore(std::vector<tType> *pSet) const;
+        // Return the Iterator for the item at the offset.
+        Iterator iteratorAt(unsigned int pOffset);
+        // Rebuild set size tree from the set sizes.
+        void buildSetSizes();
+
         unsigned int mSetCount;
         unsigned int mSize;
         std::vector<tType> *mSets;
         std::vector<tType> *mEndSet;
         std::vector<tType> *mLastSet; // Last set that has items in it
 
+        // Fenwick tree of set sizes. Element i (1 based) contains the total size of the sets in
+        //   (i - (i & -i), i].
+        unsigned int *mSetSizes;
+        unsigned int mSetSizesTopBit; // Largest power of two not greater than mSetCount
+
     };
 
     template <class tType>
@@ -193,12 +227,19 @@ namespace NextCash
         mEndSet = mSets + mSetCount;
         mLastSet = mSets;
         mSize = 0;
+
+        mSetSizes = new unsigned int[mSetCount + 1];
+        std::memset(mSetSizes, 0, (mSetCount + 1) * sizeof(unsigned int));
+        mSetSizesTopBit = 1;
+        while(mSetSizesTopBit * 2 <= mSetCount)
+            mSetSizesTopBit *= 2;
     }
 
     template <class tType>
     DistributedVector<tType>::~DistributedVector()
     {
         delete[] mSets;
+        delete[] mSetSizes;
     }
 
     template <class tType>
@@ -218,6 +259,59 @@ namespace NextCash
             set->clear();
         mLastSet = mSets;
         mSize = 0;
+        std::memset(mSetSizes, 0, (mSetCount + 1) * sizeof(unsigned int));
+    }
+
+    template <class tType>
+    void DistributedVector<tType>::addSetSize(std::vector<tType> *pSet, int pCount)
+    {
+        for(unsigned int i = (pSet - mSets) + 1; i <= mSetCount; i += i & (~i + 1))
+            mSetSizes[i] += pCount;
+    }
+
+    template <class tType>
+    unsigned int DistributedVector<tType>::sizeBefore(std::vector<tType> *pSet) const
+    {
+        unsigned int result = 0;
+        for(unsigned int i = pSet - mSets; i > 0; i -= i & (~i + 1))
+            result += mSetSizes[i];
+        return result;
+    }
+
+    template <class tType>
+    typename DistributedVector<tType>::Iterator DistributedVector<tType>::iteratorAt(unsigned int pOffset)
+    {
+        if(pOffset >= mSize)
+            return end();
+
+        // Find the last set count where the sets before it have no more than pOffset items.
+        unsigned int setOffset = 0, next;
+        for(unsigned int bit = mSetSizesTopBit; bit > 0; bit >>= 1)
+        {
+            next = setOffset + bit;
+            if(next <= mSetCount && mSetSizes[next] <= pOffset)
+            {
+                setOffset = next;
+                pOffset -= mSetSizes[next];
+            }
+        }
+
+        std::vector<tType> *set = mSets + setOffset;
+        return Iterator(this, set, set->begin() + pOffset);
+    }
+
+    template <class tType>
+    void DistributedVector<tType>::buildSetSizes()
+    {
+        unsigned int parent;
+        for(unsigned int i = 1; i <= mSetCount; ++i)
+            mSetSizes[i] = mSets[i - 1].size();
+        for(unsigned int i = 1; i <= mSetCount; ++i)
+        {
+            parent = i + (i & (~i + 1));
+            if(parent <= mSetCount)
+                mSetSizes[parent] += mSetSizes[i];
+        }
     }
 
     template <class tType>
@@ -232,16 +326,7 @@ namespace NextCash
         else if(set == enclosing->mEndSet - 1)
             return enclosing->end(); // Result would be past the end
 
-        unsigned int remaining = pCount - remainingInThisSet;
-        for(std::vector<tType> *newSet=set+1;newSet<enclosing->mEndSet;++newSet)
-        {
-            if(newSet->size() > remaining)
-                return Iterator(enclosing, newSet, newSet->begin() + remaining);
-            else
-                remaining -= newSet->size();
-        }
-
-        return enclosing->end();
+        return enclosing->iteratorAt(enclosing->sizeBefore(set) + currentOffset + pCount);
     }
 
     template <class tType>
@@ -260,18 +345,10 @@ namespace NextCash
         else if(set == enclosing->mSets)
             return enclosing->begin(); // Result would be past the beginning
 
-        unsigned int remaining = pCount - currentOffset;
-        for(std::vector<tType> *newSet=set-1;newSet>=enclosing->mSets;--newSet)
-        {
-            if(newSet->size() > remaining)
-                return Iterator(enclosing, newSet, newSet->begin() + (newSet->size() - remaining));
-            else if(newSet->size() == remaining)
-                return Iterator(enclosing, newSet, newSet->begin());
-            else
-                remaining -= newSet->size();
-        }
-
-        return enclosing->end();
+        unsigned int offset = enclosing->sizeBefore(set) + currentOffset;
+        if(offset < pCount)
+            return enclosing->begin(); // Result would be past the beginning
+        return enclosing->iteratorAt(offset - pCount);
     }
 
     template <class tType>
@@ -337,7 +414,7 @@ namespace NextCash
     template <class tType>
     tType &DistributedVector<tType>::operator [](unsigned int pOffset)
     {
-        return *(begin() + pOffset);
+        return *iteratorAt(pOffset);
     }
 
     template <class tType>
@@ -415,10 +492,17 @@ namespace NextCash
                   addCount, originalSize, nextSet->size());
 
                 // Insert items from end of current set at beginning of the next set.
-                nextSet->insert(nextSet->begin(), pSet->end() - addCount, pSet->end());
+                nextSet->insert(nextSet->begin(), std::make_move_iterator(pSet->end() - addCount),
+                  std::make_move_iterator(pSet->end()));
 
                 // Remove items from the end of the current set.
                 pSet->erase(pSet->end() - addCount, pSet->end());
+
+                addSetSize(nextSet, addCount);
+                addSetSize(pSet, -(int)addCount);
+
+                if(pSet == mLastSet)
+                    mLastSet = nextSet;
             }
         }
 
@@ -432,13 +516,14 @@ namespace NextCash
                   addCount, originalSize, previousSet->size());
 
                 // Append items from the beginning of the current set to the end or previous set.
-                unsigned int previousSize = previousSet->size();
-                previousSet->resize(previousSet->size() + addCount);
-                std::move(pSet->begin(), pSet->begin() + addCount,
-                  previousSet->begin() + previousSize);
+                previousSet->insert(previousSet->end(), std::make_move_iterator(pSet->begin()),
+                  std::make_move_iterator(pSet->begin() + addCount));
 
                 // Remove items from the beginning of the current set.
                 pSet->erase(pSet->begin(), pSet->begin() + addCount);
+
+                addSetSize(previousSet, addCount);
+                addSetSize(pSet, -(int)addCount);
             }
         }
 
@@ -449,46 +534,52 @@ namespace NextCash
     }
 
     template <class tType>
-    void DistributedVector<tType>::insert(const Iterator &pBefore, const tType &pValue)
+    template <typename... tArgs>
+    void DistributedVector<tType>::emplace(const Iterator &pBefore, tArgs &&...pArgs)
     {
-        if(pBefore.set != mSets && // Not first set
+        if(pBefore == end()) // Inserting as last item
+            emplace_back(std::forward<tArgs>(pArgs)...);
+        else if(pBefore.set != mSets && // Not first set
           pBefore.item == pBefore.set->begin()) // Inserting before first item of set
         {
             // Add to end of previous set
             std::vector<tType> *set = pBefore.set;
             --set;
-            set->push_back(pValue);
+            set->emplace_back(std::forward<tArgs>(pArgs)...);
             ++mSize;
+            addSetSize(set, 1);
             distribute(set, false, false);
         }
-        else if(pBefore == end()) // Inserting as last item
-            push_back(pValue);
         else if(pBefore.item == pBefore.set->end())
         {
             // Append to this set
-            pBefore.set->push_back(pValue);
+            pBefore.set->emplace_back(std::forward<tArgs>(pArgs)...);
             ++mSize;
+            addSetSize(pBefore.set, 1);
             distribute(pBefore.set, false, false);
         }
         else
         {
             // Normal insert into this set
-            pBefore.set->insert(pBefore.item, pValue);
+            pBefore.set->emplace(pBefore.item, std::forward<tArgs>(pArgs)...);
             ++mSize;
+            addSetSize(pBefore.set, 1);
             distribute(pBefore.set, false, false);
         }
     }
 
     template <class tType>
-    void DistributedVector<tType>::push_back(const tType &pValue)
+    template <typename... tArgs>
+    void DistributedVector<tType>::emplace_back(tArgs &&...pArgs)
     {
         while(true)
         {
             if(mLastSet->size() < mLastSet->capacity() || // This set has more capacity available
               mLastSet == (mEndSet - 1)) // This is the last possible set
             {
-                mLastSet->push_back(pValue);
+                mLastSet->emplace_back(std::forward<tArgs>(pArgs)...);
                 ++mSize;
+                addSetSize(mLastSet, 1);
                 distribute(mLastSet, false, false);
                 return;
             }
@@ -502,6 +593,7 @@ namespace NextCash
     {
         SetIterator nextItem = pItem.set->erase(pItem.item);
         --mSize;
+        addSetSize(pItem.set, -1);
         if(nextItem == pItem.set->end())
         {
             if(pItem.set == mLastSet)
@@ -529,6 +621,7 @@ namespace NextCash
                 mLastSet = set;
                 mSize += set->size();
             }
+        buildSetSizes();
     }
 
     bool testDistributedVector();
@@ -0,0 +1,300 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "frozen_hash_list.hpp"
+
+#include "log.hpp"
+#include "math.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __GNUC__
+#define NEXTCASH_PREFETCH(pAddress) __builtin_prefetch(pAddress)
+#else
+#define NEXTCASH_PREFETCH(pAddress)
+#endif
+
+
+namespace NextCash
+{
+    const unsigned int FrozenHashList::LINE_VALUES;
+
+    FrozenHashList::FrozenHashList()
+    {
+        mSize = 0;
+        mHashSize = 0;
+        mRemainderSize = 0;
+        mValues = NULL;
+    }
+
+    FrozenHashList::FrozenHashList(const HashList &pHashes)
+    {
+        mSize = 0;
+        mHashSize = 0;
+        mRemainderSize = 0;
+        mValues = NULL;
+        build(pHashes);
+    }
+
+    void FrozenHashList::clear()
+    {
+        mSize = 0;
+        mHashSize = 0;
+        mRemainderSize = 0;
+        mValues = NULL;
+        mValueData.clear();
+        mValueData.shrink_to_fit();
+        mRemainders.clear();
+        mRemainders.shrink_to_fit();
+    }
+
+    void FrozenHashList::remainder(const Hash &pHash, uint8_t *pRemainder) const
+    {
+        // Hash data is least significant first and the first 8 bytes are in the value.
+        const uint8_t *byte = pHash.data() + mRemainderSize - 1;
+        for(unsigned int i = 0; i < mRemainderSize; ++i, --byte, ++pRemainder)
+            *pRemainder = *byte;
+    }
+
+    unsigned int FrozenHashList::fill(const HashList &pHashes, unsigned int pSource,
+      unsigned int pNode)
+    {
+        if(pNode > mSize)
+            return pSource;
+
+        // Lower items are in the left subtree and higher items are in the right subtree.
+        pSource = fill(pHashes, pSource, pNode * 2);
+        mValues[pNode] = pHashes[pSource].sortValue();
+        if(mRemainderSize > 0)
+            remainder(pHashes[pSource], mRemainders.data() + (pNode * mRemainderSize));
+        return fill(pHashes, pSource + 1, (pNode * 2) + 1);
+    }
+
+    bool FrozenHashList::build(const HashList &pHashes)
+    {
+        clear();
+        if(pHashes.size() == 0)
+            return true;
+
+        bool sorted = true;
+        uint8_t hashSize = pHashes.front().size();
+        for(HashList::const_iterator hash = pHashes.begin() + 1; hash != pHashes.end(); ++hash)
+        {
+            if(hash->size() != hashSize)
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_FROZEN_HASH_LIST_LOG_NAME,
+                  "Hash sizes don't match : %d != %d", hash->size(), hashSize);
+                return false;
+            }
+            if(sorted && *(hash - 1) > *hash)
+                sorted = false;
+        }
+
+        HashList sortedHashes;
+        const HashList *source = &pHashes;
+        if(!sorted)
+        {
+            sortedHashes = pHashes;
+            std::sort(sortedHashes.begin(), sortedHashes.end());
+            source = &sortedHashes;
+        }
+
+        mSize = pHashes.size();
+        mHashSize = hashSize;
+        if(mHashSize > 8)
+            mRemainderSize = mHashSize - 8;
+
+        // Node 0 is unused so node indices can be multiplied to find children. Allocate an extra
+        //   line so mValues can be aligned to a cache line.
+        mValueData.resize(mSize + 1 + LINE_VALUES);
+        uintptr_t offset = (uintptr_t)mValueData.data() % (LINE_VALUES * sizeof(uint64_t));
+        mValues = mValueData.data();
+        if(offset != 0)
+            mValues += LINE_VALUES - (offset / sizeof(uint64_t));
+        mRemainders.resize((mSize + 1) * mRemainderSize);
+
+        fill(*source, 0, 1);
+        return true;
+    }
+
+    bool FrozenHashList::contains(const Hash &pHash) const
+    {
+        if(mSize == 0 || pHash.size() != mHashSize)
+            return false;
+
+        uint64_t value = pHash.sortValue();
+        uint8_t remainderData[256];
+        if(mRemainderSize > 0)
+            remainder(pHash, remainderData);
+
+        // Descend to the first node not less than pHash without stopping at a match, so every
+        //   search takes the same number of steps and the loop is easy to predict.
+        const uint64_t *nodeValue;
+        unsigned int node = 1;
+        while(node <= mSize)
+        {
+            // The 8 nodes 3 levels below are in one cache line. Prefetching past the end of the
+            //   array is harmless.
+            NEXTCASH_PREFETCH(mValues + (node * LINE_VALUES));
+
+            nodeValue = mValues + node;
+            node *= 2;
+            if(*nodeValue < value || (*nodeValue == value && mRemainderSize > 0 &&
+              std::memcmp(mRemainders.data() + ((node / 2) * mRemainderSize), remainderData,
+              mRemainderSize) < 0))
+                ++node; // Go right
+        }
+
+        // Undo the moves right after the last move left to get back to that node.
+        while(node & 1)
+            node >>= 1;
+        node >>= 1;
+
+        if(node == 0) // All items are less than pHash
+            return false;
+
+        return mValues[node] == value && (mRemainderSize == 0 ||
+          std::memcmp(mRemainders.data() + (node * mRemainderSize), remainderData,
+          mRemainderSize) == 0);
+    }
+
+    // Returns the number of hashes in pLookups found and sets pTime to the microseconds taken.
+    template <class tFunction>
+    static unsigned int frozenHashListLookupTime(HashList &pLookups, tFunction pFunction,
+      unsigned int &pTime)
+    {
+        unsigned int result = 0;
+        Timer timer(true);
+        for(HashList::iterator hash = pLookups.begin(); hash != pLookups.end(); ++hash)
+            if(pFunction(*hash))
+                ++result;
+        timer.stop();
+        pTime = (unsigned int)timer.microseconds();
+        return result;
+    }
+
+    bool FrozenHashList::test()
+    {
+        Log::add(Log::INFO, NEXTCASH_FROZEN_HASH_LIST_LOG_NAME,
+          "------------- Starting Frozen Hash List Tests -------------");
+
+        bool success = true;
+
+        /******************************************************************************************
+         * Every tree shape
+         *****************************************************************************************/
+        bool shapeSuccess = true;
+        HashList hashes, missing;
+        Hash hash(32);
+        FrozenHashList list;
+
+        if(list.contains(hash) || !list.build(hashes) || list.contains(hash))
+            shapeSuccess = false;
+
+        // Sizes up to a few complete levels, unsorted, with 32 and 4 byte hashes.
+        for(unsigned int size = 1; size < 70 && shapeSuccess; ++size)
+            for(unsigned int hashSize = 4; hashSize <= 32; hashSize += 28)
+            {
+                hashes.clear();
+                missing.clear();
+                hash.setSize(hashSize);
+                for(unsigned int i = 0; i < size; ++i)
+                {
+                    hash.randomize();
+                    hashes.push_back(hash);
+                    hash.randomize();
+                    missing.push_back(hash);
+                }
+                hashes.push_back(hashes.front()); // Duplicate
+
+                if(!list.build(hashes) || list.size() != size + 1 || list.hashSize() != hashSize)
+                    shapeSuccess = false;
+                for(unsigned int i = 0; i < size; ++i)
+                    if(!list.contains(hashes[i]) || list.contains(missing[i]))
+                        shapeSuccess = false;
+            }
+
+        // Hashes that only differ in the low bytes.
+        hashes.clear();
+        for(unsigned int i = 0; i < 1000; ++i)
+            hashes.push_back(Hash(32, i * 2));
+        if(!list.build(hashes))
+            shapeSuccess = false;
+        for(unsigned int i = 0; i < 1000; ++i)
+            if(!list.contains(Hash(32, i * 2)) || list.contains(Hash(32, (i * 2) + 1)))
+                shapeSuccess = false;
+        if(list.contains(Hash(20, 2)) || list.contains(Hash(32, 2000)) ||
+          list.contains(Hash(32, -1)))
+            shapeSuccess = false;
+
+        // Sizes must match.
+        hashes.push_back(Hash(20, 1));
+        if(list.build(hashes) || list.size() != 0)
+            shapeSuccess = false;
+
+        if(shapeSuccess)
+            Log::add(Log::INFO, NEXTCASH_FROZEN_HASH_LIST_LOG_NAME, "Passed tree shapes");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_FROZEN_HASH_LIST_LOG_NAME, "Failed tree shapes");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Lookup performance compared to sorted HashList
+         *****************************************************************************************/
+        const unsigned int count = 500000;
+        HashList lookups;
+        hashes.clear();
+        hash.setSize(32);
+        for(unsigned int i = 0; i < count; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+            if(i % 2 == 0)
+                lookups.push_back(hash);
+            else
+            {
+                hash.randomize();
+                lookups.push_back(hash);
+            }
+        }
+        std::sort(hashes.begin(), hashes.end());
+
+        Timer buildTimer(true);
+        FrozenHashList frozen(hashes);
+        buildTimer.stop();
+
+        unsigned int frozenTime, sortedTime, binaryTime;
+        unsigned int frozenFound = frozenHashListLookupTime(lookups,
+          [&](const Hash &pHash) { return frozen.contains(pHash); }, frozenTime);
+        unsigned int sortedFound = frozenHashListLookupTime(lookups,
+          [&](const Hash &pHash) { return hashes.containsSorted(pHash); }, sortedTime);
+        unsigned int binaryFound = frozenHashListLookupTime(lookups,
+          [&](const Hash &pHash)
+          { return std::binary_search(hashes.begin(), hashes.end(), pHash); }, binaryTime);
+
+        Log::addFormatted(Log::INFO, NEXTCASH_FROZEN_HASH_LIST_LOG_NAME,
+          "%d lookups in %d hashes (built in %d us) : FrozenHashList %d us, HashList %d us, "
+          "binary search %d us", lookups.size(), count, (int)buildTimer.microseconds(), frozenTime, sortedTime,
+          binaryTime);
+
+        if(frozenFound == count / 2 && sortedFound == frozenFound && binaryFound == frozenFound)
+            Log::add(Log::INFO, NEXTCASH_FROZEN_HASH_LIST_LOG_NAME, "Passed lookups");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_FROZEN_HASH_LIST_LOG_NAME,
+              "Failed lookups : found %d, HashList found %d, binary search found %d", frozenFound,
+              sortedFound, binaryFound);
+            success = false;
+        }
+
+        return success;
+    }
+}
@@ -0,0 +1,81 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_FROZEN_HASH_LIST_HPP
+#define NEXTCASH_FROZEN_HASH_LIST_HPP
+
+#include "hash.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#define NEXTCASH_FROZEN_HASH_LIST_LOG_NAME "FrozenHashList"
+
+
+namespace NextCash
+{
+    // Sorted hashes for lists that are searched often and rebuilt rarely, like checkpoints or
+    //   banned hashes.
+    // Hashes are stored in Eytzinger (breadth first) order so the top levels of every search
+    //   share the same cache lines and the nodes a search can reach a few levels down are
+    //   adjacent, so they are prefetched together.
+    // The most significant 8 bytes of each hash are kept in their own array so most comparisons
+    //   only read 8 bytes and 8 nodes fit in a cache line.
+    // Can't be modified after it is built. All hashes must be the same size.
+    class FrozenHashList
+    {
+    public:
+
+        FrozenHashList();
+        FrozenHashList(const HashList &pHashes);
+        ~FrozenHashList() {}
+
+        // Replaces the contents with pHashes. O(n) when pHashes is sorted, otherwise a sorted copy
+        //   is made first.
+        // Returns false and leaves the list empty if the hashes are not all the same size.
+        bool build(const HashList &pHashes);
+
+        void clear();
+
+        unsigned int size() const { return mSize; }
+        uint8_t hashSize() const { return mHashSize; }
+
+        bool contains(const Hash &pHash) const;
+
+        static bool test();
+
+    private:
+
+        // Number of values in a 64 byte cache line.
+        static const unsigned int LINE_VALUES = 8;
+
+        // Remainder bytes of pHash, most significant first.
+        void remainder(const Hash &pHash, uint8_t *pRemainder) const;
+
+        // Copies sorted hashes starting at pSource into the subtree under pNode. Returns the
+        //   offset of the next hash to copy.
+        unsigned int fill(const HashList &pHashes, unsigned int pSource, unsigned int pNode);
+
+        unsigned int mSize;
+        uint8_t mHashSize;
+        unsigned int mRemainderSize; // Bytes of each hash after the first 8.
+
+        // Most significant 8 bytes of each hash (Hash::sortValue). Node 1 is the root and the
+        //   children of node n are 2n and 2n + 1.
+        std::vector<uint64_t> mValueData;
+        uint64_t *mValues; // Within mValueData, aligned to a cache line.
+
+        // Rest of each hash, most significant first, in the same order as mValues.
+        std::vector<uint8_t> mRemainders;
+
+        FrozenHashList(const FrozenHashList &pCopy);
+        const FrozenHashList &operator = (const FrozenHashList &pRight);
+
+    };
+}
+
+#endif
@@ -9,7 +9,12 @@
 
 #include "endian.hpp"
 #include "log.hpp"
+#include "math.hpp"
 #include "digest.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <cstring>
 
 
 namespace NextCash
@@ -237,6 +242,29 @@ namespace NextCash
         return result;
     }
 
+    uint64_t Hash::sortValue() const
+    {
+        if(mData == NULL)
+            return 0;
+
+        // Most significant bytes are at the end.
+        uint64_t result = 0;
+        if(mSize >= 8)
+        {
+            std::memcpy(&result, mData + mSize - 8, 8);
+            return Endian::convert(result, Endian::LITTLE);
+        }
+
+        for(uint8_t i = 0; i < 8; ++i)
+        {
+            result <<= 8;
+            if(i < mSize)
+                result |= mData[mSize - 1 - i];
+        }
+
+        return result;
+    }
+
     const Hash &Hash::operator = (int64_t pValue)
     {
         if(mData == NULL)
@@ -576,18 +604,18 @@ namespace NextCash
         }
     }
 
-    bool HashList::insertSorted(const Hash &pHash)
+    bool HashList::findInsertPosition(const Hash &pHash, iterator &pPosition)
     {
         if(size() == 0)
         {
-            push_back(pHash);
+            pPosition = end();
             return true;
         }
 
         int compare = back().compare(pHash);
         if(compare < 0)
         {
-            push_back(pHash);
+            pPosition = end();
             return true;
         }
         else if(compare == 0)
@@ -596,37 +624,116 @@ namespace NextCash
         compare = front().compare(pHash);
         if(compare > 0)
         {
-            insert(begin(), pHash);
+            pPosition = begin();
             return true;
         }
         else if(compare == 0)
             return false;
 
-        Hash *bottom = data();
-        Hash *top = data() + size() - 1;
-        Hash *current;
+        Hash *insertBefore;
+        if(searchSorted(pHash, insertBefore) != NULL)
+            return false; // Match found
+
+        pPosition = begin() + (insertBefore - data());
+        return true;
+    }
 
-        while(true)
+    // Compare with the most significant bytes already loaded for interpolation before comparing
+    //   the rest.
+    static inline int compareSorted(const Hash &pLeft, uint64_t pLeftValue, const Hash &pRight,
+      uint64_t pRightValue)
+    {
+        if(pLeft.size() == pRight.size())
         {
-            // Break the set in two halves
-            current = bottom + ((top - bottom) / 2);
+            if(pLeftValue < pRightValue)
+                return -1;
+            if(pLeftValue > pRightValue)
+                return 1;
+        }
+        return pLeft.compare(pRight);
+    }
 
-            if(current == bottom)
-                break;
+    Hash *HashList::searchSorted(const Hash &pHash, Hash *&pInsertBefore)
+    {
+        Hash *bottom = data();
+        Hash *top = data() + size() - 1;
+        Hash *current, *guard = NULL;
+        uint64_t value = pHash.sortValue(), currentValue;
+        uint64_t bottomValue = bottom->sortValue(), topValue = top->sortValue();
+        bool interpolate = true;
+        unsigned int range = 0;
+        int compare;
+
+        while(top - bottom > 1)
+        {
+            // Estimate the position from the hash values since hashes are uniformly
+            //   distributed. Use the middle if the last estimate didn't at least halve the range
+            //   so badly distributed values are still O(log n).
+            if(guard != NULL)
+                current = guard;
+            else
+            {
+                range = top - bottom;
+                if(interpolate)
+                    current = bottom + Math::interpolate(0, range, bottomValue, topValue, value);
+                else
+                    current = bottom + (range / 2);
+            }
 
-            // Determine which half the desired item is in
-            compare = pHash.compare(*current);
+            // Determine which part the desired item is in
+            currentValue = current->sortValue();
+            compare = compareSorted(pHash, value, *current, currentValue);
             if(compare > 0)
+            {
                 bottom = current;
+                bottomValue = currentValue;
+            }
             else if(compare < 0)
+            {
                 top = current;
+                topValue = currentValue;
+            }
             else
-                return false; // Match found
+                return current;
+
+            if(guard == NULL && interpolate)
+            {
+                // The estimate is usually close, but leaves most of the range on the other side
+                //   of the item, so check a little past it.
+                if(compare > 0)
+                    guard = current + Math::interpolateGuard(range);
+                else
+                    guard = current - Math::interpolateGuard(range);
+                if(guard <= bottom || guard >= top)
+                    guard = NULL;
+            }
+            else
+            {
+                guard = NULL;
+                interpolate = (unsigned int)(top - bottom) * 2 <= range;
+            }
         }
 
-        iterator after = begin();
-        after += (current - data());
-        insert(after, pHash);
+        // pHash is above bottom and below top
+        pInsertBefore = top;
+        return NULL;
+    }
+
+    bool HashList::insertSorted(const Hash &pHash)
+    {
+        iterator position;
+        if(!findInsertPosition(pHash, position))
+            return false;
+        insert(position, pHash);
+        return true;
+    }
+
+    bool HashList::insertSorted(Hash &&pHash)
+    {
+        iterator position;
+        if(!findInsertPosition(pHash, position))
+            return false;
+        insert(position, std::move(pHash));
         return true;
     }
 
@@ -647,27 +754,8 @@ namespace NextCash
         else if(compare == 0)
             return true;
 
-        Hash *bottom = data();
-        Hash *top = data() + size() - 1;
-        Hash *current;
-
-        while(true)
-        {
-            // Break the set in two halves
-            current = bottom + ((top - bottom) / 2);
-            compare = pHash.compare(*current);
-
-            if(current == bottom)
-                return false;
-
-            // Determine which half the desired item is in
-            if(compare > 0)
-                bottom = current;
-            else if(compare < 0)
-                top = current;
-            else
-                return true;
-        }
+        Hash *insertBefore;
+        return searchSorted(pHash, insertBefore) != NULL;
     }
 
     bool HashList::removeSorted(const Hash &pHash)
@@ -693,30 +781,13 @@ namespace NextCash
             return true;
         }
 
-        Hash *bottom = data();
-        Hash *top = data() + size() - 1;
-        Hash *current;
-
-        while(true)
-        {
-            // Break the set in two halves
-            current = bottom + ((top - bottom) / 2);
-            if(current == bottom)
-                return false;
+        Hash *insertBefore;
+        Hash *match = searchSorted(pHash, insertBefore);
+        if(match == NULL)
+            return false;
 
-            // Determine which half the desired item is in
-            compare = pHash.compare(*current);
-            if(compare > 0)
-                bottom = current;
-            else if(compare < 0)
-                top = current;
-            else
-            {
-                // Remove current
-                erase(begin() + (current - data()));
-                return true;
-            }
-        }
+        erase(begin() + (match - data()));
+        return true;
     }
 
     bool Hash::test()
@@ -1248,6 +1319,150 @@ namespace NextCash
             success = false;
         }
 
+        /***********************************************************************************************
+         * Hash move
+         ***********************************************************************************************/
+        Hash moveSource("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef");
+        Hash moveCompare(moveSource);
+        const uint8_t *moveData = moveSource.data();
+        Hash moveConstructed(std::move(moveSource));
+        if(moveConstructed.data() == moveData && moveSource.isEmpty() &&
+          moveConstructed == moveCompare)
+            Log::add(Log::INFO, NEXTCASH_HASH_LOG_NAME, "Passed hash move constructor");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_LOG_NAME, "Failed hash move constructor");
+            success = false;
+        }
+
+        Hash moveAssigned(20);
+        moveAssigned = std::move(moveConstructed);
+        if(moveAssigned.data() == moveData && moveConstructed.isEmpty() &&
+          moveAssigned == moveCompare)
+            Log::add(Log::INFO, NEXTCASH_HASH_LOG_NAME, "Passed hash move assign");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_LOG_NAME, "Failed hash move assign");
+            success = false;
+        }
+
+        // Arithmetic on a temporary reuses its data.
+        Hash moveOne(32, 1), moveTwo(32, 2);
+        Hash moveSum = Hash(32, 5) + moveOne;
+        moveData = moveSum.data();
+        moveSum = std::move(moveSum) + moveTwo;
+        if(moveSum.data() == moveData && moveSum == Hash(32, 8))
+            Log::add(Log::INFO, NEXTCASH_HASH_LOG_NAME, "Passed hash move arithmetic");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_HASH_LOG_NAME,
+              "Failed hash move arithmetic : %s", moveSum.hex().text());
+            success = false;
+        }
+
+        // Vector reallocation moves hashes instead of copying them.
+        HashList moveList;
+        std::vector<const uint8_t *> moveAddresses;
+        for(unsigned int i = 0; i < 16; ++i)
+        {
+            Hash moveHash(32, (i * 7) % 16);
+            moveAddresses.push_back(moveHash.data());
+            moveList.insertSorted(std::move(moveHash));
+        }
+        moveList.reserve(moveList.capacity() * 4); // Force reallocation
+
+        bool moveListSuccess = moveList.size() == 16;
+        for(HashList::iterator hash = moveList.begin(); moveListSuccess && hash != moveList.end();
+          ++hash)
+        {
+            if(*hash != Hash(32, hash - moveList.begin()))
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_HASH_LOG_NAME,
+                  "Failed hash list move sorting at %d : %s", (int)(hash - moveList.begin()),
+                  hash->hex().text());
+                moveListSuccess = false;
+            }
+            else if(hash->data() != moveAddresses[(hash->lookup8() * 7) % 16])
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_HASH_LOG_NAME,
+                  "Failed hash list move at %d : hash was copied", (int)(hash - moveList.begin()));
+                moveListSuccess = false;
+            }
+        }
+
+        if(moveListSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_LOG_NAME, "Passed hash list move");
+        else
+            success = false;
+
+        /***********************************************************************************************
+         * Hash list interpolation search
+         ***********************************************************************************************/
+        bool searchSuccess = true;
+        Hash sortHash("0102030405060708090a");
+        if(sortHash.sortValue() != 0x0102030405060708 || Hash(32, 5).sortValue() != 0)
+            searchSuccess = false;
+
+        // Uniform hashes
+        HashList searchList, missingList;
+        Hash searchHash(32);
+        for(unsigned int i = 0; i < 200000; ++i)
+        {
+            searchHash.randomize();
+            searchList.push_back(searchHash);
+            searchHash.randomize();
+            missingList.push_back(searchHash);
+        }
+        std::sort(searchList.begin(), searchList.end());
+
+        unsigned int found = 0;
+        Timer searchTimer(true);
+        for(HashList::iterator hash = searchList.begin(); hash != searchList.end(); ++hash)
+            if(searchList.containsSorted(*hash))
+                ++found;
+        for(HashList::iterator hash = missingList.begin(); hash != missingList.end(); ++hash)
+            if(searchList.containsSorted(*hash))
+                ++found;
+        searchTimer.stop();
+
+        Timer binaryTimer(true);
+        for(HashList::iterator hash = searchList.begin(); hash != searchList.end(); ++hash)
+            if(std::binary_search(searchList.begin(), searchList.end(), *hash))
+                ++found;
+        for(HashList::iterator hash = missingList.begin(); hash != missingList.end(); ++hash)
+            if(std::binary_search(searchList.begin(), searchList.end(), *hash))
+                ++found;
+        binaryTimer.stop();
+
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_LOG_NAME,
+          "%d sorted hash lookups : interpolation %d us, binary %d us", searchList.size() * 2,
+          (int)searchTimer.microseconds(), (int)binaryTimer.microseconds());
+        if(found != searchList.size() * 2)
+            searchSuccess = false;
+
+        // Badly distributed hashes still work with the binary search fallback.
+        HashList skewedList;
+        for(unsigned int i = 0; i < 10000; ++i)
+            skewedList.push_back(Hash(32, i * 2));
+        searchHash.setMax();
+        skewedList.push_back(searchHash);
+        for(unsigned int i = 0; i < 10000; ++i)
+            if(!skewedList.containsSorted(Hash(32, i * 2)) ||
+              skewedList.containsSorted(Hash(32, (i * 2) + 1)))
+                searchSuccess = false;
+        if(!skewedList.containsSorted(searchHash) || !skewedList.insertSorted(Hash(32, 5001)) ||
+          skewedList[2501] != Hash(32, 5001) || !skewedList.removeSorted(Hash(32, 5000)) ||
+          skewedList.containsSorted(Hash(32, 5000)))
+            searchSuccess = false;
+
+        if(searchSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_LOG_NAME, "Passed hash list interpolation search");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_LOG_NAME, "Failed hash list interpolation search");
+            success = false;
+        }
+
         return success;
     }
 }
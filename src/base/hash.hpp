@@ -18,6 +18,7 @@
 #endif
 
 #include <vector>
+#include <utility>
 
 #define NEXTCASH_HASH_LOG_NAME "Hash"
 
@@ -36,9 +37,30 @@ namespace NextCash
         Hash(InputStream *pStream, uint8_t pSize)
           { mSize = 0; mData = NULL; allocate(pSize); read(pStream); }
         Hash(const Hash &pCopy);
+        // Take the data of pValue without allocating. pValue is left empty.
+        Hash(Hash &&pValue) noexcept
+        {
+            mSize = pValue.mSize;
+            mData = pValue.mData;
+            pValue.mSize = 0;
+            pValue.mData = NULL;
+        }
         ~Hash() { if(mData != NULL) delete[] mData; }
 
         const Hash &operator = (const Hash &pRight);
+        const Hash &operator = (Hash &&pRight) noexcept
+        {
+            if(this != &pRight)
+            {
+                if(mData != NULL)
+                    delete[] mData;
+                mSize = pRight.mSize;
+                mData = pRight.mData;
+                pRight.mSize = 0;
+                pRight.mData = NULL;
+            }
+            return *this;
+        }
 
         // Return the size in memory of a hash of a specific size.
         static constexpr stream_size memorySize(stream_size pSize)
@@ -134,6 +156,11 @@ namespace NextCash
 
         int compare(const Hash &pRight) const;
 
+        // Returns the most significant 8 bytes as an integer, so a hash that compares higher than
+        //   another of the same size never has a lower value. Since hashes are uniformly
+        //   distributed this can be used with Math::interpolate to search sorted hashes.
+        uint64_t sortValue() const;
+
         bool operator < (const Hash &pRight) const { return compare(pRight) < 0; }
         bool operator > (const Hash &pRight) const { return compare(pRight) > 0; }
         bool operator <= (const Hash &pRight) const { return compare(pRight) <= 0; }
@@ -185,30 +212,54 @@ namespace NextCash
 
         Hash operator -() const;
         Hash operator ~() const;
-        Hash operator +(const Hash &pValue) const
+        Hash operator +(const Hash &pValue) const &
         {
             Hash result(*this);
             result += pValue;
             return result;
         }
-        Hash operator -(const Hash &pValue) const
+        // Temporaries are reused for the result to prevent an allocation.
+        Hash operator +(const Hash &pValue) &&
+        {
+            *this += pValue;
+            return std::move(*this);
+        }
+        Hash operator -(const Hash &pValue) const &
         {
             Hash result(*this);
             result -= pValue;
             return result;
         }
-        Hash operator *(const Hash &pValue) const
+        // Temporaries are reused for the result to prevent an allocation.
+        Hash operator -(const Hash &pValue) &&
+        {
+            *this -= pValue;
+            return std::move(*this);
+        }
+        Hash operator *(const Hash &pValue) const &
         {
             Hash result(*this);
             result *= pValue;
             return result;
         }
-        Hash operator /(const Hash &pValue) const
+        // Temporaries are reused for the result to prevent an allocation.
+        Hash operator *(const Hash &pValue) &&
+        {
+            *this *= pValue;
+            return std::move(*this);
+        }
+        Hash operator /(const Hash &pValue) const &
         {
             Hash result(*this);
             result /= pValue;
             return result;
         }
+        // Temporaries are reused for the result to prevent an allocation.
+        Hash operator /(const Hash &pValue) &&
+        {
+            *this /= pValue;
+            return std::move(*this);
+        }
 
         Hash &operator ++();
         Hash &operator +=(const Hash &pValue);
@@ -312,6 +363,7 @@ namespace NextCash
 
         // Insert an item into a sorted list and retain sorting
         bool insertSorted(const Hash &pHash);
+        bool insertSorted(Hash &&pHash); // Moves pHash into the list when inserted.
 
         // Return true if the item exists in a sorted list
         bool containsSorted(const Hash &pHash);
@@ -322,6 +374,17 @@ namespace NextCash
         typedef std::vector<Hash>::iterator iterator;
         typedef std::vector<Hash>::const_iterator const_iterator;
 
+    private:
+
+        // Sets pPosition to where pHash should be inserted to retain sorting.
+        // Returns false if pHash is already in the list.
+        bool findInsertPosition(const Hash &pHash, iterator &pPosition);
+
+        // Searches between the first and last items, which must already be known to be below and
+        //   above pHash. Returns the matching item, or NULL and sets pInsertBefore to the item
+        //   that pHash belongs before.
+        Hash *searchSorted(const Hash &pHash, Hash *&pInsertBefore);
+
     };
 }
 
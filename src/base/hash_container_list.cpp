@@ -9,8 +9,7 @@
 
 #include "log.hpp"
 #include "digest.hpp"
-
-#define NEXTCASH_HASH_CONTAINER_LIST_LOG_NAME "HashContainerList"
+#include "math.hpp"
 
 
 namespace NextCash
@@ -238,6 +237,79 @@ namespace NextCash
             if(*item != NULL)
                 delete *item;
 
+        /***********************************************************************************************
+         * Hash container list sorted with duplicates
+         ***********************************************************************************************/
+        HashContainerList<unsigned int> valueList;
+        std::vector<Hash> hashes;
+        Hash hash(32);
+        bool sortedSuccess = true;
+
+        for(unsigned int i = 0; i < 5000; ++i)
+        {
+            // Every 10th hash is a duplicate of an earlier one.
+            if(i % 10 == 9)
+                hash = hashes[Math::randomInt(hashes.size())];
+            else
+                hash.randomize();
+            hashes.push_back(hash);
+            valueList.insert(hash, i);
+        }
+
+        if(valueList.size() != 5000 || valueList.hashSize() != 32)
+            sortedSuccess = false;
+
+        // Sorted by hash, then by insert order for matching hashes.
+        Hash previousHash;
+        unsigned int previousValue = 0;
+        for(HashContainerList<unsigned int>::Iterator item = valueList.begin();
+          sortedSuccess && item != valueList.end(); ++item)
+        {
+            if(item.hash() != hashes[*item] || !item.hashMatches(hashes[*item]) ||
+              item.compareHash(hashes[*item]) != 0 ||
+              item.compareHash(hashes[0]) != item.hash().compare(hashes[0]) ||
+              (!previousHash.isEmpty() && (previousHash > item.hash() ||
+              (previousHash == item.hash() && previousValue > *item))))
+                sortedSuccess = false;
+            previousHash = item.hash();
+            previousValue = *item;
+        }
+
+        // Get returns the first matching item.
+        for(unsigned int i = 0; sortedSuccess && i < hashes.size(); ++i)
+        {
+            HashContainerList<unsigned int>::Iterator item = valueList.get(hashes[i]);
+            if(item == valueList.end() || item.hash() != hashes[i] ||
+              (item != valueList.begin() && (item - 1).hash() == hashes[i]))
+                sortedSuccess = false;
+        }
+
+        // Erase every item with a hash, then check it is gone.
+        for(unsigned int i = 0; sortedSuccess && i < hashes.size(); i += 7)
+        {
+            HashContainerList<unsigned int>::Iterator item = valueList.get(hashes[i]);
+            while(item != valueList.end() && item.hashMatches(hashes[i]))
+                item = valueList.erase(item);
+            if(valueList.get(hashes[i]) != valueList.end())
+                sortedSuccess = false;
+        }
+
+        unsigned int value = 5000;
+        hash.setSize(20);
+        if(valueList.insertIfNotMatching(hash, value, NULL) || valueList.insert(hash, value) ||
+          valueList.get(hash) != valueList.end())
+            sortedSuccess = false;
+
+        if(sortedSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_CONTAINER_LIST_LOG_NAME,
+              "Passed hash container list sorted with duplicates");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_CONTAINER_LIST_LOG_NAME,
+              "Failed hash container list sorted with duplicates");
+            success = false;
+        }
+
         return success;
     }
 }
@@ -8,81 +8,106 @@
 #ifndef NEXTCASH_HASH_CONTAINER_LIST_HPP
 #define NEXTCASH_HASH_CONTAINER_LIST_HPP
 
+#include "endian.hpp"
 #include "hash.hpp"
+#include "log.hpp"
+#include "math.hpp"
 
 #ifdef PROFILER_ON
 #include "profiler.hpp"
 #endif
 
+#include <cstring>
 #include <vector>
 
+#define NEXTCASH_HASH_CONTAINER_LIST_LOG_NAME "HashContainerList"
+
 
 namespace NextCash
 {
+    // Sorted list of hashes with a value for each.
+    // Keys are kept in one contiguous array and values in a parallel array, so a binary search
+    //   only touches the key array. Each key is stored with its bytes reversed so memcmp sorts
+    //   them the same as Hash::compare.
+    // All hashes in a list must be the same size, at most MAX_KEY_SIZE bytes. The size is set by
+    //   the first insert. Inserts of other sizes return false and the caller keeps ownership of
+    //   the value.
     template <class tType>
     class HashContainerList
     {
     private:
 
-        class Data
-        {
-        public:
-            Data(const Hash &pHash, tType &pData) : hash(pHash) { data = pData; }
-
-            Hash hash;
-            tType data;
+        // Largest supported hash size.
+        static const unsigned int MAX_KEY_SIZE = 0x00ff;
 
-        private:
-            Data(const Data &pCopy);
-            const Data &operator = (const Data &pRight);
-        };
+        std::vector<uint8_t> mKeys;
+        std::vector<tType> mValues;
+        unsigned int mKeySize;
 
-        std::vector<Data *> mList;
+        const uint8_t *key(unsigned int pOffset) const
+        {
+            return mKeys.data() + (pOffset * mKeySize);
+        }
 
-        typedef typename std::vector<Data *>::iterator SubIterator;
+        // Write the key for a hash into pKey. Returns false if the hash isn't the size of the
+        //   keys in the list.
+        bool makeKey(const Hash &pHash, uint8_t *pKey) const
+        {
+            if(pHash.size() == 0 || (mKeySize != 0 && pHash.size() != mKeySize))
+                return false;
+            const uint8_t *byte = pHash.data() + pHash.size() - 1;
+            for(unsigned int i = 0; i < pHash.size(); ++i, --byte)
+                pKey[i] = *byte;
+            return true;
+        }
 
-        // Back up to first matching hash
-        SubIterator backup(const SubIterator &pIterator)
+        // Integer from the most significant bytes of a key, the same as Hash::sortValue.
+        uint64_t keyValue(const uint8_t *pKey) const
         {
-            if(pIterator == mList.end())
+            uint64_t result = 0;
+            if(mKeySize >= 8)
             {
-                // Log::add(Log::ERROR, "HashContainerList", "Backup from end");
-                return pIterator;
+                std::memcpy(&result, pKey, 8);
+                return Endian::convert(result, Endian::BIG);
             }
 
-            Hash hash = (*pIterator)->hash;
-            // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Backup hash : %s",
-              // hash.hex().text());
-            SubIterator result = pIterator;
-            while((*result)->hash == hash)
+            for(unsigned int i = 0; i < 8; ++i)
             {
-                if(result == mList.begin())
-                {
-                    // Log::add(Log::VERBOSE, "HashContainerList", "Backup at begining");
-                    return result;
-                }
-                --result;
+                result <<= 8;
+                if(i < mKeySize)
+                    result |= pKey[i];
             }
-
-            ++result;
-            // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Backup returning : %s",
-              // (*result)->hash.hex().text());
             return result;
         }
 
-        // Returns iterator to insert new item before.
-        // Returns end if the new item should be appended to the end.
-        // Set pFirst to true to ensure the returned iterator is the first item matching the
-        //   specified hash.
-        SubIterator findInsertBefore(const Hash &pHash, bool &pMatchFound);
+        // Returns the offset of the first item with a key not less than pKey.
+        unsigned int lowerBound(const uint8_t *pKey) const;
+
+        // Returns the offset between pBottom and pTop of the first item with a key greater than
+        //   pKey, or not less than pKey if pAfterMatches is false. pBottom must be before and
+        //   pTop must be at or after that item.
+        unsigned int search(const uint8_t *pKey, unsigned int pBottom, unsigned int pTop,
+          bool pAfterMatches) const;
+
+        // Returns offset to insert new item before, which is after any items matching the key.
+        // Sets pMatchFound to true if an item with a matching key is found.
+        unsigned int findInsertBefore(const uint8_t *pKey, bool &pMatchFound);
+
+        void insertAt(unsigned int pOffset, const uint8_t *pKey, tType &pData);
 
     public:
 
-        ~HashContainerList();
+        HashContainerList() { mKeySize = 0; }
+        ~HashContainerList() {}
+
+        unsigned int size() const { return mValues.size(); }
 
-        unsigned int size() const { return mList.size(); }
+        // Size in bytes of the hashes in the list. Zero until the first insert.
+        unsigned int hashSize() const { return mKeySize; }
 
-        void insert(const Hash &pHash, tType &pData);
+        // Returns false if the hash isn't the size of the hashes in the list and no insert was
+        //   done.
+        bool insert(const Hash &pHash, tType &pData);
         bool remove(const Hash &pHash);
 
         // Returns true if the new item was inserted
@@ -96,38 +121,67 @@ namespace NextCash
 
         void clear()
         {
-            for(SubIterator item = mList.begin(); item != mList.end(); ++item)
-                delete *item;
-            mList.clear();
+            mKeys.clear();
+            mValues.clear();
+            mKeySize = 0;
         }
 
         class Iterator
         {
         public:
 
-            Iterator() {}
-            Iterator(const SubIterator &pIterator) { mIterator = pIterator; }
+            Iterator() { mList = NULL; mOffset = 0; }
+            Iterator(HashContainerList *pList, unsigned int pOffset)
+            {
+                mList = pList;
+                mOffset = pOffset;
+            }
 
-            tType &operator *() { return (*mIterator)->data; }
-            tType *operator ->() { return &(*mIterator)->data; }
+            tType &operator *() { return mList->mValues[mOffset]; }
+            tType *operator ->() { return &mList->mValues[mOffset]; }
 
-            const Hash &hash() const { return (*mIterator)->hash; }
+            // Returns a copy of the hash for the item.
+            Hash hash() const
+            {
+                Hash result(mList->mKeySize);
+                const uint8_t *byte = mList->key(mOffset) + mList->mKeySize - 1;
+                for(unsigned int i = 0; i < mList->mKeySize; ++i, --byte)
+                    result.setByte(i, *byte);
+                return result;
+            }
 
-            bool operator ==(const Iterator &pRight) const { return mIterator == pRight.mIterator; }
-            bool operator !=(const Iterator &pRight) const { return mIterator != pRight.mIterator; }
+            // Same result as hash().compare(pHash) without copying the hash.
+            int compareHash(const Hash &pHash) const
+            {
+                if(pHash.size() != mList->mKeySize)
+                    return mList->mKeySize < pHash.size() ? -1 : 1;
+
+                // The key is reversed, so compare it forward against the hash backward.
+                const uint8_t *key = mList->key(mOffset);
+                const uint8_t *byte = pHash.data() + pHash.size() - 1;
+                for(unsigned int i = 0; i < mList->mKeySize; ++i, ++key, --byte)
+                    if(*key != *byte)
+                        return *key < *byte ? -1 : 1;
+                return 0;
+            }
 
-            Iterator &operator =(const Iterator &pRight)
+            // Returns true if the item's hash matches without copying the hash.
+            bool hashMatches(const Hash &pHash) const
             {
-                mIterator = pRight.mIterator;
-                return *this;
+                uint8_t key[MAX_KEY_SIZE];
+                return mList->makeKey(pHash, key) &&
+                  std::memcmp(mList->key(mOffset), key, mList->mKeySize) == 0;
             }
 
-            void increment() { ++mIterator; }
-            Iterator operator +(unsigned int pCount) { return mIterator + pCount; }
+            bool operator ==(const Iterator &pRight) const { return mOffset == pRight.mOffset; }
+            bool operator !=(const Iterator &pRight) const { return mOffset != pRight.mOffset; }
+
+            void increment() { ++mOffset; }
+            Iterator operator +(unsigned int pCount) { return Iterator(mList, mOffset + pCount); }
 
             Iterator &operator +=(unsigned int pCount)
             {
-                mIterator += pCount;
+                mOffset += pCount;
                 return *this;
             }
 
@@ -146,12 +200,12 @@ namespace NextCash
                 return result;
             }
 
-            void decrement() { --mIterator; }
-            Iterator operator -(unsigned int pCount) { return mIterator - pCount; }
+            void decrement() { --mOffset; }
+            Iterator operator -(unsigned int pCount) { return Iterator(mList, mOffset - pCount); }
 
             Iterator &operator -=(unsigned int pCount)
             {
-                mIterator -= pCount;
+                mOffset -= pCount;
                 return *this;
             }
 
@@ -170,162 +224,174 @@ namespace NextCash
                 return result;
             }
 
-            SubIterator subIterator() const { return mIterator; }
+            unsigned int offset() const { return mOffset; }
 
         private:
-            SubIterator mIterator;
+            HashContainerList *mList;
+            unsigned int mOffset;
         };
 
-        Iterator begin() { return Iterator(mList.begin()); }
-        Iterator end() { return Iterator(mList.end()); }
+        Iterator begin() { return Iterator(this, 0); }
+        Iterator end() { return Iterator(this, mValues.size()); }
 
-        tType &front() { return mList.front()->data; }
-        tType &back() { return mList.back()->data; }
-        tType &operator [](unsigned int pOffset) { return mList[pOffset]->data; }
+        tType &front() { return mValues.front(); }
+        tType &back() { return mValues.back(); }
+        tType &operator [](unsigned int pOffset) { return mValues[pOffset]; }
 
         // Return the iterator to the first item with the specified hash
         Iterator get(const Hash &pHash);
         Iterator erase(const Iterator &pToErase)
         {
-            if(pToErase.subIterator() == mList.end())
+            unsigned int offset = pToErase.offset();
+            if(offset >= mValues.size())
                 return end();
-            delete *pToErase.subIterator();
-            return Iterator(mList.erase(pToErase.subIterator()));
+            mKeys.erase(mKeys.begin() + (offset * mKeySize),
+              mKeys.begin() + ((offset + 1) * mKeySize));
+            mValues.erase(mValues.begin() + offset);
+            return Iterator(this, offset);
         }
     };
 
     template <class tType>
-    HashContainerList<tType>::~HashContainerList()
-    {
-        for(SubIterator item = mList.begin(); item != mList.end(); ++item)
-            delete *item;
-    }
+    const unsigned int HashContainerList<tType>::MAX_KEY_SIZE;
 
     template <class tType>
-    typename HashContainerList<tType>::SubIterator HashContainerList<tType>::findInsertBefore(
-      const Hash &pHash, bool &pMatchFound)
+    unsigned int HashContainerList<tType>::search(const uint8_t *pKey, unsigned int pBottom,
+      unsigned int pTop, bool pAfterMatches) const
     {
-#ifdef PROFILER_ON
-        ProfilerReference profiler(getProfiler(PROFILER_SET, PROFILER_HASH_CONT_FIND_ID,
-          PROFILER_HASH_CONT_FIND_NAME), true);
-#endif
-        // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Insert hash : %s",
-          // pHash.hex().text());
-        if(mList.size() == 0)
-        {
-            // Log::add(Log::VERBOSE, "HashContainerList", "Insert as only item");
-            return mList.end(); // Insert at the end (as only item)
-        }
-
-        Data **begin = mList.data();
-        Data **end = mList.data() + mList.size();
-        Data **bottom = begin;
-        Data **top = end - 1;
-        Data **current;
+        uint64_t value = keyValue(pKey), currentValue;
+        uint64_t bottomValue = keyValue(key(pBottom)), topValue = keyValue(key(pTop));
+        unsigned int current, guard = 0, range = 0;
+        bool interpolate = true;
+        int compare;
 
-        // Log::addFormatted(Log::VERBOSE, "HashContainerList", "First hash : %s",
-          // mList.front()->hash.hex().text());
-        int compare = mList.front()->hash.compare(pHash);
-        if(compare > 0)
+        while(pTop - pBottom > 1)
         {
-            // Log::add(Log::VERBOSE, "HashContainerList", "Insert at beginning");
-            return mList.begin();
-        }
-        else if(compare == 0)
-        {
-            // Log::add(Log::VERBOSE, "HashContainerList", "Insert after matching beginning");
-            pMatchFound = true;
-            current = begin;
-            while(current != end && (*current)->hash == pHash)
-                ++current;
-            return mList.begin() + (current - mList.data());
-        }
-        else if(mList.size() == 1)
-        {
-            // Log::add(Log::VERBOSE, "HashContainerList", "Insert after only item");
-            return mList.end();
-        }
-
-        // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Last hash : %s",
-          // mList.back()->hash.hex().text());
-        compare = mList.back()->hash.compare(pHash);
-        if(compare < 0)
-        {
-            // Log::add(Log::VERBOSE, "HashContainerList", "Insert at end");
-            return mList.end(); // Insert at the end
-        }
-        else if(compare == 0)
-        {
-            // Log::add(Log::VERBOSE, "HashContainerList", "Insert at end matching");
-            pMatchFound = true;
-            return mList.end();
-        }
-
-        while(true)
-        {
-            // Break the set in two halves
-            current = bottom + ((top - bottom) / 2);
-            if(current == bottom)
+            // Estimate the position from the key values since hashes are uniformly distributed.
+            //   Use the middle if the last estimate didn't at least halve the range.
+            if(guard != 0)
+                current = guard;
+            else
             {
-                // Log::add(Log::VERBOSE, "HashContainerList", "Current is bottom");
-                ++current;
-                break;
+                range = pTop - pBottom;
+                if(interpolate)
+                    current = Math::interpolate(pBottom, pTop, bottomValue, topValue, value);
+                else
+                    current = pBottom + (range / 2);
             }
 
-            // Determine which half the desired item is in
-            compare = pHash.compare((*current)->hash);
-            if(compare > 0)
+            // The key value is the first 8 bytes of the key so it orders the same.
+            currentValue = keyValue(key(current));
+            if(currentValue != value)
+                compare = currentValue < value ? -1 : 1;
+            else
+                compare = std::memcmp(key(current), pKey, mKeySize);
+            if(compare < 0 || (pAfterMatches && compare == 0))
+            {
+                pBottom = current;
+                bottomValue = currentValue;
+            }
+            else
             {
-                // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Bottom to current : %s",
-                  // (*current)->hash.hex().text());
-                bottom = current;
+                pTop = current;
+                topValue = currentValue;
             }
-            else if(compare < 0)
+
+            if(guard == 0 && interpolate)
             {
-                // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Top to current : %s",
-                  // (*current)->hash.hex().text());
-                top = current;
+                // The estimate is usually close, but leaves most of the range on the other side
+                //   of the item, so check a little past it.
+                if(pBottom == current)
+                    guard = current + Math::interpolateGuard(range);
+                else
+                    guard = current - Math::interpolateGuard(range);
+                if(guard <= pBottom || guard >= pTop)
+                    guard = 0;
             }
             else
             {
-                // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Match found : %s",
-                  // (*current)->hash.hex().text());
-                pMatchFound = true;
-                break; // Matching item found
+                guard = 0;
+                interpolate = (pTop - pBottom) * 2 <= range;
             }
         }
 
-        // Go to item after last matching
-        while(current != end && (*current)->hash == pHash)
+        return pTop;
+    }
+
+    template <class tType>
+    unsigned int HashContainerList<tType>::lowerBound(const uint8_t *pKey) const
+    {
+        if(mValues.size() == 0 || std::memcmp(key(0), pKey, mKeySize) >= 0)
+            return 0;
+        if(std::memcmp(key(mValues.size() - 1), pKey, mKeySize) < 0)
+            return mValues.size();
+        return search(pKey, 0, mValues.size() - 1, false);
+    }
+
+    template <class tType>
+    unsigned int HashContainerList<tType>::findInsertBefore(const uint8_t *pKey, bool &pMatchFound)
+    {
+#ifdef PROFILER_ON
+        ProfilerReference profiler(getProfiler(PROFILER_SET, PROFILER_HASH_CONT_FIND_ID,
+          PROFILER_HASH_CONT_FIND_NAME), true);
+#endif
+        if(mValues.size() == 0)
+            return 0; // Insert as only item
+
+        // Check last item first since items are often added in order.
+        int compare = std::memcmp(key(mValues.size() - 1), pKey, mKeySize);
+        if(compare < 0)
+            return mValues.size(); // Insert at the end
+        else if(compare == 0)
         {
-            ++current;
-            // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Finding item after matching : %s",
-              // (*current)->hash.hex().text());
+            pMatchFound = true;
+            return mValues.size(); // Insert at the end after matching
         }
 
-        return mList.begin() + (current - mList.data());
+        if(std::memcmp(key(0), pKey, mKeySize) > 0)
+            return 0; // Insert at the beginning
+
+        // First item with a greater key.
+        unsigned int result = search(pKey, 0, mValues.size() - 1, true);
+        if(std::memcmp(key(result - 1), pKey, mKeySize) == 0)
+            pMatchFound = true;
+        return result;
+    }
+
+    template <class tType>
+    void HashContainerList<tType>::insertAt(unsigned int pOffset, const uint8_t *pKey,
+      tType &pData)
+    {
+        mKeys.insert(mKeys.begin() + (pOffset * mKeySize), pKey, pKey + mKeySize);
+        mValues.insert(mValues.begin() + pOffset, pData);
     }
 
     template <class tType>
-    void HashContainerList<tType>::insert(const Hash &pHash, tType &pData)
+    bool HashContainerList<tType>::insert(const Hash &pHash, tType &pData)
     {
 #ifdef PROFILER_ON
         ProfilerReference profiler(getProfiler(PROFILER_SET, PROFILER_HASH_CONT_INSERT_ID,
           PROFILER_HASH_CONT_INSERT_NAME), true);
 #endif
+        uint8_t key[MAX_KEY_SIZE];
+        if(!makeKey(pHash, key))
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_HASH_CONTAINER_LIST_LOG_NAME,
+              "Insert hash size %d doesn't match list hash size %d", pHash.size(), mKeySize);
+            return false;
+        }
+        mKeySize = pHash.size();
+
         bool matchFound = false;
-        SubIterator insertBefore = findInsertBefore(pHash, matchFound);
-        if(insertBefore == mList.end())
-            mList.push_back(new Data(pHash, pData)); // Insert at the end
-        else
-            mList.insert(insertBefore, new Data(pHash, pData));
+        insertAt(findInsertBefore(key, matchFound), key, pData);
+        return true;
     }
 
     template <class tType>
     bool HashContainerList<tType>::remove(const Hash &pHash)
     {
         bool result = false;
-        for(Iterator item = get(pHash); item != end() && item.hash() == pHash;)
+        for(Iterator item = get(pHash); item != end() && item.hashMatches(pHash);)
         {
             delete *item;
             item = erase(item);
@@ -342,79 +408,43 @@ namespace NextCash
         ProfilerReference profiler(getProfiler(PROFILER_SET, PROFILER_HASH_CONT_INSERT_NM_ID,
           PROFILER_HASH_CONT_INSERT_NM_NAME), true);
 #endif
+        uint8_t key[MAX_KEY_SIZE];
+        if(!makeKey(pHash, key))
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_HASH_CONTAINER_LIST_LOG_NAME,
+              "Insert hash size %d doesn't match list hash size %d", pHash.size(), mKeySize);
+            return false;
+        }
+        mKeySize = pHash.size();
+
         bool matchFound = false;
-        SubIterator item = findInsertBefore(pHash, matchFound);
+        unsigned int offset = findInsertBefore(key, matchFound);
         if(matchFound)
         {
             // Iterate through any matching hashes to check for a matching value
-            SubIterator match = item - 1;
-            while((*match)->hash == pHash)
-            {
-                if(pValuesMatch((*match)->data, pData))
+            for(unsigned int match = offset; match > 0 &&
+              std::memcmp(this->key(match - 1), key, mKeySize) == 0; --match)
+                if(pValuesMatch(mValues[match - 1], pData))
                     return false;
-                if(match == mList.begin())
-                    break;
-                --match;
-            }
         }
 
         // No items with matching hash and value, so insert
         // This will insert after all values with matching hashes
-        if(item == mList.end())
-            mList.push_back(new Data(pHash, pData)); // Insert at the end
-        else
-            mList.insert(item, new Data(pHash, pData));
+        insertAt(offset, key, pData);
         return true;
     }
 
     template <class tType>
     typename HashContainerList<tType>::Iterator HashContainerList<tType>::get(const Hash &pHash)
     {
-        // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Get hash: %s",
-          // pHash.hex().text());
-        if(mList.size() == 0)
-            return mList.end();
-
-        // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Last hash: %s",
-          // mList.back()->hash.hex().text());
-        int compare = mList.back()->hash.compare(pHash);
-        if(compare == 0) // Last item matches hash.
-            return backup(mList.begin() + (mList.size() - 1));
-        else if(compare < 0)
-            return mList.end(); // Hash is after end.
-        else if(mList.size() == 1)
-            return mList.end(); // Only item in list doesn't match.
-
-        // Log::addFormatted(Log::VERBOSE, "HashContainerList", "First hash: %s",
-          // mList.front()->hash.hex().text());
-        compare = mList.front()->hash.compare(pHash);
-        if(compare == 0)
-            return mList.begin(); // First item matches hash.
-        else if(compare > 0)
-            return mList.end(); // Hash is before beginning.
-
-        Data **bottom = mList.data();
-        Data **top = mList.data() + mList.size() - 1;
-        Data **current;
-
-        while(true)
-        {
-            // Break the set in two halves.
-            current = bottom + ((top - bottom) / 2);
-            if(current == bottom)
-                return mList.end();
-
-            // Determine which half the desired item is in.
-            // Log::addFormatted(Log::VERBOSE, "HashContainerList", "Current hash: %s",
-              // (*current)->hash.hex().text());
-            compare = pHash.compare((*current)->hash);
-            if(compare > 0)
-                bottom = current;
-            else if(compare < 0)
-                top = current;
-            else
-                return backup(mList.begin() + (current - mList.data()));
-        }
+        uint8_t key[MAX_KEY_SIZE];
+        if(mValues.size() == 0 || !makeKey(pHash, key))
+            return end();
+
+        unsigned int offset = lowerBound(key);
+        if(offset < mValues.size() && std::memcmp(this->key(offset), key, mKeySize) == 0)
+            return Iterator(this, offset);
+        return end();
     }
 
     bool testHashContainerList();
@@ -14,7 +14,7 @@
 #include "string.hpp"
 #include "hash.hpp"
 #include "hash_container_list.hpp"
-#include "distributed_vector.hpp"
+#include "tiered_vector.hpp"
 #include "log.hpp"
 #include "stream.hpp"
 #include "file_stream.hpp"
@@ -236,8 +236,11 @@ namespace NextCash
             void loadSamples(InputStream *pIndexFile);
 
             // Find offsets into indices that contain the specified hash, based on samples
+            // Sets pBegin and pEnd to the index offsets of the samples around pHash and
+            //   pBeginValue and pEndValue to their hashes' sort values.
             bool findSample(const Hash &pHash, InputStream *pIndexFile, InputStream *pDataFile,
-              stream_size &pBegin, stream_size &pEnd);
+              stream_size &pBegin, stream_size &pEnd, uint64_t &pBeginValue,
+              uint64_t &pEndValue);
 
             bool loadCache();
             bool saveCache();
@@ -295,7 +298,7 @@ namespace NextCash
             HashDataFileSetObject *operator *() { return *mIterator; }
             HashDataFileSetObject *operator ->() { return *mIterator; }
 
-            const Hash &hash() const { return mIterator.hash(); }
+            Hash hash() const { return mIterator.hash(); }
 
             operator bool() const { return mSubSet != NULL && mIterator != mSubSet->end(); }
             bool operator !() const { return mSubSet == NULL || mIterator == mSubSet->end(); }
@@ -743,9 +746,8 @@ namespace NextCash
                 result = true;
             }
         }
-        else
+        else if(mCache.insert(pLookupValue, pValue))
         {
-            mCache.insert(pLookupValue, pValue);
             ++mNewSize;
             mCacheRawDataSize += pValue->size();
             pValue->clearDataOffset();
@@ -764,7 +766,7 @@ namespace NextCash
 
         bool result = false;
         SubSetIterator item = mCache.get(pLookupValue);
-        while(item != mCache.end() && item.hash() == pLookupValue)
+        while(item != mCache.end() && item.hashMatches(pLookupValue))
         {
             if(pValue->valuesMatch(*item) && !(*item)->markedRemove())
             {
@@ -778,7 +780,7 @@ namespace NextCash
         if(!result && pull(pLookupValue, pValue))
         {
             item = mCache.get(pLookupValue);
-            while(item != mCache.end() && item.hash() == pLookupValue)
+            while(item != mCache.end() && item.hashMatches(pLookupValue))
             {
                 if(pValue->valuesMatch(*item) && !(*item)->markedRemove())
                 {
@@ -826,7 +828,7 @@ namespace NextCash
         if(item == mCache.end() && !pForcePull && pull(pLookupValue))
             item = mCache.get(pLookupValue);
 
-        while(item != mCache.end() && item.hash() == pLookupValue)
+        while(item != mCache.end() && item.hashMatches(pLookupValue))
         {
             if(!(*item)->markedRemove())
             {
@@ -852,6 +854,7 @@ namespace NextCash
         stream_size dataOffset;
         Hash hash(tHashSize);
         stream_size first = 0, last = (mFileSize - 1) * sizeof(stream_size), begin, end, current;
+        uint64_t value = pLookupValue.sortValue(), beginValue = 0, endValue = 0;
         String filePathName;
         filePathName.writeFormatted("%s%s%04x.index", mFilePath, PATH_SEPARATOR, mID);
         FileInputStream indexFile(filePathName);
@@ -874,7 +877,7 @@ namespace NextCash
 
         if(mSamples != NULL)
         {
-            if(!findSample(pLookupValue, &indexFile, &dataFile, begin, end))
+            if(!findSample(pLookupValue, &indexFile, &dataFile, begin, end, beginValue, endValue))
                 return false; // Failed
 
             if(begin == INVALID_STREAM_SIZE)
@@ -894,6 +897,7 @@ namespace NextCash
                 return false;
 
             compare = pLookupValue.compare(hash);
+            beginValue = hash.sortValue();
             if(compare < 0)
                 return false; // Lookup is before first item
             else if(compare == 0)
@@ -908,6 +912,7 @@ namespace NextCash
                     return false;
 
                 compare = pLookupValue.compare(hash);
+                endValue = hash.sortValue();
                 if(compare > 0)
                     return false; // Lookup is after last item
                 else if(compare == 0)
@@ -921,31 +926,46 @@ namespace NextCash
             current = begin; // Lookup matches a sample
         else
         {
-            // Binary search the file indices
+            // Search the file indices. Each probe is a read from both files, so estimate the
+            //   position from the hash values since hashes are uniformly distributed. Use the
+            //   middle if the last estimate didn't at least halve the range.
+            stream_size count;
+            bool interpolate = true;
             while(true)
             {
-                // Break the set in two halves (set current to the middle)
-                current = (end - begin) / 2;
-                current -= current % sizeof(stream_size);
-                if(current == 0) // Begin and end are next to each other and have already been checked
+                count = (end - begin) / sizeof(stream_size);
+                if(count < 2) // Begin and end are next to each other and have already been checked
                     return false;
-                current += begin;
 
-                // Read the middle item
+                if(interpolate)
+                    current = begin + (Math::interpolate(0, count, beginValue, endValue, value) *
+                      sizeof(stream_size));
+                else
+                    current = begin + ((count / 2) * sizeof(stream_size));
+
+                // Read the item
                 indexFile.setReadOffset(current);
                 indexFile.read(&dataOffset, sizeof(stream_size));
                 dataFile.setReadOffset(dataOffset);
                 if(!hash.read(&dataFile))
                     return false;
 
-                // Determine which half the desired item is in
+                // Determine which part the desired item is in
                 compare = pLookupValue.compare(hash);
                 if(compare > 0)
+                {
                     begin = current;
+                    beginValue = hash.sortValue();
+                }
                 else if(compare < 0)
+                {
                     end = current;
+                    endValue = hash.sortValue();
+                }
                 else
                     break;
+
+                interpolate = ((end - begin) / sizeof(stream_size)) * 2 <= count;
             }
         }
 
@@ -1034,7 +1054,8 @@ namespace NextCash
 
     template <class tHashDataType, uint8_t tHashSize, uint16_t tSampleSize, uint16_t tSetCount>
     bool HashDataFileSet<tHashDataType, tHashSize, tSampleSize, tSetCount>::SubSet::findSample(const Hash &pHash,
-      InputStream *pIndexFile, InputStream *pDataFile, stream_size &pBegin, stream_size &pEnd)
+      InputStream *pIndexFile, InputStream *pDataFile, stream_size &pBegin, stream_size &pEnd,
+      uint64_t &pBeginValue, uint64_t &pEndValue)
     {
         // Check first entry
         SampleEntry *sample = mSamples;
@@ -1080,21 +1101,27 @@ namespace NextCash
         // Log::addFormatted(Log::VERBOSE, NEXTCASH_HASH_DATA_FILE_SET_LOG_NAME,
           // "Last : %s", mSamples[tSampleSize - 1].hash.hex().text());
 
-        // Binary search the samples
+        // Search the samples. Samples are loaded from the files when first used, so estimate
+        //   the position from the hash values since hashes are uniformly distributed. Use the
+        //   middle if the last estimate didn't at least halve the range.
         unsigned int sampleBegin = 0;
         unsigned int sampleEnd = tSampleSize - 1;
-        unsigned int sampleCurrent;
-        bool done = false;
+        unsigned int sampleCurrent, range;
+        uint64_t value = pHash.sortValue();
+        bool interpolate = true;
 
-        while(!done)
+        while(sampleEnd - sampleBegin > 1)
         {
-            sampleCurrent = (sampleBegin + sampleEnd) / 2;
+            range = sampleEnd - sampleBegin;
+            if(interpolate)
+                sampleCurrent = Math::interpolate(sampleBegin, sampleEnd,
+                  mSamples[sampleBegin].hash.sortValue(), mSamples[sampleEnd].hash.sortValue(),
+                  value);
+            else
+                sampleCurrent = sampleBegin + (range / 2);
             // Log::addFormatted(Log::VERBOSE, NEXTCASH_HASH_DATA_FILE_SET_LOG_NAME,
               // "Sample : %s", mSamples[sampleCurrent].hash.hex().text());
 
-            if(sampleCurrent == sampleBegin || sampleCurrent == sampleEnd)
-                done = true;
-
             sample = mSamples + sampleCurrent;
             if(!sample->load(pIndexFile, pDataFile))
                 return false;
@@ -1111,11 +1138,15 @@ namespace NextCash
                 sampleEnd = sampleCurrent;
                 break;
             }
+
+            interpolate = (sampleEnd - sampleBegin) * 2 <= range;
         }
 
-        // Setup index binary search on sample subset of indices
+        // Setup index search on sample subset of indices
         pBegin = mSamples[sampleBegin].offset;
         pEnd = mSamples[sampleEnd].offset;
+        pBeginValue = mSamples[sampleBegin].hash.sortValue();
+        pEndValue = mSamples[sampleEnd].hash.sortValue();
         return true;
     }
 
@@ -1167,7 +1198,12 @@ namespace NextCash
 
             next->setDataOffset(dataOffset);
 
-            mCache.insert(hash, next);
+            if(!mCache.insert(hash, next))
+            {
+                delete next;
+                success = false;
+                break;
+            }
             mCacheRawDataSize += next->size();
         }
 
@@ -1497,46 +1533,38 @@ namespace NextCash
         filePathName.writeFormatted("%s%s%04x.index", mFilePath, PATH_SEPARATOR, mID);
         FileInputStream *indexFile = new FileInputStream(filePathName);
         uint64_t previousSize = indexFile->length() / sizeof(stream_size);
-        DistributedVector<stream_size> indices(tSetCount);
-        DistributedVector<Hash> hashes(tSetCount);
-        unsigned int indicesPerSet = (previousSize / tSetCount) + 1;
+        TieredVector<stream_size> indices;
+        TieredVector<Hash> hashes;
+        std::vector<stream_size> readBuffer;
+        unsigned int readCount = 4096;
         unsigned int readIndices = 0;
-        std::vector<stream_size> *indiceSet;
-        std::vector<Hash> *hashSet;
-        unsigned int setOffset = 0;
         uint64_t reserveSize = previousSize + mCache.size();
 
-        if(reserveSize < tSetCount * 32)
-            reserveSize = tSetCount * 32;
-
         indices.reserve(reserveSize);
         hashes.reserve(reserveSize);
+        readBuffer.resize(readCount);
         indexFile->setReadOffset(0);
-        while(indexFile->remaining())
+        while(readIndices < previousSize)
         {
-            if(previousSize - readIndices < indicesPerSet)
-                indicesPerSet = previousSize - readIndices;
+            if(previousSize - readIndices < readCount)
+                readCount = previousSize - readIndices;
 
-            // Read set of indices
-            indiceSet = indices.dataSet(setOffset);
-            indiceSet->resize(indicesPerSet);
-            indexFile->read(indiceSet->data(), indicesPerSet * sizeof(stream_size));
+            // Read block of indices
+            indexFile->read(readBuffer.data(), readCount * sizeof(stream_size));
+            indices.append(readBuffer.begin(), readBuffer.begin() + readCount);
 
             // Allocate empty hashes
-            hashSet = hashes.dataSet(setOffset);
-            hashSet->resize(indicesPerSet);
+            for(unsigned int i = 0; i < readCount; ++i)
+                hashes.emplace_back();
 
-            readIndices += indicesPerSet;
-            ++setOffset;
+            readIndices += readCount;
         }
 
         delete indexFile;
-        indices.refresh();
-        hashes.refresh();
 
         // Update indices
-        DistributedVector<Hash>::Iterator hash;
-        DistributedVector<stream_size>::Iterator index;
+        TieredVector<Hash>::Iterator hash;
+        TieredVector<stream_size>::Iterator index;
         int compare;
         bool found;
         int32_t lastReport = getTime();
@@ -1623,7 +1651,7 @@ namespace NextCash
                     ++readHeadersCount;
                 }
 
-                compare = item.hash().compare(*hash);
+                compare = item.compareHash(*hash);
                 if(compare <= 0)
                 {
 
@@ -1649,7 +1677,7 @@ namespace NextCash
                     ++readHeadersCount;
                 }
 
-                compare = item.hash().compare(*hash);
+                compare = item.compareHash(*hash);
                 if(compare >= 0)
                 {
                     // Add to end
@@ -1682,7 +1710,7 @@ namespace NextCash
                         ++readHeadersCount;
                     }
 
-                    compare = item.hash().compare(*hash);
+                    compare = item.compareHash(*hash);
                     if(current == begin || compare == 0)
                     {
                         if(current != begin && compare < 0)
@@ -1722,11 +1750,11 @@ namespace NextCash
             FileOutputStream *indexOutFile = new FileOutputStream(filePathName, true);
 
             // Write the new index
-            for(setOffset = 0; setOffset < tSetCount; ++setOffset)
+            for(unsigned int block = 0; block < indices.blockCount(); ++block)
             {
-                // Write set of indices
-                indiceSet = indices.dataSet(setOffset);
-                indexOutFile->write(indiceSet->data(), indiceSet->size() * sizeof(stream_size));
+                // Write block of indices
+                const std::vector<stream_size> &indiceBlock = indices.block(block);
+                indexOutFile->write(indiceBlock.data(), indiceBlock.size() * sizeof(stream_size));
             }
 
             // Update size
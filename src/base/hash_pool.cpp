@@ -0,0 +1,476 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "hash_pool.hpp"
+
+#include "log.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+
+namespace NextCash
+{
+    const HashPool::Handle HashPool::INVALID_HANDLE;
+
+    HashPool::HashPool(uint8_t pHashSize)
+    {
+        mHashSize = pHashSize;
+        mCount = 0;
+        mSlotMask = 0;
+    }
+
+    void HashPool::clear()
+    {
+        mCount = 0;
+        mArena.clear();
+        mSlots.clear();
+        mSlotMask = 0;
+    }
+
+    void HashPool::reserve(unsigned int pCount)
+    {
+        mArena.reserve((stream_size)pCount * mHashSize);
+
+        // Keep the lookup table at most 3/4 full.
+        unsigned int slotCount = 64;
+        while(slotCount < pCount + (pCount / 3))
+            slotCount <<= 1;
+        if(slotCount > mSlots.size())
+            resizeSlots(slotCount);
+    }
+
+    unsigned int HashPool::startSlot(const uint8_t *pData) const
+    {
+        // Fold all bytes so hashes that are mostly zero (arithmetic values) still spread out.
+        uint64_t result = mHashSize;
+        uint64_t value;
+        unsigned int offset = 0;
+        for(; offset + 8 <= mHashSize; offset += 8)
+        {
+            std::memcpy(&value, pData + offset, 8);
+            result = (result ^ value) * 0x9e3779b97f4a7c15ULL;
+        }
+        for(; offset < mHashSize; ++offset)
+            result = (result ^ pData[offset]) * 0x9e3779b97f4a7c15ULL;
+        return (unsigned int)(result >> 32) & mSlotMask;
+    }
+
+    unsigned int HashPool::findSlot(const uint8_t *pData) const
+    {
+        unsigned int slot = startSlot(pData);
+        while(mSlots[slot] != INVALID_HANDLE &&
+          std::memcmp(data(mSlots[slot]), pData, mHashSize) != 0)
+            slot = (slot + 1) & mSlotMask;
+        return slot;
+    }
+
+    void HashPool::resizeSlots(unsigned int pSlotCount)
+    {
+        mSlots.assign(pSlotCount, INVALID_HANDLE);
+        mSlotMask = pSlotCount - 1;
+        for(Handle handle = 0; handle < mCount; ++handle)
+            mSlots[findSlot(data(handle))] = handle;
+    }
+
+    HashPool::Handle HashPool::add(const Hash &pHash)
+    {
+        if(pHash.size() != mHashSize || mCount == INVALID_HANDLE)
+            return INVALID_HANDLE;
+
+        if(mSlots.size() == 0)
+            resizeSlots(64);
+
+        unsigned int slot = findSlot(pHash.data());
+        if(mSlots[slot] != INVALID_HANDLE)
+            return mSlots[slot]; // Already in pool
+
+        Handle result = mCount++;
+        mArena.insert(mArena.end(), pHash.data(), pHash.data() + mHashSize);
+        mSlots[slot] = result;
+
+        if(mCount + (mCount / 3) > mSlots.size())
+            resizeSlots(mSlots.size() * 2);
+
+        return result;
+    }
+
+    HashPool::Handle HashPool::find(const Hash &pHash) const
+    {
+        if(pHash.size() != mHashSize || mCount == 0)
+            return INVALID_HANDLE;
+        return mSlots[findSlot(pHash.data())];
+    }
+
+    bool HashPool::get(Handle pHandle, Hash &pHash) const
+    {
+        if(pHandle >= mCount)
+        {
+            pHash.clear();
+            return false;
+        }
+
+        pHash.write(data(pHandle), mHashSize);
+        return true;
+    }
+
+    int HashPool::compare(Handle pLeft, Handle pRight) const
+    {
+        if(pLeft == pRight)
+            return 0;
+        if(pLeft >= mCount)
+            return pRight >= mCount ? 0 : 1;
+        if(pRight >= mCount)
+            return -1;
+
+        // Most significant byte is last, the same as Hash::compare
+        const uint8_t *left = data(pLeft) + mHashSize - 1;
+        const uint8_t *right = data(pRight) + mHashSize - 1;
+        for(uint8_t i = 0; i < mHashSize; ++i, --left, --right)
+        {
+            if(*left < *right)
+                return -1;
+            else if(*left > *right)
+                return 1;
+        }
+
+        return 0;
+    }
+
+    bool HashHandleList::insertSorted(HashPool::Handle pHandle)
+    {
+        iterator position = std::lower_bound(begin(), end(), pHandle);
+        if(position != end() && *position == pHandle)
+            return false;
+        insert(position, pHandle);
+        return true;
+    }
+
+    bool HashHandleList::containsSorted(HashPool::Handle pHandle) const
+    {
+        return std::binary_search(begin(), end(), pHandle);
+    }
+
+    bool HashHandleList::removeSorted(HashPool::Handle pHandle)
+    {
+        iterator position = std::lower_bound(begin(), end(), pHandle);
+        if(position == end() || *position != pHandle)
+            return false;
+        erase(position);
+        return true;
+    }
+
+    void HashHandleSet::clear()
+    {
+        mCount = 0;
+        mSlots.clear();
+        mSlotMask = 0;
+    }
+
+    void HashHandleSet::reserve(unsigned int pCount)
+    {
+        // Keep the lookup table at most 3/4 full.
+        unsigned int slotCount = 64;
+        while(slotCount < pCount + (pCount / 3))
+            slotCount <<= 1;
+        if(slotCount > mSlots.size())
+            resizeSlots(slotCount);
+    }
+
+    unsigned int HashHandleSet::findSlot(HashPool::Handle pHandle) const
+    {
+        unsigned int slot = startSlot(pHandle);
+        while(mSlots[slot] != HashPool::INVALID_HANDLE && mSlots[slot] != pHandle)
+            slot = (slot + 1) & mSlotMask;
+        return slot;
+    }
+
+    void HashHandleSet::resizeSlots(unsigned int pSlotCount)
+    {
+        std::vector<HashPool::Handle> previous;
+        previous.swap(mSlots);
+        mSlots.assign(pSlotCount, HashPool::INVALID_HANDLE);
+        mSlotMask = pSlotCount - 1;
+        for(std::vector<HashPool::Handle>::iterator handle = previous.begin();
+          handle != previous.end(); ++handle)
+            if(*handle != HashPool::INVALID_HANDLE)
+                mSlots[findSlot(*handle)] = *handle;
+    }
+
+    bool HashHandleSet::insert(HashPool::Handle pHandle)
+    {
+        if(pHandle == HashPool::INVALID_HANDLE)
+            return false;
+
+        if(mSlots.size() == 0)
+            resizeSlots(64);
+
+        unsigned int slot = findSlot(pHandle);
+        if(mSlots[slot] != HashPool::INVALID_HANDLE)
+            return false; // Already in set
+
+        mSlots[slot] = pHandle;
+        ++mCount;
+
+        if(mCount + (mCount / 3) > mSlots.size())
+            resizeSlots(mSlots.size() * 2);
+
+        return true;
+    }
+
+    bool HashHandleSet::contains(HashPool::Handle pHandle) const
+    {
+        if(mCount == 0 || pHandle == HashPool::INVALID_HANDLE)
+            return false;
+        return mSlots[findSlot(pHandle)] == pHandle;
+    }
+
+    bool HashHandleSet::remove(HashPool::Handle pHandle)
+    {
+        if(mCount == 0 || pHandle == HashPool::INVALID_HANDLE)
+            return false;
+
+        unsigned int slot = findSlot(pHandle);
+        if(mSlots[slot] == HashPool::INVALID_HANDLE)
+            return false;
+
+        // Shift following handles back so probe sequences stay unbroken without tombstones.
+        mSlots[slot] = HashPool::INVALID_HANDLE;
+        --mCount;
+        for(unsigned int next = (slot + 1) & mSlotMask; mSlots[next] != HashPool::INVALID_HANDLE;
+          next = (next + 1) & mSlotMask)
+            if(((next - startSlot(mSlots[next])) & mSlotMask) >= ((next - slot) & mSlotMask))
+            {
+                mSlots[slot] = mSlots[next];
+                mSlots[next] = HashPool::INVALID_HANDLE;
+                slot = next;
+            }
+
+        return true;
+    }
+
+    void HashHandleSet::getList(HashHandleList &pList) const
+    {
+        pList.reserve(pList.size() + mCount);
+        for(std::vector<HashPool::Handle>::const_iterator handle = mSlots.begin();
+          handle != mSlots.end(); ++handle)
+            if(*handle != HashPool::INVALID_HANDLE)
+                pList.push_back(*handle);
+    }
+
+    bool HashPool::test()
+    {
+        Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME,
+          "------------- Starting Hash Pool Tests -------------");
+
+        bool success = true;
+
+        /***********************************************************************************************
+         * Add and find
+         ***********************************************************************************************/
+        HashPool pool;
+        std::vector<Hash> hashes;
+        std::vector<Handle> handles;
+        Hash hash(32);
+
+        for(unsigned int i = 0; i < 5000; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+            handles.push_back(pool.add(hash));
+        }
+
+        bool addSuccess = pool.size() == 5000;
+        for(unsigned int i = 0; addSuccess && i < hashes.size(); ++i)
+            if(handles[i] != i || pool.find(hashes[i]) != handles[i] ||
+              pool.get(handles[i]) != hashes[i])
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME,
+                  "Failed add and find %d : %s", i, hashes[i].hex().text());
+                addSuccess = false;
+            }
+
+        if(addSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed add and find");
+        else
+            success = false;
+
+        /***********************************************************************************************
+         * Duplicates return the same handle
+         ***********************************************************************************************/
+        bool duplicateSuccess = true;
+        for(unsigned int i = 0; i < hashes.size(); i += 7)
+            if(pool.add(Hash(hashes[i])) != handles[i])
+                duplicateSuccess = false;
+
+        if(duplicateSuccess && pool.size() == 5000)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed duplicate add");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME,
+              "Failed duplicate add : size %d", pool.size());
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Missing and invalid hashes
+         ***********************************************************************************************/
+        hash.randomize();
+        Hash wrongSize(20);
+        wrongSize.randomize();
+        if(pool.find(hash) == INVALID_HANDLE && !pool.contains(hash) &&
+          pool.add(wrongSize) == INVALID_HANDLE && pool.find(wrongSize) == INVALID_HANDLE &&
+          pool.size() == 5000)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed missing and invalid");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME, "Failed missing and invalid");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Small arithmetic values
+         ***********************************************************************************************/
+        HashPool valuePool;
+        bool valueSuccess = true;
+        for(int i = 0; i < 1000; ++i)
+            valuePool.add(Hash(32, i));
+        for(int i = 0; i < 1000; ++i)
+            if(valuePool.find(Hash(32, i)) != (Handle)i)
+                valueSuccess = false;
+
+        if(valueSuccess && valuePool.size() == 1000)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed arithmetic values");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME, "Failed arithmetic values");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Compare matches Hash::compare
+         ***********************************************************************************************/
+        bool compareSuccess = true;
+        int hashCompare, handleCompare;
+        for(unsigned int i = 1; i < hashes.size(); ++i)
+        {
+            hashCompare = hashes[i - 1].compare(hashes[i]);
+            handleCompare = pool.compare(handles[i - 1], handles[i]);
+            if((hashCompare < 0) != (handleCompare < 0) || (hashCompare > 0) != (handleCompare > 0))
+                compareSuccess = false;
+        }
+        if(valuePool.compare(5, 6) >= 0 || valuePool.compare(256, 255) <= 0 ||
+          valuePool.compare(7, 7) != 0)
+            compareSuccess = false;
+
+        // Handles not in the pool are checked instead of read past the arena.
+        if(valuePool.compare(INVALID_HANDLE, 5) <= 0 || valuePool.compare(5, 1000) >= 0 ||
+          valuePool.compare(1000, INVALID_HANDLE) != 0 || valuePool.data(INVALID_HANDLE) != NULL ||
+          valuePool.data(1000) != NULL || valuePool.data(999) == NULL)
+            compareSuccess = false;
+
+        if(compareSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed compare");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME, "Failed compare");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Handle list
+         ***********************************************************************************************/
+        HashHandleList list;
+        for(unsigned int i = 0; i < 100; ++i)
+            list.insertSorted(handles[(i * 37) % 100]);
+        list.insertSorted(handles[10]);
+
+        bool listSuccess = list.size() == 100 && std::is_sorted(list.begin(), list.end()) &&
+          list.containsSorted(handles[50]) && !list.containsSorted(handles[150]) &&
+          list.removeSorted(handles[50]) && !list.containsSorted(handles[50]) &&
+          !list.removeSorted(handles[50]) && list.size() == 99 && list.contains(handles[51]);
+
+        if(listSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed handle list");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME, "Failed handle list");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Handle set
+         ***********************************************************************************************/
+        HashHandleSet set;
+        bool setSuccess = true;
+        for(unsigned int i = 0; i < 3000; ++i)
+            if(!set.insert(handles[i]))
+                setSuccess = false;
+        if(set.insert(handles[10]) || set.insert(INVALID_HANDLE) || set.size() != 3000)
+            setSuccess = false;
+
+        // Remove every third to exercise shifting probe sequences back.
+        for(unsigned int i = 0; i < 3000; i += 3)
+            if(!set.remove(handles[i]))
+                setSuccess = false;
+        for(unsigned int i = 0; i < 4000; ++i)
+            if(set.contains(handles[i]) != (i < 3000 && i % 3 != 0))
+                setSuccess = false;
+        if(set.remove(handles[0]) || set.size() != 2000)
+            setSuccess = false;
+
+        HashHandleList setList;
+        set.getList(setList);
+        std::sort(setList.begin(), setList.end());
+        if(setList.size() != 2000 ||
+          std::adjacent_find(setList.begin(), setList.end()) != setList.end())
+            setSuccess = false;
+
+        set.clear();
+        if(set.size() != 0 || set.contains(handles[1]) || !set.insert(handles[1]))
+            setSuccess = false;
+
+        if(setSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed handle set");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME, "Failed handle set");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Memory
+         ***********************************************************************************************/
+        // Each hash referenced from 10 places.
+        stream_size hashListMemory = hashes.size() * 10 * (sizeof(Hash) + 32);
+        stream_size handleMemory = (hashes.size() * 10 * sizeof(Handle)) + pool.memorySize();
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME,
+          "Memory for %d hashes referenced 10 times : Hash %d KB, Handle %d KB",
+          hashes.size(), hashListMemory / 1024, handleMemory / 1024);
+        if(handleMemory < hashListMemory)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed memory");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME, "Failed memory");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Clear
+         ***********************************************************************************************/
+        pool.clear();
+        if(pool.size() == 0 && pool.find(hashes[0]) == INVALID_HANDLE && pool.add(hashes[1]) == 0)
+            Log::add(Log::INFO, NEXTCASH_HASH_POOL_LOG_NAME, "Passed clear");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_POOL_LOG_NAME, "Failed clear");
+            success = false;
+        }
+
+        return success;
+    }
+}
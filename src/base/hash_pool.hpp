@@ -0,0 +1,177 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_HASH_POOL_HPP
+#define NEXTCASH_HASH_POOL_HPP
+
+#include "hash.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#define NEXTCASH_HASH_POOL_LOG_NAME "HashPool"
+
+
+namespace NextCash
+{
+    // Stores each distinct hash once in a contiguous arena and refers to it with a 32 bit handle.
+    //   Containers that repeat the same hashes many times (graph edges, orphan maps) can hold
+    //   handles instead of Hash objects. Handles of the same pool are equal only when their hashes
+    //   are equal, so equality is an integer compare.
+    // Hashes are never removed individually. Call clear() to release all of them, which
+    //   invalidates all handles.
+    class HashPool
+    {
+    public:
+
+        typedef uint32_t Handle;
+        static const Handle INVALID_HANDLE = 0xffffffff;
+
+        HashPool(uint8_t pHashSize = 32);
+
+        uint8_t hashSize() const { return mHashSize; }
+        unsigned int size() const { return mCount; }
+
+        // Memory used by the arena and lookup table.
+        stream_size memorySize() const
+        {
+            return (mArena.capacity() * sizeof(uint8_t)) + (mSlots.capacity() * sizeof(Handle));
+        }
+
+        void clear();
+        void reserve(unsigned int pCount);
+
+        // Return the handle for the hash, adding it if it isn't already in the pool.
+        //   Returns INVALID_HANDLE if the hash is not the pool's hash size.
+        Handle add(const Hash &pHash);
+
+        // Return the handle for the hash or INVALID_HANDLE if it isn't in the pool.
+        Handle find(const Hash &pHash) const;
+        bool contains(const Hash &pHash) const { return find(pHash) != INVALID_HANDLE; }
+
+        // Return the bytes of a hash. Only valid until the next add.
+        //   Returns NULL if the handle isn't in the pool.
+        const uint8_t *data(Handle pHandle) const
+        {
+            if(pHandle >= mCount)
+                return NULL;
+            return mArena.data() + ((stream_size)pHandle * mHashSize);
+        }
+
+        bool get(Handle pHandle, Hash &pHash) const;
+        Hash get(Handle pHandle) const
+        {
+            Hash result;
+            get(pHandle, result);
+            return result;
+        }
+
+        // Same ordering as Hash::compare of the hashes the handles refer to.
+        //   Handles that aren't in the pool are equal to each other and after all others.
+        int compare(Handle pLeft, Handle pRight) const;
+
+        static bool test();
+
+    private:
+
+        // Return the lookup table slot to start searching at for the hash data.
+        unsigned int startSlot(const uint8_t *pData) const;
+
+        // Return the slot containing the hash data or the empty slot where it belongs.
+        unsigned int findSlot(const uint8_t *pData) const;
+
+        void resizeSlots(unsigned int pSlotCount);
+
+        uint8_t mHashSize;
+        unsigned int mCount;
+        std::vector<uint8_t> mArena;
+        std::vector<Handle> mSlots; // Open addressing. Power of 2 size. INVALID_HANDLE when empty.
+        unsigned int mSlotMask;
+
+        HashPool(const HashPool &pCopy);
+        const HashPool &operator = (const HashPool &pRight);
+
+    };
+
+    // List of handles from a single HashPool.
+    //   Sorted functions order by handle value, not hash value, so they only use integer compares.
+    class HashHandleList : public std::vector<HashPool::Handle>
+    {
+    public:
+
+        bool contains(HashPool::Handle pHandle) const
+        {
+            for(const_iterator handle = begin(); handle != end(); ++handle)
+                if(*handle == pHandle)
+                    return true;
+            return false;
+        }
+
+        bool remove(HashPool::Handle pHandle)
+        {
+            for(iterator handle = begin(); handle != end(); ++handle)
+                if(*handle == pHandle)
+                {
+                    erase(handle);
+                    return true;
+                }
+            return false;
+        }
+
+        // Insert an item into a sorted list and retain sorting
+        bool insertSorted(HashPool::Handle pHandle);
+
+        // Return true if the item exists in a sorted list
+        bool containsSorted(HashPool::Handle pHandle) const;
+
+        // Return true if the item was removed from the sorted list
+        bool removeSorted(HashPool::Handle pHandle);
+
+    };
+
+    // Set of handles from a single HashPool.
+    //   Open addressing on the handle value, so lookups never touch the pool's arena.
+    class HashHandleSet
+    {
+    public:
+
+        HashHandleSet() : mCount(0), mSlotMask(0) {}
+
+        unsigned int size() const { return mCount; }
+        stream_size memorySize() const { return mSlots.capacity() * sizeof(HashPool::Handle); }
+
+        void clear();
+        void reserve(unsigned int pCount);
+
+        // Return false if the handle is invalid or already in the set.
+        bool insert(HashPool::Handle pHandle);
+        bool contains(HashPool::Handle pHandle) const;
+        // Return true if the handle was removed.
+        bool remove(HashPool::Handle pHandle);
+
+        // Appends the handles in the set to pList in no particular order.
+        void getList(HashHandleList &pList) const;
+
+    private:
+
+        unsigned int startSlot(HashPool::Handle pHandle) const
+          { return (unsigned int)((pHandle * 0x9e3779b97f4a7c15ULL) >> 32) & mSlotMask; }
+
+        // Return the slot containing the handle or the empty slot where it belongs.
+        unsigned int findSlot(HashPool::Handle pHandle) const;
+
+        void resizeSlots(unsigned int pSlotCount);
+
+        unsigned int mCount;
+        // Linear probing. Power of 2 size. INVALID_HANDLE when empty.
+        std::vector<HashPool::Handle> mSlots;
+        unsigned int mSlotMask;
+
+    };
+}
+
+#endif
@@ -9,6 +9,7 @@
 
 #include "log.hpp"
 #include "digest.hpp"
+#include "timer.hpp"
 
 #ifdef PROFILER_ON
 #include "profiler.hpp"
@@ -167,6 +168,102 @@ namespace NextCash
         return pIterator.eraseNoDelete();
     }
 
+    unsigned int HashSet::insert(std::vector<HashObject *> &pObjects, bool pAllowDuplicateSorts)
+    {
+        std::vector<SortedObject *> batches[SET_COUNT];
+        for(std::vector<HashObject *>::iterator object = pObjects.begin();
+          object != pObjects.end(); ++object)
+            batches[set((*object)->getHash()) - mSets].push_back(*object);
+
+        unsigned int result = 0;
+        std::vector<SortedObject *> *batch = batches;
+        SortedSet *set = mSets;
+        pObjects.clear();
+        for(unsigned int i = 0; i < SET_COUNT; ++i, ++batch, ++set)
+            if(batch->size() > 0)
+            {
+                result += set->insert(*batch, pAllowDuplicateSorts);
+
+                // Return objects that were not inserted.
+                for(std::vector<SortedObject *>::iterator object = batch->begin();
+                  object != batch->end(); ++object)
+                    pObjects.push_back((HashObject *)*object);
+            }
+
+        mSize += result;
+        return result;
+    }
+
+    unsigned int HashSet::remove(const std::vector<Hash> &pHashes)
+    {
+        std::vector<HashLookupObject> lookups;
+        lookups.reserve(pHashes.size());
+        for(std::vector<Hash>::const_iterator hash = pHashes.begin(); hash != pHashes.end();
+          ++hash)
+            lookups.emplace_back(*hash);
+
+        std::vector<SortedObject *> batches[SET_COUNT];
+        for(std::vector<HashLookupObject>::iterator lookup = lookups.begin();
+          lookup != lookups.end(); ++lookup)
+            batches[set(lookup->getHash()) - mSets].push_back(&(*lookup));
+
+        unsigned int result = 0;
+        std::vector<SortedObject *> *batch = batches;
+        SortedSet *set = mSets;
+        for(unsigned int i = 0; i < SET_COUNT; ++i, ++batch, ++set)
+            if(batch->size() > 0)
+                result += set->remove(*batch);
+
+        mSize -= result;
+        return result;
+    }
+
+    unsigned int HashSet::merge(HashSet &pOther, bool pAllowDuplicateSorts)
+    {
+        unsigned int result = 0;
+        SortedSet *set = mSets, *otherSet = pOther.mSets;
+        for(unsigned int i = 0; i < SET_COUNT; ++i, ++set, ++otherSet)
+            result += set->merge(*otherSet, pAllowDuplicateSorts);
+
+        mSize += result;
+        pOther.mSize -= result;
+        return result;
+    }
+
+    unsigned int HashSet::intersect(HashSet &pOther)
+    {
+        unsigned int result = 0;
+        SortedSet *set = mSets, *otherSet = pOther.mSets;
+        for(unsigned int i = 0; i < SET_COUNT; ++i, ++set, ++otherSet)
+            result += set->intersect(*otherSet);
+
+        mSize -= result;
+        return result;
+    }
+
+    unsigned int HashSet::subtract(HashSet &pOther)
+    {
+        unsigned int result = 0;
+        SortedSet *set = mSets, *otherSet = pOther.mSets;
+        for(unsigned int i = 0; i < SET_COUNT; ++i, ++set, ++otherSet)
+            result += set->subtract(*otherSet);
+
+        mSize -= result;
+        return result;
+    }
+
+    class HashSetTestObject : public HashObject
+    {
+    public:
+
+        HashSetTestObject(const Hash &pHash) : hash(pHash) {}
+
+        const Hash &getHash() { return hash; }
+
+        Hash hash;
+
+    };
+
     bool HashSet::test()
     {
         Log::add(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME,
@@ -433,6 +530,232 @@ namespace NextCash
         else
             Log::add(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME, "Passed hash set size");
 
+        /***********************************************************************************************
+         * Batch insert and remove
+         ***********************************************************************************************/
+        HashSet batchSet;
+        std::vector<HashObject *> batch;
+        std::vector<Hash> hashes;
+        Hash hash(32);
+
+        for(unsigned int i = 0; i < 5000; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+            if(i < 2500)
+                batchSet.insert(new HashSetTestObject(hash));
+            else
+                batch.push_back(new HashSetTestObject(hash));
+        }
+        batch.push_back(new HashSetTestObject(hashes[10]));
+
+        bool batchSuccess = batchSet.insert(batch) == 2500 && batch.size() == 1 &&
+          batch.front()->getHash() == hashes[10] && batchSet.size() == 5000;
+        delete batch.front();
+
+        // Each set must still be sorted.
+        count = 0;
+        SortedSet *previousSet = NULL;
+        HashObject *previous = NULL;
+        for(HashSet::Iterator iter = batchSet.begin(); iter != batchSet.end(); ++iter, ++count)
+        {
+            if(iter.set() == previousSet && previous->getHash() > (*iter)->getHash())
+                batchSuccess = false;
+            previousSet = iter.set();
+            previous = *iter;
+        }
+        if(count != 5000)
+            batchSuccess = false;
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+            if(!batchSet.contains(hashes[i]))
+                batchSuccess = false;
+
+        std::vector<Hash> removeHashes;
+        for(unsigned int i = 0; i < hashes.size(); i += 2)
+            removeHashes.push_back(hashes[i]);
+        if(batchSet.remove(removeHashes) != 2500 || batchSet.size() != 2500 ||
+          batchSet.remove(removeHashes) != 0)
+            batchSuccess = false;
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+            if(batchSet.contains(hashes[i]) != (i % 2 == 1))
+                batchSuccess = false;
+
+        if(batchSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME, "Passed batch insert and remove");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_SET_LOG_NAME, "Failed batch insert and remove");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Set algebra
+         ***********************************************************************************************/
+        HashSet leftSet, rightSet, overlapSet;
+
+        // Left has hashes 0-2999, right has 2000-4999 and overlap has 2000-2999.
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+        {
+            if(i < 3000)
+                leftSet.insert(new HashSetTestObject(hashes[i]));
+            if(i >= 2000)
+                rightSet.insert(new HashSetTestObject(hashes[i]));
+            if(i >= 2000 && i < 3000)
+                overlapSet.insert(new HashSetTestObject(hashes[i]));
+        }
+
+        bool algebraSuccess = leftSet.subtract(overlapSet) == 1000 && leftSet.size() == 2000 &&
+          rightSet.intersect(overlapSet) == 2000 && rightSet.size() == 1000 &&
+          leftSet.merge(rightSet) == 1000 && leftSet.size() == 3000 && rightSet.size() == 0 &&
+          leftSet.merge(overlapSet) == 0 && overlapSet.size() == 1000;
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+            if(leftSet.contains(hashes[i]) != (i < 3000))
+                algebraSuccess = false;
+
+        if(algebraSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME, "Passed set algebra");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_SET_LOG_NAME, "Failed set algebra");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Batch throughput
+         ***********************************************************************************************/
+        // Add and remove a block sized batch from a mempool sized set.
+        const unsigned int setSize = 500000, batchSize = 25000;
+        HashSet singleSet, mergeSet;
+        Timer singleInsertTimer, singleRemoveTimer, batchInsertTimer, batchRemoveTimer;
+
+        hashes.clear();
+        for(unsigned int i = 0; i < setSize + batchSize; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+        }
+        for(unsigned int i = 0; i < setSize; ++i)
+        {
+            singleSet.insert(new HashSetTestObject(hashes[i]));
+            mergeSet.insert(new HashSetTestObject(hashes[i]));
+        }
+
+        singleInsertTimer.start();
+        for(unsigned int i = setSize; i < hashes.size(); ++i)
+            singleSet.insert(new HashSetTestObject(hashes[i]));
+        singleInsertTimer.stop();
+
+        singleRemoveTimer.start();
+        for(unsigned int i = setSize; i < hashes.size(); ++i)
+            singleSet.remove(hashes[i]);
+        singleRemoveTimer.stop();
+
+        batch.clear();
+        removeHashes.clear();
+        for(unsigned int i = setSize; i < hashes.size(); ++i)
+        {
+            batch.push_back(new HashSetTestObject(hashes[i]));
+            removeHashes.push_back(hashes[i]);
+        }
+
+        batchInsertTimer.start();
+        unsigned int batchInserted = mergeSet.insert(batch);
+        batchInsertTimer.stop();
+
+        batchRemoveTimer.start();
+        unsigned int batchRemoved = mergeSet.remove(removeHashes);
+        batchRemoveTimer.stop();
+
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME,
+          "%d items into %d : single insert %d us, remove %d us", batchSize, setSize,
+          (int)singleInsertTimer.microseconds(), (int)singleRemoveTimer.microseconds());
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME,
+          "%d items into %d : batch insert %d us, remove %d us", batchSize, setSize,
+          (int)batchInsertTimer.microseconds(), (int)batchRemoveTimer.microseconds());
+
+        if(batchInserted == batchSize && batchRemoved == batchSize && batch.size() == 0 &&
+          singleSet.size() == setSize && mergeSet.size() == setSize)
+            Log::add(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME, "Passed batch throughput");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_SET_LOG_NAME, "Failed batch throughput");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Parallel visit and remove
+         ***********************************************************************************************/
+        const unsigned int parallelSize = 2000000;
+        HashSet parallelSet;
+        Timer forEachTimer, removeIfTimer;
+        std::atomic<unsigned int> visited(0), oddCount(0);
+        unsigned int expectedOdd = 0;
+
+        singleSet.clear();
+        mergeSet.clear();
+        batch.clear();
+        for(unsigned int i = 0; i < parallelSize; ++i)
+        {
+            hash.randomize();
+            if(hash.getByte(0) & 0x01)
+                ++expectedOdd;
+            batch.push_back(new HashSetTestObject(hash));
+        }
+        parallelSet.insert(batch);
+
+        bool parallelSuccess = parallelSet.size() == parallelSize;
+        unsigned int threadCounts[2] = { 1, 4 };
+        for(unsigned int i = 0; i < 2; ++i)
+        {
+            visited = 0;
+            oddCount = 0;
+            forEachTimer.clear(true);
+            parallelSet.parallelForEach([&visited, &oddCount](HashObject *pObject)
+            {
+                ++visited;
+                if(pObject->getHash().getByte(0) & 0x01)
+                    ++oddCount;
+            }, threadCounts[i]);
+            forEachTimer.stop();
+
+            Log::addFormatted(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME,
+              "Parallel for each %d items with %d threads : %d us", parallelSize,
+              threadCounts[i], (int)forEachTimer.microseconds());
+
+            if(visited != parallelSize || oddCount != expectedOdd)
+                parallelSuccess = false;
+        }
+
+        removeIfTimer.start();
+        unsigned int parallelRemoved = parallelSet.parallelRemoveIf([](HashObject *pObject)
+          { return (pObject->getHash().getByte(0) & 0x01) != 0; });
+        removeIfTimer.stop();
+
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME,
+          "Parallel remove if %d items with %d threads : %d us", parallelSize,
+          threadCounts[1], (int)removeIfTimer.microseconds());
+
+        if(parallelRemoved != expectedOdd || parallelSet.size() != parallelSize - expectedOdd)
+            parallelSuccess = false;
+
+        count = 0;
+        for(HashSet::Iterator iter = parallelSet.begin(); iter != parallelSet.end(); ++iter)
+        {
+            ++count;
+            if((*iter)->getHash().getByte(0) & 0x01)
+                parallelSuccess = false;
+        }
+        if(count != parallelSet.size())
+            parallelSuccess = false;
+
+        if(parallelSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_SET_LOG_NAME, "Passed parallel visit and remove");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_SET_LOG_NAME, "Failed parallel visit and remove");
+            success = false;
+        }
+
         return success;
     }
 }
@@ -10,6 +10,7 @@
 
 #include "hash.hpp"
 #include "sorted_set.hpp"
+#include "thread.hpp"
 
 #include <vector>
 
@@ -36,6 +37,12 @@ namespace NextCash
             }
         }
 
+        bool sortValue(uint64_t &pValue)
+        {
+            pValue = getHash().sortValue();
+            return true;
+        }
+
     };
 
     class HashSet
@@ -118,6 +125,75 @@ namespace NextCash
             return result;
         }
 
+        // Calls pFunction(HashObject *) for every item, handing the sets out to pThreadCount
+        //   threads. Items in one set are visited in order by the same thread, but pFunction is
+        //   called from several threads at once so it must be thread safe.
+        // When pThreadCount is zero the number of hardware threads is used.
+        template <class tFunction>
+        void parallelForEach(tFunction pFunction, unsigned int pThreadCount = 0)
+        {
+            SortedSet *sets = mSets;
+            parallelFor("HashSetForEach", SET_COUNT, [sets, &pFunction](unsigned int pIndex)
+            {
+                SortedSet &set = sets[pIndex];
+                for(SortedSet::Iterator item = set.begin(); item != set.end(); ++item)
+                    pFunction((HashObject *)*item);
+            }, pThreadCount);
+        }
+
+        // Removes and deletes items for which pPredicate(HashObject *) returns true, handing the
+        //   sets out to pThreadCount threads. pPredicate is called from several threads at once so
+        //   it must be thread safe.
+        // Returns the number of items removed.
+        template <class tPredicate>
+        unsigned int parallelRemoveIf(tPredicate pPredicate, unsigned int pThreadCount = 0)
+        {
+            SortedSet *sets = mSets;
+            std::vector<unsigned int> removed(SET_COUNT, 0);
+            parallelFor("HashSetRemoveIf", SET_COUNT,
+              [sets, &pPredicate, &removed](unsigned int pIndex)
+            {
+                removed[pIndex] = sets[pIndex].removeIf([&pPredicate](SortedObject *pObject)
+                  { return pPredicate((HashObject *)pObject); });
+            }, pThreadCount);
+
+            // Combine the counts from each set.
+            unsigned int result = 0;
+            for(std::vector<unsigned int>::iterator count = removed.begin(); count != removed.end();
+              ++count)
+                result += *count;
+            mSize -= result;
+            return result;
+        }
+
+        // Batch versions of insert and remove. The batch is split by set, then each set sorts its
+        //   part once and merges it in one pass.
+
+        // Inserts the objects with the same rules as insert.
+        // pObjects is left containing the objects that were not inserted, which are still owned
+        //   by the caller.
+        // Returns the number of objects inserted.
+        unsigned int insert(std::vector<HashObject *> &pObjects,
+          bool pAllowDuplicateSorts = false);
+
+        // Removes and deletes the first item matching each hash.
+        // Returns the number of items removed.
+        unsigned int remove(const std::vector<Hash> &pHashes);
+
+        // Set algebra by merging matching sets in one pass. See SortedSet.
+
+        // Moves the items from pOther into this set. Items not inserted are left in pOther.
+        // Returns the number of items moved.
+        unsigned int merge(HashSet &pOther, bool pAllowDuplicateSorts = false);
+
+        // Deletes items that don't have a match in pOther.
+        // Returns the number of items removed.
+        unsigned int intersect(HashSet &pOther);
+
+        // Deletes items that have a match in pOther.
+        // Returns the number of items removed.
+        unsigned int subtract(HashSet &pOther);
+
         void clear()
         {
             SortedSet *set = mSets;
@@ -0,0 +1,566 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "hash_table.hpp"
+
+#include "log.hpp"
+#include "timer.hpp"
+#include "reference_hash_set.hpp"
+
+#include <new>
+#include <unordered_map>
+
+
+namespace NextCash
+{
+    const unsigned int HashTable::INVALID_SLOT;
+    const unsigned int HashTable::MINIMUM_CAPACITY;
+
+    HashTable::~HashTable()
+    {
+        clear();
+    }
+
+    void HashTable::reserve(unsigned int pSize)
+    {
+        // Keep the table at most 7/8 full.
+        unsigned int capacity = MINIMUM_CAPACITY;
+        while(capacity - (capacity / 8) < pSize)
+            capacity <<= 1;
+        if(capacity > mCapacity)
+            resize(capacity);
+    }
+
+    void HashTable::resize(unsigned int pCapacity)
+    {
+        Entry *oldEntries = mEntries;
+        unsigned int oldCapacity = mCapacity;
+
+        if(pCapacity == 0)
+        {
+            mEntries = NULL;
+            mCapacity = 0;
+            mMask = 0;
+            mShift = 64;
+        }
+        else
+        {
+            try
+            {
+                mEntries = new Entry[pCapacity];
+            }
+            catch(std::bad_alloc &pBadAlloc)
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME,
+                  "Bad allocation : %s", pBadAlloc.what());
+                mEntries = oldEntries;
+                return;
+            }
+
+            std::memset(mEntries, 0, sizeof(Entry) * pCapacity);
+            mCapacity = pCapacity;
+            mMask = pCapacity - 1;
+            mShift = 64;
+            for(unsigned int i = pCapacity; i > 1; i >>= 1)
+                --mShift;
+        }
+
+        if(oldEntries != NULL)
+        {
+            for(Entry *entry = oldEntries; entry < oldEntries + oldCapacity; ++entry)
+                if(entry->object != NULL)
+                    place(entry->key, entry->object);
+            delete[] oldEntries;
+        }
+    }
+
+    void HashTable::place(uint64_t pKey, HashObject *pObject)
+    {
+        Entry carry;
+        carry.key = pKey;
+        carry.object = pObject;
+
+        unsigned int slot = homeSlot(pKey);
+        unsigned int carryDistance = 0, slotDistance;
+        Entry swap;
+        while(true)
+        {
+            if(mEntries[slot].object == NULL)
+            {
+                mEntries[slot] = carry;
+                return;
+            }
+
+            // Take the slot from entries closer to their home slot.
+            slotDistance = distance(slot);
+            if(slotDistance < carryDistance)
+            {
+                swap = mEntries[slot];
+                mEntries[slot] = carry;
+                carry = swap;
+                carryDistance = slotDistance;
+            }
+
+            slot = (slot + 1) & mMask;
+            ++carryDistance;
+        }
+    }
+
+    unsigned int HashTable::findSlot(const Hash &pHash) const
+    {
+        if(mSize == 0)
+            return INVALID_SLOT;
+
+        uint64_t hashKey = key(pHash);
+        unsigned int slot = homeSlot(hashKey);
+        for(unsigned int slotDistance = 0; ; ++slotDistance)
+        {
+            if(mEntries[slot].object == NULL || distance(slot) < slotDistance)
+                return INVALID_SLOT; // Would have been placed before this slot
+            if(mEntries[slot].key == hashKey && mEntries[slot].object->getHash() == pHash)
+                return slot;
+            slot = (slot + 1) & mMask;
+        }
+    }
+
+    void HashTable::removeSlot(unsigned int pSlot)
+    {
+        unsigned int next = (pSlot + 1) & mMask;
+        while(mEntries[next].object != NULL && distance(next) > 0)
+        {
+            mEntries[pSlot] = mEntries[next];
+            pSlot = next;
+            next = (next + 1) & mMask;
+        }
+
+        mEntries[pSlot].key = 0;
+        mEntries[pSlot].object = NULL;
+        --mSize;
+    }
+
+    unsigned int HashTable::startSlot() const
+    {
+        for(unsigned int slot = 0; slot < mCapacity; ++slot)
+            if(mEntries[slot].object == NULL)
+                return slot;
+        return 0;
+    }
+
+    bool HashTable::insert(HashObject *pObject, bool pAllowDuplicateSorts)
+    {
+        const Hash &hash = pObject->getHash();
+        uint64_t hashKey = key(hash);
+
+        if(mSize > 0)
+        {
+            // Check matching items.
+            unsigned int slot = homeSlot(hashKey);
+            for(unsigned int slotDistance = 0; ; ++slotDistance)
+            {
+                if(mEntries[slot].object == NULL || distance(slot) < slotDistance)
+                    break;
+                if(mEntries[slot].key == hashKey && mEntries[slot].object->getHash() == hash &&
+                  (!pAllowDuplicateSorts || mEntries[slot].object->valueEquals(pObject)))
+                    return false;
+                slot = (slot + 1) & mMask;
+            }
+        }
+
+        if(mSize + 1 > mCapacity - (mCapacity / 8))
+        {
+            resize(mCapacity == 0 ? MINIMUM_CAPACITY : mCapacity * 2);
+            if(mSize + 1 > mCapacity - (mCapacity / 8))
+                return false; // Failed to allocate
+        }
+
+        place(hashKey, pObject);
+        ++mSize;
+        return true;
+    }
+
+    bool HashTable::remove(const Hash &pHash)
+    {
+        unsigned int slot = findSlot(pHash);
+        if(slot == INVALID_SLOT)
+            return false;
+        delete mEntries[slot].object;
+        removeSlot(slot);
+        return true;
+    }
+
+    unsigned int HashTable::removeAll(const Hash &pHash)
+    {
+        unsigned int result = 0;
+        unsigned int slot;
+        while((slot = findSlot(pHash)) != INVALID_SLOT)
+        {
+            delete mEntries[slot].object;
+            removeSlot(slot);
+            ++result;
+        }
+        return result;
+    }
+
+    HashObject *HashTable::getAndRemove(const Hash &pHash)
+    {
+        unsigned int slot = findSlot(pHash);
+        if(slot == INVALID_SLOT)
+            return NULL;
+        HashObject *result = mEntries[slot].object;
+        removeSlot(slot);
+        return result;
+    }
+
+    void HashTable::clear()
+    {
+        for(Entry *entry = mEntries; entry < mEntries + mCapacity; ++entry)
+            if(entry->object != NULL)
+                delete entry->object;
+        clearNoDelete();
+    }
+
+    void HashTable::clearNoDelete()
+    {
+        if(mEntries != NULL)
+            delete[] mEntries;
+        mEntries = NULL;
+        mCapacity = 0;
+        mMask = 0;
+        mShift = 64;
+        mSize = 0;
+    }
+
+    void HashTable::shrink()
+    {
+        if(mSize == 0)
+        {
+            clearNoDelete();
+            return;
+        }
+
+        unsigned int capacity = MINIMUM_CAPACITY;
+        while(capacity - (capacity / 8) < mSize)
+            capacity <<= 1;
+        if(capacity < mCapacity)
+            resize(capacity);
+    }
+
+    HashTable::Iterator HashTable::begin()
+    {
+        Iterator result(this, startSlot(), 0);
+        if(mCapacity > 0)
+            result.skipEmpty();
+        return result;
+    }
+
+    HashTable::Iterator HashTable::find(const Hash &pHash)
+    {
+        unsigned int slot = findSlot(pHash);
+        if(slot == INVALID_SLOT)
+            return end();
+        unsigned int start = startSlot();
+        return Iterator(this, start, (slot - start) & mMask);
+    }
+
+    HashTable::Iterator HashTable::eraseDelete(Iterator &pIterator)
+    {
+        delete *pIterator;
+        return eraseNoDelete(pIterator);
+    }
+
+    HashTable::Iterator HashTable::eraseNoDelete(Iterator &pIterator)
+    {
+        // The next item is either shifted back into this slot or is after it.
+        removeSlot(pIterator.slot());
+        Iterator result = pIterator;
+        result.skipEmpty();
+        return result;
+    }
+
+    class HashTableTestObject : public HashObject
+    {
+    public:
+
+        HashTableTestObject(const Hash &pHash, unsigned int pValue) : hash(pHash), value(pValue) {}
+
+        const Hash &getHash() { return hash; }
+
+        bool valueEquals(const SortedObject *pRight) const
+        {
+            return value == ((const HashTableTestObject *)pRight)->value;
+        }
+
+        Hash hash;
+        unsigned int value;
+
+    };
+
+    class HashTableReferenceTestObject
+    {
+    public:
+
+        HashTableReferenceTestObject(const Hash &pHash) : hash(pHash) {}
+
+        const Hash &getHash() { return hash; }
+        bool valueEquals(HashTableReferenceTestObject &pRight) { return false; }
+        int compare(HashTableReferenceTestObject &pRight) { return hash.compare(pRight.hash); }
+
+        Hash hash;
+
+    };
+
+    class HashTableTestHasher
+    {
+    public:
+        size_t operator()(const Hash &pHash) const
+        {
+            size_t result = 0;
+            std::memcpy(&result, pHash.data(), sizeof(result));
+            return result;
+        }
+    };
+
+    bool HashTable::test()
+    {
+        Log::add(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME,
+          "------------- Starting Hash Table Tests -------------");
+
+        bool success = true;
+
+        /***********************************************************************************************
+         * Insert and get
+         ***********************************************************************************************/
+        HashTable table;
+        std::vector<Hash> hashes;
+        Hash hash(32);
+
+        for(unsigned int i = 0; i < 2000; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+            if(!table.insert(new HashTableTestObject(hash, i)))
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME,
+                  "Failed insert %d : %s", i, hash.hex().text());
+                success = false;
+            }
+        }
+
+        bool getSuccess = table.size() == 2000;
+        HashTableTestObject *object;
+        for(unsigned int i = 0; getSuccess && i < hashes.size(); ++i)
+        {
+            object = (HashTableTestObject *)table.get(hashes[i]);
+            if(object == NULL || object->value != i || !table.contains(hashes[i]))
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME,
+                  "Failed get %d : %s", i, hashes[i].hex().text());
+                getSuccess = false;
+            }
+        }
+
+        hash.randomize();
+        if(table.get(hash) != NULL || table.contains(hash))
+            getSuccess = false;
+
+        if(getSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME, "Passed insert and get");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME, "Failed insert and get");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Duplicates
+         ***********************************************************************************************/
+        HashTableTestObject *duplicate = new HashTableTestObject(hashes[5], 5);
+        bool duplicateSuccess = !table.insert(duplicate) && !table.insert(duplicate, true);
+        duplicate->value = 9999;
+        duplicateSuccess = duplicateSuccess && !table.insert(duplicate) &&
+          table.insert(duplicate, true) && table.size() == 2001;
+        duplicateSuccess = duplicateSuccess && table.removeAll(hashes[5]) == 2 &&
+          !table.contains(hashes[5]) && table.size() == 1999;
+
+        if(duplicateSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME, "Passed duplicates");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME, "Failed duplicates");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Remove
+         ***********************************************************************************************/
+        bool removeSuccess = true;
+        for(unsigned int i = 0; i < hashes.size(); i += 3)
+            if(i != 5 && !table.remove(hashes[i]))
+                removeSuccess = false;
+
+        object = (HashTableTestObject *)table.getAndRemove(hashes[1]);
+        if(object == NULL || object->value != 1 || table.contains(hashes[1]))
+            removeSuccess = false;
+        delete object;
+
+        for(unsigned int i = 2; i < hashes.size(); ++i)
+            if(i % 3 != 0 && i != 5 && table.get(hashes[i]) == NULL)
+                removeSuccess = false;
+
+        if(removeSuccess && table.size() == 1999 - 668)
+            Log::add(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME, "Passed remove");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME, "Failed remove : size %d",
+              table.size());
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Iterate and erase
+         ***********************************************************************************************/
+        unsigned int iterateCount = 0, eraseCount = 0;
+        for(Iterator item = table.begin(); item != table.end();)
+        {
+            ++iterateCount;
+            if(((HashTableTestObject *)*item)->value % 2 == 0)
+            {
+                ++eraseCount;
+                item = table.eraseDelete(item);
+            }
+            else
+                ++item;
+        }
+
+        bool iterateSuccess = iterateCount == 1999 - 668 && table.size() == iterateCount - eraseCount;
+        for(Iterator item = table.begin(); item != table.end(); ++item)
+            if(((HashTableTestObject *)*item)->value % 2 == 0)
+                iterateSuccess = false;
+
+        Iterator foundItem = table.find(hashes[7]);
+        if(!foundItem || ((HashTableTestObject *)*foundItem)->value != 7 || table.find(hashes[8]))
+            iterateSuccess = false;
+
+        if(iterateSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME, "Passed iterate and erase");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME,
+              "Failed iterate and erase : %d iterated, %d erased, size %d", iterateCount,
+              eraseCount, table.size());
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Shrink and clear
+         ***********************************************************************************************/
+        unsigned int previousCapacity = table.capacity();
+        table.shrink();
+        bool shrinkSuccess = table.capacity() < previousCapacity && table.get(hashes[7]) != NULL;
+        table.clear();
+        shrinkSuccess = shrinkSuccess && table.size() == 0 && table.get(hashes[7]) == NULL &&
+          table.begin() == table.end();
+
+        if(shrinkSuccess)
+            Log::add(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME, "Passed shrink and clear");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME, "Failed shrink and clear");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Throughput compared to HashSet, ReferenceHashSet, and unordered_map
+         ***********************************************************************************************/
+        const unsigned int benchmarkCount = 100000;
+        hashes.clear();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+        }
+
+        Timer insertTimer, lookupTimer;
+        unsigned int found = 0;
+
+        insertTimer.start();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            table.insert(new HashTableTestObject(hashes[i], i));
+        insertTimer.stop();
+        lookupTimer.start();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            if(table.get(hashes[i]) != NULL)
+                ++found;
+        lookupTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME,
+          "HashTable         %d items : insert %6d us, lookup %6d us", benchmarkCount,
+          (int)insertTimer.microseconds(), (int)lookupTimer.microseconds());
+        table.clear();
+
+        HashSet hashSet;
+        insertTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            hashSet.insert(new HashTableTestObject(hashes[i], i));
+        insertTimer.stop();
+        lookupTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            if(hashSet.get(hashes[i]) != NULL)
+                ++found;
+        lookupTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME,
+          "HashSet           %d items : insert %6d us, lookup %6d us", benchmarkCount,
+          (int)insertTimer.microseconds(), (int)lookupTimer.microseconds());
+        hashSet.clear();
+
+        ReferenceHashSet<HashTableReferenceTestObject> referenceSet;
+        insertTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+        {
+            ReferenceCounter<HashTableReferenceTestObject> reference(
+              new HashTableReferenceTestObject(hashes[i]));
+            referenceSet.insert(reference);
+        }
+        insertTimer.stop();
+        lookupTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            if(referenceSet.contains(hashes[i]))
+                ++found;
+        lookupTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME,
+          "ReferenceHashSet  %d items : insert %6d us, lookup %6d us", benchmarkCount,
+          (int)insertTimer.microseconds(), (int)lookupTimer.microseconds());
+        referenceSet.clear();
+
+        std::unordered_map<Hash, HashTableTestObject *, HashTableTestHasher> unorderedMap;
+        insertTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            unorderedMap[hashes[i]] = new HashTableTestObject(hashes[i], i);
+        insertTimer.stop();
+        lookupTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            if(unorderedMap.find(hashes[i]) != unorderedMap.end())
+                ++found;
+        lookupTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME,
+          "unordered_map     %d items : insert %6d us, lookup %6d us", benchmarkCount,
+          (int)insertTimer.microseconds(), (int)lookupTimer.microseconds());
+        for(std::unordered_map<Hash, HashTableTestObject *, HashTableTestHasher>::iterator item =
+          unorderedMap.begin(); item != unorderedMap.end(); ++item)
+            delete item->second;
+
+        if(found == benchmarkCount * 4)
+            Log::add(Log::INFO, NEXTCASH_HASH_TABLE_LOG_NAME, "Passed throughput lookups");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_HASH_TABLE_LOG_NAME,
+              "Failed throughput lookups : %d/%d found", found, benchmarkCount * 4);
+            success = false;
+        }
+
+        return success;
+    }
+}
@@ -0,0 +1,221 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_HASH_TABLE_HPP
+#define NEXTCASH_HASH_TABLE_HPP
+
+#include "hash.hpp"
+#include "hash_set.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#define NEXTCASH_HASH_TABLE_LOG_NAME "HashTable"
+
+
+namespace NextCash
+{
+    // Flat open addressing (Robin Hood, linear probing) table of HashObjects.
+    //   Same interface as HashSet, but the slot is calculated directly from the hash bytes, so a
+    //   lookup is normally one or two cache lines and no virtual compare calls.
+    //   Each slot holds the low 8 bytes of the hash inline so most mismatches are rejected without
+    //   dereferencing the object.
+    // Iteration is in table order, not sorted order.
+    class HashTable
+    {
+    public:
+
+        HashTable()
+        {
+            mEntries = NULL;
+            mCapacity = 0;
+            mMask = 0;
+            mShift = 64;
+            mSize = 0;
+        }
+        ~HashTable();
+
+        unsigned int size() const { return mSize; }
+        unsigned int capacity() const { return mCapacity; }
+
+        void reserve(unsigned int pSize);
+
+        bool contains(const Hash &pHash) const { return findSlot(pHash) != INVALID_SLOT; }
+
+        // Returns true if the item was inserted.
+        // If pAllowDuplicateSorts is false then multiple objects with the same hash will not be
+        //   inserted.
+        // Multiple objects that match according to "valueEquals" will never be inserted.
+        bool insert(HashObject *pObject, bool pAllowDuplicateSorts = false);
+
+        // Removes and deletes the first item matching the hash.
+        // Returns true if an item was removed.
+        bool remove(const Hash &pHash);
+
+        // Remove and deletes all items with a matching hash.
+        // Returns the number of items removed.
+        unsigned int removeAll(const Hash &pHash);
+
+        // Returns the item with the specified hash.
+        // Return NULL if not found.
+        HashObject *get(const Hash &pHash) const
+        {
+            unsigned int slot = findSlot(pHash);
+            if(slot == INVALID_SLOT)
+                return NULL;
+            return mEntries[slot].object;
+        }
+
+        // Returns item and doesn't delete it.
+        HashObject *getAndRemove(const Hash &pHash);
+
+        void clear();
+        void clearNoDelete(); // Doesn't delete items.
+
+        // Reduce the table to the smallest size that holds the current items.
+        void shrink();
+
+        class Iterator
+        {
+        public:
+            Iterator() { mTable = NULL; mStart = 0; mOffset = 0; }
+            Iterator(HashTable *pTable, unsigned int pStart, unsigned int pOffset)
+            {
+                mTable  = pTable;
+                mStart  = pStart;
+                mOffset = pOffset;
+            }
+            Iterator(const Iterator &pCopy)
+            {
+                mTable  = pCopy.mTable;
+                mStart  = pCopy.mStart;
+                mOffset = pCopy.mOffset;
+            }
+
+            Iterator &operator = (const Iterator &pRight)
+            {
+                mTable  = pRight.mTable;
+                mStart  = pRight.mStart;
+                mOffset = pRight.mOffset;
+                return *this;
+            }
+
+            bool operator !() const { return mTable == NULL || mOffset >= mTable->mCapacity; }
+            operator bool() const { return mTable != NULL && mOffset < mTable->mCapacity; }
+
+            HashObject *operator *() { return mTable->mEntries[slot()].object; }
+            HashObject *operator ->() { return mTable->mEntries[slot()].object; }
+
+            bool operator ==(const Iterator &pRight) const { return mOffset == pRight.mOffset; }
+            bool operator !=(const Iterator &pRight) const { return mOffset != pRight.mOffset; }
+
+            Iterator &operator ++() // Prefix increment
+            {
+                ++mOffset;
+                skipEmpty();
+                return *this;
+            }
+            Iterator operator ++(int) // Postfix increment
+            {
+                Iterator result = *this;
+                ++(*this);
+                return result;
+            }
+
+        private:
+
+            unsigned int slot() const { return (mStart + mOffset) & mTable->mMask; }
+
+            // Move forward to the next slot containing an item.
+            void skipEmpty()
+            {
+                while(mOffset < mTable->mCapacity && mTable->mEntries[slot()].object == NULL)
+                    ++mOffset;
+            }
+
+            HashTable *mTable;
+            // Iteration starts at an empty slot so that removing an item only shifts items that
+            //   have not been visited yet into visited slots.
+            unsigned int mStart, mOffset;
+
+            friend class HashTable;
+
+        };
+
+        Iterator begin();
+        Iterator end() { return Iterator(this, 0, mCapacity); }
+
+        // Return iterator to first matching item.
+        Iterator find(const Hash &pHash);
+
+        // Remove the item and return the item after it.
+        Iterator eraseDelete(Iterator &pIterator);
+        Iterator eraseNoDelete(Iterator &pIterator);
+
+        static bool test();
+
+    private:
+
+        class Entry
+        {
+        public:
+            uint64_t key; // Low bytes of the hash
+            HashObject *object; // NULL when empty
+        };
+
+        static const unsigned int INVALID_SLOT = 0xffffffff;
+        static const unsigned int MINIMUM_CAPACITY = 16;
+
+        static uint64_t key(const Hash &pHash)
+        {
+            uint64_t result = 0;
+            if(pHash.size() >= 8)
+                std::memcpy(&result, pHash.data(), 8);
+            else if(!pHash.isEmpty())
+                std::memcpy(&result, pHash.data(), pHash.size());
+            return result;
+        }
+
+        // Slot the key would be in with no collisions.
+        //   Block hashes have leading zeros in the most significant bytes, but the low bytes are
+        //   uniformly random. The multiply spreads out small arithmetic values too.
+        unsigned int homeSlot(uint64_t pKey) const
+        {
+            return (unsigned int)((pKey * 0x9e3779b97f4a7c15ULL) >> mShift);
+        }
+
+        // Number of slots the entry is past its home slot.
+        unsigned int distance(unsigned int pSlot) const
+        {
+            return (pSlot - homeSlot(mEntries[pSlot].key)) & mMask;
+        }
+
+        // Return the slot of the first item matching the hash or INVALID_SLOT.
+        unsigned int findSlot(const Hash &pHash) const;
+
+        // Insert without checking for matches or capacity.
+        void place(uint64_t pKey, HashObject *pObject);
+
+        // Remove the item at the slot and shift the items after it back.
+        void removeSlot(unsigned int pSlot);
+
+        // Return the first empty slot.
+        unsigned int startSlot() const;
+
+        void resize(unsigned int pCapacity);
+
+        Entry *mEntries;
+        unsigned int mCapacity, mMask, mShift;
+        unsigned int mSize;
+
+        HashTable(const HashTable &pCopy);
+        HashTable &operator = (const HashTable &pRight);
+
+    };
+}
+
+#endif
@@ -63,6 +63,35 @@ namespace NextCash
             return sRandomIntDistribution(sRandomLongEngine);
         }
 
+        // Returns the estimated position of the value pValue in a sorted list of uniformly
+        //   distributed values, like hashes, where position pBottom has the value pBottomValue
+        //   and pTop has pTopValue. The result is always between pBottom and pTop, exclusive, so
+        //   it can be used in place of the middle in a binary search. pTop must be at least
+        //   pBottom + 2.
+        // When the values don't fit the range the middle is returned.
+        inline uint64_t interpolate(uint64_t pBottom, uint64_t pTop, uint64_t pBottomValue,
+          uint64_t pTopValue, uint64_t pValue)
+        {
+            if(pTopValue <= pBottomValue || pValue <= pBottomValue || pValue >= pTopValue)
+                return pBottom + ((pTop - pBottom) / 2);
+
+            uint64_t result = pBottom + (uint64_t)(((double)(pValue - pBottomValue) /
+              (double)(pTopValue - pBottomValue)) * (double)(pTop - pBottom));
+            if(result <= pBottom)
+                return pBottom + 1;
+            if(result >= pTop)
+                return pTop - 1;
+            return result;
+        }
+
+        // Returns how far past an interpolated position to check next so the item is usually
+        //   between the two. Estimates from uniform values are off by about the square root of
+        //   the range.
+        inline uint64_t interpolateGuard(uint64_t pRange)
+        {
+            return (uint64_t)std::sqrt((double)pRange);
+        }
+
         // Convert 4 bit value to hex character
         inline char nibbleToHex(uint8_t pValue)
         {
@@ -0,0 +1,218 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "reference_counter.hpp"
+
+#include "log.hpp"
+#include "string.hpp"
+#include "thread.hpp"
+#include "timer.hpp"
+
+#include <vector>
+
+
+namespace NextCash
+{
+    class ReferenceCounterTestObject
+    {
+    public:
+
+        ReferenceCounterTestObject(std::atomic<int> &pLiveCount, int pValue) :
+          liveCount(pLiveCount), value(pValue)
+        {
+            ++liveCount;
+        }
+        ~ReferenceCounterTestObject() { --liveCount; }
+
+        std::atomic<int> &liveCount;
+        int value;
+
+    };
+
+    typedef ReferenceCounter<ReferenceCounterTestObject> ReferenceCounterTestReference;
+
+    class ReferenceCounterTestData
+    {
+    public:
+
+        ReferenceCounterTestData(const ReferenceCounterTestReference &pShared) :
+          shared(pShared), failed(0) {}
+
+        ReferenceCounterTestReference shared;
+        std::atomic<unsigned int> failed;
+
+    };
+
+    // Copies and destroys references to the same object.
+    static void referenceCounterTestRun(void *pParameter)
+    {
+        ReferenceCounterTestData *data = (ReferenceCounterTestData *)pParameter;
+        std::vector<ReferenceCounterTestReference> copies;
+
+        for(unsigned int i = 0; i < 100000; ++i)
+        {
+            copies.push_back(data->shared);
+            if(copies.size() == 100)
+            {
+                if(copies.back()->value != 7)
+                    ++data->failed;
+                copies.clear();
+            }
+        }
+    }
+
+    bool testReferenceCounter()
+    {
+        Log::add(Log::INFO, NEXTCASH_REFERENCE_COUNTER_LOG_NAME,
+          "------------- Starting Reference Counter Tests -------------");
+
+        bool success = true;
+        std::atomic<int> liveCount(0);
+
+        /******************************************************************************************
+         * Shared ownership
+         *****************************************************************************************/
+        bool sharedSuccess = true;
+        {
+            ReferenceCounterTestReference empty;
+            ReferenceCounterTestReference first(new ReferenceCounterTestObject(liveCount, 1));
+            ReferenceCounterTestReference second = first;
+
+            if(empty || !first || first.useCount() != 2 || second->value != 1 ||
+              empty.pointer() != NULL || liveCount != 1)
+                sharedSuccess = false;
+
+            second = second; // Self assignment must not release.
+            first.clear();
+            if(first || !second || second.useCount() != 1 || liveCount != 1)
+                sharedSuccess = false;
+
+            // Replace the object of the only reference.
+            second = new ReferenceCounterTestObject(liveCount, 2);
+            if(second->value != 2 || liveCount != 1)
+                sharedSuccess = false;
+
+            ReferenceCounterTestReference moved(std::move(second));
+            if(second || moved.useCount() != 1 || moved->value != 2)
+                sharedSuccess = false;
+        }
+        if(liveCount != 0)
+            sharedSuccess = false;
+
+        if(sharedSuccess)
+            Log::add(Log::INFO, NEXTCASH_REFERENCE_COUNTER_LOG_NAME, "Passed shared ownership");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_REFERENCE_COUNTER_LOG_NAME, "Failed shared ownership");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Make and weak references
+         *****************************************************************************************/
+        bool weakSuccess = true;
+        WeakReferenceCounter<ReferenceCounterTestObject> weak, emptyWeak;
+        {
+            ReferenceCounterTestReference made =
+              ReferenceCounterTestReference::make(liveCount, 3);
+            weak = made;
+
+            ReferenceCounterTestReference locked = weak.lock();
+            if(!locked || locked->value != 3 || made.useCount() != 2 || weak.expired() ||
+              liveCount != 1)
+                weakSuccess = false;
+
+            // Assigning a new object must not change the object weak references see.
+            locked = new ReferenceCounterTestObject(liveCount, 4);
+            if(weak.lock()->value != 3 || liveCount != 2)
+                weakSuccess = false;
+        }
+
+        // Object is destroyed with the last strong reference even though the weak reference
+        //   still holds the control block.
+        if(!weak.expired() || weak.lock() || !emptyWeak.expired() || emptyWeak.lock() ||
+          liveCount != 0)
+            weakSuccess = false;
+        weak.clear();
+
+        if(weakSuccess)
+            Log::add(Log::INFO, NEXTCASH_REFERENCE_COUNTER_LOG_NAME,
+              "Passed make and weak references");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_REFERENCE_COUNTER_LOG_NAME,
+              "Failed make and weak references");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Threads
+         *****************************************************************************************/
+        const unsigned int threadCount = 4;
+        ReferenceCounterTestData threadData(ReferenceCounterTestReference::make(liveCount, 7));
+        std::vector<Thread *> threads;
+        Timer threadTimer(true);
+        for(unsigned int i = 0; i < threadCount; ++i)
+            threads.push_back(new Thread("RefCounterTest", referenceCounterTestRun, &threadData));
+        for(std::vector<Thread *>::iterator thread = threads.begin(); thread != threads.end();
+          ++thread)
+            delete *thread;
+        threadTimer.stop();
+
+        bool threadSuccess = threadData.failed == 0 && threadData.shared.useCount() == 1 &&
+          liveCount == 1;
+        threadData.shared.clear();
+        if(liveCount != 0)
+            threadSuccess = false;
+
+        Log::addFormatted(Log::INFO, NEXTCASH_REFERENCE_COUNTER_LOG_NAME,
+          "%d threads copied and released %d references : %d us", threadCount,
+          threadCount * 100000, (int)threadTimer.microseconds());
+
+        if(threadSuccess)
+            Log::add(Log::INFO, NEXTCASH_REFERENCE_COUNTER_LOG_NAME, "Passed threads");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_REFERENCE_COUNTER_LOG_NAME, "Failed threads");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Allocation throughput
+         *****************************************************************************************/
+        const unsigned int allocationCount = 200000;
+        Timer separateTimer, madeTimer;
+        std::vector<ReferenceCounterTestReference> references;
+        references.reserve(allocationCount);
+
+        separateTimer.start();
+        for(unsigned int i = 0; i < allocationCount; ++i)
+            references.emplace_back(new ReferenceCounterTestObject(liveCount, i));
+        references.clear();
+        separateTimer.stop();
+
+        madeTimer.start();
+        for(unsigned int i = 0; i < allocationCount; ++i)
+            references.push_back(ReferenceCounterTestReference::make(liveCount, i));
+        references.clear();
+        madeTimer.stop();
+
+        Log::addFormatted(Log::INFO, NEXTCASH_REFERENCE_COUNTER_LOG_NAME,
+          "%d objects : separate allocation %d us, make %d us", allocationCount,
+          (int)separateTimer.microseconds(), (int)madeTimer.microseconds());
+
+        if(liveCount == 0)
+            Log::add(Log::INFO, NEXTCASH_REFERENCE_COUNTER_LOG_NAME, "Passed allocation");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_REFERENCE_COUNTER_LOG_NAME, "Failed allocation");
+            success = false;
+        }
+
+        return success;
+    }
+}
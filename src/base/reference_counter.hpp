@@ -8,103 +8,279 @@
 #ifndef NEXTCASH_REFERENCE_COUNTER_HPP
 #define NEXTCASH_REFERENCE_COUNTER_HPP
 
-#include "mutex.hpp"
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#define NEXTCASH_REFERENCE_COUNTER_LOG_NAME "RefCounter"
 
 
 namespace NextCash
 {
+    template <class tType>
+    class WeakReferenceCounter;
+
+    // Shared ownership of an object. The object is deleted when the last ReferenceCounter to it is
+    //   destroyed or reassigned.
+    // Counts are atomic, so different threads can copy and destroy references to the same object
+    //   without a lock. A single ReferenceCounter is not safe to modify from multiple threads.
     template <class tType>
     class ReferenceCounter
     {
     public:
 
-        ReferenceCounter() { mData = new Data(NULL); }
-        ReferenceCounter(tType *pObject) { mData = new Data(pObject); }
+        ReferenceCounter() { mData = NULL; }
+        ReferenceCounter(tType *pObject)
+        {
+            if(pObject == NULL)
+                mData = NULL;
+            else
+                mData = new Data(pObject);
+        }
         ReferenceCounter(const ReferenceCounter &pCopy)
         {
             mData = pCopy.mData;
-
-            mData->mutex.lock();
-            ++mData->count;
-            mData->mutex.unlock();
+            if(mData != NULL)
+                mData->count.fetch_add(1, std::memory_order_relaxed);
         }
-        ~ReferenceCounter()
+        ReferenceCounter(ReferenceCounter &&pMove) noexcept
         {
-            mData->mutex.lock();
-            if(--mData->count == 0)
-                delete mData;
-            else
-                mData->mutex.unlock();
+            mData = pMove.mData;
+            pMove.mData = NULL;
         }
+        ~ReferenceCounter() { release(); }
 
         ReferenceCounter &operator = (const ReferenceCounter &pRight)
         {
-            mData->mutex.lock();
-            if(--mData->count == 0)
-                delete mData;
-            else
-                mData->mutex.unlock();
-
-            mData = pRight.mData;
-
-            mData->mutex.lock();
-            ++mData->count;
-            mData->mutex.unlock();
+            // Add before release in case of self assignment.
+            Data *data = pRight.mData;
+            if(data != NULL)
+                data->count.fetch_add(1, std::memory_order_relaxed);
+            release();
+            mData = data;
+            return *this;
+        }
 
+        ReferenceCounter &operator = (ReferenceCounter &&pRight) noexcept
+        {
+            if(this != &pRight)
+            {
+                release();
+                mData = pRight.mData;
+                pRight.mData = NULL;
+            }
             return *this;
         }
 
         void operator = (tType *pObject)
         {
-            mData->mutex.lock();
-            if(mData->count == 1)
+            if(mData != NULL && !mData->inlineObject &&
+              mData->count.load(std::memory_order_acquire) == 1 &&
+              mData->weakCount.load(std::memory_order_acquire) == 1)
             {
-                // Replace object
+                // Only reference, so replace object
                 if(mData->object != NULL)
                     delete mData->object;
                 mData->object = pObject;
-                mData->mutex.unlock();
+                return;
             }
+
+            release();
+            if(pObject == NULL)
+                mData = NULL;
             else
-            {
-                --mData->count;
-                mData->mutex.unlock();
                 mData = new Data(pObject);
-            }
+        }
+
+        // Creates the object and its counts in one allocation.
+        template <typename... tArgs>
+        static ReferenceCounter make(tArgs &&... pArgs)
+        {
+            ReferenceCounter result;
+            result.mData = InlineData::create(std::forward<tArgs>(pArgs)...);
+            return result;
         }
 
         void clear() { *this = NULL; }
 
-        bool operator !() const { return mData->object == NULL; }
-        operator bool() const { return mData->object != NULL; }
+        bool operator !() const { return mData == NULL || mData->object == NULL; }
+        operator bool() const { return mData != NULL && mData->object != NULL; }
 
         tType &operator *() { return *mData->object; }
         tType *operator ->() { return mData->object; }
         const tType &operator *() const { return *mData->object; }
         const tType *operator ->() const { return mData->object; }
 
-        tType *pointer() { return mData->object; }
+        tType *pointer() { return mData == NULL ? NULL : mData->object; }
+
+        // Number of ReferenceCounters sharing the object. Can be out of date immediately when
+        //   other threads hold references.
+        unsigned int useCount() const
+        {
+            return mData == NULL ? 0 : mData->count.load(std::memory_order_relaxed);
+        }
 
     private:
 
         class Data
         {
         public:
-            Data(tType *pObject) : mutex("RefCounter")
+
+            Data(tType *pObject) : count(1), weakCount(1)
             {
                 object = pObject;
-                count = 1;
+                inlineObject = false;
             }
-            ~Data() { if(object != NULL) delete object; }
 
-            MutexWithConstantName mutex;
+            // Called when the last ReferenceCounter is released.
+            void destroyObject()
+            {
+                if(inlineObject)
+                    object->~tType();
+                else if(object != NULL)
+                    delete object;
+                object = NULL;
+            }
+
+            // Called when the last ReferenceCounter or WeakReferenceCounter is released.
+            void destroy();
+
             tType *object;
-            unsigned int count;
+            std::atomic<unsigned int> count;
+            // Number of WeakReferenceCounters plus one while count is not zero.
+            std::atomic<unsigned int> weakCount;
+            bool inlineObject;
+
+        };
+
+        // Control block with the object stored after it so both are one allocation.
+        class InlineData : public Data
+        {
+        public:
+
+            template <typename... tArgs>
+            static Data *create(tArgs &&... pArgs)
+            {
+                InlineData *result = new InlineData();
+                result->object = new(&result->storage) tType(std::forward<tArgs>(pArgs)...);
+                result->inlineObject = true;
+                return result;
+            }
+
+            typename std::aligned_storage<sizeof(tType), alignof(tType)>::type storage;
+
+        private:
+
+            InlineData() : Data(NULL) {}
+
         };
 
+        void release()
+        {
+            if(mData == NULL)
+                return;
+
+            if(mData->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                mData->destroyObject();
+                if(mData->weakCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    mData->destroy();
+            }
+            mData = NULL;
+        }
+
         Data *mData;
 
+        friend class WeakReferenceCounter<tType>;
+
     };
+
+    // Reference to an object owned by ReferenceCounters that doesn't keep it alive.
+    template <class tType>
+    class WeakReferenceCounter
+    {
+    public:
+
+        WeakReferenceCounter() { mData = NULL; }
+        WeakReferenceCounter(const ReferenceCounter<tType> &pReference)
+        {
+            mData = pReference.mData;
+            if(mData != NULL)
+                mData->weakCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        WeakReferenceCounter(const WeakReferenceCounter &pCopy)
+        {
+            mData = pCopy.mData;
+            if(mData != NULL)
+                mData->weakCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        ~WeakReferenceCounter() { release(); }
+
+        WeakReferenceCounter &operator = (const WeakReferenceCounter &pRight)
+        {
+            // Add before release in case of self assignment.
+            Data *data = pRight.mData;
+            if(data != NULL)
+                data->weakCount.fetch_add(1, std::memory_order_relaxed);
+            release();
+            mData = data;
+            return *this;
+        }
+
+        // True when the object has been deleted.
+        bool expired() const
+        {
+            return mData == NULL || mData->count.load(std::memory_order_acquire) == 0;
+        }
+
+        // Returns a reference that keeps the object alive, or an empty reference if it has
+        //   already been deleted.
+        ReferenceCounter<tType> lock() const
+        {
+            ReferenceCounter<tType> result;
+            if(mData == NULL)
+                return result;
+
+            unsigned int count = mData->count.load(std::memory_order_relaxed);
+            while(count != 0)
+                if(mData->count.compare_exchange_weak(count, count + 1,
+                  std::memory_order_acq_rel, std::memory_order_relaxed))
+                {
+                    result.mData = mData;
+                    break;
+                }
+            return result;
+        }
+
+        void clear() { release(); }
+
+    private:
+
+        typedef typename ReferenceCounter<tType>::Data Data;
+
+        void release()
+        {
+            if(mData != NULL && mData->weakCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                mData->destroy();
+            mData = NULL;
+        }
+
+        Data *mData;
+
+    };
+
+    template <class tType>
+    void ReferenceCounter<tType>::Data::destroy()
+    {
+        if(inlineObject)
+            delete static_cast<InlineData *>(this);
+        else
+            delete this;
+    }
+
+    bool testReferenceCounter();
 }
 
 #endif
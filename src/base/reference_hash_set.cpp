@@ -284,6 +284,48 @@ namespace NextCash
         else
             Log::add(Log::INFO, NEXTCASH_REF_HASH_SET_LOG_NAME, "Passed ref hash set size");
 
+        /***********************************************************************************************
+         * Parallel visit and remove
+         ***********************************************************************************************/
+        ReferenceHashSet<StringHash> parallelSet;
+        String text;
+        for(unsigned int i = 0; i < 100000; ++i)
+        {
+            text.writeFormatted("String %d", i);
+            StringHashReference newString(new StringHash(text));
+            parallelSet.insert(newString);
+        }
+
+        std::atomic<unsigned int> visited(0), expectedRemove(0);
+        parallelSet.parallelForEach([&visited, &expectedRemove](StringHashReference &pObject)
+        {
+            ++visited;
+            if(pObject->getHash().getByte(0) < 0x40)
+                ++expectedRemove;
+        });
+
+        bool parallelSuccess = visited == 100000;
+        if(parallelSet.parallelRemoveIf([](StringHashReference &pObject)
+          { return pObject->getHash().getByte(0) < 0x40; }) != expectedRemove ||
+          parallelSet.size() != 100000 - expectedRemove)
+            parallelSuccess = false;
+
+        count = 0;
+        for(ReferenceHashSet<StringHash>::Iterator iter = parallelSet.begin();
+          iter != parallelSet.end(); ++iter, ++count)
+            if((*iter)->getHash().getByte(0) < 0x40)
+                parallelSuccess = false;
+        if(count != parallelSet.size())
+            parallelSuccess = false;
+
+        if(parallelSuccess)
+            Log::add(Log::INFO, NEXTCASH_REF_HASH_SET_LOG_NAME, "Passed parallel visit and remove");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_REF_HASH_SET_LOG_NAME, "Failed parallel visit and remove");
+            success = false;
+        }
+
         return success;
     }
 }
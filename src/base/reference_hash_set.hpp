@@ -11,6 +11,7 @@
 #include "hash.hpp"
 #include "reference_counter.hpp"
 #include "reference_sorted_set.hpp"
+#include "thread.hpp"
 
 #include <vector>
 
@@ -125,6 +126,46 @@ namespace NextCash
                 return Object(NULL);
         }
 
+        // Calls pFunction(Object &) for every item, handing the sets out to pThreadCount
+        //   threads. Items in one set are visited in order by the same thread, but pFunction is
+        //   called from several threads at once so it must be thread safe.
+        // When pThreadCount is zero the number of hardware threads is used.
+        template <class tFunction>
+        void parallelForEach(tFunction pFunction, unsigned int pThreadCount = 0)
+        {
+            Set *sets = mSets;
+            parallelFor("RefHashSetForEach", SET_COUNT, [sets, &pFunction](unsigned int pIndex)
+            {
+                Set &set = sets[pIndex];
+                for(typename Set::Iterator item = set.begin(); item != set.end(); ++item)
+                    pFunction(*item);
+            }, pThreadCount);
+        }
+
+        // Removes items for which pPredicate(Object &) returns true, handing the sets
+        //   out to pThreadCount threads. pPredicate is called from several threads at once so it
+        //   must be thread safe.
+        // Returns the number of items removed.
+        template <class tPredicate>
+        unsigned int parallelRemoveIf(tPredicate pPredicate, unsigned int pThreadCount = 0)
+        {
+            Set *sets = mSets;
+            std::vector<unsigned int> removed(SET_COUNT, 0);
+            parallelFor("RefHashSetRemoveIf", SET_COUNT,
+              [sets, &pPredicate, &removed](unsigned int pIndex)
+            {
+                removed[pIndex] = sets[pIndex].removeIf(pPredicate);
+            }, pThreadCount);
+
+            // Combine the counts from each set.
+            unsigned int result = 0;
+            for(std::vector<unsigned int>::iterator count = removed.begin(); count != removed.end();
+              ++count)
+                result += *count;
+            mSize -= result;
+            return result;
+        }
+
         void clear()
         {
             Set *set = mSets;
@@ -62,6 +62,11 @@ namespace NextCash
         // Returns item and doesn't delete it.
         Object getAndRemove(Object &pMatching);
 
+        // Removes items for which pPredicate(Object &) returns true, in one pass.
+        // Returns the number of items removed.
+        template <class tPredicate>
+        unsigned int removeIf(tPredicate pPredicate);
+
         void clear() { mItems.clear(); }
 
         void shrink() { mItems.shrink_to_fit(); }
@@ -118,6 +123,24 @@ namespace NextCash
 
     };
 
+    template <class tType>
+    template <class tPredicate>
+    unsigned int ReferenceSortedSet<tType>::removeIf(tPredicate pPredicate)
+    {
+        Iterator keep = mItems.begin();
+        for(Iterator item = mItems.begin(); item != mItems.end(); ++item)
+            if(!pPredicate(*item))
+            {
+                if(keep != item)
+                    *keep = *item;
+                ++keep;
+            }
+
+        unsigned int result = mItems.end() - keep;
+        mItems.erase(keep, mItems.end());
+        return result;
+    }
+
     template <class tType>
     bool ReferenceSortedSet<tType>::contains(Object &pMatching)
     {
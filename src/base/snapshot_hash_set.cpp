@@ -0,0 +1,284 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "snapshot_hash_set.hpp"
+
+#include "log.hpp"
+#include "thread.hpp"
+#include "timer.hpp"
+
+
+namespace NextCash
+{
+    class SnapshotHashSetTestObject
+    {
+    public:
+
+        SnapshotHashSetTestObject(const Hash &pHash, unsigned int pValue,
+          std::atomic<int> &pLiveCount) : hash(pHash), value(pValue), liveCount(pLiveCount)
+        {
+            ++liveCount;
+        }
+        ~SnapshotHashSetTestObject() { --liveCount; }
+
+        const Hash &getHash() { return hash; }
+
+        bool valueEquals(SnapshotHashSetTestObject &pRight) { return value == pRight.value; }
+
+        int compare(SnapshotHashSetTestObject &pRight) { return hash.compare(pRight.hash); }
+
+        Hash hash;
+        unsigned int value;
+        std::atomic<int> &liveCount;
+
+    };
+
+    typedef SnapshotHashSet<SnapshotHashSetTestObject> SnapshotHashSetTestSet;
+
+    // One writer applies batches while readers look up items that are never removed.
+    class SnapshotHashSetTestData
+    {
+    public:
+
+        SnapshotHashSetTestData(std::vector<Hash> &pPermanent, std::atomic<int> &pLiveCount) :
+          permanent(pPermanent), liveCount(pLiveCount), writerDone(false), failed(0), lookups(0) {}
+
+        SnapshotHashSetTestSet set;
+        std::vector<Hash> &permanent;
+        std::atomic<int> &liveCount;
+        std::atomic<bool> writerDone;
+        std::atomic<unsigned int> failed;
+        std::atomic<unsigned int> lookups;
+
+    };
+
+    static void snapshotHashSetTestWriter(void *pParameter)
+    {
+        SnapshotHashSetTestData *data = (SnapshotHashSetTestData *)pParameter;
+        std::vector<SnapshotHashSetTestSet::Object> batch;
+        std::vector<Hash> hashes;
+        Hash hash(32);
+
+        for(unsigned int round = 0; round < 100; ++round)
+        {
+            batch.clear();
+            hashes.clear();
+            for(unsigned int i = 0; i < 500; ++i)
+            {
+                hash.randomize();
+                hashes.push_back(hash);
+                batch.push_back(SnapshotHashSetTestSet::Object::make(hash, i, data->liveCount));
+            }
+
+            if(data->set.insert(batch) != 500 || data->set.remove(hashes) != 500)
+                ++data->failed;
+        }
+
+        data->writerDone = true;
+    }
+
+    static void snapshotHashSetTestReader(void *pParameter)
+    {
+        SnapshotHashSetTestData *data = (SnapshotHashSetTestData *)pParameter;
+        unsigned int lookups = 0;
+
+        while(!data->writerDone)
+        {
+            SnapshotHashSetTestSet::Reader reader(data->set);
+            for(std::vector<Hash>::iterator hash = data->permanent.begin();
+              hash != data->permanent.end(); ++hash, ++lookups)
+                if(!reader.contains(*hash))
+                    ++data->failed;
+        }
+
+        data->lookups += lookups;
+    }
+
+    bool testSnapshotHashSet()
+    {
+        Log::add(Log::INFO, NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME,
+          "------------- Starting Snapshot Hash Set Tests -------------");
+
+        bool success = true;
+        std::atomic<int> liveCount(0);
+
+        /******************************************************************************************
+         * Insert and remove
+         *****************************************************************************************/
+        bool writeSuccess = true;
+        std::vector<Hash> hashes;
+        Hash hash(32);
+        {
+            SnapshotHashSetTestSet set;
+            std::vector<SnapshotHashSetTestSet::Object> batch;
+
+            for(unsigned int i = 0; i < 2000; ++i)
+            {
+                hash.randomize();
+                hashes.push_back(hash);
+                SnapshotHashSetTestSet::Object object =
+                  SnapshotHashSetTestSet::Object::make(hash, i, liveCount);
+                if(i < 1000)
+                {
+                    if(!set.insert(object))
+                        writeSuccess = false;
+                }
+                else
+                    batch.push_back(object);
+            }
+
+            // Duplicates of existing and batch items are rejected.
+            batch.push_back(SnapshotHashSetTestSet::Object::make(hashes[5], 5000, liveCount));
+            SnapshotHashSetTestSet::Object duplicate =
+              SnapshotHashSetTestSet::Object::make(hashes[1500], 1500, liveCount);
+            if(set.insert(batch) != 1000 || batch.size() != 1 || set.insert(duplicate) ||
+              set.size() != 2000)
+                writeSuccess = false;
+            batch.clear();
+            duplicate.clear();
+
+            // A different value with the same hash is allowed when duplicate sorts are.
+            duplicate = SnapshotHashSetTestSet::Object::make(hashes[7], 7000, liveCount);
+            if(!set.insert(duplicate, true) || set.size() != 2001 || liveCount != 2001)
+                writeSuccess = false;
+            duplicate.clear();
+
+            {
+                SnapshotHashSetTestSet::Reader reader(set);
+                for(unsigned int i = 0; i < hashes.size(); ++i)
+                    if(!reader.contains(hashes[i]) || reader.get(hashes[i])->value != i)
+                        writeSuccess = false;
+
+                unsigned int count = 0;
+                reader.forEach([&count](SnapshotHashSetTestSet::Object &pObject) { ++count; });
+                if(count != 2001)
+                    writeSuccess = false;
+            }
+
+            std::vector<Hash> removeHashes(hashes.begin(), hashes.begin() + 1000);
+            if(!set.remove(hashes[7]) || set.remove(removeHashes) != 1000 ||
+              set.remove(hashes[0]) || set.size() != 1000)
+                writeSuccess = false;
+
+            {
+                SnapshotHashSetTestSet::Reader reader(set);
+                for(unsigned int i = 0; i < hashes.size(); ++i)
+                    if(reader.contains(hashes[i]) != (i >= 1000))
+                        writeSuccess = false;
+            }
+
+            if(set.retiredCount() != 0 || liveCount != 1000)
+                writeSuccess = false;
+
+            set.clear();
+            if(set.size() != 0 || liveCount != 0)
+                writeSuccess = false;
+        }
+
+        if(writeSuccess)
+            Log::add(Log::INFO, NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME, "Passed insert and remove");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME, "Failed insert and remove");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Snapshots
+         *****************************************************************************************/
+        bool snapshotSuccess = true;
+        {
+            SnapshotHashSetTestSet set;
+            std::vector<SnapshotHashSetTestSet::Object> batch;
+            for(unsigned int i = 0; i < hashes.size(); ++i)
+                batch.push_back(SnapshotHashSetTestSet::Object::make(hashes[i], i, liveCount));
+            set.insert(batch);
+
+            SnapshotHashSetTestSet::Reader *reader = new SnapshotHashSetTestSet::Reader(set);
+            unsigned int setOffset = SnapshotHashSetTestSet::setOffset(hashes[0]);
+            unsigned int beforeCount = 0;
+            reader->forEachInSet(setOffset,
+              [&beforeCount](SnapshotHashSetTestSet::Object &pObject) { ++beforeCount; });
+
+            // Removed while the reader is active, so the old version must stay.
+            SnapshotHashSetTestSet::Object removed = reader->get(hashes[0]);
+            if(!set.remove(hashes[0]) || set.retiredCount() != 1 || !removed)
+                snapshotSuccess = false;
+
+            unsigned int afterCount = 0;
+            reader->forEachInSet(setOffset,
+              [&afterCount](SnapshotHashSetTestSet::Object &pObject) { ++afterCount; });
+            if(afterCount != beforeCount || !reader->contains(hashes[0]))
+                snapshotSuccess = false;
+            delete reader;
+
+            // Returned reference outlives the reader and the version.
+            set.reclaim();
+            if(set.retiredCount() != 0 || removed->getHash() != hashes[0])
+                snapshotSuccess = false;
+
+            SnapshotHashSetTestSet::Reader newReader(set);
+            if(newReader.contains(hashes[0]))
+                snapshotSuccess = false;
+        }
+        if(liveCount != 0)
+            snapshotSuccess = false;
+
+        if(snapshotSuccess)
+            Log::add(Log::INFO, NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME, "Passed snapshots");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME, "Failed snapshots");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Readers with a concurrent writer
+         *****************************************************************************************/
+        bool threadSuccess = true;
+        {
+            SnapshotHashSetTestData threadData(hashes, liveCount);
+            std::vector<SnapshotHashSetTestSet::Object> batch;
+            for(unsigned int i = 0; i < hashes.size(); ++i)
+                batch.push_back(SnapshotHashSetTestSet::Object::make(hashes[i], i, liveCount));
+            threadData.set.insert(batch);
+
+            Timer timer(true);
+            std::vector<Thread *> threads;
+            threads.push_back(new Thread("SnapshotWriter", snapshotHashSetTestWriter,
+              &threadData));
+            for(unsigned int i = 0; i < 3; ++i)
+                threads.push_back(new Thread("SnapshotReader", snapshotHashSetTestReader,
+                  &threadData));
+            for(std::vector<Thread *>::iterator thread = threads.begin();
+              thread != threads.end(); ++thread)
+                delete *thread;
+            timer.stop();
+
+            threadData.set.reclaim();
+            Log::addFormatted(Log::INFO, NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME,
+              "%d lookups by 3 readers during 100 writer batches : %d us",
+              (int)threadData.lookups, (int)timer.microseconds());
+
+            if(threadData.failed != 0 || threadData.set.size() != hashes.size() ||
+              threadData.set.retiredCount() != 0 || liveCount != (int)hashes.size())
+                threadSuccess = false;
+        }
+        if(liveCount != 0)
+            threadSuccess = false;
+
+        if(threadSuccess)
+            Log::add(Log::INFO, NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME, "Passed concurrent readers");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME, "Failed concurrent readers");
+            success = false;
+        }
+
+        return success;
+    }
+}
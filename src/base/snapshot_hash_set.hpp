@@ -0,0 +1,554 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_SNAPSHOT_HASH_SET_HPP
+#define NEXTCASH_SNAPSHOT_HASH_SET_HPP
+
+#include "hash.hpp"
+#include "mutex.hpp"
+#include "reference_counter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define NEXTCASH_SNAPSHOT_HASH_SET_LOG_NAME "SnapshotHashSet"
+
+
+namespace NextCash
+{
+    // Same items as ReferenceHashSet, but readers never block and are never blocked by writers.
+    //
+    // Each of the 256 sets is an immutable sorted vector. Writers copy the sets they change and
+    //   publish the new versions with an atomic swap (read-copy-update). Readers enter a Reader
+    //   before looking at the set, which records the current epoch in a reader slot. Replaced
+    //   versions are deleted only when every reader that could still see them has left.
+    //
+    // Writes are serialized by a lock and copy a whole set, so batch writes should be used when
+    //   many items change at once, such as when a block is applied.
+    //
+    // tType must have the following functions defined.
+    //   bool valueEquals(tType &pRight);
+    //   int compare(tType &pRight); // Calls compare on hashes.
+    //   const Hash &getHash();
+    template <class tType>
+    class SnapshotHashSet
+    {
+    public:
+
+        typedef ReferenceCounter<tType> Object;
+        typedef std::vector<Object> Items;
+
+        static const unsigned int SET_COUNT = 0x0100;
+
+        // Maximum number of Readers at the same time. More Readers wait for a slot.
+        static const unsigned int MAX_READERS = 64;
+
+        SnapshotHashSet();
+        ~SnapshotHashSet();
+
+        // Doesn't lock. The value can be out of date as soon as it is returned.
+        unsigned int size() const { return mSize.load(std::memory_order_relaxed); }
+
+        // A consistent view of each set for as long as the Reader exists. Each set is seen as it
+        //   was when first accessed, so different sets can be from different points in time.
+        // A Reader should be short lived since it prevents replaced versions from being deleted.
+        //   It must be used only by the thread that created it.
+        class Reader
+        {
+        public:
+
+            Reader(SnapshotHashSet &pSet);
+            ~Reader();
+
+            bool contains(const Hash &pHash);
+
+            // Returns the first item matching the hash or an empty reference if not found.
+            // The returned reference remains valid after the Reader is destroyed.
+            Object get(const Hash &pHash);
+
+            // Calls pFunction(Object &) for each item in the set, in sorted order.
+            template <class tFunction>
+            void forEachInSet(unsigned int pSetOffset, tFunction pFunction);
+
+            // Calls pFunction(Object &) for each item.
+            template <class tFunction>
+            void forEach(tFunction pFunction)
+            {
+                for(unsigned int i = 0; i < SET_COUNT; ++i)
+                    forEachInSet(i, pFunction);
+            }
+
+        private:
+
+            // Version of the set seen by this Reader, loaded when first accessed.
+            Items &items(unsigned int pSetOffset)
+            {
+                if(mSnapshots[pSetOffset] == NULL)
+                    mSnapshots[pSetOffset] =
+                      mSet.mSets[pSetOffset].load(std::memory_order_seq_cst);
+                return *mSnapshots[pSetOffset];
+            }
+
+            SnapshotHashSet &mSet;
+            std::atomic<uint64_t> *mSlot;
+            Items *mSnapshots[SET_COUNT];
+
+            Reader(const Reader &pCopy);
+            Reader &operator = (const Reader &pRight);
+
+        };
+
+        // Write functions. Only one writer runs at a time.
+
+        // Returns true if the item was inserted.
+        // If pAllowDuplicateSorts is false then multiple objects with the same "sort" value will
+        //   not be inserted.
+        // Multiple objects that match according to "valueEquals" will never be inserted.
+        bool insert(Object &pObject, bool pAllowDuplicateSorts = false);
+
+        // Inserts the objects with the same rules as insert, copying each changed set once.
+        // pObjects is left containing the objects that were not inserted.
+        // Returns the number of objects inserted.
+        unsigned int insert(std::vector<Object> &pObjects, bool pAllowDuplicateSorts = false);
+
+        // Removes the first item matching the hash.
+        // Returns true if an item was removed.
+        bool remove(const Hash &pHash);
+
+        // Removes the first item matching each hash, copying each changed set once.
+        // Returns the number of items removed.
+        unsigned int remove(const std::vector<Hash> &pHashes);
+
+        void clear();
+
+        // Deletes replaced versions that no Reader can see. Writes do this automatically, but
+        //   versions replaced while Readers were active wait for the next write or this call.
+        void reclaim();
+
+        // Number of replaced versions waiting to be deleted.
+        unsigned int retiredCount();
+
+        static unsigned int setOffset(const Hash &pHash)
+        {
+            if(pHash.isEmpty())
+                return 0;
+            return pHash.getByte(pHash.size() - 1);
+        }
+
+    private:
+
+        class ReaderSlot
+        {
+        public:
+
+            ReaderSlot() : epoch(0) {}
+
+            // Epoch when the Reader using this slot started, or zero when not in use.
+            std::atomic<uint64_t> epoch;
+
+            // Keep each slot on its own cache line.
+            uint8_t padding[64 - sizeof(std::atomic<uint64_t>)];
+
+        };
+
+        class Retired
+        {
+        public:
+
+            Retired(uint64_t pEpoch, Items *pItems) : epoch(pEpoch), items(pItems) {}
+
+            uint64_t epoch;
+            Items *items;
+
+        };
+
+        std::atomic<Items *> mSets[SET_COUNT];
+        std::atomic<unsigned int> mSize;
+        std::atomic<uint64_t> mEpoch;
+        ReaderSlot mReaders[MAX_READERS];
+
+        MutexWithConstantName mWriteLock;
+        std::vector<Retired> mRetired; // Protected by mWriteLock
+
+        // Items are only read after they are published, but tType functions aren't const.
+        static tType &value(const Object &pObject)
+        {
+            return *const_cast<Object &>(pObject).pointer();
+        }
+
+        // Return the first item with a hash not less than pHash.
+        static typename Items::iterator lowerBound(Items &pItems, const Hash &pHash);
+
+        // Return true and set pPosition to where pObject belongs, after items with the same sort.
+        static bool insertPosition(Items &pItems, Object &pObject, bool pAllowDuplicateSorts,
+          typename Items::iterator &pPosition);
+
+        // Replace a set with a new version. mWriteLock must be locked.
+        void publish(unsigned int pSetOffset, Items *pItems);
+
+        // Delete replaced versions that no Reader can see. mWriteLock must be locked.
+        void reclaimLocked();
+
+        SnapshotHashSet(const SnapshotHashSet &pCopy);
+        SnapshotHashSet &operator = (const SnapshotHashSet &pRight);
+
+    };
+
+    template <class tType>
+    const unsigned int SnapshotHashSet<tType>::MAX_READERS;
+
+    template <class tType>
+    const unsigned int SnapshotHashSet<tType>::SET_COUNT;
+
+    template <class tType>
+    SnapshotHashSet<tType>::SnapshotHashSet() : mSize(0), mEpoch(1), mWriteLock("SnapshotHashSet")
+    {
+        for(unsigned int i = 0; i < SET_COUNT; ++i)
+            mSets[i].store(new Items(), std::memory_order_relaxed);
+    }
+
+    template <class tType>
+    SnapshotHashSet<tType>::~SnapshotHashSet()
+    {
+        for(unsigned int i = 0; i < SET_COUNT; ++i)
+            delete mSets[i].load(std::memory_order_relaxed);
+        for(typename std::vector<Retired>::iterator retired = mRetired.begin();
+          retired != mRetired.end(); ++retired)
+            delete retired->items;
+    }
+
+    template <class tType>
+    SnapshotHashSet<tType>::Reader::Reader(SnapshotHashSet &pSet) : mSet(pSet)
+    {
+        std::memset(mSnapshots, 0, sizeof(mSnapshots));
+        mSlot = NULL;
+        uint64_t expected;
+        while(true)
+        {
+            for(unsigned int i = 0; i < MAX_READERS; ++i)
+            {
+                expected = 0;
+                if(pSet.mReaders[i].epoch.load(std::memory_order_relaxed) == 0 &&
+                  pSet.mReaders[i].epoch.compare_exchange_strong(expected,
+                  pSet.mEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst))
+                {
+                    mSlot = &pSet.mReaders[i].epoch;
+                    return;
+                }
+            }
+
+            std::this_thread::yield(); // All slots are in use
+        }
+    }
+
+    template <class tType>
+    SnapshotHashSet<tType>::Reader::~Reader()
+    {
+        mSlot->store(0, std::memory_order_release);
+    }
+
+    template <class tType>
+    bool SnapshotHashSet<tType>::Reader::contains(const Hash &pHash)
+    {
+        Items &setItems = items(setOffset(pHash));
+        typename Items::iterator item = lowerBound(setItems, pHash);
+        return item != setItems.end() && (*item)->getHash() == pHash;
+    }
+
+    template <class tType>
+    typename SnapshotHashSet<tType>::Object SnapshotHashSet<tType>::Reader::get(const Hash &pHash)
+    {
+        Items &setItems = items(setOffset(pHash));
+        typename Items::iterator item = lowerBound(setItems, pHash);
+        if(item != setItems.end() && (*item)->getHash() == pHash)
+            return *item;
+        return Object();
+    }
+
+    template <class tType>
+    template <class tFunction>
+    void SnapshotHashSet<tType>::Reader::forEachInSet(unsigned int pSetOffset,
+      tFunction pFunction)
+    {
+        Items &setItems = items(pSetOffset);
+        for(typename Items::iterator item = setItems.begin(); item != setItems.end(); ++item)
+            pFunction(*item);
+    }
+
+    template <class tType>
+    typename SnapshotHashSet<tType>::Items::iterator
+      SnapshotHashSet<tType>::lowerBound(Items &pItems, const Hash &pHash)
+    {
+        return std::lower_bound(pItems.begin(), pItems.end(), pHash,
+          [](const Object &pItem, const Hash &pValue)
+          { return value(pItem).getHash().compare(pValue) < 0; });
+    }
+
+    template <class tType>
+    bool SnapshotHashSet<tType>::insertPosition(Items &pItems, Object &pObject,
+      bool pAllowDuplicateSorts, typename Items::iterator &pPosition)
+    {
+        pPosition = std::upper_bound(pItems.begin(), pItems.end(), pObject,
+          [](const Object &pValue, const Object &pItem)
+          { return value(pValue).compare(value(pItem)) < 0; });
+
+        // Check items with the same sort.
+        for(typename Items::iterator item = pPosition; item != pItems.begin();)
+        {
+            --item;
+            if(pObject->compare(**item) != 0)
+                break;
+            if(!pAllowDuplicateSorts || pObject->valueEquals(**item))
+                return false;
+        }
+
+        return true;
+    }
+
+    template <class tType>
+    void SnapshotHashSet<tType>::publish(unsigned int pSetOffset, Items *pItems)
+    {
+        Items *previous = mSets[pSetOffset].exchange(pItems, std::memory_order_seq_cst);
+
+        // Readers that started at or before this epoch could still be using the previous
+        //   version.
+        mRetired.emplace_back(mEpoch.fetch_add(1, std::memory_order_seq_cst), previous);
+    }
+
+    template <class tType>
+    void SnapshotHashSet<tType>::reclaimLocked()
+    {
+        if(mRetired.size() == 0)
+            return;
+
+        uint64_t oldestReader = 0xffffffffffffffffULL, epoch;
+        for(unsigned int i = 0; i < MAX_READERS; ++i)
+        {
+            epoch = mReaders[i].epoch.load(std::memory_order_seq_cst);
+            if(epoch != 0 && epoch < oldestReader)
+                oldestReader = epoch;
+        }
+
+        typename std::vector<Retired>::iterator keep = mRetired.begin();
+        for(typename std::vector<Retired>::iterator retired = mRetired.begin();
+          retired != mRetired.end(); ++retired)
+        {
+            if(retired->epoch < oldestReader)
+                delete retired->items;
+            else
+                *keep++ = *retired;
+        }
+        mRetired.erase(keep, mRetired.end());
+    }
+
+    template <class tType>
+    void SnapshotHashSet<tType>::reclaim()
+    {
+        mWriteLock.lock();
+        reclaimLocked();
+        mWriteLock.unlock();
+    }
+
+    template <class tType>
+    unsigned int SnapshotHashSet<tType>::retiredCount()
+    {
+        mWriteLock.lock();
+        unsigned int result = mRetired.size();
+        mWriteLock.unlock();
+        return result;
+    }
+
+    template <class tType>
+    bool SnapshotHashSet<tType>::insert(Object &pObject, bool pAllowDuplicateSorts)
+    {
+        unsigned int offset = setOffset(pObject->getHash());
+        typename Items::iterator position;
+
+        mWriteLock.lock();
+        Items &items = *mSets[offset].load(std::memory_order_relaxed);
+        if(!insertPosition(items, pObject, pAllowDuplicateSorts, position))
+        {
+            mWriteLock.unlock();
+            return false;
+        }
+
+        Items *newItems = new Items();
+        newItems->reserve(items.size() + 1);
+        newItems->insert(newItems->end(), items.begin(), position);
+        newItems->push_back(pObject);
+        newItems->insert(newItems->end(), position, items.end());
+
+        publish(offset, newItems);
+        mSize.fetch_add(1, std::memory_order_relaxed);
+        reclaimLocked();
+        mWriteLock.unlock();
+        return true;
+    }
+
+    template <class tType>
+    unsigned int SnapshotHashSet<tType>::insert(std::vector<Object> &pObjects,
+      bool pAllowDuplicateSorts)
+    {
+        std::vector<Object> batches[SET_COUNT];
+        for(typename std::vector<Object>::iterator object = pObjects.begin();
+          object != pObjects.end(); ++object)
+            batches[setOffset((*object)->getHash())].push_back(*object);
+        pObjects.clear();
+
+        unsigned int result = 0;
+        typename Items::iterator item, position;
+        mWriteLock.lock();
+        for(unsigned int i = 0; i < SET_COUNT; ++i)
+        {
+            std::vector<Object> &batch = batches[i];
+            if(batch.size() == 0)
+                continue;
+
+            // Sort the batch, then merge it with the current version into a new version.
+            std::stable_sort(batch.begin(), batch.end(),
+              [](const Object &pLeft, const Object &pRight)
+              { return value(pLeft).compare(value(pRight)) < 0; });
+
+            Items &items = *mSets[i].load(std::memory_order_relaxed);
+            Items *newItems = new Items();
+            newItems->reserve(items.size() + batch.size());
+            item = items.begin();
+            for(typename std::vector<Object>::iterator object = batch.begin();
+              object != batch.end(); ++object)
+            {
+                position = std::upper_bound(item, items.end(), *object,
+                  [](const Object &pValue, const Object &pItem)
+                  { return value(pValue).compare(value(pItem)) < 0; });
+                newItems->insert(newItems->end(), item, position);
+                item = position;
+
+                if(insertPosition(*newItems, *object, pAllowDuplicateSorts, position))
+                {
+                    newItems->push_back(*object);
+                    ++result;
+                }
+                else
+                    pObjects.push_back(*object);
+            }
+            newItems->insert(newItems->end(), item, items.end());
+
+            if(newItems->size() == items.size())
+                delete newItems; // Nothing inserted
+            else
+                publish(i, newItems);
+        }
+
+        mSize.fetch_add(result, std::memory_order_relaxed);
+        reclaimLocked();
+        mWriteLock.unlock();
+        return result;
+    }
+
+    template <class tType>
+    bool SnapshotHashSet<tType>::remove(const Hash &pHash)
+    {
+        unsigned int offset = setOffset(pHash);
+
+        mWriteLock.lock();
+        Items &items = *mSets[offset].load(std::memory_order_relaxed);
+        typename Items::iterator item = lowerBound(items, pHash);
+        if(item == items.end() || (*item)->getHash() != pHash)
+        {
+            mWriteLock.unlock();
+            return false;
+        }
+
+        Items *newItems = new Items();
+        newItems->reserve(items.size() - 1);
+        newItems->insert(newItems->end(), items.begin(), item);
+        newItems->insert(newItems->end(), item + 1, items.end());
+
+        publish(offset, newItems);
+        mSize.fetch_sub(1, std::memory_order_relaxed);
+        reclaimLocked();
+        mWriteLock.unlock();
+        return true;
+    }
+
+    template <class tType>
+    unsigned int SnapshotHashSet<tType>::remove(const std::vector<Hash> &pHashes)
+    {
+        std::vector<Hash> batches[SET_COUNT];
+        for(std::vector<Hash>::const_iterator hash = pHashes.begin(); hash != pHashes.end();
+          ++hash)
+            batches[setOffset(*hash)].push_back(*hash);
+
+        unsigned int result = 0;
+        typename Items::iterator item, position;
+        mWriteLock.lock();
+        for(unsigned int i = 0; i < SET_COUNT; ++i)
+        {
+            std::vector<Hash> &batch = batches[i];
+            if(batch.size() == 0)
+                continue;
+
+            std::sort(batch.begin(), batch.end());
+
+            Items &items = *mSets[i].load(std::memory_order_relaxed);
+            Items *newItems = new Items();
+            newItems->reserve(items.size());
+            item = items.begin();
+            for(std::vector<Hash>::iterator hash = batch.begin(); hash != batch.end(); ++hash)
+            {
+                position = std::lower_bound(item, items.end(), *hash,
+                  [](const Object &pItem, const Hash &pValue)
+                  { return value(pItem).getHash().compare(pValue) < 0; });
+                newItems->insert(newItems->end(), item, position);
+                item = position;
+
+                // Each hash removes one item.
+                if(item != items.end() && (*item)->getHash() == *hash)
+                {
+                    ++item;
+                    ++result;
+                }
+            }
+            newItems->insert(newItems->end(), item, items.end());
+
+            if(newItems->size() == items.size())
+                delete newItems; // Nothing removed
+            else
+                publish(i, newItems);
+        }
+
+        mSize.fetch_sub(result, std::memory_order_relaxed);
+        reclaimLocked();
+        mWriteLock.unlock();
+        return result;
+    }
+
+    template <class tType>
+    void SnapshotHashSet<tType>::clear()
+    {
+        unsigned int removed = 0;
+        mWriteLock.lock();
+        for(unsigned int i = 0; i < SET_COUNT; ++i)
+        {
+            Items &items = *mSets[i].load(std::memory_order_relaxed);
+            if(items.size() > 0)
+            {
+                removed += items.size();
+                publish(i, new Items());
+            }
+        }
+        mSize.fetch_sub(removed, std::memory_order_relaxed);
+        reclaimLocked();
+        mWriteLock.unlock();
+    }
+
+    bool testSnapshotHashSet();
+}
+
+#endif
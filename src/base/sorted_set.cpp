@@ -10,6 +10,9 @@
 #include "log.hpp"
 #include "digest.hpp"
 #include "hash.hpp"
+#include "math.hpp"
+
+#include <algorithm>
 
 #ifdef PROFILER_ON
 #include "profiler.hpp"
@@ -114,6 +117,165 @@ namespace NextCash
         mItems.clear();
     }
 
+    static bool sortedObjectLess(SortedObject *pLeft, SortedObject *pRight)
+    {
+        return pLeft->compare(pRight) < 0;
+    }
+
+    static bool sortedItemLess(SortedObject *pItem, SortedObject *pMatching)
+    {
+        return pMatching->compare(pItem) > 0;
+    }
+
+    unsigned int SortedSet::mergeSorted(std::vector<SortedObject *> &pSorted,
+      bool pAllowDuplicateSorts, std::vector<SortedObject *> &pRejected)
+    {
+        if(pSorted.size() == 0)
+            return 0;
+
+        std::vector<SortedObject *> result;
+        result.reserve(mItems.size() + pSorted.size());
+
+        Iterator item = mItems.begin(), position;
+        std::vector<SortedObject *>::iterator runItem;
+        unsigned int inserted = 0;
+        bool valid;
+
+        for(Iterator object = pSorted.begin(); object != pSorted.end(); ++object)
+        {
+            // Binary search the remaining items and copy everything before and with the same
+            //   sort as the object, since new objects go after existing matches. Compares are
+            //   virtual, so this is much faster than comparing each item when the batch is
+            //   smaller than the set.
+            position = std::upper_bound(item, mItems.end(), *object, sortedObjectLess);
+            result.insert(result.end(), item, position);
+            item = position;
+
+            // Check items with the same sort, including objects inserted from this batch.
+            valid = true;
+            for(runItem = result.end(); runItem != result.begin();)
+            {
+                --runItem;
+                if((*object)->compare(*runItem) != 0)
+                    break;
+                if(!pAllowDuplicateSorts || (*object)->valueEquals(*runItem))
+                {
+                    valid = false;
+                    break;
+                }
+            }
+
+            if(valid)
+            {
+                result.push_back(*object);
+                ++inserted;
+            }
+            else
+                pRejected.push_back(*object);
+        }
+
+        result.insert(result.end(), item, mItems.end());
+        mItems.swap(result);
+        return inserted;
+    }
+
+    unsigned int SortedSet::insert(std::vector<SortedObject *> &pObjects,
+      bool pAllowDuplicateSorts)
+    {
+        // Stable so objects with the same sort are inserted in the order given, the same as
+        //   inserting them one at a time.
+        std::stable_sort(pObjects.begin(), pObjects.end(), sortedObjectLess);
+
+        std::vector<SortedObject *> rejected;
+        unsigned int result = mergeSorted(pObjects, pAllowDuplicateSorts, rejected);
+        pObjects.swap(rejected);
+        return result;
+    }
+
+    unsigned int SortedSet::remove(std::vector<SortedObject *> &pMatching)
+    {
+        if(pMatching.size() == 0 || mItems.size() == 0)
+            return 0;
+
+        std::sort(pMatching.begin(), pMatching.end(), sortedObjectLess);
+
+        Iterator item = mItems.begin(), keep = mItems.begin(), position;
+
+        for(std::vector<SortedObject *>::iterator matching = pMatching.begin();
+          matching != pMatching.end() && item != mItems.end(); ++matching)
+        {
+            position = std::lower_bound(item, mItems.end(), *matching, sortedItemLess);
+            keep = std::copy(item, position, keep);
+            item = position;
+
+            // Each matching object removes one item.
+            if(item != mItems.end() && (*matching)->compare(*item) == 0)
+            {
+                delete *item;
+                ++item;
+            }
+        }
+
+        keep = std::copy(item, mItems.end(), keep);
+        unsigned int result = mItems.end() - keep;
+        mItems.erase(keep, mItems.end());
+        return result;
+    }
+
+    unsigned int SortedSet::merge(SortedSet &pOther, bool pAllowDuplicateSorts)
+    {
+        std::vector<SortedObject *> rejected;
+        unsigned int result = mergeSorted(pOther.mItems, pAllowDuplicateSorts, rejected);
+        pOther.mItems.swap(rejected);
+        return result;
+    }
+
+    unsigned int SortedSet::intersect(SortedSet &pOther)
+    {
+        Iterator other = pOther.mItems.begin();
+        Iterator keep = mItems.begin();
+        int compare;
+
+        for(Iterator item = mItems.begin(); item != mItems.end(); ++item)
+        {
+            compare = 1;
+            while(other != pOther.mItems.end() && (compare = (*item)->compare(*other)) > 0)
+                ++other;
+
+            if(compare == 0)
+                *keep++ = *item;
+            else
+                delete *item;
+        }
+
+        unsigned int result = mItems.end() - keep;
+        mItems.erase(keep, mItems.end());
+        return result;
+    }
+
+    unsigned int SortedSet::subtract(SortedSet &pOther)
+    {
+        Iterator other = pOther.mItems.begin();
+        Iterator keep = mItems.begin();
+        int compare;
+
+        for(Iterator item = mItems.begin(); item != mItems.end(); ++item)
+        {
+            compare = 1;
+            while(other != pOther.mItems.end() && (compare = (*item)->compare(*other)) > 0)
+                ++other;
+
+            if(compare == 0)
+                delete *item;
+            else
+                *keep++ = *item;
+        }
+
+        unsigned int result = mItems.end() - keep;
+        mItems.erase(keep, mItems.end());
+        return result;
+    }
+
     SortedSet::Iterator SortedSet::moveForward(Iterator pIterator, SortedObject &pMatching,
       uint8_t &pFlags)
     {
@@ -244,12 +406,30 @@ namespace NextCash
 
         Iterator bottom = mItems.begin();
         Iterator top    = --mItems.end();
-        Iterator current;
+        Iterator current, guard = mItems.end();
+        uint64_t value, bottomValue, topValue, guardDistance;
+        bool uniform = pMatching.sortValue(value);
+        bool bottomValid = uniform && (*bottom)->sortValue(bottomValue);
+        bool topValid = uniform && (*top)->sortValue(topValue);
+        bool interpolate = uniform, interpolated = false;
+        unsigned int range = 0;
 
         while(true)
         {
-            // Break the set in two halves
-            current = bottom + ((top - bottom) / 2);
+            // Estimate the position when sorts are uniformly distributed. Use the middle if the
+            //   last estimate didn't at least halve the range so badly distributed values are
+            //   still O(log n).
+            if(guard != mItems.end())
+                current = guard;
+            else
+            {
+                range = top - bottom;
+                interpolated = interpolate && range > 1 && bottomValid && topValid;
+                if(interpolated)
+                    current = bottom + Math::interpolate(0, range, bottomValue, topValue, value);
+                else
+                    current = bottom + (range / 2); // Break the set in two halves
+            }
             compare = pMatching.compare((*current));
 
             if(compare == 0) // Matching item found
@@ -269,11 +449,38 @@ namespace NextCash
                     return mItems.end();
             }
 
-            // Determine which half contains the desired item
+            // Determine which part contains the desired item. Only reload the sort value of the
+            //   end that moved.
             if(compare > 0)
+            {
                 bottom = current;
+                if(uniform)
+                    bottomValid = (*bottom)->sortValue(bottomValue);
+            }
             else //if(compare < 0)
+            {
                 top = current;
+                if(uniform)
+                    topValid = (*top)->sortValue(topValue);
+            }
+
+            if(guard == mItems.end() && interpolated)
+            {
+                // The estimate is usually close, but leaves most of the range on the other side
+                //   of the item, so check a little past it.
+                guardDistance = Math::interpolateGuard(range);
+                if(compare > 0 && guardDistance > 0 &&
+                  guardDistance < (uint64_t)(top - current))
+                    guard = current + guardDistance;
+                else if(compare < 0 && guardDistance > 0 &&
+                  guardDistance < (uint64_t)(current - bottom))
+                    guard = current - guardDistance;
+            }
+            else
+            {
+                guard = mItems.end();
+                interpolate = uniform && (unsigned int)(top - bottom) * 2 <= range;
+            }
         }
     }
 
@@ -550,6 +757,115 @@ namespace NextCash
             Log::add(Log::INFO, NEXTCASH_SORTED_SET_LOG_NAME,
               "Passed sorted string list middle twice(2)");
 
+        /***********************************************************************************************
+         * Batch insert and remove
+         ***********************************************************************************************/
+        SortedSet batchSet;
+        std::vector<SortedObject *> batch;
+        String text;
+
+        // Even numbers one at a time, then odd numbers and a duplicate as a batch.
+        for(unsigned int i = 0; i < 200; i += 2)
+        {
+            text.writeFormatted("item%04d", i);
+            batchSet.insert(new SortedString(text));
+        }
+        for(unsigned int i = 199; i < 200; i -= 2)
+        {
+            text.writeFormatted("item%04d", i);
+            batch.push_back(new SortedString(text));
+        }
+        batch.push_back(new SortedString("item0010"));
+
+        bool batchSuccess = batchSet.insert(batch) == 100 && batch.size() == 1 &&
+          ((SortedString *)batch.front())->getString() == "item0010" && batchSet.size() == 200;
+        delete batch.front();
+
+        unsigned int index = 0;
+        for(Iterator batchItem = batchSet.begin(); batchItem != batchSet.end();
+          ++batchItem, ++index)
+        {
+            text.writeFormatted("item%04d", index);
+            if(((SortedString *)*batchItem)->getString() != text)
+                batchSuccess = false;
+        }
+
+        // Remove every third item.
+        batch.clear();
+        for(unsigned int i = 0; i < 200; i += 3)
+        {
+            text.writeFormatted("item%04d", i);
+            batch.push_back(new SortedString(text));
+        }
+        batch.push_back(new SortedString("missing"));
+        if(batchSet.remove(batch) != 67 || batchSet.size() != 133)
+            batchSuccess = false;
+        for(std::vector<SortedObject *>::iterator object = batch.begin(); object != batch.end();
+          ++object)
+        {
+            if(batchSet.contains(**object))
+                batchSuccess = false;
+            delete *object;
+        }
+
+        if(batchSuccess)
+            Log::add(Log::INFO, NEXTCASH_SORTED_SET_LOG_NAME, "Passed batch insert and remove");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_SORTED_SET_LOG_NAME, "Failed batch insert and remove");
+            success = false;
+        }
+
+        /***********************************************************************************************
+         * Set algebra
+         ***********************************************************************************************/
+        SortedSet leftSet, rightSet, otherSet;
+        SortedString lookupString;
+
+        // Left has 0-99, right has 50-149.
+        for(unsigned int i = 0; i < 150; ++i)
+        {
+            text.writeFormatted("item%04d", i);
+            if(i < 100)
+                leftSet.insert(new SortedString(text));
+            if(i >= 50)
+                rightSet.insert(new SortedString(text));
+            if(i >= 50 && i < 100)
+                otherSet.insert(new SortedString(text));
+        }
+
+        // Left becomes 0-49.
+        bool algebraSuccess = leftSet.subtract(rightSet) == 50 && leftSet.size() == 50;
+
+        // Right becomes 50-99 by intersecting with a copy of the overlap.
+        if(rightSet.intersect(otherSet) != 50 || rightSet.size() != 50)
+            algebraSuccess = false;
+
+        // Union moves everything except the duplicates of right from other.
+        if(leftSet.merge(rightSet) != 50 || rightSet.size() != 0 || leftSet.size() != 100 ||
+          leftSet.merge(otherSet) != 0 || otherSet.size() != 50)
+            algebraSuccess = false;
+
+        index = 0;
+        for(Iterator algebraItem = leftSet.begin(); algebraItem != leftSet.end();
+          ++algebraItem, ++index)
+        {
+            text.writeFormatted("item%04d", index);
+            if(((SortedString *)*algebraItem)->getString() != text)
+                algebraSuccess = false;
+        }
+        lookupString.setString("item0120");
+        if(index != 100 || leftSet.contains(lookupString))
+            algebraSuccess = false;
+
+        if(algebraSuccess)
+            Log::add(Log::INFO, NEXTCASH_SORTED_SET_LOG_NAME, "Passed set algebra");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_SORTED_SET_LOG_NAME, "Failed set algebra");
+            success = false;
+        }
+
         return success;
     }
 }
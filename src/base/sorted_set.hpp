@@ -33,6 +33,11 @@ namespace NextCash
         //   (i.e. compare can return 0 while == returns false and the object can be inserted)
         virtual bool valueEquals(const SortedObject *pRight) const { return false; }
 
+        // Returns true and sets pValue if "sorts" are uniformly distributed, like hashes, so
+        //   searches can estimate positions instead of always splitting in half.
+        // pValue must never decrease as the "sort" increases.
+        virtual bool sortValue(uint64_t &pValue) { return false; }
+
     };
 
     class SortedSet
@@ -69,6 +74,42 @@ namespace NextCash
         // Returns item and doesn't delete it.
         SortedObject *getAndRemove(SortedObject &pMatching);
 
+        // Batch versions of insert and remove. The batch is sorted once, then merged with the
+        //   set in one pass instead of a binary search and vector shift for each object.
+
+        // Inserts the objects with the same rules as insert.
+        // pObjects is left containing the objects that were not inserted, which are still owned
+        //   by the caller.
+        // Returns the number of objects inserted.
+        unsigned int insert(std::vector<SortedObject *> &pObjects,
+          bool pAllowDuplicateSorts = false);
+
+        // Removes and deletes the first item with matching "sort" value for each object in
+        //   pMatching. pMatching is sorted.
+        // Returns the number of items removed.
+        unsigned int remove(std::vector<SortedObject *> &pMatching);
+
+        // Set algebra by merging two sorted sets in one pass.
+
+        // Moves the items from pOther into this set with the same rules as insert.
+        // Items that are not inserted are left in pOther.
+        // Returns the number of items moved.
+        unsigned int merge(SortedSet &pOther, bool pAllowDuplicateSorts = false);
+
+        // Deletes items that don't have a matching "sort" value in pOther.
+        // Returns the number of items removed.
+        unsigned int intersect(SortedSet &pOther);
+
+        // Deletes items that have a matching "sort" value in pOther.
+        // Returns the number of items removed.
+        unsigned int subtract(SortedSet &pOther);
+
+        // Removes and deletes items for which pPredicate(SortedObject *) returns true, in one
+        //   pass.
+        // Returns the number of items removed.
+        template <class tPredicate>
+        unsigned int removeIf(tPredicate pPredicate);
+
         void clear();
         void clearNoDelete(); // Doesn't delete items.
 
@@ -123,10 +164,32 @@ namespace NextCash
         void searchBackward(Iterator pIterator, SortedObject &pMatching, uint8_t &pFlags);
         void searchForward(Iterator pIterator, SortedObject &pMatching, uint8_t &pFlags);
 
+        // Merges pSorted, which must already be sorted, into the set.
+        // Objects that are not inserted are appended to pRejected.
+        unsigned int mergeSorted(std::vector<SortedObject *> &pSorted, bool pAllowDuplicateSorts,
+          std::vector<SortedObject *> &pRejected);
+
         SortedSet(const SortedSet &pCopy);
         SortedSet &operator = (const SortedSet &pRight);
 
     };
+
+    template <class tPredicate>
+    unsigned int SortedSet::removeIf(tPredicate pPredicate)
+    {
+        Iterator keep = mItems.begin();
+        for(Iterator item = mItems.begin(); item != mItems.end(); ++item)
+        {
+            if(pPredicate(*item))
+                delete *item;
+            else
+                *keep++ = *item;
+        }
+
+        unsigned int result = mItems.end() - keep;
+        mItems.erase(keep, mItems.end());
+        return result;
+    }
 }
 
 #endif
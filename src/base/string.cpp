@@ -935,6 +935,56 @@ namespace NextCash
         else
             result = false;
 
+        /******************************************************************************************
+         * Move constructor and assignment transfer memory without allocating
+         ******************************************************************************************/
+        String moveSource("move value");
+        const char *moveData = moveSource.mData;
+        String moveConstructed(std::move(moveSource));
+        if(moveConstructed.mData == moveData && moveSource.mData == NULL &&
+          moveConstructed == "move value")
+            Log::add(Log::INFO, NEXTCASH_STRING_LOG_NAME, "Passed move constructor");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_STRING_LOG_NAME, "Failed move constructor");
+            result = false;
+        }
+
+        String moveAssigned("old value");
+        moveAssigned = std::move(moveConstructed);
+        if(moveAssigned.mData == moveData && moveConstructed.mData == NULL &&
+          moveAssigned == "move value")
+            Log::add(Log::INFO, NEXTCASH_STRING_LOG_NAME, "Passed move assign");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_STRING_LOG_NAME, "Failed move assign");
+            result = false;
+        }
+
+        std::vector<String> moveStrings;
+        std::vector<const char *> moveAddresses;
+        for(unsigned int i = 0; i < 16; ++i)
+        {
+            moveStrings.emplace_back();
+            moveStrings.back().writeFormatted("String %d", i);
+            moveAddresses.push_back(moveStrings.back().text());
+        }
+        moveStrings.reserve(moveStrings.capacity() * 4); // Force reallocation
+
+        bool moveReallocateSuccess = true;
+        for(unsigned int i = 0; i < moveStrings.size(); ++i)
+            if(moveStrings[i].text() != moveAddresses[i])
+                moveReallocateSuccess = false;
+
+        if(moveReallocateSuccess)
+            Log::add(Log::INFO, NEXTCASH_STRING_LOG_NAME, "Passed vector reallocate moves");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_STRING_LOG_NAME,
+              "Failed vector reallocate moves : strings were copied");
+            result = false;
+        }
+
         return result;
     }
 
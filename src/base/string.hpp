@@ -12,6 +12,7 @@
 
 #include <cstring>
 #include <cstdarg>
+#include <utility>
 
 #define NEXTCASH_STRING_LOG_NAME "String"
 
@@ -39,6 +40,12 @@ namespace NextCash
             mData = NULL;
             *this = pText; // Call = operator
         }
+        // Take the memory of pValue without allocating. pValue is left empty.
+        String(String &&pValue) noexcept
+        {
+            mData = pValue.mData;
+            pValue.mData = NULL;
+        }
         ~String()
         {
             if(mData != NULL)
@@ -204,6 +211,16 @@ namespace NextCash
          ******************************************************************************************/
         String &operator = (const char *pRight);
         String &operator = (const String &pRight);
+        String &operator = (String &&pRight) noexcept
+        {
+            if(this != &pRight)
+            {
+                clear();
+                mData = pRight.mData;
+                pRight.mData = NULL;
+            }
+            return *this;
+        }
 
         void operator += (const char *pRight);
         void operator += (const String &pRight) { *this += pRight.text(); }
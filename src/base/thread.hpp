@@ -10,9 +10,11 @@
 
 #include "string.hpp"
 
+#include <atomic>
 #include <thread>
 #include <map>
 #include <mutex>
+#include <vector>
 
 
 namespace NextCash
@@ -100,6 +102,61 @@ namespace NextCash
         static std::map<ID, Data *> sThreads;
 
     };
+
+    template <class tFunction>
+    class ParallelForData
+    {
+    public:
+
+        ParallelForData(unsigned int pCount, tFunction &pFunction) :
+          count(pCount), function(pFunction), next(0) {}
+
+        // Calls the function with the next index until all indices are taken.
+        static void run(void *pParameter)
+        {
+            ParallelForData *data = (ParallelForData *)pParameter;
+            unsigned int index;
+            while((index = data->next.fetch_add(1)) < data->count)
+                data->function(index);
+        }
+
+        unsigned int count;
+        tFunction &function;
+        std::atomic<unsigned int> next;
+
+    };
+
+    // Calls pFunction(unsigned int pIndex) for each index from zero to pCount - 1, using
+    //   pThreadCount threads including the calling thread. Threads take the next index as they
+    //   finish one, so uneven work is spread out. Returns when all indices are done.
+    // When pThreadCount is zero the number of hardware threads is used.
+    template <class tFunction>
+    void parallelFor(const char *pName, unsigned int pCount, tFunction pFunction,
+      unsigned int pThreadCount = 0)
+    {
+        if(pThreadCount == 0)
+            pThreadCount = std::thread::hardware_concurrency();
+        if(pThreadCount > pCount)
+            pThreadCount = pCount;
+
+        ParallelForData<tFunction> data(pCount, pFunction);
+        if(pThreadCount <= 1)
+        {
+            ParallelForData<tFunction>::run(&data);
+            return;
+        }
+
+        std::vector<Thread *> threads;
+        for(unsigned int i = 1; i < pThreadCount; ++i)
+            threads.push_back(new Thread(pName, ParallelForData<tFunction>::run, &data));
+
+        ParallelForData<tFunction>::run(&data);
+
+        // Thread destructor waits for the thread to finish.
+        for(typename std::vector<Thread *>::iterator thread = threads.begin();
+          thread != threads.end(); ++thread)
+            delete *thread;
+    }
 }
 
 #endif
@@ -0,0 +1,203 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "tiered_vector.hpp"
+
+#include "distributed_vector.hpp"
+#include "log.hpp"
+#include "math.hpp"
+#include "string.hpp"
+#include "timer.hpp"
+
+
+namespace NextCash
+{
+    // Return true if the vector contains exactly the items in pCheck.
+    static bool tieredVectorMatches(TieredVector<unsigned int> &pVector,
+      std::vector<unsigned int> &pCheck)
+    {
+        if(pVector.size() != pCheck.size())
+            return false;
+
+        std::vector<unsigned int>::iterator check = pCheck.begin();
+        for(TieredVector<unsigned int>::Iterator item = pVector.begin(); item != pVector.end();
+          ++item, ++check)
+            if(check == pCheck.end() || *item != *check)
+                return false;
+        return check == pCheck.end();
+    }
+
+    // Insert pCount items at random positions and return the number of microseconds it took.
+    template <class tVector>
+    static unsigned int tieredVectorInsertTime(tVector &pVector, unsigned int pCount,
+      bool pFront)
+    {
+        Timer timer(true);
+        for(unsigned int i = 0; i < pCount; ++i)
+        {
+            if(pFront)
+                pVector.insert(pVector.begin(), i);
+            else
+                pVector.insert(pVector.begin() + Math::randomInt(pVector.size() + 1), i);
+        }
+        timer.stop();
+        return (unsigned int)timer.microseconds();
+    }
+
+    bool testTieredVector()
+    {
+        Log::add(Log::INFO, NEXTCASH_TIERED_VECTOR_LOG_NAME,
+          "------------- Starting Tiered Vector Tests -------------");
+
+        bool success = true;
+
+        /******************************************************************************************
+         * Random inserts and erases
+         *****************************************************************************************/
+        TieredVector<unsigned int> vector;
+        std::vector<unsigned int> check;
+        unsigned int position;
+
+        for(unsigned int i = 0; i < 100000; ++i)
+        {
+            if(check.size() > 0 && Math::randomInt() % 4 == 0)
+            {
+                position = Math::randomInt() % check.size();
+                vector.erase(vector.begin() + position);
+                check.erase(check.begin() + position);
+            }
+            else
+            {
+                position = Math::randomInt() % (check.size() + 1);
+                if(*vector.insert(vector.begin() + position, i) != i)
+                    success = false;
+                check.insert(check.begin() + position, i);
+            }
+        }
+
+        bool randomSuccess = success && tieredVectorMatches(vector, check) &&
+          vector.blockCount() > 1;
+        for(unsigned int i = 0; randomSuccess && i < 1000; ++i)
+        {
+            position = Math::randomInt() % check.size();
+            if(vector[position] != check[position] ||
+              *(vector.end() - (check.size() - position)) != check[position])
+                randomSuccess = false;
+        }
+
+        // Blocks stay near the target size.
+        for(unsigned int i = 0; i < vector.blockCount(); ++i)
+            if(vector.block(i).size() == 0 || vector.block(i).size() > vector.targetBlockSize() * 2)
+                randomSuccess = false;
+
+        if(randomSuccess)
+            Log::addFormatted(Log::INFO, NEXTCASH_TIERED_VECTOR_LOG_NAME,
+              "Passed random inserts and erases (%d items in %d blocks)", vector.size(),
+              vector.blockCount());
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_TIERED_VECTOR_LOG_NAME,
+              "Failed random inserts and erases");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Erase everything
+         *****************************************************************************************/
+        bool eraseSuccess = true;
+        TieredVector<unsigned int>::Iterator item = vector.begin();
+        std::vector<unsigned int>::iterator checkItem = check.begin();
+        while(item != vector.end())
+        {
+            // Erase every other item while iterating.
+            if(*item % 2 == 0)
+            {
+                item = vector.erase(item);
+                checkItem = check.erase(checkItem);
+            }
+            else
+            {
+                ++item;
+                ++checkItem;
+            }
+        }
+        if(!tieredVectorMatches(vector, check))
+            eraseSuccess = false;
+
+        while(vector.size() > 0)
+        {
+            position = Math::randomInt() % check.size();
+            vector.erase(vector.begin() + position);
+            check.erase(check.begin() + position);
+        }
+        if(vector.blockCount() != 0 || vector.begin() != vector.end())
+            eraseSuccess = false;
+
+        if(eraseSuccess)
+            Log::add(Log::INFO, NEXTCASH_TIERED_VECTOR_LOG_NAME, "Passed erase");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_TIERED_VECTOR_LOG_NAME, "Failed erase");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Growth rebalances blocks
+         *****************************************************************************************/
+        bool growSuccess = true;
+        for(unsigned int i = 0; i < 2000000; ++i)
+            vector.push_back(i);
+        if(vector.size() != 2000000 || vector.front() != 0 || vector.back() != 1999999 ||
+          vector.targetBlockSize() < 1024 ||
+          vector.blockCount() > (vector.size() / vector.targetBlockSize()) + 1)
+            growSuccess = false;
+        for(unsigned int i = 0; growSuccess && i < 1000; ++i)
+        {
+            position = Math::randomInt() % vector.size();
+            if(vector[position] != position)
+                growSuccess = false;
+        }
+
+        if(growSuccess)
+            Log::addFormatted(Log::INFO, NEXTCASH_TIERED_VECTOR_LOG_NAME,
+              "Passed growth (block size %d, %d blocks)", vector.targetBlockSize(),
+              vector.blockCount());
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_TIERED_VECTOR_LOG_NAME, "Failed growth");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Insert performance compared to DistributedVector
+         *****************************************************************************************/
+        unsigned int counts[] = { 10000, 200000 };
+        for(unsigned int i = 0; i < 2; ++i)
+        {
+            TieredVector<unsigned int> tiered, tieredFront;
+            DistributedVector<unsigned int> distributed(100), distributedFront(100);
+
+            unsigned int tieredTime = tieredVectorInsertTime(tiered, counts[i], false);
+            unsigned int distributedTime = tieredVectorInsertTime(distributed, counts[i], false);
+            unsigned int tieredFrontTime = tieredVectorInsertTime(tieredFront, counts[i], true);
+            unsigned int distributedFrontTime =
+              tieredVectorInsertTime(distributedFront, counts[i], true);
+
+            Log::addFormatted(Log::INFO, NEXTCASH_TIERED_VECTOR_LOG_NAME,
+              "%d random inserts : TieredVector %d us, DistributedVector(100) %d us", counts[i],
+              tieredTime, distributedTime);
+            Log::addFormatted(Log::INFO, NEXTCASH_TIERED_VECTOR_LOG_NAME,
+              "%d front inserts  : TieredVector %d us, DistributedVector(100) %d us", counts[i],
+              tieredFrontTime, distributedFrontTime);
+
+            if(tiered.size() != counts[i] || tieredFront.front() != counts[i] - 1)
+                success = false;
+        }
+
+        return success;
+    }
+}
@@ -0,0 +1,439 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_TIERED_VECTOR_HPP
+#define NEXTCASH_TIERED_VECTOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#define NEXTCASH_TIERED_VECTOR_LOG_NAME "TieredVector"
+
+
+namespace NextCash
+{
+    // Vector split into blocks so inserts and erases only move the items in one block.
+    // Unlike DistributedVector the number of blocks isn't fixed. Blocks are split when they grow
+    //   past twice the target size and merged with a neighbor when they shrink below half of it.
+    //   The target size is about the square root of the item count, but never less than a few
+    //   KiB of items, and all blocks are rebuilt at the new target when it changes by a factor
+    //   of two. So inserts and erases are O(sqrt(n)) at any size and positional access is
+    //   O(log(n)).
+    // Inserts and erases invalidate all iterators.
+    template <class tType>
+    class TieredVector
+    {
+    public:
+
+        // Bytes of items in a block below which blocks are not made smaller.
+        static const unsigned int MIN_BLOCK_BYTES = 4096;
+
+        TieredVector();
+        ~TieredVector();
+
+        unsigned int size() const { return mSize; }
+
+        void clear();
+
+        // Reserve space for the blocks needed for pCount items.
+        void reserve(unsigned int pCount);
+
+        class Iterator
+        {
+        public:
+
+            Iterator() : enclosing(NULL), block(0), offset(0) {}
+            Iterator(TieredVector *pEnclosing, unsigned int pBlock, unsigned int pOffset) :
+              enclosing(pEnclosing), block(pBlock), offset(pOffset) {}
+
+            tType &operator *() { return (*enclosing->mBlocks[block])[offset]; }
+            tType *operator ->() { return &(*enclosing->mBlocks[block])[offset]; }
+
+            bool operator ==(const Iterator &pRight) const
+            {
+                return block == pRight.block && offset == pRight.offset;
+            }
+            bool operator !=(const Iterator &pRight) const
+            {
+                return block != pRight.block || offset != pRight.offset;
+            }
+
+            // Prefix increment
+            Iterator &operator ++()
+            {
+                if(++offset == enclosing->mBlocks[block]->size())
+                {
+                    ++block;
+                    offset = 0;
+                }
+                return *this;
+            }
+
+            // Postfix increment
+            Iterator operator ++(int)
+            {
+                Iterator result = *this;
+                ++*this;
+                return result;
+            }
+
+            // Prefix decrement
+            Iterator &operator --()
+            {
+                if(offset == 0)
+                {
+                    --block;
+                    offset = enclosing->mBlocks[block]->size();
+                }
+                --offset;
+                return *this;
+            }
+
+            // Postfix decrement
+            Iterator operator --(int)
+            {
+                Iterator result = *this;
+                --*this;
+                return result;
+            }
+
+            Iterator operator +(unsigned int pCount) const
+            {
+                if(offset + pCount < enclosing->blockSize(block))
+                    return Iterator(enclosing, block, offset + pCount);
+                return enclosing->iteratorAt(position() + pCount);
+            }
+            Iterator operator -(unsigned int pCount) const
+            {
+                if(offset >= pCount && block < enclosing->mBlocks.size())
+                    return Iterator(enclosing, block, offset - pCount);
+                unsigned int current = position();
+                if(current < pCount)
+                    return enclosing->begin(); // Result would be past the beginning
+                return enclosing->iteratorAt(current - pCount);
+            }
+            Iterator &operator +=(unsigned int pCount) { return *this = *this + pCount; }
+            Iterator &operator -=(unsigned int pCount) { return *this = *this - pCount; }
+
+            // Offset of the item from the beginning.
+            unsigned int position() const
+            {
+                if(block >= enclosing->mBlocks.size())
+                    return enclosing->mSize;
+                return enclosing->mStarts[block] + offset;
+            }
+
+            TieredVector *enclosing;
+            unsigned int block;
+            unsigned int offset;
+
+        };
+
+        Iterator begin() { return Iterator(this, 0, 0); }
+        Iterator end() { return Iterator(this, mBlocks.size(), 0); }
+
+        tType &front() { return mBlocks.front()->front(); }
+        tType &back() { return mBlocks.back()->back(); }
+        tType &operator [](unsigned int pOffset) { return *iteratorAt(pOffset); }
+
+        // Insert new item before specified item and return an iterator to it.
+        Iterator insert(const Iterator &pBefore, const tType &pValue)
+          { return emplace(pBefore, pValue); }
+        Iterator insert(const Iterator &pBefore, tType &&pValue)
+          { return emplace(pBefore, std::move(pValue)); }
+
+        // Construct a new item in place before specified item and return an iterator to it.
+        template <typename... tArgs>
+        Iterator emplace(const Iterator &pBefore, tArgs &&...pArgs);
+
+        // Add a new item to the end
+        void push_back(const tType &pValue) { emplace_back(pValue); }
+        void push_back(tType &&pValue) { emplace_back(std::move(pValue)); }
+
+        // Construct a new item in place at the end
+        template <typename... tArgs>
+        void emplace_back(tArgs &&...pArgs);
+
+        // Add items to the end.
+        template <class tIterator>
+        void append(tIterator pBegin, tIterator pEnd)
+        {
+            for(; pBegin != pEnd; ++pBegin)
+                emplace_back(*pBegin);
+        }
+
+        // Remove specified item and return the item after it
+        Iterator erase(const Iterator &pItem);
+
+        // Read only access to the blocks, for writing out items a block at a time.
+        unsigned int blockCount() const { return mBlocks.size(); }
+        const std::vector<tType> &block(unsigned int pOffset) const { return *mBlocks[pOffset]; }
+
+        // Target number of items per block.
+        unsigned int targetBlockSize() const { return mTargetSize; }
+
+    private:
+
+        typedef std::vector<tType> Block;
+
+        unsigned int blockSize(unsigned int pBlock) const
+        {
+            return pBlock < mBlocks.size() ? mBlocks[pBlock]->size() : 0;
+        }
+
+        // Return the Iterator for the item at the offset.
+        Iterator iteratorAt(unsigned int pOffset);
+
+        // Add pCount to the starts of the blocks after pBlock.
+        void offsetStarts(unsigned int pBlock, int pCount);
+
+        // Split the block in half if it is larger than allowed.
+        void checkSplit(unsigned int pBlock);
+
+        // Merge the block with a neighbor if it is smaller than allowed.
+        void checkMerge(unsigned int pBlock);
+
+        // Rebuild all blocks at a new target size if the size has changed enough.
+        void checkRebalance();
+        void rebalance();
+
+        static unsigned int minBlockSize()
+        {
+            return sizeof(tType) >= MIN_BLOCK_BYTES / 16 ? 16 : MIN_BLOCK_BYTES / sizeof(tType);
+        }
+
+        std::vector<Block *> mBlocks; // Never contains empty blocks
+        std::vector<unsigned int> mStarts; // Offset of the first item in each block
+        unsigned int mSize;
+        unsigned int mTargetSize;
+        uint64_t mRebalanceAbove, mRebalanceBelow;
+
+        TieredVector(const TieredVector &pCopy);
+        TieredVector &operator = (const TieredVector &pRight);
+
+    };
+
+    template <class tType>
+    const unsigned int TieredVector<tType>::MIN_BLOCK_BYTES;
+
+    template <class tType>
+    TieredVector<tType>::TieredVector()
+    {
+        mSize = 0;
+        mTargetSize = minBlockSize();
+        mRebalanceAbove = (uint64_t)mTargetSize * mTargetSize * 4;
+        mRebalanceBelow = 0;
+    }
+
+    template <class tType>
+    TieredVector<tType>::~TieredVector()
+    {
+        for(typename std::vector<Block *>::iterator block = mBlocks.begin();
+          block != mBlocks.end(); ++block)
+            delete *block;
+    }
+
+    template <class tType>
+    void TieredVector<tType>::clear()
+    {
+        for(typename std::vector<Block *>::iterator block = mBlocks.begin();
+          block != mBlocks.end(); ++block)
+            delete *block;
+        mBlocks.clear();
+        mStarts.clear();
+        mSize = 0;
+        mTargetSize = minBlockSize();
+        mRebalanceAbove = (uint64_t)mTargetSize * mTargetSize * 4;
+        mRebalanceBelow = 0;
+    }
+
+    template <class tType>
+    void TieredVector<tType>::reserve(unsigned int pCount)
+    {
+        unsigned int target = std::max(minBlockSize(), (unsigned int)std::sqrt((double)pCount));
+        mBlocks.reserve(pCount / target + 1);
+        mStarts.reserve(pCount / target + 1);
+    }
+
+    template <class tType>
+    typename TieredVector<tType>::Iterator TieredVector<tType>::iteratorAt(unsigned int pOffset)
+    {
+        if(pOffset >= mSize)
+            return end();
+
+        // Last block starting at or before the offset.
+        unsigned int block = std::upper_bound(mStarts.begin(), mStarts.end(), pOffset) -
+          mStarts.begin() - 1;
+        return Iterator(this, block, pOffset - mStarts[block]);
+    }
+
+    template <class tType>
+    void TieredVector<tType>::offsetStarts(unsigned int pBlock, int pCount)
+    {
+        for(std::vector<unsigned int>::iterator start = mStarts.begin() + pBlock + 1;
+          start != mStarts.end(); ++start)
+            *start += pCount;
+    }
+
+    template <class tType>
+    void TieredVector<tType>::checkSplit(unsigned int pBlock)
+    {
+        Block *block = mBlocks[pBlock];
+        if(block->size() <= mTargetSize * 2)
+            return;
+
+        // Move the second half to a new block after this one.
+        unsigned int half = block->size() / 2;
+        Block *newBlock = new Block();
+        newBlock->reserve(mTargetSize * 2);
+        newBlock->insert(newBlock->end(), std::make_move_iterator(block->begin() + half),
+          std::make_move_iterator(block->end()));
+        block->erase(block->begin() + half, block->end());
+
+        mBlocks.insert(mBlocks.begin() + pBlock + 1, newBlock);
+        mStarts.insert(mStarts.begin() + pBlock + 1, mStarts[pBlock] + half);
+    }
+
+    template <class tType>
+    void TieredVector<tType>::checkMerge(unsigned int pBlock)
+    {
+        if(mBlocks[pBlock]->size() >= mTargetSize / 2 || mBlocks.size() < 2)
+            return;
+
+        // Merge the next block into this one, or this one into the previous.
+        if(pBlock == mBlocks.size() - 1)
+            --pBlock;
+
+        Block *block = mBlocks[pBlock], *next = mBlocks[pBlock + 1];
+        block->insert(block->end(), std::make_move_iterator(next->begin()),
+          std::make_move_iterator(next->end()));
+        delete next;
+        mBlocks.erase(mBlocks.begin() + pBlock + 1);
+        mStarts.erase(mStarts.begin() + pBlock + 1);
+
+        // The neighbor could have been large.
+        checkSplit(pBlock);
+    }
+
+    template <class tType>
+    void TieredVector<tType>::checkRebalance()
+    {
+        if(mSize > mRebalanceAbove || mSize < mRebalanceBelow)
+            rebalance();
+    }
+
+    template <class tType>
+    void TieredVector<tType>::rebalance()
+    {
+        mTargetSize = std::max(minBlockSize(), (unsigned int)std::sqrt((double)mSize));
+
+        // Rebalance when the square root of the size doubles or halves.
+        mRebalanceAbove = (uint64_t)mTargetSize * mTargetSize * 4;
+        if(mTargetSize > minBlockSize())
+            mRebalanceBelow = ((uint64_t)mTargetSize * mTargetSize) / 4;
+        else
+            mRebalanceBelow = 0;
+
+        std::vector<Block *> oldBlocks;
+        oldBlocks.swap(mBlocks);
+        mStarts.clear();
+
+        Block *newBlock = NULL;
+        unsigned int offset = 0;
+        for(typename std::vector<Block *>::iterator block = oldBlocks.begin();
+          block != oldBlocks.end(); ++block)
+        {
+            for(typename Block::iterator item = (*block)->begin(); item != (*block)->end();
+              ++item)
+            {
+                if(newBlock == NULL || newBlock->size() >= mTargetSize)
+                {
+                    newBlock = new Block();
+                    newBlock->reserve(mTargetSize * 2);
+                    mBlocks.push_back(newBlock);
+                    mStarts.push_back(offset);
+                }
+                newBlock->emplace_back(std::move(*item));
+                ++offset;
+            }
+            delete *block;
+        }
+    }
+
+    template <class tType>
+    template <typename... tArgs>
+    typename TieredVector<tType>::Iterator TieredVector<tType>::emplace(const Iterator &pBefore,
+      tArgs &&...pArgs)
+    {
+        if(pBefore.block >= mBlocks.size()) // Inserting as last item
+        {
+            emplace_back(std::forward<tArgs>(pArgs)...);
+            return end() - 1;
+        }
+
+        unsigned int position = pBefore.position();
+        Block *block = mBlocks[pBefore.block];
+        block->emplace(block->begin() + pBefore.offset, std::forward<tArgs>(pArgs)...);
+        ++mSize;
+        offsetStarts(pBefore.block, 1);
+
+        if(block->size() <= mTargetSize * 2 && mSize <= mRebalanceAbove)
+            return pBefore;
+
+        checkSplit(pBefore.block);
+        checkRebalance();
+        return iteratorAt(position);
+    }
+
+    template <class tType>
+    template <typename... tArgs>
+    void TieredVector<tType>::emplace_back(tArgs &&...pArgs)
+    {
+        if(mBlocks.size() == 0 || mBlocks.back()->size() >= mTargetSize * 2)
+        {
+            // Start a new block
+            Block *newBlock = new Block();
+            newBlock->reserve(mTargetSize * 2);
+            mBlocks.push_back(newBlock);
+            mStarts.push_back(mSize);
+        }
+
+        mBlocks.back()->emplace_back(std::forward<tArgs>(pArgs)...);
+        ++mSize;
+        checkRebalance();
+    }
+
+    template <class tType>
+    typename TieredVector<tType>::Iterator TieredVector<tType>::erase(const Iterator &pItem)
+    {
+        unsigned int position = pItem.position();
+        Block *block = mBlocks[pItem.block];
+        block->erase(block->begin() + pItem.offset);
+        --mSize;
+        offsetStarts(pItem.block, -1);
+
+        if(block->size() == 0)
+        {
+            delete block;
+            mBlocks.erase(mBlocks.begin() + pItem.block);
+            mStarts.erase(mStarts.begin() + pItem.block);
+        }
+        else
+            checkMerge(pItem.block);
+
+        checkRebalance();
+        return iteratorAt(position);
+    }
+
+    bool testTieredVector();
+}
+
+#endif
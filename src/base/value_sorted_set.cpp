@@ -0,0 +1,245 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "value_sorted_set.hpp"
+
+#include "hash.hpp"
+#include "hash_set.hpp"
+#include "timer.hpp"
+
+
+namespace NextCash
+{
+    class ValueSortedSetTestItem
+    {
+    public:
+
+        ValueSortedSetTestItem() : value(0) {}
+        ValueSortedSetTestItem(const Hash &pHash, unsigned int pValue) : hash(pHash), value(pValue) {}
+
+        Hash hash;
+        unsigned int value;
+
+    };
+
+    // Sorts by hash, so items can be found with just a hash.
+    class ValueSortedSetTestCompare
+    {
+    public:
+
+        int operator()(const ValueSortedSetTestItem &pLeft,
+          const ValueSortedSetTestItem &pRight) const
+        {
+            return pLeft.hash.compare(pRight.hash);
+        }
+
+        int operator()(const Hash &pLeft, const ValueSortedSetTestItem &pRight) const
+        {
+            return pLeft.compare(pRight.hash);
+        }
+
+        bool valueEquals(const ValueSortedSetTestItem &pLeft,
+          const ValueSortedSetTestItem &pRight) const
+        {
+            return pLeft.value == pRight.value;
+        }
+
+    };
+
+    class ValueSortedSetTestObject : public HashObject
+    {
+    public:
+
+        ValueSortedSetTestObject(const Hash &pHash) : hash(pHash) {}
+
+        const Hash &getHash() { return hash; }
+
+        Hash hash;
+
+    };
+
+    bool testValueSortedSet()
+    {
+        Log::add(Log::INFO, NEXTCASH_VALUE_SORTED_SET_LOG_NAME,
+          "------------- Starting Value Sorted Set Tests -------------");
+
+        bool success = true;
+
+        /******************************************************************************************
+         * Hash values
+         *****************************************************************************************/
+        ValueSortedSet<Hash> hashSet;
+        std::vector<Hash> hashes;
+        Hash hash(32);
+
+        for(unsigned int i = 0; i < 500; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+            hashSet.insert(hash);
+        }
+
+        bool sortSuccess = hashSet.size() == 500 && !hashSet.insert(hashes[10]) &&
+          !hashSet.insert(hashes[10], true);
+        for(ValueSortedSet<Hash>::Iterator item = hashSet.begin() + 1; item != hashSet.end();
+          ++item)
+            if(*(item - 1) > *item)
+                sortSuccess = false;
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+            if(!hashSet.contains(hashes[i]) || *hashSet.get(hashes[i]) != hashes[i])
+                sortSuccess = false;
+        hash.randomize();
+        if(hashSet.contains(hash) || hashSet.get(hash) != NULL || hashSet.find(hash) != hashSet.end())
+            sortSuccess = false;
+
+        if(sortSuccess)
+            Log::add(Log::INFO, NEXTCASH_VALUE_SORTED_SET_LOG_NAME, "Passed hash values");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_VALUE_SORTED_SET_LOG_NAME, "Failed hash values");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Remove
+         *****************************************************************************************/
+        bool removeSuccess = true;
+        for(unsigned int i = 0; i < hashes.size(); i += 2)
+            if(!hashSet.remove(hashes[i]))
+                removeSuccess = false;
+        for(unsigned int i = 0; i < hashes.size(); ++i)
+            if(hashSet.contains(hashes[i]) != (i % 2 == 1))
+                removeSuccess = false;
+        if(hashSet.remove(hashes[0]) || hashSet.size() != 250)
+            removeSuccess = false;
+
+        if(removeSuccess)
+            Log::add(Log::INFO, NEXTCASH_VALUE_SORTED_SET_LOG_NAME, "Passed remove");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_VALUE_SORTED_SET_LOG_NAME, "Failed remove");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Custom comparator with duplicate sorts
+         *****************************************************************************************/
+        ValueSortedSet<ValueSortedSetTestItem, ValueSortedSetTestCompare> itemSet;
+        for(unsigned int i = 0; i < 100; ++i)
+            itemSet.insert(ValueSortedSetTestItem(hashes[i], i));
+
+        bool duplicateSuccess = !itemSet.insert(ValueSortedSetTestItem(hashes[5], 1000)) &&
+          itemSet.insert(ValueSortedSetTestItem(hashes[5], 1000), true) &&
+          itemSet.insert(ValueSortedSetTestItem(hashes[5], 1001), true) &&
+          !itemSet.insert(ValueSortedSetTestItem(hashes[5], 1000), true) &&
+          itemSet.size() == 102;
+
+        ValueSortedSet<ValueSortedSetTestItem, ValueSortedSetTestCompare>::Iterator item =
+          itemSet.find(hashes[5]);
+        // Duplicates are inserted after existing matches.
+        if(item == itemSet.end() || item->value != 5 || (++item)->value != 1000 ||
+          (++item)->value != 1001)
+            duplicateSuccess = false;
+
+        ValueSortedSetTestItem removed;
+        if(!itemSet.getAndRemove(hashes[5], removed) || removed.value != 5 ||
+          removed.hash != hashes[5])
+            duplicateSuccess = false;
+        if(itemSet.removeAll(hashes[5]) != 2 || itemSet.contains(hashes[5]) ||
+          itemSet.size() != 99)
+            duplicateSuccess = false;
+
+        if(duplicateSuccess)
+            Log::add(Log::INFO, NEXTCASH_VALUE_SORTED_SET_LOG_NAME, "Passed duplicate sorts");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_VALUE_SORTED_SET_LOG_NAME, "Failed duplicate sorts");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Throughput compared to SortedSet
+         *****************************************************************************************/
+        // Split into 256 sets by the most significant byte, the same as HashSet, so set sizes
+        //   are realistic.
+        const unsigned int benchmarkCount = 50000;
+        const unsigned int setCount = 0x0100;
+        hashes.clear();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+        {
+            hash.randomize();
+            hashes.push_back(hash);
+        }
+
+        Timer insertTimer, findTimer, removeTimer;
+        unsigned int found = 0, remaining = 0;
+
+        ValueSortedSet<ValueSortedSetTestItem, ValueSortedSetTestCompare> *valueSets =
+          new ValueSortedSet<ValueSortedSetTestItem, ValueSortedSetTestCompare>[setCount];
+        insertTimer.start();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            valueSets[hashes[i].getByte(31)].insert(ValueSortedSetTestItem(hashes[i], i));
+        insertTimer.stop();
+        findTimer.start();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            if(valueSets[hashes[i].getByte(31)].contains(hashes[i]))
+                ++found;
+        findTimer.stop();
+        removeTimer.start();
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            valueSets[hashes[i].getByte(31)].remove(hashes[i]);
+        removeTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_VALUE_SORTED_SET_LOG_NAME,
+          "ValueSortedSet %d items : insert %6d us, find %6d us, remove %6d us", benchmarkCount,
+          (int)insertTimer.microseconds(), (int)findTimer.microseconds(),
+          (int)removeTimer.microseconds());
+        for(unsigned int i = 0; i < setCount; ++i)
+            remaining += valueSets[i].size();
+        delete[] valueSets;
+
+        SortedSet *objectSets = new SortedSet[setCount];
+        ValueSortedSetTestObject lookup(hash);
+        insertTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+            objectSets[hashes[i].getByte(31)].insert(new ValueSortedSetTestObject(hashes[i]));
+        insertTimer.stop();
+        findTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+        {
+            lookup.hash = hashes[i];
+            if(objectSets[hashes[i].getByte(31)].contains(lookup))
+                ++found;
+        }
+        findTimer.stop();
+        removeTimer.clear(true);
+        for(unsigned int i = 0; i < benchmarkCount; ++i)
+        {
+            lookup.hash = hashes[i];
+            objectSets[hashes[i].getByte(31)].remove(lookup);
+        }
+        removeTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_VALUE_SORTED_SET_LOG_NAME,
+          "SortedSet      %d items : insert %6d us, find %6d us, remove %6d us", benchmarkCount,
+          (int)insertTimer.microseconds(), (int)findTimer.microseconds(),
+          (int)removeTimer.microseconds());
+        for(unsigned int i = 0; i < setCount; ++i)
+            remaining += objectSets[i].size();
+        delete[] objectSets;
+
+        if(found == benchmarkCount * 2 && remaining == 0)
+            Log::add(Log::INFO, NEXTCASH_VALUE_SORTED_SET_LOG_NAME, "Passed throughput");
+        else
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_VALUE_SORTED_SET_LOG_NAME,
+              "Failed throughput : %d/%d found, %d remaining", found, benchmarkCount * 2,
+              remaining);
+            success = false;
+        }
+
+        return success;
+    }
+}
@@ -0,0 +1,293 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_VALUE_SORTED_SET_HPP
+#define NEXTCASH_VALUE_SORTED_SET_HPP
+
+#include "log.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#define NEXTCASH_VALUE_SORTED_SET_LOG_NAME "ValueSortedSet"
+
+
+namespace NextCash
+{
+    // Default comparator for ValueSortedSet.
+    //   Sorts with tType::compare and uses == for "value" equality.
+    template <class tType>
+    class ValueCompare
+    {
+    public:
+
+        // Returns < 0 when pLeft is less than pRight, 0 when equal, > 0 when more.
+        //   pLeft can be any type with a compare function that accepts tType, so lookups don't
+        //   need a full item.
+        template <class tMatching>
+        int operator()(const tMatching &pLeft, const tType &pRight) const
+        {
+            return pLeft.compare(pRight);
+        }
+
+        bool valueEquals(const tType &pLeft, const tType &pRight) const
+        {
+            return pLeft == pRight;
+        }
+
+    };
+
+    // Same behavior as SortedSet, but items are stored by value in contiguous memory and the
+    //   comparator is a template parameter so compares are inlined instead of virtual calls.
+    //
+    // tCompare must have the following functions defined.
+    //   int operator()(const tMatching &pLeft, const tType &pRight) const;
+    //     For tMatching of tType and any other type used for lookups.
+    //   bool valueEquals(const tType &pLeft, const tType &pRight) const;
+    template <class tType, class tCompare = ValueCompare<tType> >
+    class ValueSortedSet
+    {
+    public:
+
+        ValueSortedSet() {}
+        ValueSortedSet(const tCompare &pCompare) : mCompare(pCompare) {}
+
+        unsigned int size() const { return mItems.size(); }
+
+        void reserve(unsigned int pSize) { mItems.reserve(pSize); }
+
+        template <class tMatching>
+        bool contains(const tMatching &pMatching) const
+        {
+            typename std::vector<tType>::const_iterator item = lowerBound(pMatching);
+            return item != mItems.end() && mCompare(pMatching, *item) == 0;
+        }
+
+        // Returns true if the item was inserted.
+        // If pAllowDuplicateSorts is false then multiple items with the same "sort" value will
+        //   not be inserted.
+        // Multiple items that match according to "valueEquals" will never be inserted.
+        bool insert(const tType &pValue, bool pAllowDuplicateSorts = false);
+        bool insert(tType &&pValue, bool pAllowDuplicateSorts = false);
+
+        // Removes the first item with matching "sort" value.
+        // Returns true if the item was removed.
+        template <class tMatching>
+        bool remove(const tMatching &pMatching);
+
+        // Removes all items with matching "sort" value.
+        // Returns number of items removed.
+        template <class tMatching>
+        unsigned int removeAll(const tMatching &pMatching);
+
+        // Returns the first item with matching "sort" value.
+        // Return NULL if not found. Only valid until the set is modified.
+        template <class tMatching>
+        tType *get(const tMatching &pMatching);
+
+        // Moves the first item with matching "sort" value into pValue and removes it.
+        // Returns false if not found.
+        template <class tMatching>
+        bool getAndRemove(const tMatching &pMatching, tType &pValue);
+
+        void clear() { mItems.clear(); }
+
+        void shrink() { mItems.shrink_to_fit(); }
+
+        typedef typename std::vector<tType>::iterator Iterator;
+
+        Iterator begin() { return mItems.begin(); }
+        Iterator end() { return mItems.end(); }
+
+        tType &front() { return mItems.front(); }
+        tType &back() { return mItems.back(); }
+
+        // Return iterator to first matching item or end.
+        template <class tMatching>
+        Iterator find(const tMatching &pMatching);
+
+        Iterator erase(Iterator &pIterator) { return mItems.erase(pIterator); }
+
+    private:
+
+        // Return the first item not less than pMatching.
+        template <class tMatching>
+        typename std::vector<tType>::const_iterator lowerBound(const tMatching &pMatching) const;
+
+        // Return the first item more than pMatching.
+        template <class tMatching>
+        typename std::vector<tType>::const_iterator upperBound(const tMatching &pMatching) const;
+
+        // Return the position to insert pValue at or end and set pValid to false if it can't be
+        //   inserted.
+        Iterator insertPosition(const tType &pValue, bool pAllowDuplicateSorts, bool &pValid);
+
+        std::vector<tType> mItems;
+        tCompare mCompare;
+
+        ValueSortedSet(const ValueSortedSet &pCopy);
+        ValueSortedSet &operator = (const ValueSortedSet &pRight);
+
+    };
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    typename std::vector<tType>::const_iterator
+      ValueSortedSet<tType, tCompare>::lowerBound(const tMatching &pMatching) const
+    {
+        typename std::vector<tType>::const_iterator bottom = mItems.begin(), current;
+        unsigned int count = mItems.size(), half;
+
+        while(count > 0)
+        {
+            // Break the set in two halves
+            half = count / 2;
+            current = bottom + half;
+            if(mCompare(pMatching, *current) > 0)
+            {
+                bottom = current + 1;
+                count -= half + 1;
+            }
+            else
+                count = half;
+        }
+
+        return bottom;
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    typename std::vector<tType>::const_iterator
+      ValueSortedSet<tType, tCompare>::upperBound(const tMatching &pMatching) const
+    {
+        typename std::vector<tType>::const_iterator bottom = mItems.begin(), current;
+        unsigned int count = mItems.size(), half;
+
+        while(count > 0)
+        {
+            // Break the set in two halves
+            half = count / 2;
+            current = bottom + half;
+            if(mCompare(pMatching, *current) >= 0)
+            {
+                bottom = current + 1;
+                count -= half + 1;
+            }
+            else
+                count = half;
+        }
+
+        return bottom;
+    }
+
+    template <class tType, class tCompare>
+    typename ValueSortedSet<tType, tCompare>::Iterator
+      ValueSortedSet<tType, tCompare>::insertPosition(const tType &pValue,
+      bool pAllowDuplicateSorts, bool &pValid)
+    {
+        typename std::vector<tType>::const_iterator first = lowerBound(pValue);
+        typename std::vector<tType>::const_iterator after = first;
+
+        // Check items with the same sort value.
+        while(after != mItems.end() && mCompare(pValue, *after) == 0)
+        {
+            if(!pAllowDuplicateSorts || mCompare.valueEquals(pValue, *after))
+            {
+                pValid = false;
+                return mItems.end();
+            }
+            ++after;
+        }
+
+        pValid = true;
+        return mItems.begin() + (after - mItems.begin());
+    }
+
+    template <class tType, class tCompare>
+    bool ValueSortedSet<tType, tCompare>::insert(const tType &pValue, bool pAllowDuplicateSorts)
+    {
+        bool valid;
+        Iterator position = insertPosition(pValue, pAllowDuplicateSorts, valid);
+        if(!valid)
+            return false;
+        mItems.insert(position, pValue);
+        return true;
+    }
+
+    template <class tType, class tCompare>
+    bool ValueSortedSet<tType, tCompare>::insert(tType &&pValue, bool pAllowDuplicateSorts)
+    {
+        bool valid;
+        Iterator position = insertPosition(pValue, pAllowDuplicateSorts, valid);
+        if(!valid)
+            return false;
+        mItems.insert(position, std::move(pValue));
+        return true;
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    typename ValueSortedSet<tType, tCompare>::Iterator
+      ValueSortedSet<tType, tCompare>::find(const tMatching &pMatching)
+    {
+        Iterator item = mItems.begin() + (lowerBound(pMatching) - mItems.begin());
+        if(item != mItems.end() && mCompare(pMatching, *item) == 0)
+            return item;
+        return mItems.end();
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    bool ValueSortedSet<tType, tCompare>::remove(const tMatching &pMatching)
+    {
+        Iterator item = find(pMatching);
+        if(item == mItems.end())
+            return false;
+        mItems.erase(item);
+        return true;
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    unsigned int ValueSortedSet<tType, tCompare>::removeAll(const tMatching &pMatching)
+    {
+        Iterator first = mItems.begin() + (lowerBound(pMatching) - mItems.begin());
+        Iterator after = mItems.begin() + (upperBound(pMatching) - mItems.begin());
+        unsigned int result = after - first;
+        if(result > 0)
+            mItems.erase(first, after);
+        return result;
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    tType *ValueSortedSet<tType, tCompare>::get(const tMatching &pMatching)
+    {
+        Iterator item = find(pMatching);
+        if(item == mItems.end())
+            return NULL;
+        return &(*item);
+    }
+
+    template <class tType, class tCompare>
+    template <class tMatching>
+    bool ValueSortedSet<tType, tCompare>::getAndRemove(const tMatching &pMatching,
+      tType &pValue)
+    {
+        Iterator item = find(pMatching);
+        if(item == mItems.end())
+            return false;
+        pValue = std::move(*item);
+        mItems.erase(item);
+        return true;
+    }
+
+    bool testValueSortedSet();
+}
+
+#endif
@@ -7,16 +7,23 @@
  **************************************************************************/
 #include "digest.hpp"
 
+#include "cpu.hpp"
 #include "endian.hpp"
 #include "math.hpp"
 #include "log.hpp"
 #include "stream.hpp"
 #include "buffer.hpp"
+#include "timer.hpp"
 
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <vector>
 
+#ifdef NEXTCASH_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+
 #define NEXTCASH_DIGEST_LOG_NAME "Digest"
 
 
@@ -24,34 +31,252 @@ namespace NextCash
 {
     namespace CRC32
     {
-        static const uint32_t table[256] =
-        {
-            0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
-            0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7, 0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
-            0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172, 0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-            0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
-            0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433, 0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
-            0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-            0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0, 0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
-            0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f, 0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
-            0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a, 0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683, 0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-            0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7, 0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
-            0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b, 0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
-            0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236, 0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-            0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
-            0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777, 0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
-            0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-            0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
+        static const uint32_t POLYNOMIAL = 0xedb88320; // 0x04c11db7 reflected
+        static const uint32_t CASTAGNOLI_POLYNOMIAL = 0x82f63b78; // CRC32C, 0x1edc6f41 reflected
+
+        // Table n is the CRC of a byte followed by n zero bytes, so 8 bytes can be processed with
+        //   independent lookups (slicing by 8).
+        class SliceTables
+        {
+        public:
+
+            SliceTables(uint32_t pPolynomial)
+            {
+                uint32_t value;
+                for(unsigned int i = 0; i < 256; ++i)
+                {
+                    value = i;
+                    for(unsigned int bit = 0; bit < 8; ++bit)
+                        value = (value & 1) ? (value >> 1) ^ pPolynomial : value >> 1;
+                    values[0][i] = value;
+                }
+
+                for(unsigned int i = 0; i < 256; ++i)
+                    for(unsigned int slice = 1; slice < 8; ++slice)
+                        values[slice][i] = (values[slice - 1][i] >> 8) ^
+                          values[0][values[slice - 1][i] & 0xff];
+            }
+
+            uint32_t values[8][256];
+
         };
+
+        static const SliceTables &tables()
+        {
+            static const SliceTables result(POLYNOMIAL);
+            return result;
+        }
+
+        static const SliceTables &castagnoliTables()
+        {
+            static const SliceTables result(CASTAGNOLI_POLYNOMIAL);
+            return result;
+        }
+
+        // The update functions take and return the CRC before the final inversion.
+
+        static uint32_t updateByte(uint32_t pCRC, const uint8_t *pData, stream_size pSize,
+          const SliceTables &pTables)
+        {
+            for(; pSize > 0; --pSize, ++pData)
+                pCRC = (pCRC >> 8) ^ pTables.values[0][(pCRC ^ *pData) & 0xff];
+            return pCRC;
+        }
+
+        static uint32_t updateSlicing8(uint32_t pCRC, const uint8_t *pData, stream_size pSize,
+          const SliceTables &pTables)
+        {
+            const uint32_t (*values)[256] = pTables.values;
+            uint32_t low, high;
+
+            for(; pSize >= 8; pSize -= 8, pData += 8)
+            {
+                std::memcpy(&low, pData, 4);
+                std::memcpy(&high, pData + 4, 4);
+                low = Endian::convert(low, Endian::LITTLE) ^ pCRC;
+                high = Endian::convert(high, Endian::LITTLE);
+                pCRC = values[7][low & 0xff] ^ values[6][(low >> 8) & 0xff] ^
+                  values[5][(low >> 16) & 0xff] ^ values[4][low >> 24] ^
+                  values[3][high & 0xff] ^ values[2][(high >> 8) & 0xff] ^
+                  values[1][(high >> 16) & 0xff] ^ values[0][high >> 24];
+            }
+
+            return updateByte(pCRC, pData, pSize, pTables);
+        }
+
+#ifdef NEXTCASH_X86_INTRINSICS
+        // Folds 64 bytes at a time with carry-less multiplies, then reduces to 32 bits (Intel's
+        //   "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction").
+        // pSize must be a multiple of 16 and at least 64. Only for POLYNOMIAL.
+        __attribute__((target("pclmul,sse4.1")))
+        static uint32_t updatePCLMUL(uint32_t pCRC, const uint8_t *pData, stream_size pSize)
+        {
+            // Reflected powers of x modulo the polynomial for folding across 64 bytes, 16 bytes,
+            //   and 64 bits, then the Barrett reduction constants, from the paper.
+            const __m128i fold4 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+            const __m128i fold1 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+            const __m128i fold64 = _mm_set_epi64x(0, 0x0163cd6124);
+            const __m128i barrett = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+            const __m128i low32Mask = _mm_setr_epi32(~0, 0, ~0, 0);
+            __m128i x0, x1, x2, x3, x4, y1, y2, y3, y4;
+
+            x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pData),
+              _mm_cvtsi32_si128(pCRC));
+            x2 = _mm_loadu_si128((const __m128i *)(pData + 16));
+            x3 = _mm_loadu_si128((const __m128i *)(pData + 32));
+            x4 = _mm_loadu_si128((const __m128i *)(pData + 48));
+            pData += 64;
+            pSize -= 64;
+
+            // Fold 4 lanes of 128 bits into the next 64 bytes.
+            for(; pSize >= 64; pSize -= 64, pData += 64)
+            {
+                y1 = _mm_clmulepi64_si128(x1, fold4, 0x00);
+                y2 = _mm_clmulepi64_si128(x2, fold4, 0x00);
+                y3 = _mm_clmulepi64_si128(x3, fold4, 0x00);
+                y4 = _mm_clmulepi64_si128(x4, fold4, 0x00);
+
+                x1 = _mm_clmulepi64_si128(x1, fold4, 0x11);
+                x2 = _mm_clmulepi64_si128(x2, fold4, 0x11);
+                x3 = _mm_clmulepi64_si128(x3, fold4, 0x11);
+                x4 = _mm_clmulepi64_si128(x4, fold4, 0x11);
+
+                x1 = _mm_xor_si128(_mm_xor_si128(x1, y1),
+                  _mm_loadu_si128((const __m128i *)pData));
+                x2 = _mm_xor_si128(_mm_xor_si128(x2, y2),
+                  _mm_loadu_si128((const __m128i *)(pData + 16)));
+                x3 = _mm_xor_si128(_mm_xor_si128(x3, y3),
+                  _mm_loadu_si128((const __m128i *)(pData + 32)));
+                x4 = _mm_xor_si128(_mm_xor_si128(x4, y4),
+                  _mm_loadu_si128((const __m128i *)(pData + 48)));
+            }
+
+            // Fold the lanes into one, then any remaining 16 byte blocks.
+            y1 = _mm_clmulepi64_si128(x1, fold1, 0x00);
+            x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, fold1, 0x11), x2), y1);
+            y1 = _mm_clmulepi64_si128(x1, fold1, 0x00);
+            x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, fold1, 0x11), x3), y1);
+            y1 = _mm_clmulepi64_si128(x1, fold1, 0x00);
+            x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, fold1, 0x11), x4), y1);
+
+            for(; pSize >= 16; pSize -= 16, pData += 16)
+            {
+                y1 = _mm_clmulepi64_si128(x1, fold1, 0x00);
+                x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, fold1, 0x11),
+                  _mm_loadu_si128((const __m128i *)pData)), y1);
+            }
+
+            // Fold 128 bits to 64.
+            x2 = _mm_clmulepi64_si128(x1, fold1, 0x10);
+            x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+            x2 = _mm_srli_si128(x1, 4);
+            x1 = _mm_and_si128(x1, low32Mask);
+            x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, fold64, 0x00), x2);
+
+            // Barrett reduction to 32 bits.
+            x0 = _mm_and_si128(x1, low32Mask);
+            x0 = _mm_clmulepi64_si128(x0, barrett, 0x10);
+            x0 = _mm_and_si128(x0, low32Mask);
+            x0 = _mm_clmulepi64_si128(x0, barrett, 0x00);
+            x1 = _mm_xor_si128(x1, x0);
+
+            return _mm_extract_epi32(x1, 1);
+        }
+
+        // CRC32C instruction. Only for CASTAGNOLI_POLYNOMIAL.
+        __attribute__((target("sse4.2")))
+        static uint32_t updateSSE42(uint32_t pCRC, const uint8_t *pData, stream_size pSize)
+        {
+#ifdef __x86_64__
+            uint64_t crc = pCRC, value;
+            for(; pSize >= 8; pSize -= 8, pData += 8)
+            {
+                std::memcpy(&value, pData, 8);
+                crc = _mm_crc32_u64(crc, value);
+            }
+            pCRC = (uint32_t)crc;
+#endif
+            uint32_t word;
+            for(; pSize >= 4; pSize -= 4, pData += 4)
+            {
+                std::memcpy(&word, pData, 4);
+                pCRC = _mm_crc32_u32(pCRC, word);
+            }
+            for(; pSize > 0; --pSize, ++pData)
+                pCRC = _mm_crc32_u8(pCRC, *pData);
+            return pCRC;
+        }
+#endif
+
+        static uint32_t update(uint32_t pCRC, const uint8_t *pData, stream_size pSize)
+        {
+#ifdef NEXTCASH_X86_INTRINSICS
+            if(pSize >= 64 && CPU::has(CPU::PCLMUL) && CPU::has(CPU::SSE41))
+            {
+                stream_size foldSize = pSize & ~(stream_size)15;
+                pCRC = updatePCLMUL(pCRC, pData, foldSize);
+                pData += foldSize;
+                pSize -= foldSize;
+            }
+#endif
+            return updateSlicing8(pCRC, pData, pSize, tables());
+        }
+
+        static uint32_t updateCastagnoli(uint32_t pCRC, const uint8_t *pData, stream_size pSize)
+        {
+#ifdef NEXTCASH_X86_INTRINSICS
+            if(CPU::has(CPU::SSE42))
+                return updateSSE42(pCRC, pData, pSize);
+#endif
+            return updateSlicing8(pCRC, pData, pSize, castagnoliTables());
+        }
+
+        // Product of two polynomials modulo pPolynomial. Bit 31 is x^0.
+        static uint32_t multiply(uint32_t pLeft, uint32_t pRight, uint32_t pPolynomial)
+        {
+            uint32_t result = 0;
+            for(uint32_t bit = 0x80000000; bit != 0 && pLeft != 0; bit >>= 1)
+            {
+                if(pLeft & bit)
+                {
+                    result ^= pRight;
+                    pLeft ^= bit;
+                }
+                pRight = (pRight & 1) ? (pRight >> 1) ^ pPolynomial : pRight >> 1;
+            }
+            return result;
+        }
+
+        // Appending pNextSize bytes multiplies the first CRC by x^(8 * pNextSize). The initial
+        //   and final inversions cancel out.
+        static uint32_t combine(uint32_t pCRC, uint32_t pNextCRC, stream_size pNextSize,
+          uint32_t pPolynomial)
+        {
+            uint32_t power = 0x80000000; // x^0
+            uint32_t square = 0x00800000; // x^8
+            for(; pNextSize > 0; pNextSize >>= 1)
+            {
+                if(pNextSize & 1)
+                    power = multiply(power, square, pPolynomial);
+                square = multiply(square, square, pPolynomial);
+            }
+            return multiply(power, pCRC, pPolynomial) ^ pNextCRC;
+        }
     }
 
     void Digest::crc32(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput)
     {
         uint32_t result = 0xffffffff;
-        stream_size remaining = pInputLength;
+        uint8_t block[4096];
+        stream_size remaining = pInputLength, blockSize;
 
-        while(remaining--)
-            result = (result >> 8) ^ CRC32::table[(result & 0xFF) ^ pInput->readByte()];
+        while(remaining > 0)
+        {
+            blockSize = remaining < sizeof(block) ? remaining : sizeof(block);
+            pInput->read(block, blockSize);
+            result = CRC32::update(result, block, blockSize);
+            remaining -= blockSize;
+        }
 
         result ^= 0xffffffff;
         pOutput->writeUnsignedInt(Endian::convert(result, Endian::BIG));
@@ -59,24 +284,37 @@ namespace NextCash
 
     uint32_t Digest::crc32(const char *pText)
     {
-        uint32_t result = 0xffffffff;
-        unsigned int offset = 0;
+        return crc32((const uint8_t *)pText, std::strlen(pText));
+    }
+
+    uint32_t Digest::crc32(const uint8_t *pData, stream_size pSize)
+    {
+        return CRC32::update(0xffffffff, pData, pSize) ^ 0xffffffff;
+    }
 
-        while(pText[offset])
-            result = (result >> 8) ^ CRC32::table[(result & 0xFF) ^ pText[offset++]];
+    uint32_t Digest::crc32(uint32_t pCRC, const uint8_t *pData, stream_size pSize)
+    {
+        return CRC32::update(pCRC ^ 0xffffffff, pData, pSize) ^ 0xffffffff;
+    }
 
-        return result ^ 0xffffffff;
+    uint32_t Digest::crc32c(const uint8_t *pData, stream_size pSize)
+    {
+        return CRC32::updateCastagnoli(0xffffffff, pData, pSize) ^ 0xffffffff;
     }
 
-    uint32_t Digest::crc32(const uint8_t *pData, stream_size pSize)
+    uint32_t Digest::crc32c(uint32_t pCRC, const uint8_t *pData, stream_size pSize)
     {
-        uint32_t result = 0xffffffff;
-        stream_size offset = 0;
+        return CRC32::updateCastagnoli(pCRC ^ 0xffffffff, pData, pSize) ^ 0xffffffff;
+    }
 
-        while(offset < pSize)
-            result = (result >> 8) ^ CRC32::table[(result & 0xFF) ^ pData[offset++]];
+    uint32_t Digest::crc32Combine(uint32_t pCRC, uint32_t pNextCRC, stream_size pNextSize)
+    {
+        return CRC32::combine(pCRC, pNextCRC, pNextSize, CRC32::POLYNOMIAL);
+    }
 
-        return result ^ 0xffffffff;
+    uint32_t Digest::crc32cCombine(uint32_t pCRC, uint32_t pNextCRC, stream_size pNextSize)
+    {
+        return CRC32::combine(pCRC, pNextCRC, pNextSize, CRC32::CASTAGNOLI_POLYNOMIAL);
     }
 
     namespace MD5
@@ -501,99 +739,113 @@ namespace NextCash
 
     namespace RIPEMD160
     {
-        inline uint32_t f(uint32_t pX, uint32_t pY, uint32_t pZ)
-        {
-            return pX ^ pY ^ pZ;
-        }
-
-        inline uint32_t g(uint32_t pX, uint32_t pY, uint32_t pZ)
-        {
-            return (pX & pY) | (~pX & pZ);
-        }
-
-        inline uint32_t h(uint32_t pX, uint32_t pY, uint32_t pZ)
-        {
-            return (pX | ~pY) ^ pZ;
-        }
+        // Steps are templates so the same code processes one message with uint32_t or several
+        //   messages at once with the lanes of vector types. Always inlined since they are
+        //   called with references to the state variables.
+#ifdef __GNUC__
+        #define NEXTCASH_RIPEMD160_INLINE static inline __attribute__((always_inline))
+#else
+        #define NEXTCASH_RIPEMD160_INLINE static inline
+#endif
 
-        inline uint32_t i(uint32_t pX, uint32_t pY, uint32_t pZ)
-        {
-            return (pX & pZ) | (pY & ~pZ);
-        }
+        #define NEXTCASH_RIPEMD160_ROTATE_LEFT(pValue, pBits) \
+          (((pValue) << (pBits)) | ((pValue) >> (32 - (pBits))))
 
-        inline uint32_t j(uint32_t pX, uint32_t pY, uint32_t pZ)
-        {
-            return pX ^ (pY | ~pZ);
-        }
+        // Macros instead of functions so vectors aren't returned by value.
+        #define NEXTCASH_RIPEMD160_F(pX, pY, pZ) ((pX) ^ (pY) ^ (pZ))
+        #define NEXTCASH_RIPEMD160_G(pX, pY, pZ) (((pX) & (pY)) | (~(pX) & (pZ)))
+        #define NEXTCASH_RIPEMD160_H(pX, pY, pZ) (((pX) | ~(pY)) ^ (pZ))
+        #define NEXTCASH_RIPEMD160_I(pX, pY, pZ) (((pX) & (pZ)) | ((pY) & ~(pZ)))
+        #define NEXTCASH_RIPEMD160_J(pX, pY, pZ) ((pX) ^ ((pY) | ~(pZ)))
 
-        inline void ff(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void ff(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += f(pB, pC, pD) + pX;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_F(pB, pC, pD) + pX;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void gg(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void gg(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += g(pB, pC, pD) + pX + 0x5a827999;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_G(pB, pC, pD) + pX + 0x5a827999;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void hh(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void hh(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += h(pB, pC, pD) + pX + 0x6ed9eba1;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_H(pB, pC, pD) + pX + 0x6ed9eba1;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void ii(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void ii(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += i(pB, pC, pD) + pX + 0x8f1bbcdc;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_I(pB, pC, pD) + pX + 0x8f1bbcdc;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void jj(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void jj(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += j(pB, pC, pD) + pX + 0xa953fd4e;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_J(pB, pC, pD) + pX + 0xa953fd4e;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void fff(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void fff(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += f(pB, pC, pD) + pX;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_F(pB, pC, pD) + pX;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void ggg(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void ggg(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += g(pB, pC, pD) + pX + 0x7a6d76e9;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_G(pB, pC, pD) + pX + 0x7a6d76e9;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void hhh(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void hhh(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += h(pB, pC, pD) + pX + 0x6d703ef3;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_H(pB, pC, pD) + pX + 0x6d703ef3;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void iii(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void iii(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += i(pB, pC, pD) + pX + 0x5c4dd124;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_I(pB, pC, pD) + pX + 0x5c4dd124;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
-        inline void jjj(uint32_t &pA, uint32_t &pB, uint32_t &pC, uint32_t &pD, uint32_t &pE, uint32_t &pX, uint32_t pS)
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void jjj(tVector &pA, tVector &pB, tVector &pC, tVector &pD,
+          tVector &pE, const tVector &pX, unsigned int pS)
         {
-            pA += j(pB, pC, pD) + pX + 0x50a28be6;
-            pA = Math::rotateLeft(pA, pS) + pE;
-            pC = Math::rotateLeft(pC, 10);
+            pA += NEXTCASH_RIPEMD160_J(pB, pC, pD) + pX + 0x50a28be6;
+            pA = NEXTCASH_RIPEMD160_ROTATE_LEFT(pA, pS) + pE;
+            pC = NEXTCASH_RIPEMD160_ROTATE_LEFT(pC, 10);
         }
 
         void initialize(uint32_t *pResult)
@@ -605,10 +857,12 @@ namespace NextCash
             pResult[4] = 0xc3d2e1f0;
         }
 
-        void process(uint32_t *pResult, uint32_t *pBlock)
+        // Process the block of 16 little endian words in pBlock into pResult.
+        template <class tVector>
+        NEXTCASH_RIPEMD160_INLINE void transform(tVector *pResult, const tVector *pBlock)
         {
-            uint32_t aa = pResult[0],  bb = pResult[1],  cc = pResult[2], dd = pResult[3],  ee = pResult[4];
-            uint32_t aaa = pResult[0], bbb = pResult[1], ccc = pResult[2], ddd = pResult[3], eee = pResult[4];
+            tVector aa = pResult[0],  bb = pResult[1],  cc = pResult[2], dd = pResult[3],  ee = pResult[4];
+            tVector aaa = pResult[0], bbb = pResult[1], ccc = pResult[2], ddd = pResult[3], eee = pResult[4];
 
             // Round 1
             ff(aa, bb, cc, dd, ee, pBlock[ 0], 11);
@@ -800,6 +1054,11 @@ namespace NextCash
             pResult[0] = ddd;
         }
 
+        void process(uint32_t *pResult, uint32_t *pBlock)
+        {
+            transform(pResult, pBlock);
+        }
+
         // BlockLength must be less than 64
         void finish(uint32_t *pResult, uint32_t *pBlock, unsigned int pBlockLength, uint64_t pTotalLength)
         {
@@ -877,7 +1136,8 @@ namespace NextCash
             pResult[7] = 0x5be0cd19;
         }
 
-        void process(uint32_t *pResult, uint32_t *pBlock)
+        // Portable implementation.
+        static void processGeneric(uint32_t *pResult, uint32_t *pBlock)
         {
             unsigned int i;
             uint32_t s0, s1, t1, t2;
@@ -926,178 +1186,1121 @@ namespace NextCash
                 pResult[i] += state[i];
         }
 
-        void finish(uint32_t *pResult, uint32_t *pBlock, unsigned int pBlockLength, uint64_t pTotalLength)
-        {
-            // Zeroize the end of the block
-            std::memset(((uint8_t *)pBlock) + pBlockLength, 0, 64 - pBlockLength);
+        // Works on uint32_t and on each lane of GCC vectors of uint32_t.
+        #define NEXTCASH_SHA256_ROTATE_RIGHT(pValue, pBits) \
+          (((pValue) >> (pBits)) | ((pValue) << (32 - (pBits))))
+
+        // One round with the state in variables instead of shifting an array. Each set of 8
+        //   rounds passes the variables in a rotated order.
+        #define NEXTCASH_SHA256_ROUND(a, b, c, d, e, f, g, h, pWK)                                \
+        {                                                                                       \
+            auto t1 = h + (NEXTCASH_SHA256_ROTATE_RIGHT(e, 6) ^                                  \
+              NEXTCASH_SHA256_ROTATE_RIGHT(e, 11) ^ NEXTCASH_SHA256_ROTATE_RIGHT(e, 25)) +       \
+              ((e & f) ^ (~e & g)) + (pWK);                                                     \
+            auto t2 = (NEXTCASH_SHA256_ROTATE_RIGHT(a, 2) ^ NEXTCASH_SHA256_ROTATE_RIGHT(a, 13) ^ \
+              NEXTCASH_SHA256_ROTATE_RIGHT(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));             \
+            d += t1;                                                                            \
+            h = t1 + t2;                                                                        \
+        }
+
+#ifdef NEXTCASH_X86_INTRINSICS
+        // Rotate each 32 bit lane right.
+        #define NEXTCASH_SHA256_ROTATE(pValue, pBits) \
+          _mm_or_si128(_mm_srli_epi32(pValue, pBits), _mm_slli_epi32(pValue, 32 - (pBits)))
+
+        // Extends the block to 64 words with SSE, 4 words at a time, and adds the round
+        //   constants. The rounds themselves are serial so they stay scalar.
+        // Always inlined so the AVX2 version compiles it with VEX encoding and BMI2 rotates.
+        static inline __attribute__((always_inline, target("sse4.1")))
+        void processVector(uint32_t *pResult, uint32_t *pBlock)
+        {
+            uint32_t extendedBlock[64] __attribute__((aligned(16)));
+            uint32_t roundValues[64] __attribute__((aligned(16)));
+            __m128i *words = (__m128i *)extendedBlock;
+            __m128i value, sum;
+            unsigned int i;
 
-            // Add 0x80 byte (basically a 1 bit at the end of the data)
-            ((uint8_t *)pBlock)[pBlockLength] = 0x80;
+            // Big endian words
+            const __m128i swapMask =
+              _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+            for(i = 0; i < 4; ++i)
+                words[i] = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)pBlock + i), swapMask);
 
-            // Check if there is enough room for the total length in this block
-            if(pBlockLength > 55) // 56 - 1 because of the 0x80 byte already added
+            for(i = 16; i < 64; i += 4)
             {
-                process(pResult, pBlock); // Process this block
-                std::memset(pBlock, 0, 64); // Clear the block
+                // w[i-16] + s0(w[i-15]) + w[i-7]
+                value = _mm_loadu_si128((__m128i *)(extendedBlock + i - 15));
+                sum = _mm_add_epi32(_mm_load_si128((__m128i *)(extendedBlock + i - 16)),
+                  _mm_xor_si128(_mm_xor_si128(NEXTCASH_SHA256_ROTATE(value, 7),
+                  NEXTCASH_SHA256_ROTATE(value, 18)), _mm_srli_epi32(value, 3)));
+                sum = _mm_add_epi32(sum, _mm_loadu_si128((__m128i *)(extendedBlock + i - 7)));
+
+                // s1(w[i-2]) is only known for the first 2 words. The last 2 words depend on
+                //   the first 2, so they are finished after the first 2 are shifted up. Shifted
+                //   in zeros add nothing to the first 2.
+                value = _mm_loadl_epi64((__m128i *)(extendedBlock + i - 2));
+                sum = _mm_add_epi32(sum, _mm_xor_si128(_mm_xor_si128(
+                  NEXTCASH_SHA256_ROTATE(value, 17), NEXTCASH_SHA256_ROTATE(value, 19)),
+                  _mm_srli_epi32(value, 10)));
+                value = _mm_slli_si128(sum, 8);
+                sum = _mm_add_epi32(sum, _mm_xor_si128(_mm_xor_si128(
+                  NEXTCASH_SHA256_ROTATE(value, 17), NEXTCASH_SHA256_ROTATE(value, 19)),
+                  _mm_srli_epi32(value, 10)));
+
+                _mm_store_si128((__m128i *)(extendedBlock + i), sum);
             }
 
-            // Put bit length in last 8 bytes of block (Big Endian)
-            pTotalLength *= 8;
-            ((uint64_t *)pBlock)[7] = Endian::convert(pTotalLength, Endian::BIG);
-
-            // Process last block
-            process(pResult, pBlock);
-
-            // Adjust for big endian
-            if(Endian::sSystemType != Endian::BIG)
-                for(unsigned int i=0;i<8;i++)
-                    pResult[i] = Endian::convert(pResult[i], Endian::BIG);
-        }
-    }
+            for(i = 0; i < 16; ++i)
+                _mm_store_si128((__m128i *)roundValues + i, _mm_add_epi32(words[i],
+                  _mm_loadu_si128((__m128i *)table + i)));
 
-    void Digest::sha256(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput) // 256 bit(32 byte) result
-    {
-        stream_size remaining = pInputLength;
-        uint32_t result[8];
-        uint32_t block[16];
+            uint32_t a = pResult[0], b = pResult[1], c = pResult[2], d = pResult[3];
+            uint32_t e = pResult[4], f = pResult[5], g = pResult[6], h = pResult[7];
 
-        SHA256::initialize(result);
+            for(i = 0; i < 64; i += 8)
+            {
+                NEXTCASH_SHA256_ROUND(a, b, c, d, e, f, g, h, roundValues[i]);
+                NEXTCASH_SHA256_ROUND(h, a, b, c, d, e, f, g, roundValues[i + 1]);
+                NEXTCASH_SHA256_ROUND(g, h, a, b, c, d, e, f, roundValues[i + 2]);
+                NEXTCASH_SHA256_ROUND(f, g, h, a, b, c, d, e, roundValues[i + 3]);
+                NEXTCASH_SHA256_ROUND(e, f, g, h, a, b, c, d, roundValues[i + 4]);
+                NEXTCASH_SHA256_ROUND(d, e, f, g, h, a, b, c, roundValues[i + 5]);
+                NEXTCASH_SHA256_ROUND(c, d, e, f, g, h, a, b, roundValues[i + 6]);
+                NEXTCASH_SHA256_ROUND(b, c, d, e, f, g, h, a, roundValues[i + 7]);
+            }
 
-        while(remaining >= 64)
-        {
-            pInput->read(block, 64);
-            remaining -= 64;
-            SHA256::process(result, block);
+            pResult[0] += a;
+            pResult[1] += b;
+            pResult[2] += c;
+            pResult[3] += d;
+            pResult[4] += e;
+            pResult[5] += f;
+            pResult[6] += g;
+            pResult[7] += h;
         }
 
-        pInput->read(block, remaining);
-        SHA256::finish(result, block, remaining, pInputLength);
-
-        pOutput->write(result, 32);
-        return;
-    }
-
-    namespace SHA512
-    {
-        static const uint64_t table[80] =
+        static __attribute__((target("sse4.1")))
+        void processSSE4(uint32_t *pResult, uint32_t *pBlock)
         {
-            0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
-            0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
-            0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
-            0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
-            0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
-            0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
-            0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
-            0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
-            0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
-            0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
-            0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
-            0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
-            0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
-            0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
-            0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
-            0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
-            0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
-            0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
-            0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
-            0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
-        };
+            processVector(pResult, pBlock);
+        }
 
-        void initialize(uint32_t *pResult)
+        static __attribute__((target("avx2,bmi2")))
+        void processAVX2(uint32_t *pResult, uint32_t *pBlock)
         {
-            ((uint64_t *)pResult)[0] = 0x6a09e667f3bcc908;
-            ((uint64_t *)pResult)[1] = 0xbb67ae8584caa73b;
-            ((uint64_t *)pResult)[2] = 0x3c6ef372fe94f82b;
-            ((uint64_t *)pResult)[3] = 0xa54ff53a5f1d36f1;
-            ((uint64_t *)pResult)[4] = 0x510e527fade682d1;
-            ((uint64_t *)pResult)[5] = 0x9b05688c2b3e6c1f;
-            ((uint64_t *)pResult)[6] = 0x1f83d9abfb41bd6b;
-            ((uint64_t *)pResult)[7] = 0x5be0cd19137e2179;
+            processVector(pResult, pBlock);
         }
 
-        void process(uint32_t *pResult, uint32_t *pBlock)
+        // SHA extensions do 2 rounds per instruction and most of the message schedule in
+        //   hardware.
+        static __attribute__((target("sha,sse4.1")))
+        void processSHANI(uint32_t *pResult, uint32_t *pBlock)
         {
-            unsigned int i;
-            uint64_t s0, s1, t1, t2;
-            uint64_t extendedBlock[80];
+            const __m128i swapMask =
+              _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+            __m128i words[4], roundValues, temp;
 
-            std::memcpy(extendedBlock, pBlock, 128);
+            // The instructions take the state as ABEF and CDGH.
+            __m128i state0 = _mm_loadu_si128((__m128i *)pResult); // DCBA
+            __m128i state1 = _mm_loadu_si128((__m128i *)pResult + 1); // HGFE
+            temp = _mm_shuffle_epi32(state0, 0xb1); // CDAB
+            state1 = _mm_shuffle_epi32(state1, 0x1b); // EFGH
+            state0 = _mm_alignr_epi8(temp, state1, 8); // ABEF
+            state1 = _mm_blend_epi16(state1, temp, 0xf0); // CDGH
 
-            // Adjust for big endian
-            if(Endian::sSystemType != Endian::BIG)
-                for(i=0;i<16;++i)
-                    extendedBlock[i] = Endian::convert(extendedBlock[i], Endian::BIG);
+            __m128i saveState0 = state0, saveState1 = state1;
 
-            // Extend the block to 80 64-bit words:
-            for(i=16;i<80;++i)
+            for(unsigned int i = 0; i < 16; ++i)
             {
-                s0 = extendedBlock[i-15];
-                s0 = Math::rotateRight64(s0, 1) ^ Math::rotateRight64(s0, 8) ^ (s0 >> 7);
+                // words[i % 4] holds words 4(i-4) to 4(i-4)+3 and is replaced with the next 4.
+                if(i < 4)
+                    words[i] =
+                      _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)pBlock + i), swapMask);
+                else
+                    words[i & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(
+                      _mm_sha256msg1_epu32(words[i & 3], words[(i + 1) & 3]),
+                      _mm_alignr_epi8(words[(i + 3) & 3], words[(i + 2) & 3], 4)),
+                      words[(i + 3) & 3]);
+
+                roundValues = _mm_add_epi32(words[i & 3], _mm_loadu_si128((__m128i *)table + i));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, roundValues);
+                state0 = _mm_sha256rnds2_epu32(state0, state1,
+                  _mm_shuffle_epi32(roundValues, 0x0e));
+            }
 
-                s1 = extendedBlock[i-2];
-                s1 = Math::rotateRight64(s1, 19) ^ Math::rotateRight64(s1, 61) ^ (s1 >> 6);
+            state0 = _mm_add_epi32(state0, saveState0);
+            state1 = _mm_add_epi32(state1, saveState1);
 
-                extendedBlock[i] = extendedBlock[i-16] + extendedBlock[i-7] + s0 + s1;
-            }
+            temp = _mm_shuffle_epi32(state0, 0x1b); // FEBA
+            state1 = _mm_shuffle_epi32(state1, 0xb1); // DCHG
+            state0 = _mm_blend_epi16(temp, state1, 0xf0); // DCBA
+            state1 = _mm_alignr_epi8(state1, temp, 8); // ABEF -> HGFE
 
-            uint64_t state[8];
-            std::memcpy(state, pResult, 64);
+            _mm_storeu_si128((__m128i *)pResult, state0);
+            _mm_storeu_si128((__m128i *)pResult + 1, state1);
+        }
+#endif
 
-            for(i=0;i<80;++i)
-            {
-                s0 = Math::rotateRight64(state[0], 28) ^ Math::rotateRight64(state[0], 34) ^ Math::rotateRight64(state[0], 39);
-                t2 = s0 +((state[0] & state[1]) ^ (state [0] & state[2]) ^ (state[1] & state[2]));
-                s1 = Math::rotateRight64(state[4], 14) ^ Math::rotateRight64(state[4], 18) ^ Math::rotateRight64(state[4], 41);
-                t1 = state[7] + s1 + ((state[4] & state[5]) ^ (~state[4] & state[6])) + table[i] + extendedBlock[i];
+        typedef void (*ProcessFunction)(uint32_t *pResult, uint32_t *pBlock);
 
-                state[7] = state[6];
-                state[6] = state[5];
-                state[5] = state[4];
-                state[4] = state[3] + t1;
-                state[3] = state[2];
-                state[2] = state[1];
-                state[1] = state[0];
-                state[0] = t1 + t2;
+        static ProcessFunction processFunction(Digest::SHA256Implementation pImplementation)
+        {
+            switch(pImplementation)
+            {
+#ifdef NEXTCASH_X86_INTRINSICS
+            case Digest::SHA256_SSE4:
+                return processSSE4;
+            case Digest::SHA256_AVX2:
+                return processAVX2;
+            case Digest::SHA256_SHA_NI:
+                return processSHANI;
+#endif
+            default:
+                return processGeneric;
             }
+        }
 
-            for(i=0;i<8;++i)
-                ((uint64_t *)pResult)[i] += state[i];
+        static std::atomic<int> sImplementation(-1); // Chosen on first use.
+        static std::atomic<ProcessFunction> sProcess(NULL);
+
+        static Digest::SHA256Implementation fastestImplementation()
+        {
+            if(Digest::sha256Supported(Digest::SHA256_SHA_NI))
+                return Digest::SHA256_SHA_NI;
+            if(Digest::sha256Supported(Digest::SHA256_AVX2))
+                return Digest::SHA256_AVX2;
+            if(Digest::sha256Supported(Digest::SHA256_SSE4))
+                return Digest::SHA256_SSE4;
+            return Digest::SHA256_GENERIC;
+        }
+
+        static void setImplementation(Digest::SHA256Implementation pImplementation)
+        {
+            sProcess.store(processFunction(pImplementation), std::memory_order_relaxed);
+            sImplementation.store(pImplementation, std::memory_order_relaxed);
+        }
+
+        void process(uint32_t *pResult, uint32_t *pBlock)
+        {
+            ProcessFunction function = sProcess.load(std::memory_order_relaxed);
+            if(function == NULL)
+            {
+                setImplementation(fastestImplementation());
+                function = sProcess.load(std::memory_order_relaxed);
+            }
+            function(pResult, pBlock);
         }
 
         void finish(uint32_t *pResult, uint32_t *pBlock, unsigned int pBlockLength, uint64_t pTotalLength)
         {
             // Zeroize the end of the block
-            if(pBlockLength < 128)
-                std::memset(((uint8_t *)pBlock) + pBlockLength, 0, 128 - pBlockLength);
+            std::memset(((uint8_t *)pBlock) + pBlockLength, 0, 64 - pBlockLength);
 
             // Add 0x80 byte (basically a 1 bit at the end of the data)
             ((uint8_t *)pBlock)[pBlockLength] = 0x80;
 
             // Check if there is enough room for the total length in this block
-            if(pBlockLength > 111) // 112 - 1 because of the 0x80 byte already added
+            if(pBlockLength > 55) // 56 - 1 because of the 0x80 byte already added
             {
                 process(pResult, pBlock); // Process this block
-                std::memset(pBlock, 0, 128); // Clear the block
+                std::memset(pBlock, 0, 64); // Clear the block
             }
 
-            // Put bit length in last 16 bytes of block (Big Endian)
+            // Put bit length in last 8 bytes of block (Big Endian)
             pTotalLength *= 8;
-            ((uint64_t *)pBlock)[15] = Endian::convert(pTotalLength, Endian::BIG);
+            ((uint64_t *)pBlock)[7] = Endian::convert(pTotalLength, Endian::BIG);
 
             // Process last block
             process(pResult, pBlock);
 
             // Adjust for big endian
             if(Endian::sSystemType != Endian::BIG)
-                for(unsigned int i=0;i<8;++i)
-                    ((uint64_t *)pResult)[i] = Endian::convert(((uint64_t *)pResult)[i], Endian::BIG);
+                for(unsigned int i=0;i<8;i++)
+                    pResult[i] = Endian::convert(pResult[i], Endian::BIG);
         }
-    }
 
-    void Digest::sha512(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput) // 512 bit(64 byte) result
-    {
-        stream_size remaining = pInputLength;
-        uint32_t result[16];
+        static void writeResult(const uint32_t *pState, uint8_t *pResult)
+        {
+            uint32_t word;
+            for(unsigned int i = 0; i < 8; ++i, pResult += 4)
+            {
+                word = Endian::convert(pState[i], Endian::BIG);
+                std::memcpy(pResult, &word, 4);
+            }
+        }
+
+        // Pads the last partial block of a message with pLength bytes of it already at pBlocks.
+        //   pBlocks must have room for 2 blocks. Returns the number of blocks (1 or 2).
+        static unsigned int pad(uint8_t *pBlocks, unsigned int pLength, uint64_t pTotalLength)
+        {
+            std::memset(pBlocks + pLength, 0, 128 - pLength);
+            pBlocks[pLength] = 0x80;
+
+            unsigned int result = pLength > 55 ? 2 : 1;
+            uint64_t bitLength = Endian::convert(pTotalLength * 8, Endian::BIG);
+            std::memcpy(pBlocks + (result * 64) - 8, &bitLength, 8);
+            return result;
+        }
+
+        // Message schedule plus round constants of a block that is only padding, which is the
+        //   second block of every 64 byte message.
+        class PaddingRoundValues
+        {
+        public:
+
+            PaddingRoundValues(uint64_t pTotalLength)
+            {
+                uint32_t extendedBlock[64];
+                std::memset(extendedBlock, 0, sizeof(extendedBlock));
+                extendedBlock[0] = 0x80000000;
+                extendedBlock[15] = (uint32_t)(pTotalLength * 8);
+
+                uint32_t s0, s1;
+                for(unsigned int i = 16; i < 64; ++i)
+                {
+                    s0 = extendedBlock[i - 15];
+                    s0 = Math::rotateRight(s0, 7) ^ Math::rotateRight(s0, 18) ^ (s0 >> 3);
+                    s1 = extendedBlock[i - 2];
+                    s1 = Math::rotateRight(s1, 17) ^ Math::rotateRight(s1, 19) ^ (s1 >> 10);
+                    extendedBlock[i] = extendedBlock[i - 16] + extendedBlock[i - 7] + s0 + s1;
+                }
+
+                for(unsigned int i = 0; i < 64; ++i)
+                    values[i] = extendedBlock[i] + table[i];
+            }
+
+            uint32_t values[64];
+
+        };
+
+        static const PaddingRoundValues &padding64()
+        {
+            static const PaddingRoundValues result(64);
+            return result;
+        }
+
+        // Hashes one input of a batch, then hashes the result if pDouble. Provides one block at a
+        //   time so different inputs can be processed together.
+        class HashJob
+        {
+        public:
+
+            HashJob() { mResult = NULL; }
+
+            void start(const uint8_t *pData, stream_size pLength, uint8_t *pResult, bool pDouble)
+            {
+                initialize(state);
+                mData = pData;
+                mFullBlocks = pLength / 64;
+                unsigned int tailLength = pLength % 64;
+                if(tailLength > 0)
+                    std::memcpy(mTail, pData + (mFullBlocks * 64), tailLength);
+                mTailBlocks = pad(mTail, tailLength, pLength);
+                mTailBlock = 0;
+                mSecond = !pDouble;
+                mResult = pResult;
+            }
+
+            // Returns the next block to process into state. Returns NULL when the job is finished
+            //   and the result has been written.
+            const uint8_t *nextBlock()
+            {
+                if(mResult == NULL)
+                    return NULL;
+
+                if(mFullBlocks > 0)
+                {
+                    const uint8_t *result = mData;
+                    mData += 64;
+                    --mFullBlocks;
+                    return result;
+                }
+
+                if(mTailBlock < mTailBlocks)
+                    return mTail + (64 * mTailBlock++);
+
+                if(!mSecond)
+                {
+                    // Hash the first result.
+                    writeResult(state, mTail);
+                    mTailBlocks = pad(mTail, 32, 32);
+                    mTailBlock = 1;
+                    mSecond = true;
+                    initialize(state);
+                    return mTail;
+                }
+
+                writeResult(state, mResult);
+                mResult = NULL;
+                return NULL;
+            }
+
+            uint32_t state[8];
+
+        private:
+
+            const uint8_t *mData;
+            stream_size mFullBlocks;
+            uint8_t mTail[128];
+            unsigned int mTailBlocks, mTailBlock;
+            bool mSecond; // Hashing the first result, or not double hashing
+            uint8_t *mResult;
+
+        };
+
+        // Processes one block into each state. Blocks don't have to be aligned.
+        typedef void (*LanesFunction)(uint32_t **pStates, const uint8_t **pBlocks);
+        // SHA256(SHA256()) of consecutive 64 byte inputs, one per lane.
+        typedef void (*Lanes64Function)(const uint8_t *pInputs, uint8_t *pResults);
+
+        static void processOneLane(uint32_t **pStates, const uint8_t **pBlocks)
+        {
+            uint32_t block[16];
+            std::memcpy(block, *pBlocks, 64);
+            process(*pStates, block);
+        }
+
+        static void doubleHash64OneLane(const uint8_t *pInput, uint8_t *pResult)
+        {
+            uint32_t state[8], block[32]; // Room for pad
+
+            initialize(state);
+            std::memcpy(block, pInput, 64);
+            process(state, block);
+            pad((uint8_t *)block, 0, 64);
+            process(state, block);
+
+            writeResult(state, (uint8_t *)block);
+            pad((uint8_t *)block, 32, 32);
+            initialize(state);
+            process(state, block);
+            writeResult(state, pResult);
+        }
+
+#ifdef NEXTCASH_X86_INTRINSICS
+        // Each lane of the GCC vector types holds the value for a different message.
+        typedef uint32_t Lanes4 __attribute__((vector_size(16)));
+        typedef uint32_t Lanes8 __attribute__((vector_size(32)));
+
+        // Extends the 16 words in each lane of pWords in place while doing the rounds, then adds
+        //   the result to pState.
+        template <class tVector>
+        static inline __attribute__((always_inline))
+        void transformLanes(tVector *pState, tVector *pWords)
+        {
+            tVector a = pState[0], b = pState[1], c = pState[2], d = pState[3];
+            tVector e = pState[4], f = pState[5], g = pState[6], h = pState[7];
+            tVector s0, s1;
+
+            for(unsigned int i = 0; i < 64; i += 8)
+            {
+                if(i >= 16)
+                    for(unsigned int j = i; j < i + 8; ++j)
+                    {
+                        s0 = pWords[(j + 1) & 15];
+                        s0 = NEXTCASH_SHA256_ROTATE_RIGHT(s0, 7) ^
+                          NEXTCASH_SHA256_ROTATE_RIGHT(s0, 18) ^ (s0 >> 3);
+                        s1 = pWords[(j + 14) & 15];
+                        s1 = NEXTCASH_SHA256_ROTATE_RIGHT(s1, 17) ^
+                          NEXTCASH_SHA256_ROTATE_RIGHT(s1, 19) ^ (s1 >> 10);
+                        pWords[j & 15] += s0 + pWords[(j + 9) & 15] + s1;
+                    }
+
+                NEXTCASH_SHA256_ROUND(a, b, c, d, e, f, g, h, pWords[i & 15] + table[i]);
+                NEXTCASH_SHA256_ROUND(h, a, b, c, d, e, f, g, pWords[(i + 1) & 15] + table[i + 1]);
+                NEXTCASH_SHA256_ROUND(g, h, a, b, c, d, e, f, pWords[(i + 2) & 15] + table[i + 2]);
+                NEXTCASH_SHA256_ROUND(f, g, h, a, b, c, d, e, pWords[(i + 3) & 15] + table[i + 3]);
+                NEXTCASH_SHA256_ROUND(e, f, g, h, a, b, c, d, pWords[(i + 4) & 15] + table[i + 4]);
+                NEXTCASH_SHA256_ROUND(d, e, f, g, h, a, b, c, pWords[(i + 5) & 15] + table[i + 5]);
+                NEXTCASH_SHA256_ROUND(c, d, e, f, g, h, a, b, pWords[(i + 6) & 15] + table[i + 6]);
+                NEXTCASH_SHA256_ROUND(b, c, d, e, f, g, h, a, pWords[(i + 7) & 15] + table[i + 7]);
+            }
+
+            pState[0] += a;
+            pState[1] += b;
+            pState[2] += c;
+            pState[3] += d;
+            pState[4] += e;
+            pState[5] += f;
+            pState[6] += g;
+            pState[7] += h;
+        }
+
+        // Same as transformLanes with the same precomputed words and round constants for every
+        //   lane.
+        template <class tVector>
+        static inline __attribute__((always_inline))
+        void transformLanes(tVector *pState, const uint32_t *pRoundValues)
+        {
+            tVector a = pState[0], b = pState[1], c = pState[2], d = pState[3];
+            tVector e = pState[4], f = pState[5], g = pState[6], h = pState[7];
+
+            for(unsigned int i = 0; i < 64; i += 8)
+            {
+                NEXTCASH_SHA256_ROUND(a, b, c, d, e, f, g, h, pRoundValues[i]);
+                NEXTCASH_SHA256_ROUND(h, a, b, c, d, e, f, g, pRoundValues[i + 1]);
+                NEXTCASH_SHA256_ROUND(g, h, a, b, c, d, e, f, pRoundValues[i + 2]);
+                NEXTCASH_SHA256_ROUND(f, g, h, a, b, c, d, e, pRoundValues[i + 3]);
+                NEXTCASH_SHA256_ROUND(e, f, g, h, a, b, c, d, pRoundValues[i + 4]);
+                NEXTCASH_SHA256_ROUND(d, e, f, g, h, a, b, c, pRoundValues[i + 5]);
+                NEXTCASH_SHA256_ROUND(c, d, e, f, g, h, a, b, pRoundValues[i + 6]);
+                NEXTCASH_SHA256_ROUND(b, c, d, e, f, g, h, a, pRoundValues[i + 7]);
+            }
+
+            pState[0] += a;
+            pState[1] += b;
+            pState[2] += c;
+            pState[3] += d;
+            pState[4] += e;
+            pState[5] += f;
+            pState[6] += g;
+            pState[7] += h;
+        }
+
+        // Loads word i of each lane's block into pWords[i] as big endian.
+        template <class tVector, unsigned int tLanes>
+        static inline __attribute__((always_inline))
+        void loadLanes(tVector *pWords, const uint8_t **pBlocks)
+        {
+            uint32_t words[16][tLanes], word;
+            for(unsigned int lane = 0; lane < tLanes; ++lane)
+                for(unsigned int i = 0; i < 16; ++i)
+                {
+                    std::memcpy(&word, pBlocks[lane] + (i * 4), 4);
+                    words[i][lane] = Endian::convert(word, Endian::BIG);
+                }
+            std::memcpy(pWords, words, sizeof(words));
+        }
+
+        template <class tVector, unsigned int tLanes>
+        static inline __attribute__((always_inline))
+        void processLanes(uint32_t **pStates, const uint8_t **pBlocks)
+        {
+            uint32_t values[8][tLanes];
+            tVector state[8], words[16];
+
+            for(unsigned int lane = 0; lane < tLanes; ++lane)
+                for(unsigned int i = 0; i < 8; ++i)
+                    values[i][lane] = pStates[lane][i];
+            std::memcpy(state, values, sizeof(values));
+
+            loadLanes<tVector, tLanes>(words, pBlocks);
+            transformLanes(state, words);
+
+            std::memcpy(values, state, sizeof(values));
+            for(unsigned int lane = 0; lane < tLanes; ++lane)
+                for(unsigned int i = 0; i < 8; ++i)
+                    pStates[lane][i] = values[i][lane];
+        }
+
+        // The state stays in vectors through both hashes. The second block of the first hash is
+        //   all padding so its words are precomputed, and the first hash is already in the
+        //   layout needed for the words of the second hash.
+        template <class tVector, unsigned int tLanes>
+        static inline __attribute__((always_inline))
+        void doubleHash64Lanes(const uint8_t *pInputs, uint8_t *pResults)
+        {
+            static const uint32_t initialState[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+              0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+            const uint8_t *blocks[tLanes];
+            tVector state[8], words[16];
+            unsigned int i;
+
+            for(unsigned int lane = 0; lane < tLanes; ++lane)
+                blocks[lane] = pInputs + (lane * 64);
+
+            for(i = 0; i < 8; ++i)
+                state[i] = tVector{} + initialState[i];
+            loadLanes<tVector, tLanes>(words, blocks);
+            transformLanes(state, words);
+            transformLanes(state, padding64().values);
+
+            // Second hash of the 32 byte first hash.
+            for(i = 0; i < 8; ++i)
+            {
+                words[i] = state[i];
+                state[i] = tVector{} + initialState[i];
+            }
+            words[8] = tVector{} + 0x80000000;
+            for(i = 9; i < 15; ++i)
+                words[i] = tVector{};
+            words[15] = tVector{} + 256;
+            transformLanes(state, words);
+
+            uint32_t values[8][tLanes];
+            std::memcpy(values, state, sizeof(values));
+            for(unsigned int lane = 0; lane < tLanes; ++lane)
+                for(i = 0; i < 8; ++i)
+                {
+                    uint32_t word = Endian::convert(values[i][lane], Endian::BIG);
+                    std::memcpy(pResults + (lane * 32) + (i * 4), &word, 4);
+                }
+        }
+
+        static __attribute__((target("sse4.1")))
+        void processLanesSSE4(uint32_t **pStates, const uint8_t **pBlocks)
+        {
+            processLanes<Lanes4, 4>(pStates, pBlocks);
+        }
+
+        static __attribute__((target("sse4.1")))
+        void doubleHash64LanesSSE4(const uint8_t *pInputs, uint8_t *pResults)
+        {
+            doubleHash64Lanes<Lanes4, 4>(pInputs, pResults);
+        }
+
+        static __attribute__((target("avx2")))
+        void processLanesAVX2(uint32_t **pStates, const uint8_t **pBlocks)
+        {
+            processLanes<Lanes8, 8>(pStates, pBlocks);
+        }
+
+        static __attribute__((target("avx2")))
+        void doubleHash64LanesAVX2(const uint8_t *pInputs, uint8_t *pResults)
+        {
+            doubleHash64Lanes<Lanes8, 8>(pInputs, pResults);
+        }
+#endif
+
+        static const unsigned int MAX_LANES = 8;
+
+        // Returns the number of lanes used with the current implementation. 8 lanes of AVX2 are
+        //   faster than SHA extensions one message at a time, so they are used when both are
+        //   supported.
+        static unsigned int lanes(LanesFunction &pFunction, Lanes64Function &pFunction64)
+        {
+            switch(Digest::sha256Implementation())
+            {
+#ifdef NEXTCASH_X86_INTRINSICS
+            case Digest::SHA256_SSE4:
+                pFunction = processLanesSSE4;
+                pFunction64 = doubleHash64LanesSSE4;
+                return 4;
+            case Digest::SHA256_SHA_NI:
+                if(!Digest::sha256Supported(Digest::SHA256_AVX2))
+                    break;
+                // Fall through
+            case Digest::SHA256_AVX2:
+                pFunction = processLanesAVX2;
+                pFunction64 = doubleHash64LanesAVX2;
+                return 8;
+#endif
+            default:
+                break;
+            }
+
+            pFunction = processOneLane;
+            pFunction64 = doubleHash64OneLane;
+            return 1;
+        }
+
+        // SHA256 of each input, or SHA256(SHA256()) if pDouble.
+        void hashBatch(const uint8_t *const *pInputs, const stream_size *pLengths,
+          unsigned int pCount, uint8_t *pResults, bool pDouble)
+        {
+            LanesFunction function;
+            Lanes64Function function64;
+            unsigned int laneCount = lanes(function, function64);
+
+            HashJob jobs[MAX_LANES];
+            bool active[MAX_LANES];
+            uint32_t *states[MAX_LANES];
+            const uint8_t *blocks[MAX_LANES];
+            uint32_t unusedState[8];
+            uint8_t unusedBlock[64];
+            unsigned int next = 0, activeCount, lane;
+
+            std::memset(unusedBlock, 0, 64);
+            for(lane = 0; lane < laneCount; ++lane)
+                active[lane] = true;
+
+            while(true)
+            {
+                // Start the next input in each lane that finished.
+                activeCount = 0;
+                for(lane = 0; lane < laneCount; ++lane)
+                {
+                    blocks[lane] = NULL;
+                    while(active[lane] && (blocks[lane] = jobs[lane].nextBlock()) == NULL)
+                    {
+                        if(next < pCount)
+                        {
+                            jobs[lane].start(pInputs[next], pLengths[next], pResults + (next * 32),
+                              pDouble);
+                            ++next;
+                        }
+                        else
+                            active[lane] = false;
+                    }
+
+                    if(blocks[lane] == NULL)
+                    {
+                        states[lane] = unusedState;
+                        blocks[lane] = unusedBlock;
+                    }
+                    else
+                    {
+                        states[lane] = jobs[lane].state;
+                        ++activeCount;
+                    }
+                }
+
+                if(activeCount == 0)
+                    break;
+
+                function(states, blocks);
+            }
+        }
+
+        void doubleHash64Batch(const uint8_t *pInputs, unsigned int pCount, uint8_t *pResults)
+        {
+            LanesFunction function;
+            Lanes64Function function64;
+            unsigned int laneCount = lanes(function, function64);
+
+            for(; pCount >= laneCount; pCount -= laneCount)
+            {
+                function64(pInputs, pResults);
+                pInputs += laneCount * 64;
+                pResults += laneCount * 32;
+            }
+
+            for(; pCount > 0; --pCount, pInputs += 64, pResults += 32)
+                doubleHash64OneLane(pInputs, pResults);
+        }
+    }
+
+    bool Digest::sha256Supported(SHA256Implementation pImplementation)
+    {
+        switch(pImplementation)
+        {
+        case SHA256_GENERIC:
+            return true;
+        case SHA256_SSE4:
+            return CPU::has(CPU::SSE41);
+        case SHA256_AVX2:
+            return CPU::has(CPU::AVX2) && CPU::has(CPU::BMI2);
+        case SHA256_SHA_NI:
+            return CPU::has(CPU::SHA) && CPU::has(CPU::SSE41);
+        }
+        return false;
+    }
+
+    bool Digest::setSHA256Implementation(SHA256Implementation pImplementation)
+    {
+        if(!sha256Supported(pImplementation))
+            return false;
+        SHA256::setImplementation(pImplementation);
+        return true;
+    }
+
+    void Digest::resetSHA256Implementation()
+    {
+        SHA256::setImplementation(SHA256::fastestImplementation());
+    }
+
+    Digest::SHA256Implementation Digest::sha256Implementation()
+    {
+        int result = SHA256::sImplementation.load(std::memory_order_relaxed);
+        if(result == -1)
+            return SHA256::fastestImplementation();
+        return (SHA256Implementation)result;
+    }
+
+    const char *Digest::sha256ImplementationName(SHA256Implementation pImplementation)
+    {
+        switch(pImplementation)
+        {
+        case SHA256_GENERIC:
+            return "Generic";
+        case SHA256_SSE4:
+            return "SSE4";
+        case SHA256_AVX2:
+            return "AVX2";
+        case SHA256_SHA_NI:
+            return "SHA-NI";
+        }
+        return "Unknown";
+    }
+
+    void Digest::sha256(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput) // 256 bit(32 byte) result
+    {
+        stream_size remaining = pInputLength;
+        uint32_t result[8];
+        uint32_t block[16];
+
+        SHA256::initialize(result);
+
+        while(remaining >= 64)
+        {
+            pInput->read(block, 64);
+            remaining -= 64;
+            SHA256::process(result, block);
+        }
+
+        pInput->read(block, remaining);
+        SHA256::finish(result, block, remaining, pInputLength);
+
+        pOutput->write(result, 32);
+        return;
+    }
+
+    void Digest::sha256SHA256Batch(const uint8_t *const *pInputs, const stream_size *pLengths,
+      unsigned int pCount, uint8_t *pResults)
+    {
+        SHA256::hashBatch(pInputs, pLengths, pCount, pResults, true);
+    }
+
+    void Digest::sha256SHA256Batch64(const uint8_t *pInputs, unsigned int pCount,
+      uint8_t *pResults)
+    {
+        SHA256::doubleHash64Batch(pInputs, pCount, pResults);
+    }
+
+    namespace RIPEMD160
+    {
+        // RIPEMD160 of 32 byte inputs, like SHA256 results, which are one block each.
+        typedef void (*Hash32Function)(const uint8_t *pInputs, uint8_t *pResults);
+
+        static void hash32OneLane(const uint8_t *pInput, uint8_t *pResult)
+        {
+            uint32_t state[5], block[16];
+
+            initialize(state);
+            std::memcpy(block, pInput, 32);
+            finish(state, block, 32, 32);
+            std::memcpy(pResult, state, 20);
+        }
+
+#ifdef NEXTCASH_X86_INTRINSICS
+        // Pads the 32 byte messages in the first 8 words of each lane of pWords, hashes them, and
+        //   writes the 20 byte results.
+        template <class tVector, unsigned int tLanes>
+        static inline __attribute__((always_inline))
+        void finish32Lanes(tVector *pWords, uint8_t *pResults)
+        {
+            static const uint32_t initialState[5] =
+              { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+            tVector state[5];
+            unsigned int i;
+
+            pWords[8] = tVector{} + 0x80;
+            for(i = 9; i < 16; ++i)
+                pWords[i] = tVector{};
+            pWords[14] = tVector{} + 256; // Bit length
+
+            for(i = 0; i < 5; ++i)
+                state[i] = tVector{} + initialState[i];
+            transform(state, pWords);
+
+            uint32_t values[5][tLanes], word;
+            std::memcpy(values, state, sizeof(values));
+            for(unsigned int lane = 0; lane < tLanes; ++lane)
+                for(i = 0; i < 5; ++i)
+                {
+                    word = Endian::convert(values[i][lane], Endian::LITTLE);
+                    std::memcpy(pResults + (lane * 20) + (i * 4), &word, 4);
+                }
+        }
+
+        template <class tVector, unsigned int tLanes>
+        static inline __attribute__((always_inline))
+        void hash32Lanes(const uint8_t *pInputs, uint8_t *pResults)
+        {
+            uint32_t values[8][tLanes], word;
+            tVector words[16];
+
+            for(unsigned int lane = 0; lane < tLanes; ++lane)
+                for(unsigned int i = 0; i < 8; ++i)
+                {
+                    std::memcpy(&word, pInputs + (lane * 32) + (i * 4), 4);
+                    values[i][lane] = Endian::convert(word, Endian::LITTLE);
+                }
+            std::memcpy(words, values, sizeof(values));
+
+            finish32Lanes<tVector, tLanes>(words, pResults);
+        }
+
+        // HASH160 of messages that fit in one SHA256 block (up to 55 bytes). The SHA256 result
+        //   stays in vectors and only needs its bytes swapped to be the RIPEMD160 words.
+        template <class tVector, unsigned int tLanes>
+        static inline __attribute__((always_inline))
+        void hash160ShortLanes(const uint8_t *const *pInputs, const stream_size *pLengths,
+          uint8_t *pResults)
+        {
+            uint8_t blocks[tLanes][128]; // Room for pad
+            const uint8_t *blockPointers[tLanes];
+            uint32_t initialState[8];
+            tVector state[8], words[16];
+            unsigned int i;
+
+            for(unsigned int lane = 0; lane < tLanes; ++lane)
+            {
+                std::memcpy(blocks[lane], pInputs[lane], pLengths[lane]);
+                SHA256::pad(blocks[lane], pLengths[lane], pLengths[lane]);
+                blockPointers[lane] = blocks[lane];
+            }
+
+            SHA256::initialize(initialState);
+            for(i = 0; i < 8; ++i)
+                state[i] = tVector{} + initialState[i];
+            SHA256::loadLanes<tVector, tLanes>(words, blockPointers);
+            SHA256::transformLanes(state, words);
+
+            for(i = 0; i < 8; ++i)
+                words[i] = (state[i] >> 24) | ((state[i] >> 8) & 0xff00) |
+                  ((state[i] & 0xff00) << 8) | (state[i] << 24);
+
+            finish32Lanes<tVector, tLanes>(words, pResults);
+        }
+
+        static __attribute__((target("sse4.1")))
+        void hash32LanesSSE4(const uint8_t *pInputs, uint8_t *pResults)
+        {
+            hash32Lanes<SHA256::Lanes4, 4>(pInputs, pResults);
+        }
+
+        static __attribute__((target("sse4.1")))
+        void hash160ShortLanesSSE4(const uint8_t *const *pInputs, const stream_size *pLengths,
+          uint8_t *pResults)
+        {
+            hash160ShortLanes<SHA256::Lanes4, 4>(pInputs, pLengths, pResults);
+        }
+
+        static __attribute__((target("avx2")))
+        void hash32LanesAVX2(const uint8_t *pInputs, uint8_t *pResults)
+        {
+            hash32Lanes<SHA256::Lanes8, 8>(pInputs, pResults);
+        }
+
+        static __attribute__((target("avx2")))
+        void hash160ShortLanesAVX2(const uint8_t *const *pInputs, const stream_size *pLengths,
+          uint8_t *pResults)
+        {
+            hash160ShortLanes<SHA256::Lanes8, 8>(pInputs, pLengths, pResults);
+        }
+#endif
+
+        typedef void (*Hash160ShortFunction)(const uint8_t *const *pInputs,
+          const stream_size *pLengths, uint8_t *pResults);
+
+        // Same lane counts as the SHA256 batches for the current SHA256 implementation.
+        static unsigned int lanes(Hash32Function &pFunction, Hash160ShortFunction &pShortFunction)
+        {
+            switch(Digest::sha256Implementation())
+            {
+#ifdef NEXTCASH_X86_INTRINSICS
+            case Digest::SHA256_SSE4:
+                pFunction = hash32LanesSSE4;
+                pShortFunction = hash160ShortLanesSSE4;
+                return 4;
+            case Digest::SHA256_SHA_NI:
+                if(!Digest::sha256Supported(Digest::SHA256_AVX2))
+                {
+                    pFunction = hash32LanesSSE4;
+                    pShortFunction = hash160ShortLanesSSE4;
+                    return 4;
+                }
+                // Fall through
+            case Digest::SHA256_AVX2:
+                pFunction = hash32LanesAVX2;
+                pShortFunction = hash160ShortLanesAVX2;
+                return 8;
+#endif
+            default:
+                break;
+            }
+
+            pFunction = hash32OneLane;
+            pShortFunction = NULL;
+            return 1;
+        }
+
+        static void hash32Batch(const uint8_t *pInputs, unsigned int pCount, uint8_t *pResults,
+          Hash32Function pFunction, unsigned int pLaneCount)
+        {
+            for(; pCount >= pLaneCount; pCount -= pLaneCount)
+            {
+                pFunction(pInputs, pResults);
+                pInputs += pLaneCount * 32;
+                pResults += pLaneCount * 20;
+            }
+
+            for(; pCount > 0; --pCount, pInputs += 32, pResults += 20)
+                hash32OneLane(pInputs, pResults);
+        }
+    }
+
+    void Digest::sha256RIPEMD160Batch(const uint8_t *const *pInputs, const stream_size *pLengths,
+      unsigned int pCount, uint8_t *pResults)
+    {
+        RIPEMD160::Hash32Function function;
+        RIPEMD160::Hash160ShortFunction shortFunction;
+        unsigned int laneCount = RIPEMD160::lanes(function, shortFunction);
+
+        // Inputs that don't fit in one block are hashed in groups whose SHA256 results stay in
+        //   L1 cache for RIPEMD160.
+        static const unsigned int GROUP_SIZE = 64;
+        const uint8_t *pending[GROUP_SIZE];
+        stream_size pendingLengths[GROUP_SIZE];
+        unsigned int pendingIndices[GROUP_SIZE], pendingCount = 0, index = 0, lane;
+        uint8_t hashes[GROUP_SIZE * 32], results[GROUP_SIZE * 20];
+
+        while(index < pCount || pendingCount > 0)
+        {
+            if(pendingCount == GROUP_SIZE || (index == pCount && pendingCount > 0))
+            {
+                SHA256::hashBatch(pending, pendingLengths, pendingCount, hashes, false);
+                RIPEMD160::hash32Batch(hashes, pendingCount, results, function, laneCount);
+                for(unsigned int i = 0; i < pendingCount; ++i)
+                    std::memcpy(pResults + (pendingIndices[i] * 20), results + (i * 20), 20);
+                pendingCount = 0;
+                continue;
+            }
+
+            // Hash a full set of lanes directly when they all fit in one block.
+            if(shortFunction != NULL && index + laneCount <= pCount)
+            {
+                for(lane = 0; lane < laneCount; ++lane)
+                    if(pLengths[index + lane] > 55)
+                        break;
+                if(lane == laneCount)
+                {
+                    shortFunction(pInputs + index, pLengths + index, pResults + (index * 20));
+                    index += laneCount;
+                    continue;
+                }
+            }
+
+            pending[pendingCount] = pInputs[index];
+            pendingLengths[pendingCount] = pLengths[index];
+            pendingIndices[pendingCount] = index;
+            ++pendingCount;
+            ++index;
+        }
+    }
+
+    namespace SHA512
+    {
+        static const uint64_t table[80] =
+        {
+            0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+            0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+            0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+            0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+            0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+            0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+            0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+            0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+            0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+            0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+            0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
+            0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+            0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+            0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+            0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+            0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+            0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+            0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+            0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+            0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+        };
+
+        void initialize(uint32_t *pResult)
+        {
+            ((uint64_t *)pResult)[0] = 0x6a09e667f3bcc908;
+            ((uint64_t *)pResult)[1] = 0xbb67ae8584caa73b;
+            ((uint64_t *)pResult)[2] = 0x3c6ef372fe94f82b;
+            ((uint64_t *)pResult)[3] = 0xa54ff53a5f1d36f1;
+            ((uint64_t *)pResult)[4] = 0x510e527fade682d1;
+            ((uint64_t *)pResult)[5] = 0x9b05688c2b3e6c1f;
+            ((uint64_t *)pResult)[6] = 0x1f83d9abfb41bd6b;
+            ((uint64_t *)pResult)[7] = 0x5be0cd19137e2179;
+        }
+
+        void process(uint32_t *pResult, uint32_t *pBlock)
+        {
+            unsigned int i;
+            uint64_t s0, s1, t1, t2;
+            uint64_t extendedBlock[80];
+
+            std::memcpy(extendedBlock, pBlock, 128);
+
+            // Adjust for big endian
+            if(Endian::sSystemType != Endian::BIG)
+                for(i=0;i<16;++i)
+                    extendedBlock[i] = Endian::convert(extendedBlock[i], Endian::BIG);
+
+            // Extend the block to 80 64-bit words:
+            for(i=16;i<80;++i)
+            {
+                s0 = extendedBlock[i-15];
+                s0 = Math::rotateRight64(s0, 1) ^ Math::rotateRight64(s0, 8) ^ (s0 >> 7);
+
+                s1 = extendedBlock[i-2];
+                s1 = Math::rotateRight64(s1, 19) ^ Math::rotateRight64(s1, 61) ^ (s1 >> 6);
+
+                extendedBlock[i] = extendedBlock[i-16] + extendedBlock[i-7] + s0 + s1;
+            }
+
+            uint64_t state[8];
+            std::memcpy(state, pResult, 64);
+
+            for(i=0;i<80;++i)
+            {
+                s0 = Math::rotateRight64(state[0], 28) ^ Math::rotateRight64(state[0], 34) ^ Math::rotateRight64(state[0], 39);
+                t2 = s0 +((state[0] & state[1]) ^ (state [0] & state[2]) ^ (state[1] & state[2]));
+                s1 = Math::rotateRight64(state[4], 14) ^ Math::rotateRight64(state[4], 18) ^ Math::rotateRight64(state[4], 41);
+                t1 = state[7] + s1 + ((state[4] & state[5]) ^ (~state[4] & state[6])) + table[i] + extendedBlock[i];
+
+                state[7] = state[6];
+                state[6] = state[5];
+                state[5] = state[4];
+                state[4] = state[3] + t1;
+                state[3] = state[2];
+                state[2] = state[1];
+                state[1] = state[0];
+                state[0] = t1 + t2;
+            }
+
+            for(i=0;i<8;++i)
+                ((uint64_t *)pResult)[i] += state[i];
+        }
+
+        void finish(uint32_t *pResult, uint32_t *pBlock, unsigned int pBlockLength, uint64_t pTotalLength)
+        {
+            // Zeroize the end of the block
+            if(pBlockLength < 128)
+                std::memset(((uint8_t *)pBlock) + pBlockLength, 0, 128 - pBlockLength);
+
+            // Add 0x80 byte (basically a 1 bit at the end of the data)
+            ((uint8_t *)pBlock)[pBlockLength] = 0x80;
+
+            // Check if there is enough room for the total length in this block
+            if(pBlockLength > 111) // 112 - 1 because of the 0x80 byte already added
+            {
+                process(pResult, pBlock); // Process this block
+                std::memset(pBlock, 0, 128); // Clear the block
+            }
+
+            // Put bit length in last 16 bytes of block (Big Endian)
+            pTotalLength *= 8;
+            ((uint64_t *)pBlock)[15] = Endian::convert(pTotalLength, Endian::BIG);
+
+            // Process last block
+            process(pResult, pBlock);
+
+            // Adjust for big endian
+            if(Endian::sSystemType != Endian::BIG)
+                for(unsigned int i=0;i<8;++i)
+                    ((uint64_t *)pResult)[i] = Endian::convert(((uint64_t *)pResult)[i], Endian::BIG);
+        }
+    }
+
+    void Digest::sha512(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput) // 512 bit(64 byte) result
+    {
+        stream_size remaining = pInputLength;
+        uint32_t result[16];
         uint32_t block[32];
 
         SHA512::initialize(result);
@@ -1164,520 +2367,1452 @@ namespace NextCash
             pResult[0] ^= block;
         }
 
-        // Process less than 8 bytes and length
-        uint64_t finish(uint64_t *pResult, const uint8_t *pBlock, unsigned int pBlockLength,
-          uint64_t pTotalLength)
+        // Process less than 8 bytes and length
+        uint64_t finish(uint64_t *pResult, const uint8_t *pBlock, unsigned int pBlockLength,
+          uint64_t pTotalLength)
+        {
+            // Create last block
+            uint8_t lastBlock[8];
+            std::memset(lastBlock, 0, 8);
+
+            // Copy partial block into last block
+            std::memcpy(lastBlock, pBlock, pBlockLength);
+
+            // Put least significant byte of total length into most significant byte of
+            //   last "block"
+            lastBlock[7] = pTotalLength & 0xff;
+
+            // Process last block
+            process(pResult, lastBlock);
+
+            pResult[2] ^= 0xff;
+            round(pResult, 4); // The 4 from SipHash-2-4
+
+            return pResult[0] ^ pResult[1] ^ pResult[2] ^ pResult[3];
+        }
+    }
+
+    uint64_t Digest::sipHash24(const uint8_t *pData, stream_size pLength, uint64_t pKey0,
+      uint64_t pKey1)
+    {
+        uint64_t result[4];
+
+        SipHash24::initialize(result, pKey0, pKey1);
+
+        stream_size offset = 0;
+        while(pLength - offset >= 8)
+        {
+            SipHash24::process(result, pData);
+            pData += 8;
+            offset += 8;
+        }
+
+        return SipHash24::finish(result, pData, pLength - offset, pLength);
+    }
+
+    namespace MURMUR3
+    {
+        // Only 32 bit implemented
+        void initialize(uint32_t &pResult, uint32_t pSeed)
+        {
+            pResult = pSeed;
+        }
+
+        // Process 4 bytes
+        void process(uint32_t &pResult, uint32_t pBlock)
+        {
+            uint32_t block = pBlock;
+
+            block *= 0xcc9e2d51;
+            block = (block << 15) | (block >> 17);
+            block *= 0x1b873593;
+
+            pResult ^= block;
+            pResult = (pResult << 13) | (pResult >> 19);
+            pResult = (pResult * 5) + 0xe6546b64;
+        }
+
+        // Process less than 4 bytes and length
+        void finish(uint32_t &pResult, const uint8_t *pBlockData, unsigned int pBlockLength,
+          uint64_t pTotalLength)
+        {
+            if(pBlockLength > 0)
+            {
+                uint32_t block = 0;
+                const uint8_t *byte = pBlockData;
+                for(unsigned int i=0;i<pBlockLength;++i)
+                    block |= (uint32_t)*byte++ << (i * 8);
+
+                block *= 0xcc9e2d51;
+                block = (block << 15) | (block >> 17);
+                block *= 0x1b873593;
+
+                pResult ^= block;
+            }
+
+            pResult ^= pTotalLength;
+            pResult ^= pResult >> 16;
+            pResult *= 0x85ebca6b;
+            pResult ^= pResult >> 13;
+            pResult *= 0xc2b2ae35;
+            pResult ^= pResult >> 16;
+        }
+    }
+
+    uint32_t Digest::murMur3(const uint8_t *pData, stream_size pLength, uint32_t pSeed)
+    {
+        uint32_t result;
+        MURMUR3::initialize(result, pSeed);
+
+        stream_size offset = 0;
+        while(pLength - offset >= 4)
+        {
+            MURMUR3::process(result, Endian::convert(*(uint32_t *)pData, Endian::LITTLE));
+            pData += 4;
+            offset += 4;
+        }
+
+        MURMUR3::finish(result, pData, pLength - offset, pLength);
+        return result;
+    }
+
+    Digest::Digest(Type pType)
+    {
+        mType = pType;
+        mByteCount = 0;
+        mBlockLength = 0;
+        setOutputEndian(Endian::BIG);
+        allocate();
+        initialize();
+    }
+
+    Digest::Digest(const Digest &pCopy)
+    {
+        mType = pCopy.mType;
+        mByteCount = 0;
+        mBlockLength = 0;
+        setOutputEndian(Endian::BIG);
+        allocate();
+        *this = pCopy;
+    }
+
+    Digest::~Digest()
+    {
+        deallocate();
+    }
+
+    void Digest::allocate()
+    {
+        switch(mType)
+        {
+        case CRC32:
+        case CRC32C:
+            mBlockSize = 1;
+            mResultData = new uint32_t[1];
+            mBlockData = NULL;
+            break;
+        //case MD5:
+        //    mBlockSize = 64;
+        //    break;
+        case SHA1:
+        case RIPEMD160:
+            mBlockSize = 64;
+            mResultData = new uint32_t[5];
+            mBlockData  = new uint32_t[mBlockSize / 4];
+            break;
+        case SHA256:
+        case SHA256_SHA256:
+        case SHA256_RIPEMD160:
+            mBlockSize = 64;
+            mResultData = new uint32_t[8];
+            mBlockData  = new uint32_t[mBlockSize / 4];
+            break;
+        case MURMUR3:
+            mBlockSize = 4;
+            mResultData = new uint32_t[1];
+            mBlockData  = new uint32_t[mBlockSize / 4];
+            break;
+        case SHA512:
+            mBlockSize = 128;
+            mResultData = new uint32_t[16];
+            mBlockData  = new uint32_t[mBlockSize / 4];
+            break;
+        default:
+            mBlockSize = 0;
+            mResultData = NULL;
+            mBlockData = NULL;
+            break;
+        }
+    }
+
+    void Digest::deallocate()
+    {
+        if(mBlockData != NULL)
+            delete[] mBlockData;
+        if(mResultData != NULL)
+            delete[] mResultData;
+        mBlockData = NULL;
+        mResultData = NULL;
+    }
+
+    unsigned int Digest::stateSize(Type pType)
+    {
+        switch(pType)
+        {
+        case CRC32:
+        case CRC32C:
+        case MURMUR3:
+            return 4;
+        case SHA1:
+        case RIPEMD160:
+            return 20;
+        case SHA256:
+        case SHA256_SHA256:
+        case SHA256_RIPEMD160:
+            return 32;
+        case SHA512:
+            return 64;
+        default:
+            return 0;
+        }
+    }
+
+    const Digest &Digest::operator = (const Digest &pRight)
+    {
+        if(this == &pRight)
+            return *this;
+
+        if(mType != pRight.mType)
+        {
+            deallocate();
+            mType = pRight.mType;
+            allocate();
+        }
+
+        mByteCount = pRight.mByteCount;
+        mBlockLength = pRight.mBlockLength;
+        if(mResultData != NULL)
+            std::memcpy(mResultData, pRight.mResultData, stateSize(mType));
+        if(mBlockLength > 0)
+            std::memcpy(mBlockData, pRight.mBlockData, mBlockLength);
+        return *this;
+    }
+
+    void Digest::writeState(OutputStream *pStream) const
+    {
+        pStream->writeByte(mType);
+        pStream->writeUnsignedLong(mByteCount);
+
+        // SHA512 chaining values are 64 bit.
+        if(mType == SHA512)
+            for(unsigned int i = 0; i < 8; ++i)
+                pStream->writeUnsignedLong(((uint64_t *)mResultData)[i]);
+        else
+            for(unsigned int i = 0; i < stateSize(mType) / 4; ++i)
+                pStream->writeUnsignedInt(mResultData[i]);
+
+        pStream->writeByte(mBlockLength);
+        if(mBlockLength > 0)
+            pStream->write(mBlockData, mBlockLength);
+    }
+
+    bool Digest::readState(InputStream *pStream)
+    {
+        if(pStream->remaining() < 9)
+            return false;
+
+        unsigned int type = pStream->readByte();
+        if(type > CRC32C || pStream->remaining() < 8 + stateSize((Type)type) + 1)
+            return false;
+
+        // Read into a separate digest so a bad or truncated state leaves this one unchanged.
+        Digest state((Type)type);
+        state.mByteCount = pStream->readUnsignedLong();
+
+        if(state.mType == SHA512)
+            for(unsigned int i = 0; i < 8; ++i)
+                ((uint64_t *)state.mResultData)[i] = pStream->readUnsignedLong();
+        else
+            for(unsigned int i = 0; i < stateSize(state.mType) / 4; ++i)
+                state.mResultData[i] = pStream->readUnsignedInt();
+
+        // Full blocks are always processed, so the partial block length follows from the count.
+        unsigned int blockLength = pStream->readByte();
+        if(blockLength != state.mByteCount % state.mBlockSize ||
+          pStream->remaining() < blockLength)
+            return false;
+
+        state.mBlockLength = blockLength;
+        if(blockLength > 0)
+            pStream->read(state.mBlockData, blockLength);
+
+        *this = state;
+        return true;
+    }
+
+    HMACDigest::HMACDigest(Type pType, InputStream *pKey) : Digest(pType), mInnerState(pType),
+      mOuterState(pType)
+    {
+        initialize(pKey);
+    }
+
+    HMACDigest::HMACDigest(Type pType, const uint8_t *pKey, stream_size pKeySize) :
+      Digest(pType), mInnerState(pType), mOuterState(pType)
+    {
+        initialize(pKey, pKeySize);
+    }
+
+    bool HMACDigest::initialize(InputStream *pKey)
+    {
+        Buffer key;
+        key.writeStream(pKey, pKey->remaining());
+        return initialize(key.begin(), key.length());
+    }
+
+    bool HMACDigest::initialize(const uint8_t *pKey, stream_size pKeySize)
+    {
+        uint8_t key[128], paddedKey[128]; // Largest block size
+        unsigned int keySize = pKeySize;
+
+        // A hashed key must fit in the padded key block.
+        if(resultSize() > mBlockSize)
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+              "HMAC not supported for digest type %d", type());
+            mInnerState.initialize();
+            mOuterState.initialize();
+            reinitialize();
+            return false;
+        }
+
+        if(pKeySize > mBlockSize)
         {
-            // Create last block
-            uint8_t lastBlock[8];
-            std::memset(lastBlock, 0, 8);
+            // Hash key
+            Digest::initialize();
+            write(pKey, pKeySize);
+            keySize = resultSize();
+            Digest::getResult(key);
+        }
+        else if(pKeySize > 0)
+            std::memcpy(key, pKey, pKeySize);
 
-            // Copy partial block into last block
-            std::memcpy(lastBlock, pBlock, pBlockLength);
+        // Pad key to block size
+        std::memset(key + keySize, 0, mBlockSize - keySize);
 
-            // Put least significant byte of total length into most significant byte of
-            //   last "block"
-            lastBlock[7] = pTotalLength & 0xff;
+        mInnerState.initialize();
+        for(unsigned int i = 0; i < mBlockSize; ++i)
+            paddedKey[i] = 0x36 ^ key[i];
+        mInnerState.write(paddedKey, mBlockSize);
 
-            // Process last block
-            process(pResult, lastBlock);
+        mOuterState.initialize();
+        for(unsigned int i = 0; i < mBlockSize; ++i)
+            paddedKey[i] = 0x5c ^ key[i];
+        mOuterState.write(paddedKey, mBlockSize);
 
-            pResult[2] ^= 0xff;
-            round(pResult, 4); // The 4 from SipHash-2-4
+        std::memset(key, 0, sizeof(key));
+        std::memset(paddedKey, 0, sizeof(paddedKey));
 
-            return pResult[0] ^ pResult[1] ^ pResult[2] ^ pResult[3];
-        }
+        reinitialize();
+        return true;
     }
 
-    uint64_t Digest::sipHash24(const uint8_t *pData, stream_size pLength, uint64_t pKey0,
-      uint64_t pKey1)
+    void HMACDigest::getResult(uint8_t *pResult)
     {
-        uint64_t result[4];
+        uint8_t innerResult[64];
+        unsigned int size = resultSize();
+        Digest::getResult(innerResult);
+
+        // Hash the inner result after the outer padded key
+        Digest::operator = (mOuterState);
+        write(innerResult, size);
+        Digest::getResult(pResult);
+    }
 
-        SipHash24::initialize(result, pKey0, pKey1);
+    void HMACDigest::getResult(RawOutputStream *pOutput)
+    {
+        uint8_t result[64];
+        unsigned int size = resultSize();
+        getResult(result);
+        pOutput->write(result, size);
+    }
 
-        stream_size offset = 0;
-        while(pLength - offset >= 8)
-        {
-            SipHash24::process(result, pData);
-            pData += 8;
-            offset += 8;
+    void HMACDigest::pbkdf2(Type pType, const uint8_t *pPassword, stream_size pPasswordSize,
+      const uint8_t *pSalt, stream_size pSaltSize, unsigned int pIterations, uint8_t *pResult,
+      stream_size pResultSize)
+    {
+        // The key midstates are calculated once and copied for each of the iterations.
+        HMACDigest hmac(pType, pPassword, pPasswordSize);
+        unsigned int size = hmac.resultSize(), copySize;
+        uint8_t value[64], block[64];
+        uint32_t blockIndex = 1, bigIndex;
+
+        for(; pResultSize > 0; ++blockIndex)
+        {
+            hmac.reinitialize();
+            hmac.write(pSalt, pSaltSize);
+            bigIndex = Endian::convert(blockIndex, Endian::BIG);
+            hmac.write(&bigIndex, 4);
+            hmac.getResult(value);
+            std::memcpy(block, value, size);
+
+            for(unsigned int i = 1; i < pIterations; ++i)
+            {
+                hmac.reinitialize();
+                hmac.write(value, size);
+                hmac.getResult(value);
+                for(unsigned int j = 0; j < size; ++j)
+                    block[j] ^= value[j];
+            }
+
+            copySize = pResultSize < size ? pResultSize : size;
+            std::memcpy(pResult, block, copySize);
+            pResult += copySize;
+            pResultSize -= copySize;
         }
 
-        return SipHash24::finish(result, pData, pLength - offset, pLength);
+        std::memset(value, 0, sizeof(value));
+        std::memset(block, 0, sizeof(block));
     }
 
-    namespace MURMUR3
+    void Digest::write(const void *pInput, stream_size pSize)
     {
-        // Only 32 bit implemented
-        void initialize(uint32_t &pResult, uint32_t pSeed)
+        const uint8_t *input = (const uint8_t *)pInput;
+        mByteCount += pSize;
+
+        if(mType == CRC32)
         {
-            pResult = pSeed;
+            *mResultData = CRC32::update(*mResultData, input, pSize);
+            return;
         }
-
-        // Process 4 bytes
-        void process(uint32_t &pResult, uint32_t pBlock)
+        else if(mType == CRC32C)
         {
-            uint32_t block = pBlock;
+            *mResultData = CRC32::updateCastagnoli(*mResultData, input, pSize);
+            return;
+        }
 
-            block *= 0xcc9e2d51;
-            block = (block << 15) | (block >> 17);
-            block *= 0x1b873593;
+        // Complete the partial block from previous writes.
+        if(mBlockLength > 0)
+        {
+            unsigned int copySize = mBlockSize - mBlockLength;
+            if(copySize > pSize)
+                copySize = pSize;
+            std::memcpy((uint8_t *)mBlockData + mBlockLength, input, copySize);
+            mBlockLength += copySize;
+            input += copySize;
+            pSize -= copySize;
 
-            pResult ^= block;
-            pResult = (pResult << 13) | (pResult >> 19);
-            pResult = (pResult * 5) + 0xe6546b64;
+            if(mBlockLength < mBlockSize)
+                return;
+            process((uint8_t *)mBlockData, 1);
+            mBlockLength = 0;
         }
 
-        // Process less than 4 bytes and length
-        void finish(uint32_t &pResult, const uint8_t *pBlockData, unsigned int pBlockLength,
-          uint64_t pTotalLength)
+        // Process whole blocks directly from the input.
+        stream_size blockCount = pSize / mBlockSize;
+        if(blockCount > 0)
         {
-            if(pBlockLength > 0)
-            {
-                uint32_t block = 0;
-                const uint8_t *byte = pBlockData;
-                for(unsigned int i=0;i<pBlockLength;++i)
-                    block |= (uint32_t)*byte++ << (i * 8);
+            process(input, blockCount);
+            input += blockCount * mBlockSize;
+            pSize -= blockCount * mBlockSize;
+        }
 
-                block *= 0xcc9e2d51;
-                block = (block << 15) | (block >> 17);
-                block *= 0x1b873593;
+        // Keep the rest until the block is complete or the result is requested.
+        if(pSize > 0)
+        {
+            std::memcpy(mBlockData, input, pSize);
+            mBlockLength = pSize;
+        }
+    }
 
-                pResult ^= block;
-            }
+    void Digest::initialize(uint32_t pSeed)
+    {
+        mByteCount = 0;
+        mBlockLength = 0;
 
-            pResult ^= pTotalLength;
-            pResult ^= pResult >> 16;
-            pResult *= 0x85ebca6b;
-            pResult ^= pResult >> 13;
-            pResult *= 0xc2b2ae35;
-            pResult ^= pResult >> 16;
+        switch(mType)
+        {
+        case CRC32:
+        case CRC32C:
+            mResultData[0] = 0xffffffff;
+            break;
+        //case MD5:
+        //    break;
+        case SHA1:
+            SHA1::initialize(mResultData);
+            break;
+        case RIPEMD160:
+            RIPEMD160::initialize(mResultData);
+            break;
+        case SHA256:
+        case SHA256_SHA256:
+        case SHA256_RIPEMD160:
+            SHA256::initialize(mResultData);
+            break;
+        case MURMUR3:
+            MURMUR3::initialize(*mResultData, pSeed);
+            break;
+        case SHA512:
+            SHA512::initialize(mResultData);
+            break;
         }
     }
 
-    uint32_t Digest::murMur3(const uint8_t *pData, stream_size pLength, uint32_t pSeed)
+    void Digest::process(const uint8_t *pBlocks, stream_size pCount)
     {
-        uint32_t result;
-        MURMUR3::initialize(result, pSeed);
+        // The block process functions don't modify the block, and the ones that read words
+        //   directly from it (RIPEMD160 and MURMUR3) are given aligned copies.
+        const uint8_t *end = pBlocks + (pCount * mBlockSize);
+        uint32_t alignedBlock[16];
 
-        stream_size offset = 0;
-        while(pLength - offset >= 4)
+        switch(mType)
         {
-            MURMUR3::process(result, Endian::convert(*(uint32_t *)pData, Endian::LITTLE));
-            pData += 4;
-            offset += 4;
+        //case MD5:
+        //    break;
+        case SHA1:
+            for(; pBlocks < end; pBlocks += mBlockSize)
+                SHA1::process(mResultData, (uint32_t *)pBlocks);
+            break;
+        case RIPEMD160:
+            for(; pBlocks < end; pBlocks += mBlockSize)
+            {
+                if((uintptr_t)pBlocks % sizeof(uint32_t) == 0)
+                    RIPEMD160::process(mResultData, (uint32_t *)pBlocks);
+                else
+                {
+                    std::memcpy(alignedBlock, pBlocks, mBlockSize);
+                    RIPEMD160::process(mResultData, alignedBlock);
+                }
+            }
+            break;
+        case SHA256:
+        case SHA256_SHA256:
+        case SHA256_RIPEMD160:
+            for(; pBlocks < end; pBlocks += mBlockSize)
+                SHA256::process(mResultData, (uint32_t *)pBlocks);
+            break;
+        case MURMUR3:
+            for(; pBlocks < end; pBlocks += mBlockSize)
+            {
+                std::memcpy(alignedBlock, pBlocks, mBlockSize);
+                MURMUR3::process(*mResultData, *alignedBlock);
+            }
+            break;
+        case SHA512:
+            for(; pBlocks < end; pBlocks += mBlockSize)
+                SHA512::process(mResultData, (uint32_t *)pBlocks);
+            break;
+        default:
+            break;
         }
+    }
 
-        MURMUR3::finish(result, pData, pLength - offset, pLength);
-        return result;
+    unsigned int Digest::resultSize() const
+    {
+        switch(mType)
+        {
+        case CRC32:
+        case CRC32C:
+        case MURMUR3:
+            return 4;
+        case SHA1:
+        case RIPEMD160:
+        case SHA256_RIPEMD160:
+            return 20;
+        case SHA256:
+        case SHA256_SHA256:
+            return 32;
+        case SHA512:
+            return 64;
+        default:
+            return 0;
+        }
     }
 
-    Digest::Digest(Type pType)
+    unsigned int Digest::getResult()
     {
-        mType = pType;
-        mByteCount = 0;
-        setOutputEndian(Endian::BIG);
+        switch(mType)
+        {
+        case CRC32:
+        case CRC32C:
+            // Finalize result
+            *mResultData ^= 0xffffffff;
+            *mResultData = Endian::convert(*mResultData, Endian::BIG);
+            return *mResultData;
+
+        case MURMUR3:
+            // Last partial block is less than 4 bytes
+            MURMUR3::finish(*mResultData, (uint8_t *)mBlockData, mBlockLength, mByteCount);
+            return *mResultData;
+
+        default:
+            return 0;
+        }
+    }
+
+    void Digest::getResult(uint8_t *pResult)
+    {
+        unsigned int size = resultSize();
 
         switch(mType)
         {
         case CRC32:
-            mBlockSize = 1;
-            mResultData = new uint32_t[1];
-            mBlockData = NULL;
+        case CRC32C:
+            // Finalize result
+            *mResultData ^= 0xffffffff;
+            *mResultData = Endian::convert(*mResultData, Endian::BIG);
             break;
         //case MD5:
-        //    mBlockSize = 64;
         //    break;
         case SHA1:
+            SHA1::finish(mResultData, mBlockData, mBlockLength, mByteCount);
+            break;
         case RIPEMD160:
-            mBlockSize = 64;
-            mResultData = new uint32_t[5];
-            mBlockData  = new uint32_t[mBlockSize / 4];
+            RIPEMD160::finish(mResultData, mBlockData, mBlockLength, mByteCount);
             break;
         case SHA256:
+            SHA256::finish(mResultData, mBlockData, mBlockLength, mByteCount);
+            break;
         case SHA256_SHA256:
+            SHA256::finish(mResultData, mBlockData, mBlockLength, mByteCount);
+
+            // SHA256 of the first result, reusing the block and state.
+            std::memcpy(mBlockData, mResultData, 32);
+            SHA256::initialize(mResultData);
+            SHA256::finish(mResultData, mBlockData, 32, 32);
+            break;
         case SHA256_RIPEMD160:
-            mBlockSize = 64;
-            mResultData = new uint32_t[8];
-            mBlockData  = new uint32_t[mBlockSize / 4];
+            SHA256::finish(mResultData, mBlockData, mBlockLength, mByteCount);
+
+            // RIPEMD160 of the SHA256 result, reusing the block and state.
+            std::memcpy(mBlockData, mResultData, 32);
+            RIPEMD160::initialize(mResultData);
+            RIPEMD160::finish(mResultData, mBlockData, 32, 32);
             break;
         case MURMUR3:
-            mBlockSize = 4;
-            mResultData = new uint32_t[1];
-            mBlockData  = new uint32_t[mBlockSize / 4];
+            // Last partial block is less than 4 bytes
+            MURMUR3::finish(*mResultData, (uint8_t *)mBlockData, mBlockLength, mByteCount);
             break;
         case SHA512:
-            mBlockSize = 128;
-            mResultData = new uint32_t[16];
-            mBlockData  = new uint32_t[mBlockSize / 4];
+            SHA512::finish(mResultData, mBlockData, mBlockLength, mByteCount);
             break;
         default:
-            mBlockSize = 0;
-            mResultData = NULL;
-            mBlockData = NULL;
-            break;
+            return;
         }
 
-        initialize();
-    }
+        std::memcpy(pResult, mResultData, size);
 
-    Digest::~Digest()
-    {
+        // Zeroize
+        std::memset(mResultData, 0, size);
         if(mBlockData != NULL)
-            delete[] mBlockData;
-        if(mResultData != NULL)
-            delete[] mResultData;
+            std::memset(mBlockData, 0, mBlockSize);
+        mBlockLength = 0;
     }
 
-    HMACDigest::HMACDigest(Type pType, InputStream *pKey) : Digest(pType)
+    void Digest::getResult(RawOutputStream *pOutput)
     {
-        initialize(pKey);
+        uint8_t result[64];
+        unsigned int size = resultSize();
+        getResult(result);
+        pOutput->write(result, size);
     }
 
-    void HMACDigest::initialize(InputStream *pKey)
+    bool buffersMatch(Buffer &pLeft, Buffer &pRight)
     {
-        Digest::initialize();
+        if(pLeft.length() != pRight.length())
+            return false;
 
-        Buffer key;
-        key.writeStream(pKey, pKey->remaining());
+        while(pLeft.remaining())
+            if(pLeft.readByte() != pRight.readByte())
+                return false;
 
-        if(key.length() > mBlockSize)
-        {
-            // Hash key
-            writeStream(&key, key.length());
-            key.clear(); // Clear key data
-            Digest::getResult(&key); // Read key hash into key
-            Digest::initialize(); // Reinitialize digest
-        }
+        return true;
+    }
 
-        // Pad key to block size
-        while(key.length() < mBlockSize)
-            key.writeByte(0);
-
-        // Create outer padded key
-        key.setReadOffset(0);
-        mOuterPaddedKey.setWriteOffset(0);
-        while(key.remaining())
-            mOuterPaddedKey.writeByte(0x5c ^ key.readByte());
-
-        // Create inner padded key
-        Buffer innerPaddedKey;
-        key.setReadOffset(0);
-        while(key.remaining())
-            innerPaddedKey.writeByte(0x36 ^ key.readByte());
-
-        // Write inner padded key into digest
-        innerPaddedKey.setReadOffset(0);
-        writeStream(&innerPaddedKey, innerPaddedKey.length());
+    void logResults(const char *pDescription, Buffer &pBuffer)
+    {
+        Buffer hex;
+        pBuffer.setReadOffset(0);
+        hex.writeAsHex(&pBuffer, pBuffer.length(), true);
+        char *hexText = new char[hex.length()];
+        hex.read((uint8_t *)hexText, hex.length());
+        Log::addFormatted(Log::VERBOSE, NEXTCASH_DIGEST_LOG_NAME, "%s : %s", pDescription, hexText);
+        delete[] hexText;
     }
 
-    void HMACDigest::getResult(RawOutputStream *pOutput)
+    bool Digest::test()
     {
-        // Get digest result
-        Buffer firstResult;
-        Digest::getResult(&firstResult);
+        Log::add(NextCash::Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+          "------------- Starting Digest Tests -------------");
+
+        bool result = true;
+        Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME, "CPU features : %s",
+          CPU::featureNames());
+
+        // Run all test vectors with each SHA256 implementation the CPU supports.
+        SHA256Implementation implementation;
+        for(unsigned int i = 0; i < SHA256_IMPLEMENTATION_COUNT; ++i)
+        {
+            implementation = (SHA256Implementation)i;
+            if(!setSHA256Implementation(implementation))
+            {
+                Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+                  "SHA256 %s implementation not supported",
+                  sha256ImplementationName(implementation));
+                continue;
+            }
 
-        // Reinitialize digest
-        Digest::initialize();
+            Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+              "Testing with SHA256 %s implementation", sha256ImplementationName(implementation));
+            if(!testVectors())
+                result = false;
+        }
 
-        // Write outer padded key into digest
-        mOuterPaddedKey.setReadOffset(0);
-        writeStream(&mOuterPaddedKey, mOuterPaddedKey.length());
+        /******************************************************************************************
+         * SHA256 implementations match on all lengths
+         ******************************************************************************************/
+        Buffer input, correctDigest, resultDigest;
+        bool matchSuccess = true;
+        std::vector<Buffer> genericResults;
 
-        // Write previous digest result into digest
-        writeStream(&firstResult, firstResult.length());
+        for(unsigned int i = 0; i < 300; ++i)
+            input.writeByte(Math::randomInt());
 
-        // Get the final result
-        Digest::getResult(pOutput);
-    }
+        setSHA256Implementation(SHA256_GENERIC);
+        for(unsigned int length = 0; length <= input.length(); ++length)
+        {
+            input.setReadOffset(0);
+            genericResults.emplace_back();
+            sha256(&input, length, &genericResults.back());
+        }
 
-    void Digest::write(const void *pInput, stream_size pSize)
-    {
-        mInput.write(pInput, pSize);
-        mByteCount += pSize;
-        process();
-    }
+        for(unsigned int i = 1; i < SHA256_IMPLEMENTATION_COUNT; ++i)
+        {
+            if(!setSHA256Implementation((SHA256Implementation)i))
+                continue;
 
-    void Digest::initialize(uint32_t pSeed)
-    {
-        mByteCount = 0;
-        mInput.clear();
+            for(unsigned int length = 0; length <= input.length(); ++length)
+            {
+                input.setReadOffset(0);
+                resultDigest.clear();
+                sha256(&input, length, &resultDigest);
+                if(!buffersMatch(genericResults[length], resultDigest))
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                      "SHA256 %s doesn't match generic for length %d",
+                      sha256ImplementationName((SHA256Implementation)i), length);
+                    matchSuccess = false;
+                    break;
+                }
+            }
+        }
 
-        switch(mType)
+        if(matchSuccess)
+            Log::add(Log::INFO, NEXTCASH_DIGEST_LOG_NAME, "Passed SHA256 implementations match");
+        else
         {
-        case CRC32:
-            mResultData[0] = 0xffffffff;
-            break;
-        //case MD5:
-        //    break;
-        case SHA1:
-            SHA1::initialize(mResultData);
-            break;
-        case RIPEMD160:
-            RIPEMD160::initialize(mResultData);
-            break;
-        case SHA256:
-        case SHA256_SHA256:
-        case SHA256_RIPEMD160:
-            SHA256::initialize(mResultData);
-            break;
-        case MURMUR3:
-            MURMUR3::initialize(*mResultData, pSeed);
-            break;
-        case SHA512:
-            SHA512::initialize(mResultData);
-            break;
+            Log::add(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME, "Failed SHA256 implementations match");
+            result = false;
         }
-    }
 
-    void Digest::process()
-    {
-        switch(mType)
+        /******************************************************************************************
+         * Split and unaligned writes
+         ******************************************************************************************/
+        const Type splitTypes[] = { CRC32, SHA1, RIPEMD160, SHA256, SHA256_SHA256,
+          SHA256_RIPEMD160, SHA512, MURMUR3, CRC32C };
+        const unsigned int splitSize = 1000;
+        bool splitSuccess = true;
+        uint8_t splitData[splitSize], unalignedData[splitSize + 1];
+        uint8_t wholeResult[64], splitResult[64];
+        unsigned int offset, writeSize;
+
+        for(unsigned int i = 0; i < splitSize; ++i)
+            splitData[i] = Math::randomInt();
+        std::memcpy(unalignedData + 1, splitData, splitSize);
+
+        for(unsigned int i = 0; i < sizeof(splitTypes) / sizeof(Type); ++i)
         {
-        case CRC32:
-            while(mInput.remaining() >= mBlockSize)
-                *mResultData = (*mResultData >> 8) ^ CRC32::table[(*mResultData & 0xFF) ^ mInput.readByte()];
-            break;
-        //case MD5:
-        //    break;
-        case SHA1:
-            while(mInput.remaining() >= mBlockSize)
-            {
-                mInput.read(mBlockData, mBlockSize);
-                SHA1::process(mResultData, mBlockData);
-            }
-            break;
-        case RIPEMD160:
-            while(mInput.remaining() >= mBlockSize)
-            {
-                mInput.read(mBlockData, mBlockSize);
-                RIPEMD160::process(mResultData, mBlockData);
-            }
-            break;
-        case SHA256:
-        case SHA256_SHA256:
-        case SHA256_RIPEMD160:
-            while(mInput.remaining() >= mBlockSize)
-            {
-                mInput.read(mBlockData, mBlockSize);
-                SHA256::process(mResultData, mBlockData);
-            }
-            break;
-        case MURMUR3:
-            while(mInput.remaining() >= mBlockSize)
+            for(unsigned int length = 0; length <= splitSize; length += length < 300 ? 1 : 233)
             {
-                mInput.read(mBlockData, mBlockSize);
-                MURMUR3::process(*mResultData, *mBlockData);
+                // One write from the stream interface.
+                Digest whole(splitTypes[i]);
+                whole.write(splitData, length);
+                resultDigest.clear();
+                whole.getResult(&resultDigest);
+                resultDigest.read(wholeResult, whole.resultSize());
+
+                // Random sized writes from an unaligned pointer into a fixed buffer.
+                Digest split(splitTypes[i]);
+                for(offset = 0; offset < length; offset += writeSize)
+                {
+                    writeSize = Math::randomInt() % 150;
+                    if(writeSize > length - offset)
+                        writeSize = length - offset;
+                    split.write(unalignedData + 1 + offset, writeSize);
+                }
+                split.getResult(splitResult);
+
+                if(resultDigest.length() != split.resultSize() ||
+                  std::memcmp(wholeResult, splitResult, split.resultSize()) != 0)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                      "Digest type %d split writes don't match for length %d", splitTypes[i],
+                      length);
+                    splitSuccess = false;
+                    break;
+                }
             }
-            break;
-        case SHA512:
-            while(mInput.remaining() >= mBlockSize)
+        }
+
+        if(splitSuccess)
+            Log::add(Log::INFO, NEXTCASH_DIGEST_LOG_NAME, "Passed split and unaligned writes");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME, "Failed split and unaligned writes");
+            result = false;
+        }
+
+        /******************************************************************************************
+         * Midstates
+         ******************************************************************************************/
+        const unsigned int prefixLengths[] = { 0, 1, 3, 4, 63, 64, 65, 127, 128, 129, 500 };
+        bool midstateSuccess = true;
+        Buffer midstate;
+
+        for(unsigned int i = 0; i < sizeof(splitTypes) / sizeof(Type) && midstateSuccess; ++i)
+            for(unsigned int j = 0; j < sizeof(prefixLengths) / sizeof(unsigned int); ++j)
             {
-                mInput.read(mBlockData, mBlockSize);
-                SHA512::process(mResultData, mBlockData);
+                unsigned int prefixLength = prefixLengths[j];
+                unsigned int suffixLength = Math::randomInt() % 200;
+
+                Digest whole(splitTypes[i]);
+                whole.write(splitData, prefixLength + suffixLength);
+                whole.getResult(wholeResult);
+
+                Digest prefix(splitTypes[i]);
+                prefix.write(splitData, prefixLength);
+
+                // Copy constructed
+                Digest copy(prefix);
+                copy.write(splitData + prefixLength, suffixLength);
+                copy.getResult(splitResult);
+                if(std::memcmp(wholeResult, splitResult, whole.resultSize()) != 0)
+                    midstateSuccess = false;
+
+                // Assigned over a different type
+                Digest assigned(splitTypes[i] == SHA512 ? CRC32 : SHA512);
+                assigned = prefix;
+                assigned.write(splitData + prefixLength, suffixLength);
+                assigned.getResult(splitResult);
+                if(assigned.type() != splitTypes[i] ||
+                  std::memcmp(wholeResult, splitResult, whole.resultSize()) != 0)
+                    midstateSuccess = false;
+
+                // Serialized
+                midstate.clear();
+                prefix.writeState(&midstate);
+                Digest resumed(SHA1);
+                if(!resumed.readState(&midstate))
+                    midstateSuccess = false;
+                resumed.write(splitData + prefixLength, suffixLength);
+                resumed.getResult(splitResult);
+                if(std::memcmp(wholeResult, splitResult, whole.resultSize()) != 0)
+                    midstateSuccess = false;
+
+                // The original continues unaffected.
+                prefix.write(splitData + prefixLength, suffixLength);
+                prefix.getResult(splitResult);
+                if(std::memcmp(wholeResult, splitResult, whole.resultSize()) != 0)
+                    midstateSuccess = false;
+
+                // Truncated
+                midstate.setReadOffset(0);
+                Buffer truncated;
+                truncated.writeStream(&midstate, midstate.length() - 1);
+                if(resumed.readState(&truncated))
+                    midstateSuccess = false;
+
+                // Truncated state of a different type leaves the digest usable.
+                Digest truncatedOther(splitTypes[i] == SHA512 ? SHA256 : SHA512);
+                truncatedOther.write(splitData, 100);
+                midstate.setReadOffset(0);
+                truncated.clear();
+                truncated.writeStream(&midstate, midstate.length() - 1);
+                if(truncatedOther.readState(&truncated))
+                    midstateSuccess = false;
+                truncatedOther.write(splitData + 100, 10);
+                truncatedOther.getResult(splitResult);
+                Digest untouched(truncatedOther.type());
+                untouched.write(splitData, 110);
+                untouched.getResult(wholeResult);
+                if(std::memcmp(wholeResult, splitResult, untouched.resultSize()) != 0)
+                    midstateSuccess = false;
+
+                if(!midstateSuccess)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                      "Digest type %d midstate doesn't match for prefix %d", splitTypes[i],
+                      prefixLength);
+                    break;
+                }
             }
-            break;
+
+        if(midstateSuccess)
+            Log::add(Log::INFO, NEXTCASH_DIGEST_LOG_NAME, "Passed midstates");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME, "Failed midstates");
+            result = false;
         }
 
-        mInput.flush();
-    }
+        // Hashes of a shared prefix with different nonces.
+        const unsigned int nonceCount = 2000;
+        uint32_t nonce;
 
-    unsigned int Digest::getResult()
-    {
-        switch(mType)
+        Timer prefixTimer(true);
+        for(nonce = 0; nonce < nonceCount; ++nonce)
         {
-        case CRC32:
-            // Finalize result
-            *mResultData ^= 0xffffffff;
-            *mResultData = Endian::convert(*mResultData, Endian::BIG);
-            return *mResultData;
+            Digest digest(SHA256_SHA256);
+            digest.write(splitData, splitSize);
+            digest.write(&nonce, 4);
+            digest.getResult(splitResult);
+        }
+        prefixTimer.stop();
 
-        case MURMUR3:
+        Timer midstateTimer(true);
+        Digest prefixDigest(SHA256_SHA256), nonceDigest(SHA256_SHA256);
+        prefixDigest.write(splitData, splitSize);
+        for(nonce = 0; nonce < nonceCount; ++nonce)
         {
-            // Get last partial block (must be less than 4 bytes)
-            unsigned int lastBlockSize = mInput.remaining();
-            mInput.read(mBlockData, lastBlockSize);
-            MURMUR3::finish(*mResultData, (uint8_t *)mBlockData, lastBlockSize, mByteCount);
-            return *mResultData;
-        }
-        default:
-            return 0;
+            nonceDigest = prefixDigest;
+            nonceDigest.write(&nonce, 4);
+            nonceDigest.getResult(splitResult);
         }
-    }
+        midstateTimer.stop();
 
-    void Digest::getResult(RawOutputStream *pOutput)
-    {
-        switch(mType)
-        {
-        case CRC32:
-            // Finalize result
-            *mResultData ^= 0xffffffff;
-            *mResultData = Endian::convert(*mResultData, Endian::BIG);
+        Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+          "%d SHA256_SHA256 of %d byte prefix and nonce : full %d us, midstate copy %d us",
+          nonceCount, splitSize, (int)prefixTimer.microseconds(),
+          (int)midstateTimer.microseconds());
 
-            // Output result
-            pOutput->write(mResultData, 4);
+        /******************************************************************************************
+         * CRC32 and CRC32C
+         ******************************************************************************************/
+        bool crcSuccess = true;
+        const uint8_t *checkData = (const uint8_t *)"123456789";
+        const CRC32::SliceTables &crcTables = CRC32::tables();
+        const CRC32::SliceTables &castagnoliTables = CRC32::castagnoliTables();
+        uint32_t byteCRC, crc;
 
-            // Zeroize
-            *mResultData = 0;
-            break;
-        //case MD5:
-        //    break;
-        case SHA1:
+        if(crc32(checkData, 9) != 0xcbf43926 || crc32("123456789") != 0xcbf43926 ||
+          crc32c(checkData, 9) != 0xe3069283)
         {
-            // Get last partial block (must be less than 64 bytes)
-            unsigned int lastBlockSize = mInput.remaining();
-            mInput.read(mBlockData, lastBlockSize);
+            Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+              "CRC check values : CRC32 0x%08x, CRC32C 0x%08x", crc32(checkData, 9),
+              crc32c(checkData, 9));
+            crcSuccess = false;
+        }
+
+        // Every implementation matches byte at a time on all lengths and alignments.
+        for(unsigned int length = 0; length <= 300 && crcSuccess; ++length)
+            for(unsigned int start = 0; start < 8; ++start)
+            {
+                const uint8_t *data = splitData + start;
+
+                byteCRC = CRC32::updateByte(0xffffffff, data, length, crcTables);
+                if(CRC32::updateSlicing8(0xffffffff, data, length, crcTables) != byteCRC ||
+                  CRC32::update(0xffffffff, data, length) != byteCRC)
+                    crcSuccess = false;
+#ifdef NEXTCASH_X86_INTRINSICS
+                if(CPU::has(CPU::PCLMUL) && CPU::has(CPU::SSE41) && length >= 64 &&
+                  length % 16 == 0 && CRC32::updatePCLMUL(0xffffffff, data, length) != byteCRC)
+                    crcSuccess = false;
+#endif
+
+                byteCRC = CRC32::updateByte(0xffffffff, data, length, castagnoliTables);
+                if(CRC32::updateSlicing8(0xffffffff, data, length, castagnoliTables) !=
+                  byteCRC || CRC32::updateCastagnoli(0xffffffff, data, length) != byteCRC)
+                    crcSuccess = false;
+#ifdef NEXTCASH_X86_INTRINSICS
+                if(CPU::has(CPU::SSE42) &&
+                  CRC32::updateSSE42(0xffffffff, data, length) != byteCRC)
+                    crcSuccess = false;
+#endif
+
+                if(!crcSuccess)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                      "CRC implementations don't match for length %d at offset %d", length,
+                      start);
+                    break;
+                }
+            }
 
-            SHA1::finish(mResultData, mBlockData, lastBlockSize, mByteCount);
+        // Continue and combine at every split.
+        for(unsigned int split = 0; split <= 300 && crcSuccess; ++split)
+        {
+            crc = crc32(splitData, 300);
+            if(crc32(crc32(splitData, split), splitData + split, 300 - split) != crc ||
+              crc32Combine(crc32(splitData, split), crc32(splitData + split, 300 - split),
+              300 - split) != crc)
+                crcSuccess = false;
 
-            // Output result
-            pOutput->write(mResultData, 20);
+            crc = crc32c(splitData, 300);
+            if(crc32c(crc32c(splitData, split), splitData + split, 300 - split) != crc ||
+              crc32cCombine(crc32c(splitData, split), crc32c(splitData + split, 300 - split),
+              300 - split) != crc)
+                crcSuccess = false;
 
-            // Zeroize
-            std::memset(mResultData, 0, 20);
-            std::memset(mBlockData, 0, mBlockSize);
-            break;
+            if(!crcSuccess)
+                Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                  "CRC continue or combine failed at split %d", split);
         }
-        case RIPEMD160:
+
+        if(crcSuccess)
+            Log::add(Log::INFO, NEXTCASH_DIGEST_LOG_NAME, "Passed CRC32 and CRC32C");
+        else
         {
-            // Get last partial block (must be less than 64 bytes)
-            unsigned int lastBlockSize = mInput.remaining();
-            mInput.read(mBlockData, lastBlockSize);
+            Log::add(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME, "Failed CRC32 and CRC32C");
+            result = false;
+        }
 
-            RIPEMD160::finish(mResultData, mBlockData, lastBlockSize, mByteCount);
+        /******************************************************************************************
+         * HMAC reuse and PBKDF2
+         ******************************************************************************************/
+        bool pbkdf2Success = true;
+        uint8_t derived[64];
+        Buffer expected;
 
-            // Output result
-            pOutput->write(mResultData, 20);
+        // Reinitialized messages match new digests.
+        HMACDigest reused(SHA256, splitData, 100);
+        for(unsigned int i = 0; i < 3; ++i)
+        {
+            HMACDigest fresh(SHA256, splitData, 100);
+            fresh.write(splitData + i, 50);
+            fresh.getResult(wholeResult);
 
-            // Zeroize
-            std::memset(mResultData, 0, 20);
-            std::memset(mBlockData, 0, mBlockSize);
-            break;
+            reused.reinitialize();
+            reused.write(splitData + i, 50);
+            reused.getResult(splitResult);
+            if(std::memcmp(wholeResult, splitResult, 32) != 0)
+                pbkdf2Success = false;
         }
-        case SHA256:
+
+        // Types with results larger than their block are rejected.
+        HMACDigest crcHMAC(CRC32);
+        if(crcHMAC.initialize(splitData, 100) || !reused.initialize(splitData, 100))
         {
-            // Get last partial block (must be less than 64 bytes)
-            unsigned int lastBlockSize = mInput.remaining();
-            mInput.read(mBlockData, lastBlockSize);
+            Log::add(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME, "HMAC CRC32 key not rejected");
+            pbkdf2Success = false;
+        }
 
-            SHA256::finish(mResultData, mBlockData, lastBlockSize, mByteCount);
+        struct PBKDF2Vector
+        {
+            Type type;
+            const char *password, *salt;
+            unsigned int iterations;
+            const char *derivedKey;
+        };
+        const PBKDF2Vector pbkdf2Vectors[] =
+        {
+            { SHA256, "password", "salt", 1,
+              "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b" },
+            { SHA256, "password", "salt", 2,
+              "ae4d0c95af6b46d32d0adff928f06dd02a303f8ef3c251dfd6e2d85a95474c43" },
+            { SHA256, "password", "salt", 4096,
+              "c5e478d59288c841aa530db6845c4c8d962893a001ce4e11a4963873aa98134a" },
+            { SHA256, "passwd", "salt", 1, // 2 blocks
+              "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+              "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783" },
+            { SHA512, "password", "salt", 1,
+              "867f70cf1ade02cff3752599a3a53dc4af34c7a669815ae5d513554e1c8cf252"
+              "c02d470a285a0501bad999bfe943c08f050235d7d68b1da55e63f73b60a57fce" },
+            { SHA512, "password", "salt", 2,
+              "e1d9c16aa681708a45f5c7c4e215ceb66e011a2e9f0040713f18aefdb866d53c"
+              "f76cab2868a39b9f7840edce4fef5a82be67335c77a6068e04112754f27ccf4e" },
+            // BIP-0039 seed of "abandon ... about" with passphrase "TREZOR"
+            { SHA512, "abandon abandon abandon abandon abandon abandon abandon abandon abandon "
+              "abandon abandon about", "mnemonicTREZOR", 2048,
+              "c55257c360c07c72029aebc1b53c05ed0362ada38ead3e3e9efa3708e5349553"
+              "1f09a6987599d18264c1e1c92f2cf141630c7a3c4ab7c81b2f001698e7463b04" }
+        };
 
-            // Output result
-            pOutput->write(mResultData, 32);
+        for(unsigned int i = 0; i < sizeof(pbkdf2Vectors) / sizeof(PBKDF2Vector); ++i)
+        {
+            const PBKDF2Vector &vector = pbkdf2Vectors[i];
+            expected.clear();
+            expected.writeHex(vector.derivedKey);
+            HMACDigest::pbkdf2(vector.type, (const uint8_t *)vector.password,
+              std::strlen(vector.password), (const uint8_t *)vector.salt,
+              std::strlen(vector.salt), vector.iterations, derived, expected.length());
+            if(std::memcmp(derived, expected.begin(), expected.length()) != 0)
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                  "PBKDF2 vector %d doesn't match", i);
+                pbkdf2Success = false;
+            }
+        }
 
-            // Zeroize
-            std::memset(mResultData, 0, 32);
-            std::memset(mBlockData, 0, mBlockSize);
-            break;
+        if(pbkdf2Success)
+            Log::add(Log::INFO, NEXTCASH_DIGEST_LOG_NAME, "Passed HMAC reuse and PBKDF2");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME, "Failed HMAC reuse and PBKDF2");
+            result = false;
         }
-        case SHA256_SHA256:
+
+        // Iterations per second compared to keying a new HMAC for each iteration. A 64 byte
+        //   SHA256 key is 2 blocks of iterations.
+        const unsigned int pbkdf2Iterations = 2048;
+        for(unsigned int i = 0; i < 2; ++i)
         {
-            // Get last partial block (must be less than 64 bytes)
-            unsigned int lastBlockSize = mInput.remaining();
-            mInput.read(mBlockData, lastBlockSize);
+            Type type = i == 0 ? SHA256 : SHA512;
+            Buffer key;
+            key.write(splitData, 32);
 
-            SHA256::finish(mResultData, mBlockData, lastBlockSize, mByteCount);
+            Timer rekeyTimer(true);
+            for(unsigned int j = 0; j < pbkdf2Iterations; ++j)
+            {
+                key.setReadOffset(0);
+                HMACDigest hmac(type, &key);
+                hmac.write(splitData, 64);
+                hmac.getResult(derived);
+            }
+            rekeyTimer.stop();
 
-            // Compute SHA256 of result
-            Digest secondSHA256(SHA256);
-            secondSHA256.write(mResultData, 32);
-            Buffer secondSHA256Data(32);
-            secondSHA256.getResult(&secondSHA256Data);
+            Timer pbkdf2Timer(true);
+            HMACDigest::pbkdf2(type, splitData, 32, splitData + 32, 16, pbkdf2Iterations,
+              derived, 64);
+            pbkdf2Timer.stop();
 
-            // Output result
-            pOutput->writeStream(&secondSHA256Data, 32);
+            Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+              "PBKDF2 HMAC %s iterations/s : midstates %d, keyed per iteration %d",
+              type == SHA256 ? "SHA256" : "SHA512",
+              (int)((double)pbkdf2Iterations * (type == SHA256 ? 2 : 1) * 1000000.0 /
+              (double)pbkdf2Timer.microseconds()),
+              (int)((double)pbkdf2Iterations * 1000000.0 / (double)rekeyTimer.microseconds()));
+        }
 
-            // Zeroize
-            std::memset(mResultData, 0, 32);
-            std::memset(mBlockData, 0, mBlockSize);
-            break;
+        /******************************************************************************************
+         * SHA256_SHA256 batches
+         ******************************************************************************************/
+        const unsigned int batchCount = 40;
+        const unsigned int batchLengths[] = { 0, 1, 31, 32, 55, 56, 63, 64, 65, 119, 120, 128, 300 };
+        bool batchSuccess = true;
+        std::vector<Buffer> batchInputs(batchCount);
+        std::vector<const uint8_t *> batchPointers;
+        std::vector<stream_size> batchSizes;
+        uint8_t batchData[batchCount * 64], batchCorrect[batchCount * 32];
+        uint8_t batchResults[batchCount * 32];
+
+        for(unsigned int i = 0; i < batchCount; ++i)
+        {
+            unsigned int length;
+            if(i < sizeof(batchLengths) / sizeof(unsigned int))
+                length = batchLengths[i];
+            else
+                length = Math::randomInt() % 400;
+            batchInputs[i].writeByte(0); // So begin() isn't NULL for empty inputs.
+            batchInputs[i].setReadOffset(1);
+            for(unsigned int j = 0; j < length; ++j)
+                batchInputs[i].writeByte(Math::randomInt());
+
+            Digest digest(SHA256_SHA256);
+            digest.writeStream(&batchInputs[i], length);
+            resultDigest.clear();
+            digest.getResult(&resultDigest);
+            resultDigest.read(batchCorrect + (i * 32), 32);
+
+            batchPointers.push_back(batchInputs[i].begin() + 1);
+            batchSizes.push_back(length);
+        }
+
+        for(unsigned int i = 0; i < SHA256_IMPLEMENTATION_COUNT; ++i)
+        {
+            implementation = (SHA256Implementation)i;
+            if(!setSHA256Implementation(implementation))
+                continue;
+
+            // Every count up to a few more than the lanes, then all.
+            for(unsigned int count = 0; count <= batchCount; count = count < 18 ? count + 1 :
+              batchCount + (count == batchCount ? 1 : 0))
+            {
+                std::memset(batchResults, 0, sizeof(batchResults));
+                sha256SHA256Batch(batchPointers.data(), batchSizes.data(), count, batchResults);
+                if(std::memcmp(batchResults, batchCorrect, count * 32) != 0)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                      "SHA256_SHA256 %s batch of %d doesn't match",
+                      sha256ImplementationName(implementation), count);
+                    batchSuccess = false;
+                    break;
+                }
+            }
         }
-        case SHA256_RIPEMD160:
-        {
-            // Get last partial block (must be less than 64 bytes)
-            unsigned int lastBlockSize = mInput.remaining();
-            mInput.read(mBlockData, lastBlockSize);
 
-            SHA256::finish(mResultData, mBlockData, lastBlockSize, mByteCount);
+        // 64 byte inputs
+        for(unsigned int i = 0; i < batchCount * 64; ++i)
+            batchData[i] = Math::randomInt();
+        for(unsigned int i = 0; i < batchCount; ++i)
+        {
+            Digest digest(SHA256_SHA256);
+            digest.write(batchData + (i * 64), 64);
+            resultDigest.clear();
+            digest.getResult(&resultDigest);
+            resultDigest.read(batchCorrect + (i * 32), 32);
+        }
 
-            // Compute SHA256 of result
-            Digest ripEMD160(RIPEMD160);
-            ripEMD160.write(mResultData, 32);
-            Buffer ripEMD160Data(20);
-            ripEMD160.getResult(&ripEMD160Data);
+        for(unsigned int i = 0; i < SHA256_IMPLEMENTATION_COUNT; ++i)
+        {
+            implementation = (SHA256Implementation)i;
+            if(!setSHA256Implementation(implementation))
+                continue;
 
-            // Output result
-            pOutput->writeStream(&ripEMD160Data, 20);
+            for(unsigned int count = 0; count <= batchCount; ++count)
+            {
+                std::memset(batchResults, 0, sizeof(batchResults));
+                sha256SHA256Batch64(batchData, count, batchResults);
+                if(std::memcmp(batchResults, batchCorrect, count * 32) != 0)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                      "SHA256_SHA256 %s batch of %d 64 byte inputs doesn't match",
+                      sha256ImplementationName(implementation), count);
+                    batchSuccess = false;
+                    break;
+                }
+            }
+        }
 
-            // Zeroize
-            std::memset(mResultData, 0, 20);
-            std::memset(mBlockData, 0, mBlockSize);
-            break;
+        if(batchSuccess)
+            Log::add(Log::INFO, NEXTCASH_DIGEST_LOG_NAME, "Passed SHA256_SHA256 batches");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME, "Failed SHA256_SHA256 batches");
+            result = false;
         }
-        case MURMUR3:
+
+        /******************************************************************************************
+         * SHA256_SHA256 batch throughput
+         ******************************************************************************************/
+        const unsigned int throughputCount = 20000;
+        std::vector<uint8_t> throughputData(throughputCount * 64);
+        std::vector<uint8_t> throughputResults(throughputCount * 32);
+        for(std::vector<uint8_t>::iterator byte = throughputData.begin();
+          byte != throughputData.end(); ++byte)
+            *byte = Math::randomInt();
+
+        Buffer digestResult;
+        Timer digestTimer(true);
+        for(unsigned int i = 0; i < throughputCount; ++i)
         {
-            // Get last partial block (must be less than 4 bytes)
-            unsigned int lastBlockSize = mInput.remaining();
-            mInput.read(mBlockData, lastBlockSize);
+            Digest digest(SHA256_SHA256);
+            digest.write(throughputData.data() + (i * 64), 64);
+            digestResult.clear();
+            digest.getResult(&digestResult);
+        }
+        digestTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+          "%d SHA256_SHA256 64 byte hashes : Digest objects %d us", throughputCount,
+          (int)digestTimer.microseconds());
 
-            MURMUR3::finish(*mResultData, (uint8_t *)mBlockData, lastBlockSize, mByteCount);
+        for(unsigned int i = 0; i < SHA256_IMPLEMENTATION_COUNT; ++i)
+        {
+            implementation = (SHA256Implementation)i;
+            if(!setSHA256Implementation(implementation))
+                continue;
 
-            // Output result
-            pOutput->write(mResultData, 4);
+            Timer timer(true);
+            sha256SHA256Batch64(throughputData.data(), throughputCount, throughputResults.data());
+            timer.stop();
+            Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+              "%d SHA256_SHA256 64 byte hashes : %-7s batch %d us", throughputCount,
+              sha256ImplementationName(implementation), (int)timer.microseconds());
+        }
 
-            // Zeroize
-            std::memset(mResultData, 0, 4);
-            std::memset(mBlockData, 0, mBlockSize);
-            break;
+        /******************************************************************************************
+         * SHA256_RIPEMD160 batches
+         ******************************************************************************************/
+        const unsigned int hash160Count = 40;
+        const unsigned int hash160Lengths[] = { 0, 20, 25, 33, 55, 56, 65, 33, 33, 120, 33, 300 };
+        bool hash160Success = true;
+        std::vector<Buffer> hash160Inputs(hash160Count);
+        std::vector<const uint8_t *> hash160Pointers;
+        std::vector<stream_size> hash160Sizes;
+        uint8_t hash160Correct[hash160Count * 20], hash160Results[hash160Count * 20];
+
+        // Mostly short inputs, like public keys, mixed with long ones.
+        for(unsigned int i = 0; i < hash160Count; ++i)
+        {
+            unsigned int length;
+            if(i < sizeof(hash160Lengths) / sizeof(unsigned int))
+                length = hash160Lengths[i];
+            else if(i % 4 == 3)
+                length = Math::randomInt() % 400;
+            else
+                length = Math::randomInt() % 56;
+            hash160Inputs[i].writeByte(0); // So begin() isn't NULL for empty inputs.
+            hash160Inputs[i].setReadOffset(1);
+            for(unsigned int j = 0; j < length; ++j)
+                hash160Inputs[i].writeByte(Math::randomInt());
+
+            Digest digest(SHA256_RIPEMD160);
+            digest.writeStream(&hash160Inputs[i], length);
+            digest.getResult(hash160Correct + (i * 20));
+
+            hash160Pointers.push_back(hash160Inputs[i].begin() + 1);
+            hash160Sizes.push_back(length);
+        }
+
+        for(unsigned int i = 0; i < SHA256_IMPLEMENTATION_COUNT; ++i)
+        {
+            implementation = (SHA256Implementation)i;
+            if(!setSHA256Implementation(implementation))
+                continue;
+
+            // Every count up to a few more than the lanes, then all.
+            for(unsigned int count = 0; count <= hash160Count; count = count < 18 ? count + 1 :
+              hash160Count + (count == hash160Count ? 1 : 0))
+            {
+                std::memset(hash160Results, 0, sizeof(hash160Results));
+                sha256RIPEMD160Batch(hash160Pointers.data(), hash160Sizes.data(), count,
+                  hash160Results);
+                if(std::memcmp(hash160Results, hash160Correct, count * 20) != 0)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME,
+                      "SHA256_RIPEMD160 %s batch of %d doesn't match",
+                      sha256ImplementationName(implementation), count);
+                    hash160Success = false;
+                    break;
+                }
+            }
         }
-        case SHA512:
+
+        if(hash160Success)
+            Log::add(Log::INFO, NEXTCASH_DIGEST_LOG_NAME, "Passed SHA256_RIPEMD160 batches");
+        else
         {
-            // Get last partial block (must be less than 64 bytes)
-            unsigned int lastBlockSize = mInput.remaining();
-            mInput.read(mBlockData, lastBlockSize);
+            Log::add(Log::ERROR, NEXTCASH_DIGEST_LOG_NAME, "Failed SHA256_RIPEMD160 batches");
+            result = false;
+        }
 
-            SHA512::finish(mResultData, mBlockData, lastBlockSize, mByteCount);
+        /******************************************************************************************
+         * SHA256_RIPEMD160 batch throughput
+         ******************************************************************************************/
+        std::vector<const uint8_t *> hash160ThroughputPointers(throughputCount);
+        std::vector<stream_size> hash160ThroughputSizes(throughputCount, 33);
+        std::vector<uint8_t> hash160ThroughputResults(throughputCount * 20);
+        for(unsigned int i = 0; i < throughputCount; ++i)
+            hash160ThroughputPointers[i] = throughputData.data() + (i * 64);
 
-            // Output result
-            pOutput->write(mResultData, 64);
+        digestTimer.clear(true);
+        for(unsigned int i = 0; i < throughputCount; ++i)
+        {
+            Digest digest(SHA256_RIPEMD160);
+            digest.write(hash160ThroughputPointers[i], 33);
+            digest.getResult(hash160ThroughputResults.data() + (i * 20));
+        }
+        digestTimer.stop();
+        Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+          "%d SHA256_RIPEMD160 33 byte hashes : Digest objects %d us", throughputCount,
+          (int)digestTimer.microseconds());
 
-            // Zeroize
-            std::memset(mResultData, 0, 64);
-            std::memset(mBlockData, 0, mBlockSize);
-            break;
+        for(unsigned int i = 0; i < SHA256_IMPLEMENTATION_COUNT; ++i)
+        {
+            implementation = (SHA256Implementation)i;
+            if(!setSHA256Implementation(implementation))
+                continue;
+
+            Timer timer(true);
+            sha256RIPEMD160Batch(hash160ThroughputPointers.data(), hash160ThroughputSizes.data(),
+              throughputCount, hash160ThroughputResults.data());
+            timer.stop();
+            Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+              "%d SHA256_RIPEMD160 33 byte hashes : %-7s batch %d us", throughputCount,
+              sha256ImplementationName(implementation), (int)timer.microseconds());
         }
+
+        /******************************************************************************************
+         * SHA256 throughput
+         ******************************************************************************************/
+        const unsigned int benchmarkSize = 0x00800000; // 8 MiB
+        std::vector<uint32_t> benchmarkData(0x4000); // 64 KiB
+        uint32_t state[8];
+        for(std::vector<uint32_t>::iterator word = benchmarkData.begin();
+          word != benchmarkData.end(); ++word)
+            *word = Math::randomInt();
+
+        for(unsigned int i = 0; i < SHA256_IMPLEMENTATION_COUNT; ++i)
+        {
+            implementation = (SHA256Implementation)i;
+            if(!setSHA256Implementation(implementation))
+                continue;
+
+            SHA256::initialize(state);
+            Timer timer(true);
+            for(unsigned int offset = 0; offset < benchmarkSize; offset += 64)
+                SHA256::process(state,
+                  benchmarkData.data() + ((offset % (benchmarkData.size() * 4)) / 4));
+            timer.stop();
+
+            Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+              "SHA256 %-7s : %d MB/s", sha256ImplementationName(implementation),
+              (int)(((double)benchmarkSize / 1000000.0) /
+              ((double)timer.microseconds() / 1000000.0)));
         }
-    }
 
-    bool buffersMatch(Buffer &pLeft, Buffer &pRight)
-    {
-        if(pLeft.length() != pRight.length())
-            return false;
+        resetSHA256Implementation();
 
-        while(pLeft.remaining())
-            if(pLeft.readByte() != pRight.readByte())
-                return false;
+        /******************************************************************************************
+         * CRC throughput
+         ******************************************************************************************/
+        const unsigned int crcSize = 0x00800000; // 8 MiB
+        std::vector<uint8_t> crcData(crcSize);
+        for(std::vector<uint8_t>::iterator byte = crcData.begin(); byte != crcData.end(); ++byte)
+            *byte = Math::randomInt();
+
+        Timer byteTimer(true);
+        crc = CRC32::updateByte(0xffffffff, crcData.data(), crcSize, crcTables);
+        byteTimer.stop();
+        Timer slicingTimer(true);
+        crc ^= CRC32::updateSlicing8(0xffffffff, crcData.data(), crcSize, crcTables);
+        slicingTimer.stop();
+        Timer crc32Timer(true);
+        crc ^= crc32(crcData.data(), crcSize);
+        crc32Timer.stop();
+        Timer crc32cTimer(true);
+        crc ^= crc32c(crcData.data(), crcSize);
+        crc32cTimer.stop();
+
+        Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+          "CRC MB/s : byte table %d, slicing by 8 %d, CRC32 %d, CRC32C %d (0x%08x)",
+          (int)(crcSize / byteTimer.microseconds()), (int)(crcSize / slicingTimer.microseconds()),
+          (int)(crcSize / crc32Timer.microseconds()), (int)(crcSize / crc32cTimer.microseconds()),
+          crc);
 
-        return true;
-    }
+        /******************************************************************************************
+         * Digest write throughput
+         ******************************************************************************************/
+        const uint8_t *benchmarkBytes = (const uint8_t *)benchmarkData.data();
+        uint8_t benchmarkResult[64];
+        for(unsigned int i = 0; i < sizeof(splitTypes) / sizeof(Type); ++i)
+        {
+            Digest digest(splitTypes[i]);
+            Timer timer(true);
+            // Odd write sizes so most writes start and end with partial blocks.
+            for(offset = 0; offset < benchmarkSize; offset += 0xfff)
+                digest.write(benchmarkBytes + (offset % 0x8000), 0xfff);
+            digest.getResult(benchmarkResult);
+            timer.stop();
 
-    void logResults(const char *pDescription, Buffer &pBuffer)
-    {
-        Buffer hex;
-        pBuffer.setReadOffset(0);
-        hex.writeAsHex(&pBuffer, pBuffer.length(), true);
-        char *hexText = new char[hex.length()];
-        hex.read((uint8_t *)hexText, hex.length());
-        Log::addFormatted(Log::VERBOSE, NEXTCASH_DIGEST_LOG_NAME, "%s : %s", pDescription, hexText);
-        delete[] hexText;
+            Log::addFormatted(Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
+              "Digest type %d writes : %d MB/s", splitTypes[i],
+              (int)(((double)offset / 1000000.0) / ((double)timer.microseconds() / 1000000.0)));
+        }
+
+        return result;
     }
 
-    bool Digest::test()
+    bool Digest::testVectors()
     {
-        Log::add(NextCash::Log::INFO, NEXTCASH_DIGEST_LOG_NAME,
-          "------------- Starting Digest Tests -------------");
-
         bool result = true;
         Buffer input, correctDigest, resultDigest, hmacKey;
 
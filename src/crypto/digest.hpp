@@ -21,11 +21,19 @@ namespace NextCash
     {
     public:
 
-        enum Type { CRC32, SHA1, RIPEMD160, SHA256, SHA256_SHA256, SHA256_RIPEMD160, SHA512, MURMUR3 }; //TODO Not yet supported - MD5
+        enum Type { CRC32, SHA1, RIPEMD160, SHA256, SHA256_SHA256, SHA256_RIPEMD160, SHA512, MURMUR3, CRC32C }; //TODO Not yet supported - MD5
 
         Digest(Type pType);
+        // Copies the midstate, so hashes sharing a prefix can continue from a copy made after
+        //   the prefix instead of hashing it again. Assignment doesn't allocate when the types
+        //   match.
+        Digest(const Digest &pCopy);
         ~Digest();
 
+        const Digest &operator = (const Digest &pRight);
+
+        Type type() const { return mType; }
+
         // Set data to initial state. Automatically called by constructor
         void initialize(uint32_t pSeed = 0); // Seed only used for MURMUR3
 
@@ -34,19 +42,66 @@ namespace NextCash
         // Calculate result
         void getResult(RawOutputStream *pOutput);
         unsigned int getResult();
+        // Writes resultSize() bytes to pResult without allocating.
+        void getResult(uint8_t *pResult);
+        unsigned int resultSize() const;
+
+        // Write the midstate (type, byte count, chaining values, and partial block) so it can be
+        //   resumed later, possibly by a different digest object.
+        void writeState(OutputStream *pStream) const;
+        // Replace this digest's midstate, and type if different, with one from writeState.
+        // Returns false if the data isn't a valid midstate.
+        bool readState(InputStream *pStream);
 
         // Static digest calculation functions
         static void crc32(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput); // 32 bit(4 byte) result
         static uint32_t crc32(const char *pText);
         static uint32_t crc32(const uint8_t *pData, stream_size pSize);
+        // Continue from the CRC32 of preceding data.
+        static uint32_t crc32(uint32_t pCRC, const uint8_t *pData, stream_size pSize);
+        // Castagnoli polynomial. Uses the SSE4.2 crc32 instruction when available.
+        static uint32_t crc32c(const uint8_t *pData, stream_size pSize);
+        static uint32_t crc32c(uint32_t pCRC, const uint8_t *pData, stream_size pSize);
+        // CRC of two buffers concatenated, from their separate CRCs and the second's size.
+        static uint32_t crc32Combine(uint32_t pCRC, uint32_t pNextCRC, stream_size pNextSize);
+        static uint32_t crc32cCombine(uint32_t pCRC, uint32_t pNextCRC, stream_size pNextSize);
         static void md5(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput);  // 128 bit(16 byte) result
         static void sha1(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput);  // 160 bit(20 byte) result
         static void ripEMD160(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput);  // 160 bit(20 bytes) result
         static void sha256(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput);  // 256 bit(32 bytes) result
         static void sha512(InputStream *pInput, stream_size pInputLength, OutputStream *pOutput);  // 512 bit(64 bytes) result
+
+        // SHA256(SHA256()) of pCount separate inputs together. Input i is pLengths[i] bytes at
+        //   pInputs[i]. Its 32 byte result is written to pResults + (i * 32).
+        // Inputs are interleaved in the lanes of SSE or AVX2 registers. Without either they are
+        //   hashed one at a time, still without allocating.
+        static void sha256SHA256Batch(const uint8_t *const *pInputs, const stream_size *pLengths,
+          unsigned int pCount, uint8_t *pResults);
+        // Same for pCount consecutive 64 byte inputs, like pairs of merkle tree hashes.
+        static void sha256SHA256Batch64(const uint8_t *pInputs, unsigned int pCount,
+          uint8_t *pResults);
+
+        // HASH160, RIPEMD160(SHA256()), of pCount separate inputs together. Input i is
+        //   pLengths[i] bytes at pInputs[i]. Its 20 byte result is written to pResults + (i * 20).
+        // Uses the same lanes as sha256SHA256Batch. Inputs of up to 55 bytes, like public keys
+        //   and scripts, stay in registers between the two hashes.
+        static void sha256RIPEMD160Batch(const uint8_t *const *pInputs,
+          const stream_size *pLengths, unsigned int pCount, uint8_t *pResults);
+
         static uint64_t sipHash24(const uint8_t *pData, stream_size pLength, uint64_t pKey0, uint64_t pKey1);
         static uint32_t murMur3(const uint8_t *pData, stream_size pLength, uint32_t pSeed);
 
+        // SHA256 implementations. The fastest one the CPU supports is used unless another is set.
+        enum SHA256Implementation { SHA256_GENERIC, SHA256_SSE4, SHA256_AVX2, SHA256_SHA_NI };
+        static const unsigned int SHA256_IMPLEMENTATION_COUNT = 4;
+
+        static bool sha256Supported(SHA256Implementation pImplementation);
+        // Returns false if the CPU doesn't support the implementation.
+        static bool setSHA256Implementation(SHA256Implementation pImplementation);
+        static void resetSHA256Implementation(); // Go back to the fastest implementation.
+        static SHA256Implementation sha256Implementation();
+        static const char *sha256ImplementationName(SHA256Implementation pImplementation);
+
         // Virtual overloaded functions
         stream_size writeOffset() const { return mByteCount; }
         void write(const void *pInput, stream_size pSize);
@@ -59,11 +114,23 @@ namespace NextCash
     private:
         Type mType;
         stream_size mByteCount;
-        Buffer mInput;
+        // Bytes of a partial block held in mBlockData. Whole blocks are processed directly from
+        //   the input to write.
+        unsigned int mBlockLength;
         uint32_t *mBlockData, *mResultData;
 
-        // Process as many blocks of data as possible
-        void process();
+        // Allocate result and block data for mType.
+        void allocate();
+        void deallocate();
+
+        // Bytes of chaining values in mResultData for pType.
+        static unsigned int stateSize(Type pType);
+
+        // Process pCount consecutive blocks.
+        void process(const uint8_t *pBlocks, stream_size pCount);
+
+        // Known results for each digest type.
+        static bool testVectors();
 
     };
 
@@ -71,14 +138,32 @@ namespace NextCash
     {
     public:
 
-        HMACDigest(Type pType) : Digest(pType) {} // Must still be initialized with a key
+        // Must still be initialized with a key
+        HMACDigest(Type pType) : Digest(pType), mInnerState(pType), mOuterState(pType) {}
         HMACDigest(Type pType, InputStream *pKey);
+        HMACDigest(Type pType, const uint8_t *pKey, stream_size pKeySize);
+
+        // Hashes the inner and outer padded keys once and keeps their midstates.
+        // Returns false for types with results larger than their block (CRC32 and CRC32C), which
+        //   can't be used for HMAC.
+        bool initialize(InputStream *pKey);
+        bool initialize(const uint8_t *pKey, stream_size pKeySize);
+        // Start a new message with the same key from the inner padded key midstate.
+        void reinitialize() { Digest::operator = (mInnerState); }
 
-        void initialize(InputStream *pKey);
         void getResult(RawOutputStream *pOutput);
+        // Writes resultSize() bytes to pResult without allocating.
+        void getResult(uint8_t *pResult);
+
+        // PBKDF2 (RFC 8018) with HMAC of pType, usually SHA256 or SHA512. Writes pResultSize
+        //   bytes of derived key to pResult.
+        static void pbkdf2(Type pType, const uint8_t *pPassword, stream_size pPasswordSize,
+          const uint8_t *pSalt, stream_size pSaltSize, unsigned int pIterations,
+          uint8_t *pResult, stream_size pResultSize);
 
     private:
-        Buffer mOuterPaddedKey;
+        // Midstates after the padded keys
+        Digest mInnerState, mOuterState;
     };
 }
 
@@ -7,10 +7,19 @@
  **************************************************************************/
 #include "encrypt.hpp"
 
+#include "cpu.hpp"
 #include "log.hpp"
+#include "math.hpp"
+#include "thread.hpp"
+#include "timer.hpp"
 
+#include <atomic>
 #include <cstring>
 
+#ifdef NEXTCASH_X86_INTRINSICS
+#include <immintrin.h>
+#endif
+
 
 #define NEXTCASH_ENCRYPT_LOG_NAME "Encrypt"
 
@@ -129,439 +138,1093 @@ namespace NextCash
                                               0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
                                               0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
                                               0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d };
-    }
-
-    class AES
-    {
-    public:
 
-        AES(unsigned int pKeySize, const uint8_t *pKey, unsigned int pKeyLength);
-        ~AES()
+        static uint8_t multiply(uint8_t pLeft, uint8_t pRight)
         {
-            if(mExpandedKey != NULL)
-                delete[] mExpandedKey;
-            if(mPreviousState != NULL)
-                delete[] mPreviousState;
-        }
-
-        void encryptBlock(uint8_t *pData);
-        bool decryptBlock(uint8_t *pData);
-
-    private:
+            uint8_t result = 0;
+            uint8_t highBit;
 
-        unsigned int mKeySize;
-        unsigned int mBlockByteCount;
-        unsigned int mRowLength;
-        unsigned int mRoundCount;
-        unsigned int mKeyOffset;
-        uint8_t *mState;
-        uint8_t *mPreviousState;
-        uint8_t *mExpandedKey;
+            for(unsigned int i = 0; i < 8; ++i)
+            {
+                if(pRight & 0x01)
+                    result ^= pLeft;
+                highBit = (pLeft & 0x80);
+                pLeft <<= 1;
+                if(highBit)
+                    pLeft ^= 0x1b; /* x^8 + x^4 + x^3 + x + 1 */
+                pRight >>= 1;
+            }
 
-        inline int gridOffset(unsigned int pRow, unsigned int pColumn, unsigned int pRowLength)
-        {
-            return (pColumn * pRowLength) + pRow;
+            return result;
         }
 
-        void keyScheduleCore(uint8_t *pData, unsigned int pIteration)
+        static void keyScheduleCore(uint8_t *pData, unsigned int pIteration)
         {
             uint8_t swap = pData[0];
 
-            swap = pData [0];
             pData[0] = pData[1];
             pData[1] = pData[2];
             pData[2] = pData[3];
             pData[3] = swap;
 
             for(unsigned int i = 0; i < 4; ++i)
-                pData[i] = Rijndael::sBox[pData[i]];
+                pData[i] = sBox[pData[i]];
 
-            pData[0] ^= Rijndael::sCon[pIteration];
+            pData[0] ^= sCon[pIteration];
         }
 
-        void expandKey(const uint8_t *pKey, unsigned int pKeyLength);
-
-        void addRoundKey()
+        // Sets pResult to the round keys in byte order. Keys shorter than pKeySize are padded with
+        //   zeros and longer keys are truncated.
+        static void expandKey(const uint8_t *pKey, unsigned int pKeyLength, unsigned int pKeySize,
+          unsigned int pRoundCount, uint8_t *pResult)
         {
-            unsigned int r, c;
-
-            for(r = 0; r < 4; ++r)
-                for(c = 0; c < mRowLength; ++c)
-                    mState[(r * mRowLength) + c] ^= mExpandedKey[mKeyOffset++];
-        }
+            if(pKeyLength > pKeySize)
+                pKeyLength = pKeySize;
+            std::memcpy(pResult, pKey, pKeyLength);
+            if(pKeySize > pKeyLength)
+                std::memset(pResult + pKeyLength, 0, pKeySize - pKeyLength);
 
-        void shiftRows()
-        {
-            unsigned int shift, shiftTo, shiftFrom, row;
+            uint8_t currentCore[4];
+            unsigned int i = 2, j, k, m;
+            unsigned int keyCount = pKeySize;
 
-            std::memcpy(mPreviousState, mState, mBlockByteCount);
+            for(j = 0; j < 4; ++j)
+                currentCore[j] = pResult[pKeySize - 4 + j];
 
-            if(mRowLength < 7)
-            {
-                for(row = 1, shift = 1; row < 4; ++row, ++shift)
-                    for(shiftTo = 0, shiftFrom = shift; shiftTo < mRowLength;
-                      ++shiftTo, ++shiftFrom)
-                        mState[gridOffset(row, shiftTo, mRowLength)] =
-                          mPreviousState[gridOffset(row, shiftFrom % mRowLength, mRowLength)];
-            }
-            else if(mRowLength == 7)
+            while(keyCount < (pRoundCount + 1) * 16)
             {
-                for(row = 1, shift = 0; row < 4; ++row)
+                keyScheduleCore(currentCore, i++);
+
+                for(j = 0; j < 4; ++j)
                 {
-                    switch(shift)
-                    {
-                    case 0:
-                        shift = 1;
-                        break;
-                    case 1:
-                        shift = 2;
-                        break;
-                    case 2:
-                        shift = 4;
-                        break;
-                    default:
-                        break;
-                    }
+                    for(k = 0; k < 4; ++k)
+                        currentCore[k] ^= pResult[keyCount + k - pKeySize];
 
-                    for(shiftTo = 0, shiftFrom = shift; shiftTo < mRowLength;
-                      ++shiftTo, ++shiftFrom)
-                        mState[gridOffset(row, shiftTo, mRowLength)] =
-                          mPreviousState[gridOffset(row, shiftFrom % mRowLength, mRowLength)];
+                    std::memcpy(pResult + keyCount, currentCore, 4);
+                    keyCount += 4;
                 }
 
-            }
-            else if(mRowLength == 8)
-            {
-                for(row = 1, shift = 0; row < 4; ++row)
+                if(pKeySize == 32) // AES 256
                 {
-                    switch(shift)
-                    {
-                    case 0:
-                        shift = 1;
-                        break;
-                    case 1:
-                        shift = 3;
-                        break;
-                    case 3:
-                        shift = 4;
-                        break;
-                    default:
-                        break;
-                    }
+                    for(j = 0; j < 4; ++j)
+                        currentCore[j] = sBox[currentCore[j]];
 
-                    for(shiftTo = 0, shiftFrom = shift; shiftTo < mRowLength;
-                      ++shiftTo, ++shiftFrom)
-                        mState[gridOffset(row, shiftTo, mRowLength)] =
-                          mPreviousState[gridOffset (row, shiftFrom % mRowLength, mRowLength)];
+                    for(k = 0; k < 4; ++k)
+                        currentCore[k] ^= pResult[keyCount + k - pKeySize];
+
+                    std::memcpy(pResult + keyCount, currentCore, 4);
+                    keyCount += 4;
+                }
+
+                if(pKeySize == 32)
+                    m = 3;
+                else if(pKeySize == 24)
+                    m = 2;
+                else
+                    m = 0;
+
+                while(m)
+                {
+                    for(k = 0; k < 4; ++k)
+                        currentCore[k] ^= pResult[keyCount + k - pKeySize];
+
+                    std::memcpy(pResult + keyCount, currentCore, 4);
+                    keyCount += 4;
+
+                    --m;
                 }
             }
         }
 
-        uint8_t multiply(uint8_t a, uint8_t b)
+        // Each entry combines sub bytes and mix columns for one byte of a column, so a round is
+        //   16 lookups. Tables 1 to 3 are table 0 rotated for the other rows.
+        class Tables
         {
-            uint8_t result = 0;
-            uint8_t i;
-            uint8_t hi_bit_set;
+        public:
 
-            for(i = 0; i < 8; ++i)
+            Tables()
             {
-                if(b & 0x01)
-                    result ^= a;
-                hi_bit_set = (a & 0x80);
-                a <<= 1;
-                if(hi_bit_set)
-                    a ^= 0x1b; /* x^8 + x^4 + x^3 + x + 1 */
-                b >>= 1;
+                uint8_t value;
+                for(unsigned int i = 0; i < 256; ++i)
+                {
+                    value = sBox[i];
+                    encrypt[0][i] = ((uint32_t)multiply(value, 0x02) << 24) |
+                      ((uint32_t)value << 16) | ((uint32_t)value << 8) |
+                      (uint32_t)multiply(value, 0x03);
+
+                    value = sInverseSBox[i];
+                    decrypt[0][i] = ((uint32_t)multiply(value, 0x0e) << 24) |
+                      ((uint32_t)multiply(value, 0x09) << 16) |
+                      ((uint32_t)multiply(value, 0x0d) << 8) | (uint32_t)multiply(value, 0x0b);
+
+                    for(unsigned int table = 1; table < 4; ++table)
+                    {
+                        encrypt[table][i] = (encrypt[table - 1][i] >> 8) |
+                          (encrypt[table - 1][i] << 24);
+                        decrypt[table][i] = (decrypt[table - 1][i] >> 8) |
+                          (decrypt[table - 1][i] << 24);
+                    }
+                }
             }
 
+            uint32_t encrypt[4][256];
+            uint32_t decrypt[4][256];
+
+        };
+
+        static const Tables &tables()
+        {
+            static const Tables result;
             return result;
         }
 
-        void mixColumns()
+        static inline uint32_t loadWord(const uint8_t *pData)
         {
-            unsigned int row, col;
-
-            std::memcpy(mPreviousState, mState, mBlockByteCount);
+            return ((uint32_t)pData[0] << 24) | ((uint32_t)pData[1] << 16) |
+              ((uint32_t)pData[2] << 8) | (uint32_t)pData[3];
+        }
 
-            for(col = 0; col < mRowLength; ++col)
-                for(row = 0; row < 4; ++row)
-                    mState[gridOffset(row, col, mRowLength)] =
-                      multiply(0x02, mPreviousState [gridOffset (row, col, mRowLength)]) ^
-                      multiply(0x03, mPreviousState[gridOffset((row + 1) % 4, col, mRowLength)]) ^
-                      mPreviousState[gridOffset((row + 2) % 4, col, mRowLength)] ^
-                      mPreviousState[gridOffset((row + 3) % 4, col, mRowLength)];
+        static inline void storeWord(uint32_t pValue, uint8_t *pData)
+        {
+            pData[0] = pValue >> 24;
+            pData[1] = pValue >> 16;
+            pData[2] = pValue >> 8;
+            pData[3] = pValue;
         }
 
-        void subtractRoundKey()
+        // T-table implementation. Keys are big endian words of each round key.
+        static void encryptBlocksGeneric(const uint32_t *pKey, unsigned int pRoundCount,
+          const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount)
         {
-            unsigned int r, c;
-            unsigned int otherKeyOffset = mKeyOffset;
+            const uint32_t (*table)[256] = tables().encrypt;
+            const uint32_t *key;
+            uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
 
-            for(r=0;r<4;r++)
-                for(c=0;c<mRowLength;c++)
-                    mState[(r * mRowLength) + c] ^= mExpandedKey[otherKeyOffset++];
+            for(; pCount > 0; --pCount, pInput += 16, pOutput += 16)
+            {
+                key = pKey;
+                s0 = loadWord(pInput) ^ key[0];
+                s1 = loadWord(pInput + 4) ^ key[1];
+                s2 = loadWord(pInput + 8) ^ key[2];
+                s3 = loadWord(pInput + 12) ^ key[3];
+
+                for(unsigned int round = 1; round < pRoundCount; ++round)
+                {
+                    key += 4;
+                    t0 = table[0][s0 >> 24] ^ table[1][(s1 >> 16) & 0xff] ^
+                      table[2][(s2 >> 8) & 0xff] ^ table[3][s3 & 0xff] ^ key[0];
+                    t1 = table[0][s1 >> 24] ^ table[1][(s2 >> 16) & 0xff] ^
+                      table[2][(s3 >> 8) & 0xff] ^ table[3][s0 & 0xff] ^ key[1];
+                    t2 = table[0][s2 >> 24] ^ table[1][(s3 >> 16) & 0xff] ^
+                      table[2][(s0 >> 8) & 0xff] ^ table[3][s1 & 0xff] ^ key[2];
+                    t3 = table[0][s3 >> 24] ^ table[1][(s0 >> 16) & 0xff] ^
+                      table[2][(s1 >> 8) & 0xff] ^ table[3][s2 & 0xff] ^ key[3];
+                    s0 = t0;
+                    s1 = t1;
+                    s2 = t2;
+                    s3 = t3;
+                }
 
-            mKeyOffset -= mBlockByteCount;
+                // Final round has no mix columns.
+                key += 4;
+                storeWord(((uint32_t)sBox[s0 >> 24] << 24) ^
+                  ((uint32_t)sBox[(s1 >> 16) & 0xff] << 16) ^
+                  ((uint32_t)sBox[(s2 >> 8) & 0xff] << 8) ^ (uint32_t)sBox[s3 & 0xff] ^ key[0],
+                  pOutput);
+                storeWord(((uint32_t)sBox[s1 >> 24] << 24) ^
+                  ((uint32_t)sBox[(s2 >> 16) & 0xff] << 16) ^
+                  ((uint32_t)sBox[(s3 >> 8) & 0xff] << 8) ^ (uint32_t)sBox[s0 & 0xff] ^ key[1],
+                  pOutput + 4);
+                storeWord(((uint32_t)sBox[s2 >> 24] << 24) ^
+                  ((uint32_t)sBox[(s3 >> 16) & 0xff] << 16) ^
+                  ((uint32_t)sBox[(s0 >> 8) & 0xff] << 8) ^ (uint32_t)sBox[s1 & 0xff] ^ key[2],
+                  pOutput + 8);
+                storeWord(((uint32_t)sBox[s3 >> 24] << 24) ^
+                  ((uint32_t)sBox[(s0 >> 16) & 0xff] << 16) ^
+                  ((uint32_t)sBox[(s1 >> 8) & 0xff] << 8) ^ (uint32_t)sBox[s2 & 0xff] ^ key[3],
+                  pOutput + 12);
+            }
         }
 
-        bool inverseShiftRows()
+        // Keys are the encrypt keys in reverse order with inverse mix columns applied to the
+        //   middle rounds (equivalent inverse cipher).
+        static void decryptBlocksGeneric(const uint32_t *pKey, unsigned int pRoundCount,
+          const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount)
         {
-            unsigned int shift, shiftTo, shiftFrom, row;
+            const uint32_t (*table)[256] = tables().decrypt;
+            const uint32_t *key;
+            uint32_t s0, s1, s2, s3, t0, t1, t2, t3;
+
+            for(; pCount > 0; --pCount, pInput += 16, pOutput += 16)
+            {
+                key = pKey;
+                s0 = loadWord(pInput) ^ key[0];
+                s1 = loadWord(pInput + 4) ^ key[1];
+                s2 = loadWord(pInput + 8) ^ key[2];
+                s3 = loadWord(pInput + 12) ^ key[3];
+
+                for(unsigned int round = 1; round < pRoundCount; ++round)
+                {
+                    key += 4;
+                    t0 = table[0][s0 >> 24] ^ table[1][(s3 >> 16) & 0xff] ^
+                      table[2][(s2 >> 8) & 0xff] ^ table[3][s1 & 0xff] ^ key[0];
+                    t1 = table[0][s1 >> 24] ^ table[1][(s0 >> 16) & 0xff] ^
+                      table[2][(s3 >> 8) & 0xff] ^ table[3][s2 & 0xff] ^ key[1];
+                    t2 = table[0][s2 >> 24] ^ table[1][(s1 >> 16) & 0xff] ^
+                      table[2][(s0 >> 8) & 0xff] ^ table[3][s3 & 0xff] ^ key[2];
+                    t3 = table[0][s3 >> 24] ^ table[1][(s2 >> 16) & 0xff] ^
+                      table[2][(s1 >> 8) & 0xff] ^ table[3][s0 & 0xff] ^ key[3];
+                    s0 = t0;
+                    s1 = t1;
+                    s2 = t2;
+                    s3 = t3;
+                }
+
+                key += 4;
+                storeWord(((uint32_t)sInverseSBox[s0 >> 24] << 24) ^
+                  ((uint32_t)sInverseSBox[(s3 >> 16) & 0xff] << 16) ^
+                  ((uint32_t)sInverseSBox[(s2 >> 8) & 0xff] << 8) ^
+                  (uint32_t)sInverseSBox[s1 & 0xff] ^ key[0], pOutput);
+                storeWord(((uint32_t)sInverseSBox[s1 >> 24] << 24) ^
+                  ((uint32_t)sInverseSBox[(s0 >> 16) & 0xff] << 16) ^
+                  ((uint32_t)sInverseSBox[(s3 >> 8) & 0xff] << 8) ^
+                  (uint32_t)sInverseSBox[s2 & 0xff] ^ key[1], pOutput + 4);
+                storeWord(((uint32_t)sInverseSBox[s2 >> 24] << 24) ^
+                  ((uint32_t)sInverseSBox[(s1 >> 16) & 0xff] << 16) ^
+                  ((uint32_t)sInverseSBox[(s0 >> 8) & 0xff] << 8) ^
+                  (uint32_t)sInverseSBox[s3 & 0xff] ^ key[2], pOutput + 8);
+                storeWord(((uint32_t)sInverseSBox[s3 >> 24] << 24) ^
+                  ((uint32_t)sInverseSBox[(s2 >> 16) & 0xff] << 16) ^
+                  ((uint32_t)sInverseSBox[(s1 >> 8) & 0xff] << 8) ^
+                  (uint32_t)sInverseSBox[s0 & 0xff] ^ key[3], pOutput + 12);
+            }
+        }
 
-            std::memcpy(mPreviousState, mState, mBlockByteCount);
+        static void encryptCBCGeneric(const uint32_t *pKey, unsigned int pRoundCount,
+          const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount, uint8_t *pVector)
+        {
+            for(; pCount > 0; --pCount, pInput += 16, pOutput += 16)
+            {
+                for(unsigned int i = 0; i < 16; ++i)
+                    pVector[i] ^= pInput[i];
+                encryptBlocksGeneric(pKey, pRoundCount, pVector, pVector, 1);
+                std::memcpy(pOutput, pVector, 16);
+            }
+        }
 
-            if(mRowLength < 7)
+        static void decryptCBCGeneric(const uint32_t *pKey, unsigned int pRoundCount,
+          const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount, uint8_t *pVector)
+        {
+            uint8_t encrypted[16];
+            for(; pCount > 0; --pCount, pInput += 16, pOutput += 16)
             {
-                for(row = 1, shift = 1; row < 4; ++row, ++shift)
-                    for(shiftTo = 0, shiftFrom = shift; shiftTo < mRowLength;
-                      ++shiftTo, ++shiftFrom)
-                        mState[gridOffset(row, shiftFrom % mRowLength, mRowLength)] =
-                          mPreviousState[gridOffset(row, shiftTo, mRowLength)];
+                std::memcpy(encrypted, pInput, 16); // Output can be the same as input
+                decryptBlocksGeneric(pKey, pRoundCount, pInput, pOutput, 1);
+                for(unsigned int i = 0; i < 16; ++i)
+                    pOutput[i] ^= pVector[i];
+                std::memcpy(pVector, encrypted, 16);
             }
-            else if(mRowLength == 7)
+        }
+
+#ifdef NEXTCASH_X86_INTRINSICS
+        // AES-NI implementation. Keys are the round keys in byte order. Independent blocks are
+        //   processed 4 at a time to hide the latency of the AES instructions.
+        static __attribute__((target("aes")))
+        void encryptBlocksNI(const uint8_t *pKey, unsigned int pRoundCount, const uint8_t *pInput,
+          uint8_t *pOutput, unsigned int pCount)
+        {
+            __m128i key[15], b0, b1, b2, b3;
+            unsigned int round;
+            for(round = 0; round <= pRoundCount; ++round)
+                key[round] = _mm_loadu_si128((const __m128i *)(pKey + (round * 16)));
+
+            for(; pCount >= 4; pCount -= 4, pInput += 64, pOutput += 64)
             {
-                for(row = 1, shift = 0; row < 4; ++row)
+                b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pInput), key[0]);
+                b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pInput + 16)), key[0]);
+                b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pInput + 32)), key[0]);
+                b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pInput + 48)), key[0]);
+                for(round = 1; round < pRoundCount; ++round)
                 {
-                    switch(shift)
-                    {
-                    case 0:
-                        shift = 1;
-                        break;
-                    case 1:
-                        shift = 2;
-                        break;
-                    case 2:
-                        shift = 4;
-                        break;
-                    default:
-                        return false;
-                    }
-
-                    for(shiftTo = 0, shiftFrom = shift; shiftTo < mRowLength;
-                      ++shiftTo, ++shiftFrom)
-                        mState[gridOffset(row, shiftFrom % mRowLength, mRowLength)] =
-                          mPreviousState[gridOffset(row, shiftTo, mRowLength)];
+                    b0 = _mm_aesenc_si128(b0, key[round]);
+                    b1 = _mm_aesenc_si128(b1, key[round]);
+                    b2 = _mm_aesenc_si128(b2, key[round]);
+                    b3 = _mm_aesenc_si128(b3, key[round]);
                 }
+                _mm_storeu_si128((__m128i *)pOutput, _mm_aesenclast_si128(b0, key[round]));
+                _mm_storeu_si128((__m128i *)(pOutput + 16), _mm_aesenclast_si128(b1, key[round]));
+                _mm_storeu_si128((__m128i *)(pOutput + 32), _mm_aesenclast_si128(b2, key[round]));
+                _mm_storeu_si128((__m128i *)(pOutput + 48), _mm_aesenclast_si128(b3, key[round]));
+            }
 
+            for(; pCount > 0; --pCount, pInput += 16, pOutput += 16)
+            {
+                b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pInput), key[0]);
+                for(round = 1; round < pRoundCount; ++round)
+                    b0 = _mm_aesenc_si128(b0, key[round]);
+                _mm_storeu_si128((__m128i *)pOutput, _mm_aesenclast_si128(b0, key[round]));
             }
-            else if(mRowLength == 8)
+        }
+
+        static __attribute__((target("aes")))
+        void decryptBlocksNI(const uint8_t *pKey, unsigned int pRoundCount, const uint8_t *pInput,
+          uint8_t *pOutput, unsigned int pCount)
+        {
+            __m128i key[15], b0, b1, b2, b3;
+            unsigned int round;
+            for(round = 0; round <= pRoundCount; ++round)
+                key[round] = _mm_loadu_si128((const __m128i *)(pKey + (round * 16)));
+
+            for(; pCount >= 4; pCount -= 4, pInput += 64, pOutput += 64)
             {
-                for(row = 1, shift = 0; row < 4; ++row)
+                b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pInput), key[0]);
+                b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pInput + 16)), key[0]);
+                b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pInput + 32)), key[0]);
+                b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(pInput + 48)), key[0]);
+                for(round = 1; round < pRoundCount; ++round)
                 {
-                    switch(shift)
-                    {
-                    case 0:
-                        shift = 1;
-                        break;
-                    case 1:
-                        shift = 3;
-                        break;
-                    case 3:
-                        shift = 4;
-                        break;
-                        break;
-                    default:
-                        return false;
-                    }
+                    b0 = _mm_aesdec_si128(b0, key[round]);
+                    b1 = _mm_aesdec_si128(b1, key[round]);
+                    b2 = _mm_aesdec_si128(b2, key[round]);
+                    b3 = _mm_aesdec_si128(b3, key[round]);
+                }
+                _mm_storeu_si128((__m128i *)pOutput, _mm_aesdeclast_si128(b0, key[round]));
+                _mm_storeu_si128((__m128i *)(pOutput + 16), _mm_aesdeclast_si128(b1, key[round]));
+                _mm_storeu_si128((__m128i *)(pOutput + 32), _mm_aesdeclast_si128(b2, key[round]));
+                _mm_storeu_si128((__m128i *)(pOutput + 48), _mm_aesdeclast_si128(b3, key[round]));
+            }
 
-                    for(shiftTo = 0, shiftFrom = shift; shiftTo < mRowLength;
-                      ++shiftTo, ++shiftFrom)
-                        mState[gridOffset(row, shiftFrom % mRowLength, mRowLength)] =
-                          mPreviousState[gridOffset(row, shiftTo, mRowLength)];
+            for(; pCount > 0; --pCount, pInput += 16, pOutput += 16)
+            {
+                b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)pInput), key[0]);
+                for(round = 1; round < pRoundCount; ++round)
+                    b0 = _mm_aesdec_si128(b0, key[round]);
+                _mm_storeu_si128((__m128i *)pOutput, _mm_aesdeclast_si128(b0, key[round]));
+            }
+        }
+
+        // Each block depends on the previous one, so CBC encryption can't be interleaved.
+        static __attribute__((target("aes")))
+        void encryptCBCNI(const uint8_t *pKey, unsigned int pRoundCount, const uint8_t *pInput,
+          uint8_t *pOutput, unsigned int pCount, uint8_t *pVector)
+        {
+            __m128i key[15];
+            unsigned int round;
+            for(round = 0; round <= pRoundCount; ++round)
+                key[round] = _mm_loadu_si128((const __m128i *)(pKey + (round * 16)));
+
+            __m128i block = _mm_loadu_si128((const __m128i *)pVector);
+            for(; pCount > 0; --pCount, pInput += 16, pOutput += 16)
+            {
+                block = _mm_xor_si128(block, _mm_loadu_si128((const __m128i *)pInput));
+                block = _mm_xor_si128(block, key[0]);
+                for(round = 1; round < pRoundCount; ++round)
+                    block = _mm_aesenc_si128(block, key[round]);
+                block = _mm_aesenclast_si128(block, key[round]);
+                _mm_storeu_si128((__m128i *)pOutput, block);
+            }
+            _mm_storeu_si128((__m128i *)pVector, block);
+        }
+
+        static __attribute__((target("aes")))
+        void decryptCBCNI(const uint8_t *pKey, unsigned int pRoundCount, const uint8_t *pInput,
+          uint8_t *pOutput, unsigned int pCount, uint8_t *pVector)
+        {
+            __m128i key[15], b0, b1, b2, b3, e0, e1, e2, e3;
+            unsigned int round;
+            for(round = 0; round <= pRoundCount; ++round)
+                key[round] = _mm_loadu_si128((const __m128i *)(pKey + (round * 16)));
+
+            // Encrypted blocks are kept in registers so output can be the same as input.
+            __m128i vector = _mm_loadu_si128((const __m128i *)pVector);
+            for(; pCount >= 4; pCount -= 4, pInput += 64, pOutput += 64)
+            {
+                e0 = _mm_loadu_si128((const __m128i *)pInput);
+                e1 = _mm_loadu_si128((const __m128i *)(pInput + 16));
+                e2 = _mm_loadu_si128((const __m128i *)(pInput + 32));
+                e3 = _mm_loadu_si128((const __m128i *)(pInput + 48));
+                b0 = _mm_xor_si128(e0, key[0]);
+                b1 = _mm_xor_si128(e1, key[0]);
+                b2 = _mm_xor_si128(e2, key[0]);
+                b3 = _mm_xor_si128(e3, key[0]);
+                for(round = 1; round < pRoundCount; ++round)
+                {
+                    b0 = _mm_aesdec_si128(b0, key[round]);
+                    b1 = _mm_aesdec_si128(b1, key[round]);
+                    b2 = _mm_aesdec_si128(b2, key[round]);
+                    b3 = _mm_aesdec_si128(b3, key[round]);
                 }
+                b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, key[round]), vector);
+                b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, key[round]), e0);
+                b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, key[round]), e1);
+                b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, key[round]), e2);
+                _mm_storeu_si128((__m128i *)pOutput, b0);
+                _mm_storeu_si128((__m128i *)(pOutput + 16), b1);
+                _mm_storeu_si128((__m128i *)(pOutput + 32), b2);
+                _mm_storeu_si128((__m128i *)(pOutput + 48), b3);
+                vector = e3;
             }
-            else
-                return false;
 
-            return true;
+            for(; pCount > 0; --pCount, pInput += 16, pOutput += 16)
+            {
+                e0 = _mm_loadu_si128((const __m128i *)pInput);
+                b0 = _mm_xor_si128(e0, key[0]);
+                for(round = 1; round < pRoundCount; ++round)
+                    b0 = _mm_aesdec_si128(b0, key[round]);
+                b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, key[round]), vector);
+                _mm_storeu_si128((__m128i *)pOutput, b0);
+                vector = e0;
+            }
+            _mm_storeu_si128((__m128i *)pVector, vector);
         }
 
-        void inverseMixColumns()
+        // Sets pResult to the decrypt keys for aesdec, the encrypt keys in reverse order with
+        //   inverse mix columns applied to the middle rounds.
+        static __attribute__((target("aes")))
+        void decryptKeysNI(const uint8_t *pKey, unsigned int pRoundCount, uint8_t *pResult)
         {
-            unsigned int row, col;
+            __m128i key;
+            for(unsigned int round = 0; round <= pRoundCount; ++round)
+            {
+                key = _mm_loadu_si128((const __m128i *)(pKey + ((pRoundCount - round) * 16)));
+                if(round > 0 && round < pRoundCount)
+                    key = _mm_aesimc_si128(key);
+                _mm_storeu_si128((__m128i *)(pResult + (round * 16)), key);
+            }
+        }
+#endif
 
-            std::memcpy(mPreviousState, mState, mBlockByteCount);
+        static std::atomic<int> sImplementation(-1); // Chosen on first use.
 
-            for(col = 0; col < mRowLength; ++col)
-                for(row = 0; row < 4; ++row)
-                    mState[gridOffset(row, col, mRowLength)] =
-                      multiply(0x0e, mPreviousState[gridOffset(row, col, mRowLength)]) ^
-                      multiply(0x0b, mPreviousState[gridOffset((row + 1) % 4, col, mRowLength)]) ^
-                      multiply(0x0d, mPreviousState[gridOffset((row + 2) % 4, col, mRowLength)]) ^
-                      multiply(0x09, mPreviousState[gridOffset((row + 3) % 4, col, mRowLength)]);
+        static Encryption::AESImplementation fastestImplementation()
+        {
+            if(Encryption::aesSupported(Encryption::AES_NI))
+                return Encryption::AES_NI;
+            return Encryption::AES_GENERIC;
         }
+    }
+
+    bool Encryption::aesSupported(AESImplementation pImplementation)
+    {
+        switch(pImplementation)
+        {
+        case AES_GENERIC:
+            return true;
+        case AES_NI:
+#ifdef NEXTCASH_X86_INTRINSICS
+            return CPU::has(CPU::AES);
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    bool Encryption::setAESImplementation(AESImplementation pImplementation)
+    {
+        if(!aesSupported(pImplementation))
+            return false;
+        Rijndael::sImplementation.store(pImplementation, std::memory_order_relaxed);
+        return true;
+    }
+
+    void Encryption::resetAESImplementation()
+    {
+        Rijndael::sImplementation.store(Rijndael::fastestImplementation(),
+          std::memory_order_relaxed);
+    }
+
+    Encryption::AESImplementation Encryption::aesImplementation()
+    {
+        int result = Rijndael::sImplementation.load(std::memory_order_relaxed);
+        if(result == -1)
+            return Rijndael::fastestImplementation();
+        return (AESImplementation)result;
+    }
+
+    const char *Encryption::aesImplementationName(AESImplementation pImplementation)
+    {
+        switch(pImplementation)
+        {
+        case AES_GENERIC:
+            return "Generic";
+        case AES_NI:
+            return "AES-NI";
+        }
+        return "Unknown";
+    }
+
+    // Key schedule calculated once by the constructor. The implementation is chosen when the
+    //   object is created.
+    class AES
+    {
+    public:
+
+        AES(unsigned int pKeySize, const uint8_t *pKey, unsigned int pKeyLength);
+        ~AES() { zeroize(); }
+
+        Encryption::AESImplementation implementation() const { return mImplementation; }
+
+        // Process pCount 16 byte blocks. pOutput can be the same as pInput.
+        void encrypt(const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount) const;
+        void decrypt(const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount) const;
+
+        // pVector is the 16 byte chaining value and is updated for the next call.
+        void encryptCBC(const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount,
+          uint8_t *pVector) const;
+        void decryptCBC(const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount,
+          uint8_t *pVector) const;
+
+    private:
+
+        static const unsigned int MAX_ROUND_COUNT = 14;
+
+        void zeroize();
+
+        Encryption::AESImplementation mImplementation;
+        unsigned int mRoundCount;
+
+        // Round keys in byte order for AES-NI.
+        uint8_t mEncryptKey[(MAX_ROUND_COUNT + 1) * 16];
+        uint8_t mDecryptKey[(MAX_ROUND_COUNT + 1) * 16];
+
+        // Round keys in big endian words for the T-tables.
+        uint32_t mEncryptWords[(MAX_ROUND_COUNT + 1) * 4];
+        uint32_t mDecryptWords[(MAX_ROUND_COUNT + 1) * 4];
+
+        AES(const AES &pCopy);
+        const AES &operator = (const AES &pRight);
+
     };
 
     AES::AES(unsigned int pKeySize, const uint8_t *pKey, unsigned int pKeyLength)
     {
-        mKeySize = pKeySize;
-        mBlockByteCount = 16;
-        mRowLength = mBlockByteCount / 4;
+        mImplementation = Encryption::aesImplementation();
+        mRoundCount = (pKeySize / 4) + 6;
 
-        unsigned int roundIndex;
-        if(mRowLength > (mKeySize / 4))
-            roundIndex = mRowLength;
-        else
-            roundIndex = (mKeySize / 4);
+        // Extra space because the last expansion step can write past the last round key.
+        uint8_t expandedKey[(MAX_ROUND_COUNT + 2) * 16];
+        Rijndael::expandKey(pKey, pKeyLength, pKeySize, mRoundCount, expandedKey);
+        std::memcpy(mEncryptKey, expandedKey, (mRoundCount + 1) * 16);
+        std::memset(expandedKey, 0, sizeof(expandedKey));
+
+#ifdef NEXTCASH_X86_INTRINSICS
+        if(mImplementation == Encryption::AES_NI)
+        {
+            Rijndael::decryptKeysNI(mEncryptKey, mRoundCount, mDecryptKey);
+            return;
+        }
+#endif
 
-        mRoundCount = roundIndex + 6;
-        mKeyOffset = 0;
-        mExpandedKey = NULL;
-        mState = NULL;
-        mPreviousState = new uint8_t[mBlockByteCount];
+        for(unsigned int i = 0; i < (mRoundCount + 1) * 4; ++i)
+            mEncryptWords[i] = Rijndael::loadWord(mEncryptKey + (i * 4));
 
-        expandKey(pKey, pKeyLength);
+        const Rijndael::Tables &tables = Rijndael::tables();
+        const uint32_t *encryptWord;
+        uint32_t *decryptWord = mDecryptWords;
+        for(unsigned int round = 0; round <= mRoundCount; ++round)
+        {
+            encryptWord = mEncryptWords + ((mRoundCount - round) * 4);
+            for(unsigned int i = 0; i < 4; ++i, ++encryptWord, ++decryptWord)
+            {
+                if(round == 0 || round == mRoundCount)
+                    *decryptWord = *encryptWord;
+                else // Inverse mix columns. The decrypt tables include the inverse S-box.
+                    *decryptWord = tables.decrypt[0][Rijndael::sBox[*encryptWord >> 24]] ^
+                      tables.decrypt[1][Rijndael::sBox[(*encryptWord >> 16) & 0xff]] ^
+                      tables.decrypt[2][Rijndael::sBox[(*encryptWord >> 8) & 0xff]] ^
+                      tables.decrypt[3][Rijndael::sBox[*encryptWord & 0xff]];
+            }
+        }
     }
 
-    void AES::expandKey(const uint8_t *pKey, unsigned int pKeyLength)
+    void AES::zeroize()
     {
-        if(mExpandedKey != NULL)
-            delete[] mExpandedKey;
+        std::memset(mEncryptKey, 0, sizeof(mEncryptKey));
+        std::memset(mDecryptKey, 0, sizeof(mDecryptKey));
+        std::memset(mEncryptWords, 0, sizeof(mEncryptWords));
+        std::memset(mDecryptWords, 0, sizeof(mDecryptWords));
+    }
 
-        mExpandedKey = new uint8_t[((mRoundCount + 2) * mBlockByteCount)];
-        std::memcpy(mExpandedKey, pKey, pKeyLength);
-        if(mKeySize > pKeyLength)
-            std::memset(mExpandedKey + pKeyLength, 0, mKeySize - pKeyLength);
+    void AES::encrypt(const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount) const
+    {
+#ifdef NEXTCASH_X86_INTRINSICS
+        if(mImplementation == Encryption::AES_NI)
+        {
+            Rijndael::encryptBlocksNI(mEncryptKey, mRoundCount, pInput, pOutput, pCount);
+            return;
+        }
+#endif
+        Rijndael::encryptBlocksGeneric(mEncryptWords, mRoundCount, pInput, pOutput, pCount);
+    }
 
-        uint8_t currentCore[4];
-        unsigned int i = 2, j, k, m;
-        unsigned int keyCount = mKeySize;
+    void AES::decrypt(const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount) const
+    {
+#ifdef NEXTCASH_X86_INTRINSICS
+        if(mImplementation == Encryption::AES_NI)
+        {
+            Rijndael::decryptBlocksNI(mDecryptKey, mRoundCount, pInput, pOutput, pCount);
+            return;
+        }
+#endif
+        Rijndael::decryptBlocksGeneric(mDecryptWords, mRoundCount, pInput, pOutput, pCount);
+    }
 
-        for(j = 0; j < 4; ++j)
-            currentCore[j] = mExpandedKey[mKeySize - 4 + j];
+    void AES::encryptCBC(const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount,
+      uint8_t *pVector) const
+    {
+#ifdef NEXTCASH_X86_INTRINSICS
+        if(mImplementation == Encryption::AES_NI)
+        {
+            Rijndael::encryptCBCNI(mEncryptKey, mRoundCount, pInput, pOutput, pCount, pVector);
+            return;
+        }
+#endif
+        Rijndael::encryptCBCGeneric(mEncryptWords, mRoundCount, pInput, pOutput, pCount,
+          pVector);
+    }
 
-        while(keyCount < (mRoundCount + 1) * mBlockByteCount)
+    void AES::decryptCBC(const uint8_t *pInput, uint8_t *pOutput, unsigned int pCount,
+      uint8_t *pVector) const
+    {
+#ifdef NEXTCASH_X86_INTRINSICS
+        if(mImplementation == Encryption::AES_NI)
         {
-            keyScheduleCore(currentCore, i++);
+            Rijndael::decryptCBCNI(mDecryptKey, mRoundCount, pInput, pOutput, pCount, pVector);
+            return;
+        }
+#endif
+        Rijndael::decryptCBCGeneric(mDecryptWords, mRoundCount, pInput, pOutput, pCount,
+          pVector);
+    }
 
-            for(j = 0; j < 4; ++j)
-            {
-                for(k = 0; k < 4; ++k)
-                    currentCore[k] ^= mExpandedKey[keyCount + k - mKeySize];
+    namespace Galois
+    {
+        // Reduction of the 4 bits shifted out of the low end, for the generic multiply.
+        static const uint64_t sLast4[16] =
+        {
+            0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+            0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+        };
 
-                std::memcpy(mExpandedKey + keyCount, currentCore, 4);
-                keyCount += 4;
-            }
+        // Sets pHigh and pLow to the key times each 4 bit value, in the bit reflected order GCM
+        //   uses, so a multiply is 32 lookups.
+        static void generateTables(const uint8_t *pKey, uint64_t *pHigh, uint64_t *pLow)
+        {
+            uint64_t high = ((uint64_t)Rijndael::loadWord(pKey) << 32) |
+              Rijndael::loadWord(pKey + 4);
+            uint64_t low = ((uint64_t)Rijndael::loadWord(pKey + 8) << 32) |
+              Rijndael::loadWord(pKey + 12);
 
-            if(mKeySize == 32) // AES 256
+            pHigh[0] = 0;
+            pLow[0] = 0;
+            pHigh[8] = high;
+            pLow[8] = low;
+
+            for(unsigned int i = 4; i > 0; i >>= 1)
             {
-                for(j = 0; j < 4; ++j)
-                    currentCore[j] = Rijndael::sBox[currentCore [j]];
+                uint64_t reduce = (low & 1) * 0xe1000000;
+                low = (high << 63) | (low >> 1);
+                high = (high >> 1) ^ (reduce << 32);
+                pHigh[i] = high;
+                pLow[i] = low;
+            }
 
-                for(k = 0; k < 4; ++k)
-                    currentCore[k] ^= mExpandedKey[keyCount + k - mKeySize];
+            for(unsigned int i = 2; i <= 8; i *= 2)
+                for(unsigned int j = 1; j < i; ++j)
+                {
+                    pHigh[i + j] = pHigh[i] ^ pHigh[j];
+                    pLow[i + j] = pLow[i] ^ pLow[j];
+                }
+        }
 
-                std::memcpy(mExpandedKey + keyCount, currentCore, 4);
-                keyCount += 4;
+        // Multiplies the 16 byte pValue by the key.
+        static void multiplyGeneric(uint8_t *pValue, const uint64_t *pHigh, const uint64_t *pLow)
+        {
+            unsigned int index = pValue[15] & 0x0f, remainder;
+            uint64_t high = pHigh[index], low = pLow[index];
+
+            for(int i = 15; i >= 0; --i)
+            {
+                if(i != 15)
+                {
+                    index = pValue[i] & 0x0f;
+                    remainder = low & 0x0f;
+                    low = (high << 60) | (low >> 4);
+                    high = (high >> 4) ^ (sLast4[remainder] << 48);
+                    high ^= pHigh[index];
+                    low ^= pLow[index];
+                }
+
+                index = pValue[i] >> 4;
+                remainder = low & 0x0f;
+                low = (high << 60) | (low >> 4);
+                high = (high >> 4) ^ (sLast4[remainder] << 48);
+                high ^= pHigh[index];
+                low ^= pLow[index];
             }
 
-            if(mKeySize == 32)
-                m = 3;
-            else if(mKeySize == 24)
-                m = 2;
-            else
-                m = 0;
+            Rijndael::storeWord(high >> 32, pValue);
+            Rijndael::storeWord(high, pValue + 4);
+            Rijndael::storeWord(low >> 32, pValue + 8);
+            Rijndael::storeWord(low, pValue + 12);
+        }
 
-            while(m)
-            {
-                for(k = 0; k < 4; ++k)
-                    currentCore[k] ^= mExpandedKey[keyCount + k - mKeySize];
+#ifdef NEXTCASH_X86_INTRINSICS
+        // Carry-less multiply of byte reversed values with reduction (Intel's GCM white paper).
+        static __attribute__((target("pclmul,ssse3")))
+        __m128i multiplyPCLMUL(__m128i pLeft, __m128i pRight)
+        {
+            __m128i low = _mm_clmulepi64_si128(pLeft, pRight, 0x00);
+            __m128i middle = _mm_xor_si128(_mm_clmulepi64_si128(pLeft, pRight, 0x10),
+              _mm_clmulepi64_si128(pLeft, pRight, 0x01));
+            __m128i high = _mm_clmulepi64_si128(pLeft, pRight, 0x11);
+            __m128i a, b, c;
+
+            low = _mm_xor_si128(low, _mm_slli_si128(middle, 8));
+            high = _mm_xor_si128(high, _mm_srli_si128(middle, 8));
+
+            // Shift the 256 bit product left one bit because the values are bit reflected.
+            a = _mm_srli_epi32(low, 31);
+            b = _mm_srli_epi32(high, 31);
+            low = _mm_slli_epi32(low, 1);
+            high = _mm_slli_epi32(high, 1);
+            c = _mm_srli_si128(a, 12);
+            b = _mm_slli_si128(b, 4);
+            a = _mm_slli_si128(a, 4);
+            low = _mm_or_si128(low, a);
+            high = _mm_or_si128(_mm_or_si128(high, b), c);
+
+            // Reduce modulo x^128 + x^7 + x^2 + x + 1.
+            a = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(low, 31), _mm_slli_epi32(low, 30)),
+              _mm_slli_epi32(low, 25));
+            b = _mm_srli_si128(a, 4);
+            a = _mm_slli_si128(a, 12);
+            low = _mm_xor_si128(low, a);
+            c = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(low, 1), _mm_srli_epi32(low, 2)),
+              _mm_srli_epi32(low, 7));
+            c = _mm_xor_si128(c, b);
+            low = _mm_xor_si128(low, c);
+            return _mm_xor_si128(high, low);
+        }
 
-                std::memcpy(mExpandedKey + keyCount, currentCore, 4);
-                keyCount += 4;
+        static __attribute__((target("ssse3")))
+        __m128i reverseBytes(__m128i pValue)
+        {
+            return _mm_shuffle_epi8(pValue,
+              _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        }
 
-                --m;
+        // Sets pPowers to the key to the power of 1 to 4, byte reversed.
+        static __attribute__((target("pclmul,ssse3")))
+        void generatePowers(const uint8_t *pKey, uint8_t (*pPowers)[16])
+        {
+            __m128i key = reverseBytes(_mm_loadu_si128((const __m128i *)pKey));
+            __m128i power = key;
+            for(unsigned int i = 0; i < 4; ++i)
+            {
+                _mm_storeu_si128((__m128i *)pPowers[i], power);
+                power = multiplyPCLMUL(power, key);
             }
         }
+
+        // Four blocks are combined with the powers of the key so their multiplies are independent
+        //   and overlap.
+        static __attribute__((target("pclmul,ssse3")))
+        void processPCLMUL(uint8_t *pValue, const uint8_t (*pPowers)[16], const uint8_t *pBlocks,
+          stream_size pCount)
+        {
+            __m128i value = reverseBytes(_mm_loadu_si128((const __m128i *)pValue));
+            __m128i h1 = _mm_loadu_si128((const __m128i *)pPowers[0]);
+            __m128i h2 = _mm_loadu_si128((const __m128i *)pPowers[1]);
+            __m128i h3 = _mm_loadu_si128((const __m128i *)pPowers[2]);
+            __m128i h4 = _mm_loadu_si128((const __m128i *)pPowers[3]);
+            __m128i b0, b1, b2, b3;
+
+            for(; pCount >= 4; pCount -= 4, pBlocks += 64)
+            {
+                b0 = _mm_xor_si128(value,
+                  reverseBytes(_mm_loadu_si128((const __m128i *)pBlocks)));
+                b1 = reverseBytes(_mm_loadu_si128((const __m128i *)(pBlocks + 16)));
+                b2 = reverseBytes(_mm_loadu_si128((const __m128i *)(pBlocks + 32)));
+                b3 = reverseBytes(_mm_loadu_si128((const __m128i *)(pBlocks + 48)));
+                value = _mm_xor_si128(
+                  _mm_xor_si128(multiplyPCLMUL(b0, h4), multiplyPCLMUL(b1, h3)),
+                  _mm_xor_si128(multiplyPCLMUL(b2, h2), multiplyPCLMUL(b3, h1)));
+            }
+
+            for(; pCount > 0; --pCount, pBlocks += 16)
+                value = multiplyPCLMUL(_mm_xor_si128(value,
+                  reverseBytes(_mm_loadu_si128((const __m128i *)pBlocks))), h1);
+
+            _mm_storeu_si128((__m128i *)pValue, reverseBytes(value));
+        }
+#endif
     }
 
-    void AES::encryptBlock(uint8_t *pData)
+    // GCM authentication hash. Blocks are added then multiplied by the hash key in GF(2^128).
+    class GHASH
     {
-        unsigned int i;
+    public:
 
-        mState = pData;
-        mKeyOffset = 0;
+        // pKey is the 16 byte hash key.
+        GHASH(const uint8_t *pKey, bool pUsePCLMUL);
+        ~GHASH();
 
-        // Initial Round
-        // Add Round Key
-        addRoundKey();
+        // Start a new hash with the same key.
+        void clear() { std::memset(mValue, 0, 16); mBlockLength = 0; }
 
-        // Intermediate Rounds
-        for(unsigned int roundOffset = 1; roundOffset < mRoundCount; ++roundOffset)
-        {
-            // Sub Bytes
-            for(i = 0; i < mBlockByteCount; ++i)
-                mState[i] = Rijndael::sBox[mState[i]];
+        // Partial blocks are kept until more data is written or pad is called.
+        void write(const uint8_t *pData, stream_size pSize);
+
+        // Zero fills a partial block. Separates authenticated data from encrypted data.
+        void pad();
+
+        // Adds the length block and sets pResult to the 16 byte hash.
+        void finish(stream_size pAuthenticatedSize, stream_size pEncryptedSize,
+          uint8_t *pResult);
+
+    private:
+
+        void process(const uint8_t *pBlocks, stream_size pCount);
+
+        bool mUsePCLMUL;
+        uint8_t mValue[16];
+        uint8_t mBlock[16];
+        unsigned int mBlockLength;
+
+        // Generic multiply tables
+        uint64_t mHigh[16], mLow[16];
 
-            // Shift Rows
-            shiftRows();
+        // Byte reversed powers of the key for PCLMUL
+        uint8_t mPowers[4][16];
 
-            // Mix Columns
-            mixColumns();
+        GHASH(const GHASH &pCopy);
+        const GHASH &operator = (const GHASH &pRight);
 
-            // Add Round Key
-            addRoundKey();
+    };
+
+    GHASH::GHASH(const uint8_t *pKey, bool pUsePCLMUL)
+    {
+        mUsePCLMUL = false;
+#ifdef NEXTCASH_X86_INTRINSICS
+        mUsePCLMUL = pUsePCLMUL;
+        if(mUsePCLMUL)
+            Galois::generatePowers(pKey, mPowers);
+#endif
+        if(!mUsePCLMUL)
+            Galois::generateTables(pKey, mHigh, mLow);
+        clear();
+    }
+
+    GHASH::~GHASH()
+    {
+        // The tables are derived from the key.
+        std::memset(mHigh, 0, sizeof(mHigh));
+        std::memset(mLow, 0, sizeof(mLow));
+        std::memset(mPowers, 0, sizeof(mPowers));
+    }
+
+    void GHASH::process(const uint8_t *pBlocks, stream_size pCount)
+    {
+#ifdef NEXTCASH_X86_INTRINSICS
+        if(mUsePCLMUL)
+        {
+            Galois::processPCLMUL(mValue, mPowers, pBlocks, pCount);
+            return;
+        }
+#endif
+        for(; pCount > 0; --pCount, pBlocks += 16)
+        {
+            for(unsigned int i = 0; i < 16; ++i)
+                mValue[i] ^= pBlocks[i];
+            Galois::multiplyGeneric(mValue, mHigh, mLow);
         }
+    }
 
-        // Final Round
-        // Sub Bytes
-        for(i = 0; i < mBlockByteCount; ++i)
-            mState[i] = Rijndael::sBox[mState[i]];
+    void GHASH::write(const uint8_t *pData, stream_size pSize)
+    {
+        if(mBlockLength > 0)
+        {
+            stream_size fill = 16 - mBlockLength;
+            if(fill > pSize)
+                fill = pSize;
+            std::memcpy(mBlock + mBlockLength, pData, fill);
+            mBlockLength += fill;
+            pData += fill;
+            pSize -= fill;
+            if(mBlockLength < 16)
+                return;
+            process(mBlock, 1);
+            mBlockLength = 0;
+        }
 
-        // Shift Rows
-        shiftRows();
+        stream_size count = pSize / 16;
+        if(count > 0)
+        {
+            process(pData, count);
+            pData += count * 16;
+            pSize -= count * 16;
+        }
 
-        // Add Round Key
-        addRoundKey();
+        std::memcpy(mBlock, pData, pSize);
+        mBlockLength = pSize;
+    }
 
-        mState = NULL;
+    void GHASH::pad()
+    {
+        if(mBlockLength == 0)
+            return;
+        std::memset(mBlock + mBlockLength, 0, 16 - mBlockLength);
+        process(mBlock, 1);
+        mBlockLength = 0;
     }
 
-    bool AES::decryptBlock(uint8_t *pData)
+    void GHASH::finish(stream_size pAuthenticatedSize, stream_size pEncryptedSize,
+      uint8_t *pResult)
     {
-        unsigned int i;
+        pad();
 
-        mState = pData;
-        mKeyOffset = ((1 + mRoundCount) * mBlockByteCount) - mBlockByteCount;
+        // Sizes in bits
+        uint8_t sizes[16];
+        Rijndael::storeWord((uint64_t)pAuthenticatedSize >> 29, sizes);
+        Rijndael::storeWord((uint64_t)pAuthenticatedSize << 3, sizes + 4);
+        Rijndael::storeWord((uint64_t)pEncryptedSize >> 29, sizes + 8);
+        Rijndael::storeWord((uint64_t)pEncryptedSize << 3, sizes + 12);
+        process(sizes, 1);
 
-        // Initial Round
+        std::memcpy(pResult, mValue, 16);
+    }
 
-        // Subtract Round Key
-        subtractRoundKey();
+    namespace Counter
+    {
+        // Counter blocks encrypted per AES call, so AES-NI can interleave them.
+        static const unsigned int CHUNK_BLOCKS = 256;
+        // Blocks per task when using threads.
+        static const unsigned int THREAD_BLOCKS = 4096;
 
-        // Intermediate Rounds
-        for(unsigned int roundOffset = 1; roundOffset < mRoundCount; ++roundOffset)
+        // Adds pCount to the big endian counter block. GCM only increments the last 32 bits.
+        static void add(uint8_t *pCounter, uint64_t pCount, bool pIncrement32)
         {
-            // Inverse Shift Rows
-            if(!inverseShiftRows())
-                return false;
+            if(pIncrement32)
+            {
+                Rijndael::storeWord(Rijndael::loadWord(pCounter + 12) + (uint32_t)pCount,
+                  pCounter + 12);
+                return;
+            }
+
+            unsigned int sum;
+            for(int i = 15; i >= 0 && pCount > 0; --i)
+            {
+                sum = pCounter[i] + (unsigned int)(pCount & 0xff);
+                pCounter[i] = sum;
+                pCount = (pCount >> 8) + (sum >> 8);
+            }
+        }
+
+        // XORs pCount blocks of key stream starting at pCounter into pOutput. pCounter is moved
+        //   past the blocks. pOutput can be the same as pInput.
+        static void process(const AES *pAES, uint8_t *pCounter, bool pIncrement32,
+          const uint8_t *pInput, uint8_t *pOutput, stream_size pCount)
+        {
+            uint8_t keyStream[CHUNK_BLOCKS * 16];
+            unsigned int count, size;
 
-            // Inverse Sub Bytes
-            for(i = 0; i < mBlockByteCount; ++i)
-                mState[i] = Rijndael::sInverseSBox[mState[i]];
+            while(pCount > 0)
+            {
+                if(pCount > CHUNK_BLOCKS)
+                    count = CHUNK_BLOCKS;
+                else
+                    count = (unsigned int)pCount;
+
+                for(unsigned int i = 0; i < count; ++i)
+                {
+                    std::memcpy(keyStream + (i * 16), pCounter, 16);
+                    add(pCounter, 1, pIncrement32);
+                }
+                pAES->encrypt(keyStream, keyStream, count);
 
-            // Subtract Round Key
-            subtractRoundKey();
+                size = count * 16;
+                for(unsigned int i = 0; i < size; ++i)
+                    pOutput[i] = pInput[i] ^ keyStream[i];
 
-            // Inverse Mix Columns
-            inverseMixColumns();
+                pInput += size;
+                pOutput += size;
+                pCount -= count;
+            }
         }
 
-        // Final Round
+        // Same as process, but large counts are split between pThreadCount threads. Every block
+        //   only depends on its counter.
+        static void process(const AES *pAES, uint8_t *pCounter, bool pIncrement32,
+          const uint8_t *pInput, uint8_t *pOutput, stream_size pCount, unsigned int pThreadCount)
+        {
+            if(pThreadCount == 1 || pCount <= THREAD_BLOCKS)
+            {
+                process(pAES, pCounter, pIncrement32, pInput, pOutput, pCount);
+                return;
+            }
+
+            unsigned int taskCount = (unsigned int)((pCount + THREAD_BLOCKS - 1) / THREAD_BLOCKS);
+            parallelFor("AESCounter", taskCount, [=](unsigned int pTask)
+            {
+                uint8_t counter[16];
+                stream_size offset = (stream_size)pTask * THREAD_BLOCKS;
+                stream_size count = pCount - offset;
+                if(count > THREAD_BLOCKS)
+                    count = THREAD_BLOCKS;
+
+                std::memcpy(counter, pCounter, 16);
+                add(counter, offset, pIncrement32);
+                process(pAES, counter, pIncrement32, pInput + (offset * 16),
+                  pOutput + (offset * 16), count);
+            }, pThreadCount);
+
+            add(pCounter, pCount, pIncrement32);
+        }
 
-        // Inverse Shift Rows
-        if(!inverseShiftRows())
-            return false;
+        // Sets pCounter to the counter block of the first encrypted block.
+        static void initializeCTR(const uint8_t *pVector, unsigned int pVectorLength,
+          uint8_t *pCounter)
+        {
+            if(pVectorLength > 16)
+                pVectorLength = 16;
+            std::memcpy(pCounter, pVector, pVectorLength);
+            std::memset(pCounter + pVectorLength, 0, 16 - pVectorLength);
+        }
 
-        // Inverse Sub Bytes
-        for(i = 0; i < mBlockByteCount; ++i)
-            mState[i] = Rijndael::sInverseSBox[mState[i]];
+        // Sets pCounter to the counter block of the first encrypted block and pTagMask to the
+        //   encrypted block before it, which is XORed with the hash for the tag. Returns the
+        //   hash for the tag.
+        static GHASH *initializeGCM(const AES *pAES, const uint8_t *pVector,
+          unsigned int pVectorLength, uint8_t *pCounter, uint8_t *pTagMask)
+        {
+            uint8_t key[16];
+            std::memset(key, 0, 16);
+            pAES->encrypt(key, key, 1);
 
-        // Subtract Round Key
-        subtractRoundKey();
+            bool usePCLMUL = pAES->implementation() == Encryption::AES_NI &&
+              CPU::has(CPU::PCLMUL) && CPU::has(CPU::SSSE3);
+            GHASH *result = new GHASH(key, usePCLMUL);
+            std::memset(key, 0, 16);
 
-        mState = NULL;
-        return true;
+            // 12 byte vectors are used directly, others are hashed.
+            if(pVectorLength == 12)
+            {
+                std::memcpy(pCounter, pVector, 12);
+                Rijndael::storeWord(1, pCounter + 12);
+            }
+            else
+            {
+                result->write(pVector, pVectorLength);
+                result->finish(0, pVectorLength, pCounter);
+                result->clear();
+            }
+
+            pAES->encrypt(pCounter, pTagMask, 1);
+            add(pCounter, 1, true);
+            return result;
+        }
     }
 
     Encryptor::Encryptor(OutputStream *pOutput, Encryption::Type pType,
@@ -574,6 +1237,13 @@ namespace NextCash
         mAES = NULL;
         mBlockSize = blockSize(pType, pBlockMethod);
         mBlock = new uint8_t[mBlockSize];
+        mBlockLength = 0;
+        mChunk.resize(CHUNK_SIZE);
+        mThreadCount = 1;
+        mGHASH = NULL;
+        mAuthenticatedSize = 0;
+        mFinalized = false;
+        mFailed = false;
     }
 
     Encryptor::~Encryptor()
@@ -582,84 +1252,197 @@ namespace NextCash
         delete[] mBlock;
         if(mAES != NULL)
             delete mAES;
+        if(mGHASH != NULL)
+            delete mGHASH;
     }
 
     void Encryptor::setup(const uint8_t *pKey, int pKeyLength, const uint8_t *pInitializationVector,
       int pInitializationVectorLength)
     {
         mByteCount = 0;
-        mData.clear();
+        mBlockLength = 0;
+        mAuthenticatedSize = 0;
+        mFinalized = false;
+        mFailed = false;
 
         if(mAES != NULL)
             delete mAES;
+        if(mGHASH != NULL)
+        {
+            delete mGHASH;
+            mGHASH = NULL;
+        }
 
         mAES = new AES(keySize(mType), pKey, pKeyLength);
 
         mVector.clear();
         mVector.resize(pInitializationVectorLength);
         std::memcpy(mVector.data(), pInitializationVector, pInitializationVectorLength);
+
+        switch(mBlockMethod)
+        {
+        case Encryption::CTR:
+            Counter::initializeCTR(pInitializationVector, pInitializationVectorLength, mCounter);
+            break;
+        case Encryption::GCM:
+            mGHASH = Counter::initializeGCM(mAES, pInitializationVector,
+              pInitializationVectorLength, mCounter, mTagMask);
+            break;
+        default:
+            break;
+        }
     }
 
-    void Encryptor::process()
+    bool Encryptor::addAuthenticatedData(const uint8_t *pData, stream_size pSize)
     {
-        while(mData.remaining() >= mBlockSize)
-        {
-            mData.read(mBlock, mBlockSize);
+        if(mGHASH == NULL || mByteCount > 0)
+            return false;
+        mGHASH->write(pData, pSize);
+        mAuthenticatedSize += pSize;
+        return true;
+    }
 
-            // Perform the Block Cipher
-            switch (mBlockMethod)
-            {
-            case Encryption::CBC:
-                xorBlock(mVector.data(), mVector.size(), mBlock, mBlockSize);
-                break;
-            case Encryption::ECB:
-            default:
-                break;
-            }
+    void Encryptor::setThreadCount(unsigned int pThreadCount)
+    {
+        mThreadCount = pThreadCount;
+        mChunk.resize(mThreadCount == 1 ? CHUNK_SIZE : THREAD_CHUNK_SIZE);
+    }
 
-            // Encrypt the block
-            switch (mType)
-            {
-            case Encryption::AES_128:
-            case Encryption::AES_192:
-            case Encryption::AES_256:
-                mAES->encryptBlock(mBlock);
-                break;
-            }
+    void Encryptor::process(const uint8_t *pInput, stream_size pCount)
+    {
+        unsigned int count;
+        while(pCount > 0)
+        {
+            if(pCount > mChunk.size() / mBlockSize)
+                count = mChunk.size() / mBlockSize;
+            else
+                count = (unsigned int)pCount;
 
-            // Perform the Block Cipher
-            switch (mBlockMethod)
+            switch(mBlockMethod)
             {
             case Encryption::CBC:
-                std::memcpy(mVector.data(), mBlock,
-                  mVector.size() > mBlockSize ? mBlockSize : mVector.size());
+                if(mVector.size() == mBlockSize)
+                    mAES->encryptCBC(pInput, mChunk.data(), count, mVector.data());
+                else
+                {
+                    // Initialization vectors that aren't one block are repeated or truncated.
+                    for(unsigned int i = 0; i < count; ++i)
+                    {
+                        std::memcpy(mChunk.data() + (i * mBlockSize), pInput + (i * mBlockSize),
+                          mBlockSize);
+                        xorBlock(mVector.data(), mVector.size(), mChunk.data() + (i * mBlockSize),
+                          mBlockSize);
+                        mAES->encrypt(mChunk.data() + (i * mBlockSize),
+                          mChunk.data() + (i * mBlockSize), 1);
+                        std::memcpy(mVector.data(), mChunk.data() + (i * mBlockSize),
+                          mVector.size() > mBlockSize ? mBlockSize : mVector.size());
+                    }
+                }
+                break;
+            case Encryption::CTR:
+            case Encryption::GCM:
+                Counter::process(mAES, mCounter, mBlockMethod == Encryption::GCM, pInput,
+                  mChunk.data(), count, mThreadCount);
+                if(mGHASH != NULL)
+                {
+                    mGHASH->pad(); // End of authenticated data
+                    mGHASH->write(mChunk.data(), count * mBlockSize);
+                }
                 break;
             case Encryption::ECB:
             default:
+                mAES->encrypt(pInput, mChunk.data(), count);
                 break;
             }
 
-            mOutput->write(mBlock, mBlockSize);
+            mOutput->write(mChunk.data(), count * mBlockSize);
+            pInput += count * mBlockSize;
+            pCount -= count;
         }
-
-        mData.flush();
     }
 
     void Encryptor::finalize()
     {
-        if(mData.remaining() > 0)
+        if(mFailed)
+            return;
+
+        if(mBlockLength > 0)
+        {
+            if(mBlockMethod == Encryption::CTR || mBlockMethod == Encryption::GCM)
+            {
+                // Not padded. Only the partial block is written.
+                Counter::process(mAES, mCounter, mBlockMethod == Encryption::GCM, mBlock, mBlock,
+                  1);
+                if(mGHASH != NULL)
+                {
+                    mGHASH->pad();
+                    mGHASH->write(mBlock, mBlockLength);
+                }
+                mOutput->write(mBlock, mBlockLength);
+                mBlockLength = 0;
+            }
+            else
+            {
+                std::memset(mBlock + mBlockLength, 0, mBlockSize - mBlockLength);
+                mBlockLength = 0;
+                process(mBlock, 1);
+            }
+        }
+
+        if(mGHASH != NULL && !mFinalized)
         {
-            while(mData.remaining() < mBlockSize)
-                mData.writeByte(0);
-            process();
+            uint8_t tag[Encryption::GCM_TAG_SIZE];
+            mGHASH->finish(mAuthenticatedSize, mByteCount, tag);
+            for(unsigned int i = 0; i < Encryption::GCM_TAG_SIZE; ++i)
+                tag[i] ^= mTagMask[i];
+            mOutput->write(tag, Encryption::GCM_TAG_SIZE);
+            mFinalized = true;
         }
     }
 
     void Encryptor::write(const void *pInput, stream_size pSize)
     {
-        mData.write(pInput, pSize);
+        const uint8_t *input = (const uint8_t *)pInput;
+
+        if(mFailed)
+            return;
+        if(mBlockMethod == Encryption::GCM && pSize > Encryption::GCM_MAX_SIZE - mByteCount)
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+              "GCM encrypted data exceeds maximum size");
+            mFailed = true;
+            return;
+        }
+
         mByteCount += pSize;
-        process();
+
+        // Complete the partial block.
+        if(mBlockLength > 0)
+        {
+            stream_size fill = mBlockSize - mBlockLength;
+            if(fill > pSize)
+                fill = pSize;
+            std::memcpy(mBlock + mBlockLength, input, fill);
+            mBlockLength += fill;
+            input += fill;
+            pSize -= fill;
+            if(mBlockLength < mBlockSize)
+                return;
+            mBlockLength = 0;
+            process(mBlock, 1);
+        }
+
+        // Whole blocks directly from the input.
+        stream_size count = pSize / mBlockSize;
+        if(count > 0)
+        {
+            process(input, count);
+            input += count * mBlockSize;
+            pSize -= count * mBlockSize;
+        }
+
+        std::memcpy(mBlock, input, pSize);
+        mBlockLength = pSize;
     }
 
     Decryptor::Decryptor(InputStream *pInput, Encryption::Type pType,
@@ -670,74 +1453,234 @@ namespace NextCash
         mBlockMethod = pBlockMethod;
         mAES = NULL;
         mBlockSize = blockSize(pType, pBlockMethod);
-        mBlock = new uint8_t[mBlockSize];
         mEncryptedBlock = new uint8_t[mBlockSize];
+        mChunk.resize(CHUNK_SIZE);
+        mThreadCount = 1;
+        mStartOffset = 0;
+        mGHASH = NULL;
     }
 
     Decryptor::~Decryptor()
     {
-        delete[] mBlock;
         delete[] mEncryptedBlock;
         if(mAES != NULL)
             delete mAES;
+        if(mGHASH != NULL)
+            delete mGHASH;
     }
 
     void Decryptor::setup(const uint8_t *pKey, int pKeyLength,
       const uint8_t *pInitializationVector, int pInitializationVectorLength)
     {
         mData.clear();
+        mAuthenticatedData.clear();
+        mStartOffset = mInput->readOffset();
 
         if(mAES != NULL)
             delete mAES;
+        if(mGHASH != NULL)
+        {
+            delete mGHASH;
+            mGHASH = NULL;
+        }
 
         mAES = new AES(keySize(mType), pKey, pKeyLength);
 
         mVector.clear();
         mVector.resize(pInitializationVectorLength);
         std::memcpy(mVector.data(), pInitializationVector, pInitializationVectorLength);
+
+        switch(mBlockMethod)
+        {
+        case Encryption::CTR:
+            Counter::initializeCTR(pInitializationVector, pInitializationVectorLength,
+              mFirstCounter);
+            break;
+        case Encryption::GCM:
+            mGHASH = Counter::initializeGCM(mAES, pInitializationVector,
+              pInitializationVectorLength, mFirstCounter, mTagMask);
+            break;
+        default:
+            break;
+        }
     }
 
-    bool Decryptor::read(void *pOutput, stream_size pSize)
+    bool Decryptor::addAuthenticatedData(const uint8_t *pData, stream_size pSize)
+    {
+        if(mGHASH == NULL)
+            return false;
+        mAuthenticatedData.insert(mAuthenticatedData.end(), pData, pData + pSize);
+        return true;
+    }
+
+    bool Decryptor::authenticate()
     {
-        while(mData.remaining() < pSize)
+        if(mGHASH == NULL)
+            return false;
+
+        stream_size offset = mInput->readOffset(), end = length();
+        if(end < mStartOffset || end - mStartOffset > Encryption::GCM_MAX_SIZE ||
+          mInput->length() < Encryption::GCM_TAG_SIZE || !mInput->setReadOffset(mStartOffset))
+            return false;
+
+        mGHASH->clear();
+        mGHASH->write(mAuthenticatedData.data(), mAuthenticatedData.size());
+        mGHASH->pad();
+
+        // The hash is of the encrypted data, so nothing is decrypted.
+        stream_size remaining = end - mStartOffset, size;
+        while(remaining > 0)
         {
-            if(mInput->remaining() == 0)
-                break;
-            else if(mInput->remaining() < mBlockSize)
+            size = remaining;
+            if(size > mChunk.size())
+                size = mChunk.size();
+            if(!mInput->read(mChunk.data(), size))
             {
-                // Zeroize end of block
-                std::memset(mBlock + mInput->remaining(), 0, mBlockSize - mInput->remaining());
-                mInput->read(mBlock, mInput->remaining());
+                mInput->setReadOffset(offset);
+                return false;
             }
+            mGHASH->write(mChunk.data(), size);
+            remaining -= size;
+        }
+
+        uint8_t tag[Encryption::GCM_TAG_SIZE], hash[Encryption::GCM_TAG_SIZE];
+        bool success = mInput->read(tag, Encryption::GCM_TAG_SIZE);
+        mGHASH->finish(mAuthenticatedData.size(), end - mStartOffset, hash);
+        mInput->setReadOffset(offset);
+
+        // Compare every byte so the time taken doesn't show how much matched.
+        uint8_t difference = 0;
+        for(unsigned int i = 0; i < Encryption::GCM_TAG_SIZE; ++i)
+            difference |= tag[i] ^ hash[i] ^ mTagMask[i];
+        return success && difference == 0;
+    }
+
+    void Decryptor::setThreadCount(unsigned int pThreadCount)
+    {
+        mThreadCount = pThreadCount;
+        mChunk.resize(mThreadCount == 1 ? CHUNK_SIZE : THREAD_CHUNK_SIZE);
+    }
+
+    bool Decryptor::setReadOffset(stream_size pOffset)
+    {
+        // CBC blocks depend on the block before them.
+        if(mAES == NULL || mBlockMethod == Encryption::CBC || pOffset < mStartOffset ||
+          pOffset > length() ||
+          (mBlockMethod == Encryption::GCM && pOffset - mStartOffset > Encryption::GCM_MAX_SIZE))
+            return false;
+
+        stream_size blockOffset = mStartOffset +
+          (((pOffset - mStartOffset) / mBlockSize) * mBlockSize);
+        if(!mInput->setReadOffset(blockOffset))
+            return false;
+        mData.clear();
+
+        // Decrypt the block containing the offset and skip to the offset.
+        if(pOffset > blockOffset)
+        {
+            uint8_t skip[16];
+            return read(skip, pOffset - blockOffset);
+        }
+
+        return true;
+    }
+
+    stream_size Decryptor::length() const
+    {
+        if(mBlockMethod == Encryption::GCM && mInput->length() >= Encryption::GCM_TAG_SIZE)
+            return mInput->length() - Encryption::GCM_TAG_SIZE;
+        return mInput->length();
+    }
+
+    stream_size Decryptor::inputRemaining() const
+    {
+        if(mBlockMethod != Encryption::GCM)
+            return mInput->remaining();
+
+        stream_size end = length(), offset = mInput->readOffset();
+        if(offset < end)
+            return end - offset;
+        return 0;
+    }
+
+    void Decryptor::process(unsigned int pCount, stream_size pBlockOffset)
+    {
+        uint8_t counter[16];
+
+        switch(mBlockMethod)
+        {
+        case Encryption::CBC:
+            if(mVector.size() == mBlockSize)
+                mAES->decryptCBC(mChunk.data(), mChunk.data(), pCount, mVector.data());
             else
-                mInput->read(mBlock, mBlockSize);
+            {
+                // Initialization vectors that aren't one block are repeated or truncated.
+                for(unsigned int i = 0; i < pCount; ++i)
+                {
+                    std::memcpy(mEncryptedBlock, mChunk.data() + (i * mBlockSize), mBlockSize);
+                    mAES->decrypt(mChunk.data() + (i * mBlockSize),
+                      mChunk.data() + (i * mBlockSize), 1);
+                    xorBlock(mVector.data(), mVector.size(), mChunk.data() + (i * mBlockSize),
+                      mBlockSize);
+                    std::memcpy(mVector.data(), mEncryptedBlock,
+                      mVector.size() > mBlockSize ? mBlockSize : mVector.size());
+                }
+            }
+            break;
+        case Encryption::CTR:
+        case Encryption::GCM:
+            // The counter is calculated from the offset so reads can start anywhere.
+            std::memcpy(counter, mFirstCounter, 16);
+            Counter::add(counter, pBlockOffset, mBlockMethod == Encryption::GCM);
+            Counter::process(mAES, counter, mBlockMethod == Encryption::GCM, mChunk.data(),
+              mChunk.data(), pCount, mThreadCount);
+            break;
+        case Encryption::ECB:
+        default:
+            mAES->decrypt(mChunk.data(), mChunk.data(), pCount);
+            break;
+        }
+    }
 
-            std::memcpy(mEncryptedBlock, mBlock, mBlockSize);
+    bool Decryptor::read(void *pOutput, stream_size pSize)
+    {
+        stream_size needed, size, blockOffset;
+        unsigned int count;
 
-            // Decrypt a block
-            switch (mType)
+        mData.flush();
+        while(mData.remaining() < pSize && inputRemaining() > 0)
+        {
+            // Only read the blocks needed, up to a chunk.
+            needed = (pSize - mData.remaining() + mBlockSize - 1) / mBlockSize;
+            if(needed > mChunk.size() / mBlockSize)
+                count = mChunk.size() / mBlockSize;
+            else
+                count = (unsigned int)needed;
+            size = count * mBlockSize;
+            if(size > inputRemaining())
             {
-            case Encryption::AES_128:
-            case Encryption::AES_192:
-            case Encryption::AES_256:
-                mAES->decryptBlock(mBlock);
-                break;
+                size = inputRemaining();
+                count = (size + mBlockSize - 1) / mBlockSize;
+                // Zeroize end of block
+                std::memset(mChunk.data() + size, 0, (count * mBlockSize) - size);
             }
 
-            // Perform the Block Cipher
-            switch (mBlockMethod)
+            blockOffset = (mInput->readOffset() - mStartOffset) / mBlockSize;
+            if(mBlockMethod == Encryption::GCM &&
+              blockOffset + count > Encryption::GCM_MAX_SIZE / mBlockSize)
             {
-            case Encryption::CBC:
-                xorBlock(mVector.data(), mVector.size(), mBlock, mBlockSize);
-                std::memcpy(mVector.data(), mEncryptedBlock,
-                  mVector.size() > mBlockSize ? mBlockSize : mVector.size());
-                break;
-            case Encryption::ECB:
-            default:
-                break;
+                Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                  "GCM encrypted data exceeds maximum size");
+                return false;
             }
+            mInput->read(mChunk.data(), size);
+            process(count, blockOffset);
 
-            mData.write(mBlock, mBlockSize);
+            // CTR and GCM aren't padded.
+            if(mBlockMethod == Encryption::CTR || mBlockMethod == Encryption::GCM)
+                mData.write(mChunk.data(), size);
+            else
+                mData.write(mChunk.data(), count * mBlockSize);
         }
 
         return mData.read(pOutput, pSize);
@@ -1326,6 +2269,478 @@ namespace NextCash
             result = false;
         }
 
+        /******************************************************************************************
+         * NIST SP 800-38A CTR and GCM specification test vectors
+         ******************************************************************************************/
+        struct ModeVector
+        {
+            Type type;
+            BlockMethod method;
+            const char *key, *vector, *authenticated, *data, *encrypted;
+        };
+        const ModeVector modeVectors[] =
+        {
+            { AES_128, CTR, "2b7e151628aed2a6abf7158809cf4f3c", "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+              "", "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce41"
+              "1e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+              "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff5ae4df3edbd5d35e5b4"
+              "f09020db03eab1e031dda2fbe03d1792170a0f3009cee" },
+            { AES_256, CTR,
+              "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4",
+              "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff",
+              "", "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e5130c81c46a35ce41"
+              "1e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710",
+              "601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c52b0930daa23de94ce87"
+              "017ba2d84988ddfc9c58db67aada613c2dd08457941a6" },
+            { AES_128, GCM, "00000000000000000000000000000000", "000000000000000000000000", "",
+              "00000000000000000000000000000000",
+              "0388dace60b6a392f328c2b971b2fe78ab6e47d42cec13bdf53a67b21257bddf" },
+            { AES_128, GCM, "feffe9928665731c6d6a8f9467308308", "cafebabefacedbaddecaf888",
+              "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+              "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532"
+              "fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+              "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7"
+              "d8f6a5aac84aa051ba30b396a0aac973d58e0915bc94fbc3221a5db94fae95ae7121a47" },
+            { AES_128, GCM, "feffe9928665731c6d6a8f9467308308",
+              "9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728c3c0c95156809539f"
+              "cf0e2429a6b525416aedbf5a0de6a57a637b39b",
+              "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+              "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532"
+              "fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+              "8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca701e4a9a4fba43c90c"
+              "cdcb281d48c7c6fd62875d2aca417034c34aee5619cc5aefffe0bfa462af43c1699d050" },
+            { AES_256, GCM, "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+              "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+              "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532"
+              "fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+              "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da"
+              "7b08b1056828838c5f61e6393ba7a0abcc9f66276fc6ece0f4e1768cddf8853bb2d551b" }
+        };
+        bool modeSuccess = true;
+        Buffer authenticated;
+
+        for(unsigned int i = 0; i < AES_IMPLEMENTATION_COUNT; ++i)
+        {
+            if(!setAESImplementation((AESImplementation)i))
+                continue;
+
+            for(unsigned int j = 0; j < sizeof(modeVectors) / sizeof(ModeVector); ++j)
+            {
+                const ModeVector &modeVector = modeVectors[j];
+                key.clear();
+                key.writeHex(modeVector.key);
+                initVector.clear();
+                initVector.writeHex(modeVector.vector);
+                authenticated.clear();
+                authenticated.writeHex(modeVector.authenticated);
+                data.clear();
+                data.writeHex(modeVector.data);
+                correctOutput.clear();
+                correctOutput.writeHex(modeVector.encrypted);
+
+                encryptedData.clear();
+                Encryptor encryptor(&encryptedData, modeVector.type, modeVector.method);
+                encryptor.setup(key.begin(), key.length(), initVector.begin(),
+                  initVector.length());
+                if(modeVector.method == GCM)
+                    encryptor.addAuthenticatedData(authenticated.begin(), authenticated.length());
+                encryptor.writeStream(&data, data.remaining());
+                encryptor.finalize();
+
+                if(encryptedData != correctOutput)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                      "%s mode vector %d encrypt doesn't match : %s",
+                      aesImplementationName((AESImplementation)i), j,
+                      encryptedData.readHexString(encryptedData.length()).text());
+                    modeSuccess = false;
+                }
+
+                encryptedData.setReadOffset(0);
+                Decryptor decryptor(&encryptedData, modeVector.type, modeVector.method);
+                decryptor.setup(key.begin(), key.length(), initVector.begin(),
+                  initVector.length());
+                if(modeVector.method == GCM)
+                {
+                    decryptor.addAuthenticatedData(authenticated.begin(), authenticated.length());
+                    if(!decryptor.authenticate())
+                    {
+                        Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                          "%s mode vector %d tag doesn't match",
+                          aesImplementationName((AESImplementation)i), j);
+                        modeSuccess = false;
+                    }
+                }
+
+                correctOutput.clear();
+                correctOutput.writeStream(&decryptor, decryptor.remaining());
+                data.setReadOffset(0);
+                if(correctOutput != data)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                      "%s mode vector %d decrypt doesn't match",
+                      aesImplementationName((AESImplementation)i), j);
+                    modeSuccess = false;
+                }
+
+                // Any change to the encrypted data or tag must fail.
+                if(modeVector.method == GCM)
+                    for(unsigned int offset = 0; offset < encryptedData.length(); offset += 7)
+                    {
+                        encryptedData.begin()[offset] ^= 0x01;
+                        if(decryptor.authenticate())
+                        {
+                            Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                              "%s mode vector %d modified at %d authenticated",
+                              aesImplementationName((AESImplementation)i), j, offset);
+                            modeSuccess = false;
+                        }
+                        encryptedData.begin()[offset] ^= 0x01;
+                    }
+            }
+        }
+
+        resetAESImplementation();
+
+        if(modeSuccess)
+            Log::add(Log::INFO, NEXTCASH_ENCRYPT_LOG_NAME, "Passed AES CTR and GCM vectors");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME, "Failed AES CTR and GCM vectors");
+            result = false;
+        }
+
+        /******************************************************************************************
+         * AES implementations
+         ******************************************************************************************/
+        const Encryption::Type types[] = { Encryption::AES_128, Encryption::AES_192,
+          Encryption::AES_256 };
+        const Encryption::BlockMethod methods[] = { Encryption::ECB, Encryption::CBC,
+          Encryption::CTR, Encryption::GCM };
+        // 8 uses the repeated vector path for CBC and the hashed vector path for GCM
+        const unsigned int vectorLengths[] = { 16, 8 };
+        const unsigned int implementationSize = 1000;
+        bool implementationSuccess = true;
+        uint8_t implementationKey[32], implementationVector[16];
+        Buffer implementationData, correctEncrypted, implementationEncrypted, implementationResult;
+        AESImplementation implementation;
+        stream_size size;
+
+        for(unsigned int i = 0; i < sizeof(implementationKey); ++i)
+            implementationKey[i] = Math::randomInt();
+        for(unsigned int i = 0; i < sizeof(implementationVector); ++i)
+            implementationVector[i] = Math::randomInt();
+        for(unsigned int i = 0; i < implementationSize; ++i)
+            implementationData.writeByte(Math::randomInt());
+
+        for(unsigned int typeIndex = 0; typeIndex < 3; ++typeIndex)
+            for(unsigned int methodIndex = 0; methodIndex < 4; ++methodIndex)
+                for(unsigned int vectorIndex = 0; vectorIndex < 2; ++vectorIndex)
+                {
+                    correctEncrypted.clear();
+                    for(unsigned int i = 0; i < AES_IMPLEMENTATION_COUNT; ++i)
+                    {
+                        implementation = (AESImplementation)i;
+                        if(!setAESImplementation(implementation))
+                            continue;
+
+                        // Write in random sizes so some blocks are split between writes.
+                        implementationEncrypted.clear();
+                        Encryptor encryptor(&implementationEncrypted, types[typeIndex],
+                          methods[methodIndex]);
+                        encryptor.setup(implementationKey, keySize(types[typeIndex]),
+                          implementationVector, vectorLengths[vectorIndex]);
+                        if(methods[methodIndex] == GCM)
+                            encryptor.addAuthenticatedData(implementationKey, 20);
+                        implementationData.setReadOffset(0);
+                        while(implementationData.remaining() > 0)
+                        {
+                            size = Math::randomInt() % 100;
+                            if(size > implementationData.remaining())
+                                size = implementationData.remaining();
+                            encryptor.writeStream(&implementationData, size);
+                        }
+                        encryptor.finalize();
+
+                        if(implementation == AES_GENERIC)
+                        {
+                            correctEncrypted.writeStream(&implementationEncrypted,
+                              implementationEncrypted.length());
+                            implementationEncrypted.setReadOffset(0);
+                        }
+                        else if(implementationEncrypted != correctEncrypted)
+                        {
+                            Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                              "%s AES %d method %d vector %d encrypt doesn't match generic",
+                              aesImplementationName(implementation),
+                              keySize(types[typeIndex]) * 8, methods[methodIndex],
+                              vectorLengths[vectorIndex]);
+                            implementationSuccess = false;
+                        }
+
+                        implementationResult.clear();
+                        Decryptor decryptor(&implementationEncrypted, types[typeIndex],
+                          methods[methodIndex]);
+                        decryptor.setup(implementationKey, keySize(types[typeIndex]),
+                          implementationVector, vectorLengths[vectorIndex]);
+                        if(methods[methodIndex] == GCM)
+                        {
+                            decryptor.addAuthenticatedData(implementationKey, 20);
+                            if(!decryptor.authenticate())
+                            {
+                                Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                                  "%s AES %d GCM vector %d tag doesn't match",
+                                  aesImplementationName(implementation),
+                                  keySize(types[typeIndex]) * 8, vectorLengths[vectorIndex]);
+                                implementationSuccess = false;
+                            }
+                        }
+                        while(implementationResult.length() < implementationSize)
+                        {
+                            size = Math::randomInt() % 100;
+                            if(size > implementationSize - implementationResult.length())
+                                size = implementationSize - implementationResult.length();
+                            implementationResult.writeStream(&decryptor, size);
+                        }
+
+                        implementationData.setReadOffset(0);
+                        if(implementationResult != implementationData)
+                        {
+                            Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                              "%s AES %d method %d vector %d decrypt doesn't match",
+                              aesImplementationName(implementation),
+                              keySize(types[typeIndex]) * 8, methods[methodIndex],
+                              vectorLengths[vectorIndex]);
+                            implementationSuccess = false;
+                        }
+                    }
+                }
+
+        resetAESImplementation();
+
+        if(implementationSuccess)
+            Log::add(Log::INFO, NEXTCASH_ENCRYPT_LOG_NAME, "Passed AES implementations");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME, "Failed AES implementations");
+            result = false;
+        }
+
+        /******************************************************************************************
+         * AES GCM threads and random access
+         ******************************************************************************************/
+        const unsigned int accessSize = 100003; // Over the thread size and not whole blocks
+        bool accessSuccess = true;
+        Buffer accessData, accessEncrypted, accessThreadEncrypted;
+        std::vector<uint8_t> accessResult(accessSize);
+        stream_size accessOffset;
+
+        for(unsigned int i = 0; i < accessSize; ++i)
+            accessData.writeByte(Math::randomInt());
+
+        Encryptor accessEncryptor(&accessEncrypted, AES_256, GCM);
+        accessEncryptor.setup(implementationKey, 32, implementationVector, 12);
+        accessEncryptor.writeStream(&accessData, accessSize);
+        accessEncryptor.finalize();
+
+        Encryptor accessThreadEncryptor(&accessThreadEncrypted, AES_256, GCM);
+        accessThreadEncryptor.setup(implementationKey, 32, implementationVector, 12);
+        accessThreadEncryptor.setThreadCount(4);
+        accessData.setReadOffset(0);
+        accessThreadEncryptor.writeStream(&accessData, accessSize);
+        accessThreadEncryptor.finalize();
+
+        if(accessEncrypted.length() != accessSize + GCM_TAG_SIZE ||
+          accessThreadEncrypted != accessEncrypted)
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+              "GCM encrypted with threads doesn't match");
+            accessSuccess = false;
+        }
+
+        Decryptor accessDecryptor(&accessEncrypted, AES_256, GCM);
+        accessDecryptor.setup(implementationKey, 32, implementationVector, 12);
+        accessDecryptor.setThreadCount(4);
+        if(!accessDecryptor.authenticate() || accessDecryptor.length() != accessSize ||
+          !accessDecryptor.read(accessResult.data(), accessSize) ||
+          std::memcmp(accessResult.data(), accessData.begin(), accessSize) != 0)
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME, "GCM decrypted with threads doesn't match");
+            accessSuccess = false;
+        }
+
+        // Read parts at random offsets, including the last bytes.
+        for(unsigned int i = 0; i < 100 && accessSuccess; ++i)
+        {
+            accessOffset = i == 0 ? accessSize - 10 : Math::randomInt() % accessSize;
+            size = Math::randomInt() % 1000;
+            if(size > accessSize - accessOffset)
+                size = accessSize - accessOffset;
+
+            if(!accessDecryptor.setReadOffset(accessOffset) ||
+              accessDecryptor.readOffset() != accessOffset ||
+              accessDecryptor.remaining() != accessSize - accessOffset ||
+              !accessDecryptor.read(accessResult.data(), size) ||
+              std::memcmp(accessResult.data(), accessData.begin() + accessOffset, size) != 0)
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                  "GCM read of %d bytes at offset %d doesn't match", (int)size, (int)accessOffset);
+                accessSuccess = false;
+            }
+        }
+
+        if(accessSuccess)
+            Log::add(Log::INFO, NEXTCASH_ENCRYPT_LOG_NAME, "Passed AES GCM threads and random access");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME, "Failed AES GCM threads and random access");
+            result = false;
+        }
+
+        /******************************************************************************************
+         * AES GCM size limit
+         ******************************************************************************************/
+        // Encrypted data of any size, all zeros, so the end can be read without storing it.
+        class ZeroStream : public InputStream
+        {
+        public:
+            ZeroStream(stream_size pLength) : mLength(pLength), mOffset(0) {}
+
+            stream_size readOffset() const { return mOffset; }
+            bool setReadOffset(stream_size pOffset)
+            {
+                if(pOffset > mLength)
+                    return false;
+                mOffset = pOffset;
+                return true;
+            }
+            stream_size length() const { return mLength; }
+            bool read(void *pOutput, stream_size pSize)
+            {
+                if(pSize > mLength - mOffset)
+                    return false;
+                std::memset(pOutput, 0, pSize);
+                mOffset += pSize;
+                return true;
+            }
+
+        private:
+            stream_size mLength, mOffset;
+        };
+
+        bool limitSuccess = true;
+        uint8_t limitBlock[16], limitCounter[16];
+
+        // One block more than the limit and the tag.
+        ZeroStream limitStream(Encryption::GCM_MAX_SIZE + 16 + GCM_TAG_SIZE);
+        Decryptor limitDecryptor(&limitStream, AES_256, GCM);
+        limitDecryptor.setup(implementationKey, 32, implementationVector, 12);
+
+        // The last block allowed has the highest counter before it wraps back to the tag mask.
+        std::memcpy(limitCounter, implementationVector, 12);
+        std::memset(limitCounter + 12, 0xff, 4);
+        Buffer limitExpected;
+        Encryptor limitCounterEncryptor(&limitExpected, AES_256, ECB);
+        limitCounterEncryptor.setup(implementationKey, 32, NULL, 0);
+        limitCounterEncryptor.write(limitCounter, 16);
+
+        if(!limitDecryptor.setReadOffset(Encryption::GCM_MAX_SIZE - 16) ||
+          !limitDecryptor.read(limitBlock, 16) ||
+          std::memcmp(limitBlock, limitExpected.begin(), 16) != 0)
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME, "GCM last block doesn't match");
+            limitSuccess = false;
+        }
+
+        if(limitDecryptor.read(limitBlock, 16) ||
+          limitDecryptor.setReadOffset(Encryption::GCM_MAX_SIZE + 1) ||
+          limitDecryptor.authenticate())
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME, "GCM read past maximum size");
+            limitSuccess = false;
+        }
+
+        // The size is checked before any data is read.
+        Buffer limitEncrypted;
+        Encryptor limitEncryptor(&limitEncrypted, AES_256, GCM);
+        limitEncryptor.setup(implementationKey, 32, implementationVector, 12);
+        limitEncryptor.write(implementationKey, 16);
+        limitEncryptor.write(implementationKey, Encryption::GCM_MAX_SIZE - 15);
+        limitEncryptor.finalize();
+        if(limitEncryptor.writeOffset() != 16 || limitEncrypted.length() != 16)
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME, "GCM wrote past maximum size");
+            limitSuccess = false;
+        }
+
+        if(limitSuccess)
+            Log::add(Log::INFO, NEXTCASH_ENCRYPT_LOG_NAME, "Passed AES GCM size limit");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME, "Failed AES GCM size limit");
+            result = false;
+        }
+
+        /******************************************************************************************
+         * AES throughput
+         ******************************************************************************************/
+        const unsigned int benchmarkSize = 0x00100000; // 1 MiB
+        std::vector<uint8_t> benchmarkData(benchmarkSize);
+        for(std::vector<uint8_t>::iterator byte = benchmarkData.begin();
+          byte != benchmarkData.end(); ++byte)
+            *byte = Math::randomInt();
+
+        Buffer benchmarkEncrypted, benchmarkResult;
+        benchmarkEncrypted.setSize(benchmarkSize);
+        benchmarkResult.setSize(benchmarkSize);
+
+        const BlockMethod benchmarkMethods[] = { CBC, CTR, GCM };
+        const char *benchmarkMethodNames[] = { "CBC", "CTR", "GCM" };
+
+        for(unsigned int i = 0; i < AES_IMPLEMENTATION_COUNT; ++i)
+        {
+            implementation = (AESImplementation)i;
+            if(!setAESImplementation(implementation))
+                continue;
+
+            for(unsigned int j = 0; j < 3; ++j)
+            {
+                benchmarkEncrypted.clear();
+                Encryptor encryptor(&benchmarkEncrypted, AES_256, benchmarkMethods[j]);
+                encryptor.setup(implementationKey, 32, implementationVector, 16);
+                Timer encryptTimer(true);
+                encryptor.write(benchmarkData.data(), benchmarkSize);
+                encryptor.finalize();
+                encryptTimer.stop();
+
+                benchmarkResult.clear();
+                Decryptor decryptor(&benchmarkEncrypted, AES_256, benchmarkMethods[j]);
+                decryptor.setup(implementationKey, 32, implementationVector, 16);
+                Timer decryptTimer(true);
+                benchmarkResult.writeStream(&decryptor, benchmarkSize);
+                decryptTimer.stop();
+
+                Log::addFormatted(Log::INFO, NEXTCASH_ENCRYPT_LOG_NAME,
+                  "AES 256 %s %-7s : encrypt %d MB/s, decrypt %d MB/s", benchmarkMethodNames[j],
+                  aesImplementationName(implementation),
+                  (int)(((double)benchmarkSize / 1000000.0) /
+                  ((double)encryptTimer.microseconds() / 1000000.0)),
+                  (int)(((double)benchmarkSize / 1000000.0) /
+                  ((double)decryptTimer.microseconds() / 1000000.0)));
+
+                if(benchmarkResult.length() != benchmarkSize ||
+                  std::memcmp(benchmarkResult.begin(), benchmarkData.data(), benchmarkSize) != 0)
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_ENCRYPT_LOG_NAME,
+                      "Failed AES 256 %s %s throughput data doesn't match",
+                      benchmarkMethodNames[j], aesImplementationName(implementation));
+                    result = false;
+                }
+            }
+        }
+
+        resetAESImplementation();
+
         return result;
     }
 }
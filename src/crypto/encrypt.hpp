@@ -26,12 +26,33 @@ namespace NextCash
 
         enum BlockMethod { NONE,
                            ECB,    // Electronic Codebook
-                           CBC };  // Cipher Block Chaining
+                           CBC,    // Cipher Block Chaining
+                           CTR,    // Counter, initialization vector is the first counter block
+                           GCM };  // Galois/Counter Mode, CTR with an authentication tag
+
+        // CTR and GCM aren't padded. GCM writes a tag of this size after the encrypted data.
+        static const unsigned int GCM_TAG_SIZE = 16;
+        // GCM only increments the last 32 bits of the counter, so past 2^32 - 2 blocks it would
+        //   repeat the key stream (SP 800-38D).
+        static const stream_size GCM_MAX_SIZE = ((stream_size)0xffffffff - 1) * 16;
+
+        // AES implementation used by Encryptor and Decryptor objects created after it is set.
+        enum AESImplementation { AES_GENERIC,   // T-tables
+                                 AES_NI };      // x86 AES instructions, and PCLMUL for GCM
+        static const unsigned int AES_IMPLEMENTATION_COUNT = 2;
+
+        bool aesSupported(AESImplementation pImplementation);
+        // Returns false if the CPU doesn't support the implementation.
+        bool setAESImplementation(AESImplementation pImplementation);
+        void resetAESImplementation(); // Go back to the fastest implementation.
+        AESImplementation aesImplementation();
+        const char *aesImplementationName(AESImplementation pImplementation);
 
         bool test();
     }
 
     class AES;
+    class GHASH;
 
     class Encryptor : public OutputStream
     {
@@ -45,25 +66,51 @@ namespace NextCash
         void setup(const uint8_t *pKey, int pKeyLength,
           const uint8_t *pInitializationVector, int pInitializationVectorLength);
 
-        void finalize(); // Write any remaining data to output
+        // Data authenticated by the GCM tag without being encrypted, like a file header. Must be
+        //   called after setup and before writing. Returns false if it is too late or the block
+        //   method isn't GCM.
+        bool addAuthenticatedData(const uint8_t *pData, stream_size pSize);
+
+        // Threads used to encrypt large CTR and GCM writes. Zero uses the number of hardware
+        //   threads.
+        void setThreadCount(unsigned int pThreadCount);
+
+        // Write any remaining data to output. Also writes the tag for GCM.
+        void finalize();
 
         // Virtual overloaded functions
         stream_size writeOffset() const { return mByteCount; }
+        // Writes that would take GCM past GCM_MAX_SIZE are dropped and no tag is written.
         void write(const void *pInput, stream_size pSize);
 
     private:
 
+        // Whole blocks are encrypted from the input into a chunk and written together. Chunks
+        //   are larger when using threads.
+        static const unsigned int CHUNK_SIZE = 4096;
+        static const unsigned int THREAD_CHUNK_SIZE = 0x00100000;
+
         Encryption::Type mType;
         Encryption::BlockMethod mBlockMethod;
         std::vector<uint8_t> mVector;
         stream_size mByteCount;
         unsigned int mBlockSize;
-        uint8_t *mBlock;
-        Buffer mData;
+        uint8_t *mBlock; // Partial block waiting for more data
+        unsigned int mBlockLength;
+        std::vector<uint8_t> mChunk;
+        unsigned int mThreadCount;
         AES *mAES;
         OutputStream *mOutput;
 
-        void process();
+        // CTR and GCM
+        uint8_t mCounter[16]; // Next counter block
+        uint8_t mTagMask[16]; // Encrypted first counter block
+        GHASH *mGHASH;
+        stream_size mAuthenticatedSize;
+        bool mFinalized;
+        bool mFailed; // Size limit exceeded
+
+        void process(const uint8_t *pInput, stream_size pCount);
 
     };
 
@@ -76,27 +123,59 @@ namespace NextCash
           Encryption::BlockMethod pBlockMethod = Encryption::CBC);
         ~Decryptor();
 
+        // The input read offset should be at the start of the encrypted data.
         void setup(const uint8_t *pKey, int pKeyLength,
           const uint8_t *pInitializationVector, int pInitializationVectorLength);
 
+        // Same as Encryptor::addAuthenticatedData. Used by authenticate.
+        bool addAuthenticatedData(const uint8_t *pData, stream_size pSize);
+
+        // Returns true if the GCM tag at the end of the input matches the encrypted data. Reads
+        //   all of the encrypted data, then returns the input to the current offset.
+        bool authenticate();
+
+        // Same as Encryptor::setThreadCount.
+        void setThreadCount(unsigned int pThreadCount);
+
         // Virtual overloaded functions
-        stream_size readOffset() const { return mInput->readOffset(); }
-        stream_size length() const { return mInput->length(); }
-        stream_size remaining() const { return mInput->remaining(); }
+        // Offsets are in the input. Blocks are decrypted ahead of reads, so decrypted data not
+        //   read yet is included.
+        stream_size readOffset() const { return mInput->readOffset() - mData.remaining(); }
+        // CTR and GCM can start reading at any offset after the start of the encrypted data, so
+        //   separate parts can be decrypted in parallel. GCM reads fail past GCM_MAX_SIZE.
+        bool setReadOffset(stream_size pOffset);
+        stream_size length() const;
+        stream_size remaining() const { return inputRemaining() + mData.remaining(); }
         bool read(void *pOutput, stream_size pSize);
 
     private:
 
+        // Blocks are read and decrypted a chunk at a time.
+        static const unsigned int CHUNK_SIZE = 4096;
+        static const unsigned int THREAD_CHUNK_SIZE = 0x00100000;
+
         Encryption::Type mType;
         Encryption::BlockMethod mBlockMethod;
         std::vector<uint8_t> mVector;
         unsigned int mBlockSize;
-        uint8_t *mBlock, *mEncryptedBlock;
+        uint8_t *mEncryptedBlock;
+        std::vector<uint8_t> mChunk;
+        unsigned int mThreadCount;
         Buffer mData;
         AES *mAES;
         InputStream *mInput;
 
-        void process();
+        // CTR and GCM
+        stream_size mStartOffset; // Input offset of the encrypted data
+        uint8_t mFirstCounter[16]; // Counter block of the first encrypted block
+        uint8_t mTagMask[16];
+        GHASH *mGHASH;
+        std::vector<uint8_t> mAuthenticatedData;
+
+        // Encrypted bytes left in the input, not including the GCM tag.
+        stream_size inputRemaining() const;
+
+        void process(unsigned int pCount, stream_size pBlockOffset);
 
     };
 }
@@ -0,0 +1,372 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#include "merkle_tree.hpp"
+
+#include "digest.hpp"
+#include "log.hpp"
+#include "thread.hpp"
+#include "timer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace NextCash
+{
+    const unsigned int MerkleTree::HASH_SIZE;
+    const unsigned int MerkleTree::CHUNK_LEAVES;
+    const unsigned int MerkleTree::CHUNK_LEVELS;
+
+    void MerkleTree::hashLevel(unsigned int pLevel, unsigned int pBegin, unsigned int pEnd)
+    {
+        const uint8_t *children = mLevels[pLevel].data();
+        unsigned int childCount = levelSize(pLevel);
+        uint8_t *parents = mLevels[pLevel + 1].data();
+
+        // Children pairs are consecutive 64 byte inputs.
+        unsigned int pairsEnd = std::min(pEnd, childCount / 2);
+        if(pairsEnd > pBegin)
+            Digest::sha256SHA256Batch64(children + (pBegin * HASH_SIZE * 2), pairsEnd - pBegin,
+              parents + (pBegin * HASH_SIZE));
+
+        if(pEnd > pairsEnd)
+        {
+            // Last child is paired with itself.
+            uint8_t pair[HASH_SIZE * 2];
+            std::memcpy(pair, children + ((childCount - 1) * HASH_SIZE), HASH_SIZE);
+            std::memcpy(pair + HASH_SIZE, pair, HASH_SIZE);
+            Digest::sha256SHA256Batch64(pair, 1, parents + (pairsEnd * HASH_SIZE));
+        }
+    }
+
+    bool MerkleTree::assign(const HashList &pLeaves, unsigned int pThreadCount)
+    {
+        mLevels.clear();
+        if(pLeaves.size() == 0)
+            return true;
+
+        // Allocate all levels so threads can fill separate parts of them.
+        unsigned int count = pLeaves.size();
+        mLevels.emplace_back(count * HASH_SIZE);
+        while(count > 1)
+        {
+            count = (count + 1) / 2;
+            mLevels.emplace_back(count * HASH_SIZE);
+        }
+
+        uint8_t *leaf = mLevels.front().data();
+        for(HashList::const_iterator hash = pLeaves.begin(); hash != pLeaves.end();
+          ++hash, leaf += HASH_SIZE)
+        {
+            if(hash->size() != HASH_SIZE)
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME,
+                  "Leaf %d is %d bytes, not %d", hash - pLeaves.begin(), hash->size(),
+                  HASH_SIZE);
+                mLevels.clear();
+                return false;
+            }
+            std::memcpy(leaf, hash->data(), HASH_SIZE);
+        }
+
+        // Subtrees of CHUNK_LEAVES leaves don't depend on each other up to their roots, so each
+        //   is built by one thread.
+        unsigned int chunkCount = (pLeaves.size() + CHUNK_LEAVES - 1) / CHUNK_LEAVES;
+        parallelFor("MerkleTree", chunkCount, [this](unsigned int pChunk)
+        {
+            unsigned int begin, end;
+            for(unsigned int level = 0; level < CHUNK_LEVELS && level + 1 < mLevels.size();
+              ++level)
+            {
+                begin = (pChunk * CHUNK_LEAVES) >> (level + 1);
+                end = std::min(((pChunk + 1) * CHUNK_LEAVES) >> (level + 1),
+                  levelSize(level + 1));
+                hashLevel(level, begin, end);
+            }
+        }, pThreadCount);
+
+        for(unsigned int level = CHUNK_LEVELS; level + 1 < mLevels.size(); ++level)
+            hashLevel(level, 0, levelSize(level + 1));
+
+        return true;
+    }
+
+    bool MerkleTree::append(const Hash &pLeaf)
+    {
+        if(pLeaf.size() != HASH_SIZE)
+        {
+            Log::addFormatted(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME,
+              "Appended leaf is %d bytes, not %d", pLeaf.size(), HASH_SIZE);
+            return false;
+        }
+
+        if(mLevels.size() == 0)
+            mLevels.emplace_back();
+        mLevels.front().insert(mLevels.front().end(), pLeaf.data(), pLeaf.data() + HASH_SIZE);
+
+        // Only the right edge of each level changes.
+        unsigned int index = levelSize(0) - 1;
+        for(unsigned int level = 0; levelSize(level) > 1; ++level)
+        {
+            if(level + 1 == mLevels.size())
+                mLevels.emplace_back();
+
+            index /= 2;
+            if(levelSize(level + 1) <= index)
+                mLevels[level + 1].resize((index + 1) * HASH_SIZE);
+            hashLevel(level, index, index + 1);
+        }
+
+        return true;
+    }
+
+    Hash MerkleTree::root() const
+    {
+        if(mLevels.size() == 0)
+            return Hash(HASH_SIZE);
+
+        Hash result;
+        result.write(mLevels.back().data(), HASH_SIZE);
+        return result;
+    }
+
+    bool MerkleTree::getProof(unsigned int pIndex, HashList &pProof) const
+    {
+        pProof.clear();
+        if(pIndex >= size())
+            return false;
+
+        unsigned int sibling;
+        for(unsigned int level = 0; level + 1 < mLevels.size(); ++level, pIndex /= 2)
+        {
+            sibling = pIndex ^ 1;
+            if(sibling >= levelSize(level))
+                sibling = pIndex; // Paired with itself
+            pProof.emplace_back();
+            pProof.back().write(mLevels[level].data() + (sibling * HASH_SIZE), HASH_SIZE);
+        }
+
+        return true;
+    }
+
+    bool MerkleTree::verify(const Hash &pLeaf, unsigned int pIndex, const HashList &pProof,
+      const Hash &pRoot)
+    {
+        if(pLeaf.size() != HASH_SIZE || pRoot.size() != HASH_SIZE)
+            return false;
+
+        uint8_t pair[HASH_SIZE * 2], hash[HASH_SIZE];
+        std::memcpy(hash, pLeaf.data(), HASH_SIZE);
+
+        for(HashList::const_iterator sibling = pProof.begin(); sibling != pProof.end();
+          ++sibling, pIndex /= 2)
+        {
+            if(sibling->size() != HASH_SIZE)
+                return false;
+
+            if(pIndex & 1)
+            {
+                std::memcpy(pair, sibling->data(), HASH_SIZE);
+                std::memcpy(pair + HASH_SIZE, hash, HASH_SIZE);
+            }
+            else
+            {
+                std::memcpy(pair, hash, HASH_SIZE);
+                std::memcpy(pair + HASH_SIZE, sibling->data(), HASH_SIZE);
+            }
+            Digest::sha256SHA256Batch64(pair, 1, hash);
+        }
+
+        // An index beyond the proof means the proof is for a different leaf.
+        return pIndex == 0 && std::memcmp(hash, pRoot.data(), HASH_SIZE) == 0;
+    }
+
+    Hash MerkleTree::calculateRoot(const HashList &pLeaves, unsigned int pThreadCount)
+    {
+        MerkleTree tree(pLeaves, pThreadCount);
+        return tree.root();
+    }
+
+    // Merkle root calculated with a Digest for each node.
+    static Hash merkleTreeDigestRoot(const HashList &pLeaves)
+    {
+        if(pLeaves.size() == 0)
+            return Hash(MerkleTree::HASH_SIZE);
+
+        HashList level = pLeaves, nextLevel;
+        while(level.size() > 1)
+        {
+            nextLevel.clear();
+            for(unsigned int i = 0; i < level.size(); i += 2)
+            {
+                Digest digest(Digest::SHA256_SHA256);
+                level[i].write(&digest);
+                if(i + 1 < level.size())
+                    level[i + 1].write(&digest);
+                else
+                    level[i].write(&digest);
+                nextLevel.emplace_back(MerkleTree::HASH_SIZE);
+                digest.getResult(&nextLevel.back());
+            }
+            level.swap(nextLevel);
+        }
+
+        return level.front();
+    }
+
+    bool MerkleTree::test()
+    {
+        Log::add(Log::INFO, NEXTCASH_MERKLE_TREE_LOG_NAME,
+          "------------- Starting Merkle Tree Tests -------------");
+
+        bool success = true;
+
+        /******************************************************************************************
+         * Block 100000
+         *****************************************************************************************/
+        HashList leaves;
+        leaves.emplace_back("8c14f0db3df150123e6f3dbbf30f8b955a8249b62ac1d1ff16284aefa3d06d87");
+        leaves.emplace_back("fff2525b8931402dd09222c50775608f75787bd2b87e56995a7bdd30f79702c4");
+        leaves.emplace_back("6359f0868171b1d194cbee1af2f16ea598ae8fad666d9b012c8ed2b79a236ec4");
+        leaves.emplace_back("e9a66845e05d5abc0ad04ec80f774a7e585c6e8db975962d069a522137b80c1d");
+        Hash correctRoot("f3e94742aca4b5ef85488dc37c06c3282295ffec960994b2c0d5ac2a25a95766");
+
+        if(calculateRoot(leaves) == correctRoot && merkleTreeDigestRoot(leaves) == correctRoot)
+            Log::add(Log::INFO, NEXTCASH_MERKLE_TREE_LOG_NAME, "Passed block 100000");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME, "Failed block 100000");
+            Log::addFormatted(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME, "Correct : %s",
+              correctRoot.hex().text());
+            Log::addFormatted(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME, "Result  : %s",
+              calculateRoot(leaves).hex().text());
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Incremental append
+         *****************************************************************************************/
+        bool appendSuccess = true;
+        MerkleTree tree;
+        Hash leaf(HASH_SIZE);
+
+        leaves.clear();
+        if(!tree.root().isZero())
+            appendSuccess = false;
+        for(unsigned int i = 0; i < 300 && appendSuccess; ++i)
+        {
+            leaf.randomize();
+            leaves.push_back(leaf);
+            if(!tree.append(leaf) || tree.size() != leaves.size() ||
+              tree.root() != merkleTreeDigestRoot(leaves))
+            {
+                Log::addFormatted(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME,
+                  "Root doesn't match after appending leaf %d", i);
+                appendSuccess = false;
+            }
+        }
+
+        if(tree.append(Hash(20)))
+            appendSuccess = false;
+
+        if(appendSuccess)
+            Log::add(Log::INFO, NEXTCASH_MERKLE_TREE_LOG_NAME, "Passed incremental append");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME, "Failed incremental append");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Proofs
+         *****************************************************************************************/
+        bool proofSuccess = true;
+        HashList allLeaves = leaves, proof;
+        Hash root;
+
+        for(unsigned int count = 1; count < 40 && proofSuccess; ++count)
+        {
+            leaves.assign(allLeaves.begin(), allLeaves.begin() + count);
+            if(!tree.assign(leaves))
+                proofSuccess = false;
+            root = tree.root();
+            for(unsigned int i = 0; i < count; ++i)
+            {
+                if(!tree.getProof(i, proof) || !verify(leaves[i], i, proof, root))
+                {
+                    Log::addFormatted(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME,
+                      "Proof for leaf %d of %d failed", i, count);
+                    proofSuccess = false;
+                }
+
+                // Wrong leaf, index or root
+                if(verify(leaves[(i + 1) % count], i, proof, root) && count > 1)
+                    proofSuccess = false;
+                if(verify(leaves[i], i + (1 << proof.size()), proof, root))
+                    proofSuccess = false;
+                if(verify(leaves[i], i, proof, leaves[i]) && count > 1)
+                    proofSuccess = false;
+            }
+        }
+
+        if(tree.getProof(tree.size(), proof))
+            proofSuccess = false;
+
+        if(proofSuccess)
+            Log::add(Log::INFO, NEXTCASH_MERKLE_TREE_LOG_NAME, "Passed proofs");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME, "Failed proofs");
+            success = false;
+        }
+
+        /******************************************************************************************
+         * Threads
+         *****************************************************************************************/
+        const unsigned int leafCount = 100000;
+        leaves.clear();
+        for(unsigned int i = 0; i < leafCount; ++i)
+        {
+            leaf.randomize();
+            leaves.push_back(leaf);
+        }
+
+        Timer digestTimer(true);
+        Hash digestRoot = merkleTreeDigestRoot(leaves);
+        digestTimer.stop();
+
+        Timer singleTimer(true);
+        Hash singleRoot = calculateRoot(leaves, 1);
+        singleTimer.stop();
+
+        Timer threadsTimer(true);
+        Hash threadsRoot = calculateRoot(leaves, 4);
+        threadsTimer.stop();
+
+        Timer appendTimer(true);
+        tree.clear();
+        for(HashList::iterator hash = leaves.begin(); hash != leaves.end(); ++hash)
+            tree.append(*hash);
+        appendTimer.stop();
+
+        Log::addFormatted(Log::INFO, NEXTCASH_MERKLE_TREE_LOG_NAME,
+          "%d leaves : Digest per node %d us, 1 thread %d us, 4 threads %d us, append %d us",
+          leafCount, (int)digestTimer.microseconds(), (int)singleTimer.microseconds(),
+          (int)threadsTimer.microseconds(), (int)appendTimer.microseconds());
+
+        if(singleRoot == digestRoot && threadsRoot == digestRoot && tree.root() == digestRoot)
+            Log::add(Log::INFO, NEXTCASH_MERKLE_TREE_LOG_NAME, "Passed threads");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_MERKLE_TREE_LOG_NAME, "Failed threads");
+            success = false;
+        }
+
+        return success;
+    }
+}
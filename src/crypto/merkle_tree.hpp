@@ -0,0 +1,85 @@
+/**************************************************************************
+ * Copyright 2018 NextCash, LLC                                           *
+ * Contributors :                                                         *
+ *   Curtis Ellis <curtis@nextcash.tech>                                  *
+ * Distributed under the MIT software license, see the accompanying       *
+ * file license.txt or http://www.opensource.org/licenses/mit-license.php *
+ **************************************************************************/
+#ifndef NEXTCASH_MERKLE_TREE_HPP
+#define NEXTCASH_MERKLE_TREE_HPP
+
+#include "hash.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#define NEXTCASH_MERKLE_TREE_LOG_NAME "MerkleTree"
+
+
+namespace NextCash
+{
+    // Bitcoin style merkle tree of 32 byte hashes. Each node is SHA256_SHA256 of its two children
+    //   concatenated. When a level has an odd number of nodes the last one is paired with itself.
+    // Every level is kept so appending a leaf only recalculates the nodes above it and proofs are
+    //   lookups.
+    class MerkleTree
+    {
+    public:
+
+        static const unsigned int HASH_SIZE = 32;
+
+        MerkleTree() {}
+        // Builds the tree using pThreadCount threads. Zero uses the number of hardware threads.
+        MerkleTree(const HashList &pLeaves, unsigned int pThreadCount = 1)
+          { assign(pLeaves, pThreadCount); }
+
+        // Replaces the tree with one built from pLeaves using pThreadCount threads. Zero uses the
+        //   number of hardware threads.
+        // Returns false and leaves the tree empty if any leaf isn't 32 bytes.
+        bool assign(const HashList &pLeaves, unsigned int pThreadCount = 1);
+
+        // Adds a leaf to the end and recalculates the nodes above it.
+        // Returns false if the leaf isn't 32 bytes.
+        bool append(const Hash &pLeaf);
+
+        void clear() { mLevels.clear(); }
+
+        // Number of leaves.
+        unsigned int size() const { return mLevels.size() == 0 ? 0 : levelSize(0); }
+
+        // Zero hash when there are no leaves.
+        Hash root() const;
+
+        // Sets pProof to the sibling of each node on the path from the leaf to the root.
+        // Returns false if pIndex isn't a leaf.
+        bool getProof(unsigned int pIndex, HashList &pProof) const;
+
+        // Returns true if the leaf at pIndex with pProof hashes to pRoot.
+        static bool verify(const Hash &pLeaf, unsigned int pIndex, const HashList &pProof,
+          const Hash &pRoot);
+
+        // Root of pLeaves without keeping the tree.
+        static Hash calculateRoot(const HashList &pLeaves, unsigned int pThreadCount = 1);
+
+        static bool test();
+
+    private:
+
+        // Subtrees of this many leaves are built by one thread. Must be a power of two.
+        static const unsigned int CHUNK_LEAVES = 0x1000;
+        static const unsigned int CHUNK_LEVELS = 12;
+
+        unsigned int levelSize(unsigned int pLevel) const
+          { return mLevels[pLevel].size() / HASH_SIZE; }
+
+        // Calculates nodes pBegin to pEnd - 1 of the level above pLevel.
+        void hashLevel(unsigned int pLevel, unsigned int pBegin, unsigned int pEnd);
+
+        // Nodes of each level as consecutive 32 byte hashes. Level zero is the leaves and the
+        //   last level has one node, the root.
+        std::vector<std::vector<uint8_t> > mLevels;
+
+    };
+}
+
+#endif
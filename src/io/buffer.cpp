@@ -13,6 +13,7 @@
 
 #include <cstring>
 #include <new>
+#include <utility>
 
 #define NEXTCASH_BUFFER_LOG_NAME "Buffer"
 
@@ -49,6 +50,14 @@ namespace NextCash
             *this = pCopy;
     }
 
+    Buffer::Buffer(Buffer &&pValue) noexcept
+    {
+        mData = NULL;
+        mSize = 0;
+        mSharing = false;
+        *this = std::move(pValue);
+    }
+
     Buffer::Buffer(stream_size pSize)
     {
         mSize = pSize;
@@ -100,6 +109,29 @@ namespace NextCash
         return *this;
     }
 
+    const Buffer &Buffer::operator = (Buffer &&pRight) noexcept
+    {
+        if(this == &pRight)
+            return *this;
+
+        clear();
+        mData = pRight.mData;
+        mSize = pRight.mSize;
+        mReadOffset = pRight.mReadOffset;
+        mWriteOffset = pRight.mWriteOffset;
+        mEndOffset = pRight.mEndOffset;
+        mAutoFlush = pRight.mAutoFlush;
+        mSharing = pRight.mSharing;
+
+        pRight.mData = NULL;
+        pRight.mSize = 0;
+        pRight.mReadOffset = 0;
+        pRight.mWriteOffset = 0;
+        pRight.mEndOffset = 0;
+        pRight.mSharing = false;
+        return *this;
+    }
+
     bool Buffer::read(void *pOutput, stream_size pSize)
     {
         stream_size toRead = pSize;
@@ -497,6 +529,36 @@ namespace NextCash
             result = false;
         }
 
+        /******************************************************************************************
+         * Move
+         ******************************************************************************************/
+        Buffer moveSource;
+        moveSource.writeString("move data");
+        moveSource.readByte();
+        uint8_t *moveData = moveSource.begin();
+        Buffer moveConstructed(std::move(moveSource));
+        if(moveConstructed.begin() == moveData && moveSource.begin() == NULL &&
+          moveSource.length() == 0 && moveConstructed.length() == 9 &&
+          moveConstructed.readOffset() == 1 && moveConstructed.readString(8) == "ove data")
+            Log::add(Log::INFO, NEXTCASH_BUFFER_LOG_NAME, "Passed move constructor");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_BUFFER_LOG_NAME, "Failed move constructor");
+            result = false;
+        }
+
+        Buffer moveAssigned;
+        moveAssigned.writeString("old data");
+        moveAssigned = std::move(moveConstructed);
+        if(moveAssigned.begin() == moveData && moveConstructed.begin() == NULL &&
+          moveAssigned.length() == 9)
+            Log::add(Log::INFO, NEXTCASH_BUFFER_LOG_NAME, "Passed move assign");
+        else
+        {
+            Log::add(Log::ERROR, NEXTCASH_BUFFER_LOG_NAME, "Failed move assign");
+            result = false;
+        }
+
         return result;
     }
 }
@@ -23,6 +23,7 @@ namespace NextCash
         Buffer();
         Buffer(const Buffer &pCopy);
         Buffer(Buffer &pCopy, bool pShare = false);
+        Buffer(Buffer &&pValue) noexcept; // Takes memory of pValue. pValue is left empty.
         Buffer(stream_size pSize);
         ~Buffer();
 
@@ -63,6 +64,7 @@ namespace NextCash
         void writeStreamCompact(InputStream &pInput, stream_size pSize);
 
         const Buffer &operator = (const Buffer &pRight);
+        const Buffer &operator = (Buffer &&pRight) noexcept;
 
         bool operator == (Buffer &pRight) const
         {